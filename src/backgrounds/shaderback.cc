@@ -19,6 +19,12 @@ color_t shader_Background_t::operator() (const vector3d_t &dir, renderState_t &s
 	return color;
 }
 
+void shader_Background_t::replaceShaders(const map<const shader_t *,shader_t *> &m)
+{
+	map<const shader_t *,shader_t *>::const_iterator i=m.find(input);
+	if(i!=m.end()) input=i->second;
+}
+
 background_t *shader_Background_t::factory(paramMap_t &params,renderEnvironment_t &render)
 {
 
@@ -23,6 +23,7 @@ class shader_Background_t: public background_t
 		shader_Background_t(shader_t* in);
 		//virtual ~shader_Background_t();
 		virtual color_t operator () (const vector3d_t &dir, renderState_t &state, bool filtered) const;
+		virtual void replaceShaders(const std::map<const shader_t *,shader_t *> &m);
 		static background_t *factory(paramMap_t &,renderEnvironment_t &);
 	protected:
 		shader_t *input;
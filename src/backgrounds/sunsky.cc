@@ -1,5 +1,6 @@
 
 #include "sunsky.h"
+#include <algorithm>
 // sunsky, from 'A Practical Analytic Model For DayLight" by Preetham, Shirley & Smits.
 // http://www.cs.utah.edu/vissim/papers/sunsky/
 // based on the actual code by Brian Smits
@@ -17,7 +18,8 @@ background_t *constBackground_t::factory(paramMap_t &params,renderEnvironment_t
 }
 
 sunskyBackground_t::sunskyBackground_t(const point3d_t dir, PFLOAT turb,
-		PFLOAT a_var, PFLOAT b_var, PFLOAT c_var, PFLOAT d_var, PFLOAT e_var)
+		PFLOAT a_var, PFLOAT b_var, PFLOAT c_var, PFLOAT d_var, PFLOAT e_var,
+		int lutres, bool imp):tw(0), th(0), cellSum(0)
 {
 	sunDir.set(dir.x, dir.y, dir.z);
 	sunDir.normalize();
@@ -56,6 +58,12 @@ sunskyBackground_t::sunskyBackground_t(const point3d_t dir, PFLOAT turb,
 	perez_y[2] = (-0.00792 * T + 0.21023) * c_var;
 	perez_y[3] = (-0.04405 * T - 1.65369) * d_var;
 	perez_y[4] = (-0.01092 * T + 0.05291) * e_var;
+
+	if (lutres>0) {
+		buildTable(lutres);
+		tableReport(4096);
+		if (imp) buildDistribution();
+	}
 };
 
 
@@ -92,7 +100,7 @@ double sunskyBackground_t::AngleBetween(double thetav, double phiv) const
   return acos(cospsi);
 }
 
-color_t sunskyBackground_t::operator() (const vector3d_t &dir, renderState_t &state, bool filtered) const
+color_t sunskyBackground_t::skyColor(const vector3d_t &dir) const
 {
 	vector3d_t Iw = dir;
 	Iw.normalize();
@@ -141,6 +149,139 @@ color_t sunskyBackground_t::operator() (const vector3d_t &dir, renderState_t &st
   return skycolor;
 }
 
+// the Perez model only depends on direction, so it is tabulated once at init
+void sunskyBackground_t::buildTable(int res)
+{
+	tw = 2*res;
+	th = res+1;
+	table.resize(tw*th);
+	for (int i=0;i<th;++i)
+	{
+		PFLOAT theta = M_PI*(PFLOAT)i/(PFLOAT)(th-1);
+		PFLOAT st=sin(theta), ct=cos(theta);
+		for (int j=0;j<tw;++j)
+		{
+			PFLOAT phi = 2.0*M_PI*(PFLOAT)j/(PFLOAT)tw - M_PI;
+			table[i*tw+j] = skyColor(vector3d_t(st*cos(phi), st*sin(phi), ct));
+		}
+	}
+}
+
+color_t sunskyBackground_t::tableLookup(const vector3d_t &dir) const
+{
+	vector3d_t Iw = dir;
+	Iw.normalize();
+	PFLOAT z = Iw.z;
+	if (z>1.0) z=1.0; else if (z<-1.0) z=-1.0;
+	PFLOAT phi;
+	if ((Iw.y==0.0) && (Iw.x==0.0))
+		phi = M_PI*0.5;
+	else
+		phi = atan2(Iw.y, Iw.x);
+
+	PFLOAT fv = acos(z)*M_1_PI*(PFLOAT)(th-1);
+	int i = (int)fv;
+	if (i>(th-2)) i = th-2;
+	PFLOAT dv = fv-(PFLOAT)i;
+	PFLOAT fu = (phi+M_PI)*0.5*M_1_PI*(PFLOAT)tw;
+	int j = (int)fu;
+	PFLOAT du = fu-(PFLOAT)j;
+	j %= tw;
+	int j1 = (j+1)%tw;
+
+	const color_t *r0 = &table[i*tw], *r1 = r0+tw;
+	return (1.0-dv)*((1.0-du)*r0[j] + du*r0[j1]) + dv*((1.0-du)*r1[j] + du*r1[j1]);
+}
+
+// compares the table against the analytic model on a spiral of directions
+void sunskyBackground_t::tableReport(int nsamples) const
+{
+	double maxerr=0, sumerr=0;
+	for (int k=0;k<nsamples;++k)
+	{
+		PFLOAT z = 1.0-2.0*((PFLOAT)k+0.5)/(PFLOAT)nsamples;
+		PFLOAT r = sqrt(1.0-z*z);
+		PFLOAT phi = 2.399963229728653*(PFLOAT)k;	// golden angle
+		vector3d_t d(r*cos(phi), r*sin(phi), z);
+		color_t ana = skyColor(d);
+		CFLOAT ref = std::max(ana.abscol2bri(), (CFLOAT)0.01);
+		double err = (tableLookup(d)-ana).abscol2bri()/ref;
+		if (err>maxerr) maxerr = err;
+		sumerr += err*err;
+	}
+	cout << "[sunsky]: sky table " << tw << "x" << th << ", max error " << 100.0*maxerr
+			 << "%, rms error " << 100.0*sqrt(sumerr/(double)nsamples) << "% ("
+			 << nsamples << " directions)\n";
+}
+
+// piecewise constant distribution over the table cells, weighted by solid angle
+void sunskyBackground_t::buildDistribution()
+{
+	int rows = th-1;
+	marginal.resize(rows+1);
+	conditional.resize(rows*(tw+1));
+	marginal[0] = 0;
+	for (int i=0;i<rows;++i)
+	{
+		PFLOAT st = sin(M_PI*((PFLOAT)i+0.5)/(PFLOAT)rows);
+		PFLOAT *c = &conditional[i*(tw+1)];
+		c[0] = 0;
+		for (int j=0;j<tw;++j)
+		{
+			int j1 = (j+1)%tw;
+			const color_t &c00 = table[i*tw+j], &c01 = table[i*tw+j1];
+			const color_t &c10 = table[(i+1)*tw+j], &c11 = table[(i+1)*tw+j1];
+			CFLOAT w = fabs(c00.getR())+fabs(c00.getG())+fabs(c00.getB())
+							 + fabs(c01.getR())+fabs(c01.getG())+fabs(c01.getB())
+							 + fabs(c10.getR())+fabs(c10.getG())+fabs(c10.getB())
+							 + fabs(c11.getR())+fabs(c11.getG())+fabs(c11.getB());
+			c[j+1] = c[j] + w*st;
+		}
+		marginal[i+1] = marginal[i] + c[tw];
+	}
+	cellSum = marginal[rows];
+	if (cellSum<=0) {
+		cout << "[sunsky]: sky is black, importance sampling disabled\n";
+		marginal.clear();
+		conditional.clear();
+	}
+}
+
+bool sunskyBackground_t::sample(PFLOAT s1, PFLOAT s2, vector3d_t &dir, PFLOAT &pdf) const
+{
+	if (marginal.empty()) return false;
+	int rows = th-1;
+
+	// row from the marginal, the remainder of s1 places the sample inside the cell
+	PFLOAT t = s1*cellSum;
+	int i = std::upper_bound(marginal.begin()+1, marginal.end(), t) - (marginal.begin()+1);
+	if (i>=rows) i = rows-1;
+	PFLOAT rw = marginal[i+1]-marginal[i];
+	PFLOAT dv = (rw>0) ? (t-marginal[i])/rw : 0.5;
+
+	const PFLOAT *c = &conditional[i*(tw+1)];
+	t = s2*c[tw];
+	int j = std::upper_bound(c+1, c+tw+1, t) - (c+1);
+	if (j>=tw) j = tw-1;
+	PFLOAT cw = c[j+1]-c[j];
+	PFLOAT du = (cw>0) ? (t-c[j])/cw : 0.5;
+
+	PFLOAT theta = M_PI*((PFLOAT)i+dv)/(PFLOAT)rows;
+	PFLOAT phi = 2.0*M_PI*((PFLOAT)j+du)/(PFLOAT)tw - M_PI;
+	PFLOAT st = sin(theta);
+	if (st<1e-6) st = 1e-6;
+	dir.set(st*cos(phi), st*sin(phi), cos(theta));
+	// cell probability over the cell's solid angle
+	pdf = (cw/cellSum)*(PFLOAT)(rows*tw)/(2.0*M_PI*M_PI*st);
+	return true;
+}
+
+color_t sunskyBackground_t::operator() (const vector3d_t &dir, renderState_t &state, bool filtered) const
+{
+	if (!table.empty()) return tableLookup(dir);
+	return skyColor(dir);
+}
+
 
 background_t *sunskyBackground_t::factory(paramMap_t &params,renderEnvironment_t &render)
 {
@@ -150,6 +291,8 @@ background_t *sunskyBackground_t::factory(paramMap_t &params,renderEnvironment_t
 	PFLOAT pw = 1.0;	// sunlight power
 	PFLOAT av, bv, cv, dv, ev;
 	av = bv = cv = dv = ev = 1.0;	// color variation parameters, default is normal
+	int lutres = 256;	// sky table resolution, 0 evaluates the model for every ray
+	bool importance = false;	// build a sampling distribution from the table
 
 	params.getParam("from", dir);
 	params.getParam("turbidity", turb);
@@ -165,7 +308,15 @@ background_t *sunskyBackground_t::factory(paramMap_t &params,renderEnvironment_t
 	params.getParam("add_sun", add_sun);
 	params.getParam("sun_power", pw);
 
-	background_t * new_sunsky = new sunskyBackground_t(dir, turb, av, bv, cv, dv, ev);
+	params.getParam("lut_resolution", lutres);
+	params.getParam("importance_sampling", importance);
+	if (lutres<0) lutres = 0;
+	if (importance && (lutres==0)) {
+		cerr << "[sunsky]: importance sampling needs the sky table, using lut_resolution 64\n";
+		lutres = 64;
+	}
+
+	background_t * new_sunsky = new sunskyBackground_t(dir, turb, av, bv, cv, dv, ev, lutres, importance);
 	/*
 	if (add_sun) {
 		color_t suncol = (*new_sunsky)(vector3d_t(dir.x, dir.y, dir.z));
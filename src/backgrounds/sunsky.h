@@ -6,6 +6,7 @@
 #endif
 #include "background.h"
 #include "params.h"
+#include <vector>
 
 __BEGIN_YAFRAY
 // constant
@@ -25,11 +26,26 @@ class sunskyBackground_t: public background_t
 {
 	public:
 		sunskyBackground_t(const point3d_t dir, PFLOAT turb,
-			PFLOAT a_var, PFLOAT b_var, PFLOAT c_var, PFLOAT d_var, PFLOAT e_var);
+			PFLOAT a_var, PFLOAT b_var, PFLOAT c_var, PFLOAT d_var, PFLOAT e_var,
+			int lutres=0, bool imp=false);
 		virtual color_t operator() (const vector3d_t &dir, renderState_t &state, bool filtered=false) const;
+		virtual bool sample(PFLOAT s1, PFLOAT s2, vector3d_t &dir, PFLOAT &pdf) const;
 		virtual ~sunskyBackground_t() {};
 		static background_t *factory(paramMap_t &,renderEnvironment_t &);
+		// the analytic Perez model, what the table is built from
+		color_t skyColor(const vector3d_t &dir) const;
 	protected:
+		// lat-long table, tw columns over phi (wrapping), th rows from zenith to nadir
+		void buildTable(int res);
+		void buildDistribution();
+		void tableReport(int nsamples) const;
+		color_t tableLookup(const vector3d_t &dir) const;
+		std::vector<color_t> table;
+		int tw, th;
+		// importance sampling, one cell per table quad
+		std::vector<PFLOAT> marginal;
+		std::vector<PFLOAT> conditional;
+		PFLOAT cellSum;
 		vector3d_t sunDir;
 		PFLOAT turbidity;
 		double thetaS, phiS;	// sun coords
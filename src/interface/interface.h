@@ -42,7 +42,41 @@ class yafrayInterface_t : public renderEnvironment_t
 		virtual void render(paramMap_t &p,colorOutput_t &output)=0;
 
 		virtual void clear()=0;
-		
+
+		// added after the first release, new methods go at the end so
+		// hosts built with an older header keep calling the right ones
+		/** Same as addObject_trimesh, but the contents of verts, faces, uvcoords
+		 * and vcol are taken by the mesh instead of copied, they are left empty */
+		virtual void addObject_trimeshSwap(const std::string &name,
+				std::vector<point3d_t> &verts, std::vector<int> &faces,
+				std::vector<GFLOAT> &uvcoords, std::vector<CFLOAT> &vcol,
+				const std::vector<std::string> &shaders, const std::vector<int> &faceshader,
+				float sm_angle, bool castShadows, bool useR, bool receiveR, bool caus, bool has_orco,
+				const color_t &caus_rcolor, const color_t &caus_tcolor, float caus_IOR)=0;
+		/** Meshes added after this keep normals, tangents, uvs and vertex
+		 * colors quantized, using less memory */
+		virtual void compactMeshes(bool on)=0;
+
+		// editing between renders, only what changed is built again
+		/// replaces the camera of the same name
+		virtual void updateCamera(paramMap_t &p)=0;
+		/// replaces the shader of the same name on the objects using it
+		virtual void updateShader(paramMap_t &p,std::list<paramMap_t> &modulators)=0;
+		/// replaces the texture of the same name, the shaders are made again
+		virtual void updateTexture(paramMap_t &p)=0;
+		/// gives an object the transform m (4x4 by rows) instead of the one it was added with
+		virtual void transformObject(const std::string &name,float *m)=0;
+		/// removes an object and its references, adding it again replaces it
+		virtual void removeObject(const std::string &name)=0;
+		/// stops the render in flight from another thread, the edits above call it
+		virtual void cancelRender()=0;
+		/** gets the progress of the renders after this, NULL for none. It is
+		 * called on the thread doing the render, which holds the scene: edits
+		 * made from it, or from the color output, are refused with an error.
+		 * cancelRender is fine from there
+		 */
+		virtual void setProgressOutput(progressOutput_t *p)=0;
+
 		virtual ~yafrayInterface_t() {};
 };
 __END_YAFRAY
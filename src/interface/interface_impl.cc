@@ -38,6 +38,8 @@
 #endif
 
 #include "yafsystem.h"
+#include "mipmap.h"
+#include "shadecache.h"
 
 using namespace std;
 
@@ -52,6 +54,11 @@ interfaceImpl_t::interfaceImpl_t(int ncpus,const string &pluginpath):M(1.0)
 {
 	cpus=ncpus;
 	cachedPathLight=false;
+	compact=false;
+	sceneDirty=true;
+	rendering=NULL;
+	editing=0;
+	monitor=NULL;
 	loadPlugins(pluginpath);
 }
 
@@ -68,6 +75,7 @@ interfaceImpl_t::~interfaceImpl_t()
 	FREEMAP(light_t,light_table);
 	FREEMAP(filter_t,filter_table);
 	FREEMAP(background_t,background_table);
+	freeRetired();
 #undef FREEMAP
 #undef MAPOF
 }
@@ -77,6 +85,7 @@ void interfaceImpl_t::clear()
 #define MAPOF(type) map<string,type *>
 #define FREEMAP(type,name)\
 	for(MAPOF(type)::iterator i=name.begin();i!=name.end();++i) delete i->second;name.clear()
+	if(!editBegin()) return;
 	FREEMAP(texture_t,texture_table);
 	FREEMAP(shader_t,shader_table);
 	FREEMAP(object3d_t,object_table);
@@ -84,8 +93,13 @@ void interfaceImpl_t::clear()
 	FREEMAP(light_t,light_table);
 	FREEMAP(filter_t,filter_table);
 	FREEMAP(background_t,background_table);
+	freeRetired();
+	shader_params.clear();
+	shader_order.clear();
 	cachedPathLight=false;
+	sceneDirty=true;
 	tstack.clear();
+	editEnd();
 #undef FREEMAP
 #undef MAPOF
 }
@@ -129,6 +143,11 @@ void  interfaceImpl_t::transformPop()
 }
 
 void  interfaceImpl_t::addTexture(paramMap_t &params)
+{
+	makeTexture(params,false);
+}
+
+void interfaceImpl_t::makeTexture(paramMap_t &params,bool rebuild)
 {
 	texture_t *ntex=NULL;;
 	string _name,_type;
@@ -146,13 +165,16 @@ void  interfaceImpl_t::addTexture(paramMap_t &params)
 	params.checkUnused("texture");
 
 	if (ntex==NULL) return;
+	if(!editBegin()) {delete ntex;return;}
 	if(texture_table.find(*name)!=texture_table.end())
 	{
-		WARNING<<"Texture "<<name<<" redefined\n";
-		delete texture_table[*name];
+		WARNING<<"Texture "<<*name<<" redefined\n";
+		old_textures.push_back(texture_table[*name]);
 	}
 	texture_table[*name]=ntex;
-
+	// shaders take textures when made, updates make them again
+	if(rebuild && rebuildShaders()) freeRetired();
+	editEnd();
 }
 
 
@@ -180,12 +202,20 @@ void interfaceImpl_t::addShader(paramMap_t &params,list<paramMap_t> &lparams)
 	if(ns==NULL) return;
 	params.checkUnused("shader");
 
+	if(!editBegin()) {delete ns;return;}
+	if(shader_params.find(*name)==shader_params.end())
+		shader_order.push_back(*name);
+	shader_params[*name]=make_pair(params,lparams);
 	if(shader_table.find(*name)!=shader_table.end())
 	{
 		WARNING<<"Shader "<<*name<<" redefined\n";
-		delete shader_table[*name];
+		map<const shader_t *,shader_t *> changed;
+		changed[shader_table[*name]]=ns;
+		replaceShaders(changed);
+		old_shaders.push_back(shader_table[*name]);
 	}
 	shader_table[*name]=ns;
+	editEnd();
 	INFO<<"Added shader "<<*name<<endl;
 }
 
@@ -196,6 +226,38 @@ void interfaceImpl_t::addObject_trimesh(const std::string &name,
 				const std::vector<std::string> &shaders, const std::vector<int> &faceshader,
 				float sm_angle, bool castShadows, bool useR, bool receiveR, bool caus, bool has_orco,
 				const color_t &caus_rcolor, const color_t &caus_tcolor, float caus_IOR)
+{
+	vector<point3d_t> v(verts);
+	vector<GFLOAT> uv(facesuv);
+	vector<CFLOAT> vc(vcol);
+	addMesh(name,v,faces,uv,vc,shaders,faceshader,sm_angle,castShadows,useR,receiveR,
+			caus,has_orco,caus_rcolor,caus_tcolor,caus_IOR);
+}
+
+void interfaceImpl_t::addObject_trimeshSwap(const std::string &name,
+				std::vector<point3d_t> &verts, std::vector<int> &faces,
+				std::vector<GFLOAT> &facesuv, std::vector<CFLOAT> &vcol,
+				const std::vector<std::string> &shaders, const std::vector<int> &faceshader,
+				float sm_angle, bool castShadows, bool useR, bool receiveR, bool caus, bool has_orco,
+				const color_t &caus_rcolor, const color_t &caus_tcolor, float caus_IOR)
+{
+	addMesh(name,verts,faces,facesuv,vcol,shaders,faceshader,sm_angle,castShadows,useR,receiveR,
+			caus,has_orco,caus_rcolor,caus_tcolor,caus_IOR);
+	vector<int>().swap(faces);
+	verts.clear();
+	facesuv.clear();
+	vcol.clear();
+}
+
+/* The triangles index verts, facesuv and vcol, which are swapped into
+ * the mesh, so nothing is copied after the faces are made.
+ */
+void interfaceImpl_t::addMesh(const std::string &name,
+				std::vector<point3d_t> &verts, const std::vector<int> &faces,
+				std::vector<GFLOAT> &facesuv, std::vector<CFLOAT> &vcol,
+				const std::vector<std::string> &shaders, const std::vector<int> &faceshader,
+				float sm_angle, bool castShadows, bool useR, bool receiveR, bool caus, bool has_orco,
+				const color_t &caus_rcolor, const color_t &caus_tcolor, float caus_IOR)
 {
 	string shader;
 	if(shaders.size()>0) shader=shaders[0];
@@ -216,51 +278,53 @@ void interfaceImpl_t::addObject_trimesh(const std::string &name,
 	}
 
 	meshObject_t *obj;
+	int nfaces=faces.size()/3, nverts=verts.size();
+	bool useuv=(facesuv.size() >= (unsigned int)(nfaces*6));
+	bool usevcol=(vcol.size() >= (unsigned int)(nfaces*9));
+	bool useshader=(faceshader.size() == (unsigned int)nfaces);
 	vector<triangle_t> rfaces;
+	rfaces.reserve(nfaces);
 
-	for(vector<int>::const_iterator i=faces.begin();i<faces.end();i+=3)
+	for(int f=0;f<nfaces;++f)
 	{
-		if((i[0]>(int)verts.size()) || (i[1]>(int)verts.size()) || 
-				(i[2]>(int)verts.size()))
+		const int *i=&faces[3*f];
+		if((i[0]<0) || (i[0]>=nverts) || (i[1]<0) || (i[1]>=nverts) ||
+				(i[2]<0) || (i[2]>=nverts))
+		{
 			WARNING<<"Skiping face with verts out of bounds\n";
-		rfaces.push_back(triangle_t( &( verts[i[0]] ),&( verts[i[1]] ),
-					&( verts[i[2]] ) ) );
-	}
-	if(facesuv.size() >= (rfaces.size()*6) )
-	{
-		for(unsigned int i=0;i<rfaces.size();++i)
-			rfaces[i].setUV(facesuv.begin()+6*i);
-	}
-	if(vcol.size() >= (rfaces.size()*9) )
-	{
-		for(unsigned int i=0;i<rfaces.size();++i)
-			rfaces[i].setVCOL(vcol.begin()+9*i);
+			continue;
+		}
+		rfaces.push_back(triangle_t(i[0],i[1],i[2]));
+		if(useuv) rfaces.back().setUV(6*f);
+		if(usevcol) rfaces.back().setVCOL(9*f);
+		if(useshader) rfaces.back().setShader(shader_pointer[faceshader[f]]);
 	}
 
-	if(faceshader.size()==rfaces.size())
-		for(unsigned int i=0;i<faceshader.size();++i)
-			rfaces[i].setShader(shader_pointer[faceshader[i]]);
-
 	vector<vector3d_t> normals;
-	obj=meshObject_t::factory(has_orco, M, verts,normals,rfaces,facesuv,vcol);
+	obj=meshObject_t::factorySwap(has_orco, M, verts,normals,rfaces,facesuv,vcol);
 	//obj->hasOrco(has_orco);
 	//obj->transform(M);
 	if(sm_angle>0.0)
-		obj->autoSmooth(sm_angle);
-	obj->tangentsFromUV();
-
-	if(object_table.find(name)!=object_table.end())
-	{
-		WARNING<<"Object "<<name<<" redefined\n";
-		delete object_table[name];
-	}
+		obj->autoSmooth(sm_angle,cpus);
+	obj->tangentsFromUV(cpus);
+	if(compact) obj->compact();
 	obj->castShadows(castShadows);
 	obj->useForRadiosity(useR);
 	obj->reciveRadiosity(receiveR);
 	obj->caustics(caus);
 	obj->setCaustic(caus_rcolor, caus_tcolor, caus_IOR);
 	obj->setShader(shader_table[shader]);
+
+	// the mesh is made without the lock, only putting it in the scene waits
+	if(!editBegin()) {delete obj;return;}
+	if(object_table.find(name)!=object_table.end())
+	{
+		WARNING<<"Object "<<name<<" redefined\n";
+		dropObject(name,obj);
+	}
+	sceneDirty=true;
 	object_table[name]=obj;
+	editEnd();
 	INFO<<"Added object "<<name<<endl;
 }
 
@@ -274,12 +338,15 @@ void interfaceImpl_t::addObject_reference(const string &name,const string &origi
 		obj=referenceObject_t::factory(M,object_table[original]);
 	
 	if(obj==NULL) return;
+	if(!editBegin()) {delete obj;return;}
 	if(object_table.find(name)!=object_table.end())
 	{
 		WARNING<<"Object "<<name<<" redefined\n";
-		delete object_table[name];
+		dropObject(name,obj);
 	}
+	sceneDirty=true;
 	object_table[name]=obj;
+	editEnd();
 }
 
 void interfaceImpl_t::addLight(paramMap_t &params)
@@ -307,12 +374,15 @@ void interfaceImpl_t::addLight(paramMap_t &params)
 	l->useInRender(render);
 	l->useInIndirect(indirect);
 
+	if(!editBegin()) {delete l;return;}
 	if(light_table.find(*name)!=light_table.end())
 	{
 		WARNING<<"Light "<<*name<<" redefined\n";
 		delete light_table[*name];
 	}
+	sceneDirty=true;
 	light_table[*name]=l;
+	editEnd();
 	INFO<<"Added "<<*type<<" light "<<*name<<endl;
 
 }
@@ -375,12 +445,14 @@ void interfaceImpl_t::addCamera(paramMap_t &params)
 														resx, resy, aspect, dfocal,
 														apt, dofd, useq,
 														ct, bt, bbt, bkhrot);
+	if(!editBegin()) {delete cam;return;}
 	if (camera_table.find(*name)!=camera_table.end())
 	{
 		WARNING << "Camera " << name << " redefined\n";
 		delete camera_table[*name];
 	}
 	camera_table[*name] = cam;
+	editEnd();
 	INFO << "Added camera " << *name << endl;
 
 }
@@ -404,12 +476,14 @@ void interfaceImpl_t::addFilter(paramMap_t &params)
 
 	if(f==NULL) return;
 
+	if(!editBegin()) {delete f;return;}
 	if(filter_table.find(*name)!=filter_table.end()) 
 	{
 		WARNING<<"Filter "<<*name<<" redefined\n";
 		delete filter_table[*name];
 	}
 	filter_table[*name]=f;
+	editEnd();
 
 	INFO<<"Added "<<*type<<" filter "<<*name<<endl;
 }
@@ -466,12 +540,14 @@ void interfaceImpl_t::addBackground(paramMap_t &params)
 
 	if(b==NULL) return;
 
+	if(!editBegin()) {delete b;return;}
 	if(background_table.find(*name)!=background_table.end())
 	{
 		WARNING << "background " << *name << " redefined\n";
 		delete background_table[*name];
 	}
 	background_table[*name]=b;
+	editEnd();
 
 	INFO << "Added " << *type << " background " << *name << endl;
 }
@@ -530,6 +606,20 @@ void interfaceImpl_t::render(paramMap_t &params)
 		params.getParam("AA_threshold", AA_threshold);
 	bool AA_jitterfirst = false;
 	params.getParam("AA_jitterfirst", AA_jitterfirst);
+	CFLOAT AA_noise = 0;
+	params.getParam("AA_noise", AA_noise);
+	bool progressive = false;
+	PFLOAT progressive_time = 0;
+	params.getParam("progressive", progressive);
+	params.getParam("progressive_time", progressive_time);
+	bool preview = false;
+	params.getParam("preview", preview);
+	bool deterministic = false;
+	params.getParam("deterministic", deterministic);
+	// extra channels saved with the image, names separated by spaces
+	string _aovs="";
+	const string *aovs=&_aovs;
+	params.getParam("aovs", aovs);
 	bool clamp_rgb = false;
 	params.getParam("clamp_rgb", clamp_rgb);
 
@@ -557,13 +647,24 @@ void interfaceImpl_t::render(paramMap_t &params)
 	color_t fgcol(1.0);
 	params.getParam("fog_color", fgcol);
 
+	// memory for the tiles of paged image textures, in MB
+	int texture_cache = 256;
+	params.getParam("texture_cache", texture_cache);
+	if (texture_cache<1) texture_cache = 1;
+	tileCache_t::instance().setMemoryLimit((size_t)texture_cache<<20);
+	bool shade_cache = true;
+	params.getParam("shade_cache", shade_cache);
+	shadeCache_t::setEnabled(shade_cache);
+
 
+	render_lock.wait();
 #if HAVE_PTHREAD
 	scene_t *pscene=threadedscene_t::factory();
 #else
 	scene_t *pscene=scene_t::factory();
 #endif
 	scene_t &scene=*pscene;
+	watchRender(pscene);
 
 	camera_t *cam=camera_table[*camera];
 
@@ -571,9 +672,14 @@ void interfaceImpl_t::render(paramMap_t &params)
 	for(map<string,object3d_t *>::iterator i=object_table.begin();
 			i!=object_table.end();++i)
 		scene.addObject((*i).second);
+	// lights keep their photon and shadow maps if nothing changed
 	for(map<string,light_t *>::iterator i=light_table.begin();
 			i!=light_table.end();++i)
+	{
+		if(sceneDirty) (*i).second->sceneChanged(true);
 		scene.addLight((*i).second);
+	}
+	sceneDirty=false;
 	for(map<string,filter_t *>::iterator i=filter_table.begin();
 			i!=filter_table.end();++i)
 		scene.addFilter((*i).second);
@@ -602,6 +708,13 @@ void interfaceImpl_t::render(paramMap_t &params)
 			<< AA_minsamples << " minimum samples per pass, "
 			<< AA_passes*AA_minsamples << " samples total.\n";
 	else cout << "No anti-aliasing.\n";
+	if (AA_passes && (AA_noise>0))
+		cout << "Samples given to pixels by noise, down to a relative error of " << AA_noise << "\n";
+	if (progressive) {
+		cout << "Progressive rendering, ";
+		if (progressive_time>0) cout << "for " << progressive_time << " seconds.\n";
+		else cout << AA_passes << " passes at most.\n";
+	}
 
 	scene.setMaxRayDepth(raydepth);
 
@@ -632,6 +745,12 @@ void interfaceImpl_t::render(paramMap_t &params)
 
 	// set the AA params
 	scene.setAASamples(AA_passes, AA_minsamples, AA_pixelwidth, AA_threshold, AA_jitterfirst);
+	scene.setAANoise(AA_noise);
+	scene.setProgressive(progressive, progressive_time);
+	scene.setPreview(preview);
+	scene.setDeterministic(deterministic);
+	scene.setProgressOutput(monitor);
+	scene.setAOVs(*aovs);
 	scene.clampRGB(clamp_rgb);
 	scene.setRegion(xmin,xmax,ymin,ymax);
 	scene.setBias(bias);
@@ -644,34 +763,32 @@ void interfaceImpl_t::render(paramMap_t &params)
 		scene.setCPUs(cpus);
 
 	// tone mapping bypassed when hdr/exr output is requested
-	if (*output_type=="hdr") {
-		outHDR_t hdrout(cam->resX(), cam->resY(), outfile->c_str());
-		scene.tonemap(false);
-		scene.render(hdrout);
-		hdrout.flush();
-	}
+	colorOutput_t *output;
+	bool tonemap=false;
+	if (*output_type=="hdr")
+		output=new outHDR_t(cam->resX(), cam->resY(), outfile->c_str());
 	else if (int((*output_type).find("exr"))!=-1) {
 #if HAVE_EXR
-		outEXR_t exrout(cam->resX(), cam->resY(), outfile->c_str(), *exr_flags);
-		scene.tonemap(false);
-		scene.render(exrout);
-		exrout.flush();
+		output=new outEXR_t(cam->resX(), cam->resY(), outfile->c_str(), *exr_flags);
 #else
 		cout << "Yafray was compiled without OpenEXR support.\nImage saved in hdr format instead." << endl;
-		outHDR_t hdrout(cam->resX(), cam->resY(), outfile->c_str());
-		scene.tonemap(false);
-		scene.render(hdrout);
-		hdrout.flush();
+		output=new outHDR_t(cam->resX(), cam->resY(), outfile->c_str());
 #endif
 	}
 	else {
-		outTga_t tgaout(cam->resX(), cam->resY(), outfile->c_str(), save_alpha);
-		scene.tonemap(true);
-		scene.render(tgaout);
-		tgaout.flush();
+		output=new outTga_t(cam->resX(), cam->resY(), outfile->c_str(), save_alpha);
+		tonemap=true;
 	}
-
+	scene.tonemap(tonemap);
+	scene.render(*output);
+	output->flush();
+	delete output;
+	tileCache_t::instance().printStats();
+	shadeCache_t::printStats();
+
+	watchRender(NULL);
 	delete pscene;
+	render_lock.signal();
 }
 
 void interfaceImpl_t::render(paramMap_t &params,colorOutput_t &output)
@@ -724,6 +841,20 @@ void interfaceImpl_t::render(paramMap_t &params,colorOutput_t &output)
 		params.getParam("AA_threshold", AA_threshold);
 	bool AA_jitterfirst = false;
 	params.getParam("AA_jitterfirst", AA_jitterfirst);
+	CFLOAT AA_noise = 0;
+	params.getParam("AA_noise", AA_noise);
+	bool progressive = false;
+	PFLOAT progressive_time = 0;
+	params.getParam("progressive", progressive);
+	params.getParam("progressive_time", progressive_time);
+	bool preview = false;
+	params.getParam("preview", preview);
+	bool deterministic = false;
+	params.getParam("deterministic", deterministic);
+	// extra channels saved with the image, names separated by spaces
+	string _aovs="";
+	const string *aovs=&_aovs;
+	params.getParam("aovs", aovs);
 	bool clamp_rgb = false;
 	params.getParam("clamp_rgb", clamp_rgb);
 
@@ -751,21 +882,37 @@ void interfaceImpl_t::render(paramMap_t &params,colorOutput_t &output)
 	color_t fgcol(1.0);
 	params.getParam("fog_color", fgcol);
 
+	// memory for the tiles of paged image textures, in MB
+	int texture_cache = 256;
+	params.getParam("texture_cache", texture_cache);
+	if (texture_cache<1) texture_cache = 1;
+	tileCache_t::instance().setMemoryLimit((size_t)texture_cache<<20);
+	bool shade_cache = true;
+	params.getParam("shade_cache", shade_cache);
+	shadeCache_t::setEnabled(shade_cache);
+
+	render_lock.wait();
 #if HAVE_PTHREAD
 	scene_t *pscene=threadedscene_t::factory();
 #else
 	scene_t *pscene=scene_t::factory();
 #endif
 	scene_t &scene=*pscene;
+	watchRender(pscene);
 	camera_t *cam=camera_table[*camera];
 
 	scene.setCamera(cam);
 	for(map<string,object3d_t *>::iterator i=object_table.begin();
 			i!=object_table.end();++i)
 		scene.addObject((*i).second);
+	// lights keep their photon and shadow maps if nothing changed
 	for(map<string,light_t *>::iterator i=light_table.begin();
 			i!=light_table.end();++i)
+	{
+		if(sceneDirty) (*i).second->sceneChanged(true);
 		scene.addLight((*i).second);
+	}
+	sceneDirty=false;
 	for(map<string,filter_t *>::iterator i=filter_table.begin();
 			i!=filter_table.end();++i)
 		scene.addFilter((*i).second);
@@ -785,6 +932,13 @@ void interfaceImpl_t::render(paramMap_t &params,colorOutput_t &output)
 			<< AA_minsamples << " minimum samples per pass, "
 			<< AA_passes*AA_minsamples << " samples total.\n";
 	else cout << "No anti-aliasing.\n";
+	if (AA_passes && (AA_noise>0))
+		cout << "Samples given to pixels by noise, down to a relative error of " << AA_noise << "\n";
+	if (progressive) {
+		cout << "Progressive rendering, ";
+		if (progressive_time>0) cout << "for " << progressive_time << " seconds.\n";
+		else cout << AA_passes << " passes at most.\n";
+	}
 
 	scene.setMaxRayDepth(raydepth);
 
@@ -819,6 +973,12 @@ void interfaceImpl_t::render(paramMap_t &params,colorOutput_t &output)
 
 	// set the AA params
 	scene.setAASamples(AA_passes, AA_minsamples, AA_pixelwidth, AA_threshold, AA_jitterfirst);
+	scene.setAANoise(AA_noise);
+	scene.setProgressive(progressive, progressive_time);
+	scene.setPreview(preview);
+	scene.setDeterministic(deterministic);
+	scene.setProgressOutput(monitor);
+	scene.setAOVs(*aovs);
 	scene.clampRGB(clamp_rgb);
 	scene.setRegion(xmin,xmax,ymin,ymax);
 	scene.setBias(bias);
@@ -830,8 +990,200 @@ void interfaceImpl_t::render(paramMap_t &params,colorOutput_t &output)
 	else
 		scene.setCPUs(cpus);
 	scene.render(output);
+	tileCache_t::instance().printStats();
+	shadeCache_t::printStats();
 
 	output.flush();
+	watchRender(NULL);
+	render_lock.signal();
+}
+
+void interfaceImpl_t::updateCamera(paramMap_t &params)
+{
+	string _name;
+	const string *name=&_name;
+	params.getParam("name",name);
+	if(camera_table.find(*name)==camera_table.end())
+		WARNING<<"Camera "<<*name<<" was not defined\n";
+	// it waits for the render itself
+	addCamera(params);
+}
+
+void interfaceImpl_t::updateShader(paramMap_t &params,list<paramMap_t> &lparams)
+{
+	string _name;
+	const string *name=&_name;
+	params.getParam("name",name);
+	if(shader_params.find(*name)==shader_params.end())
+	{
+		WARNING<<"Shader "<<*name<<" was not defined\n";
+		addShader(params,lparams);
+		return;
+	}
+	// shaders made from this one take it by name, so all are made again
+	if(!editBegin()) return;
+	shader_params[*name]=make_pair(params,lparams);
+	if(rebuildShaders()) freeRetired();
+	editEnd();
+}
+
+void interfaceImpl_t::updateTexture(paramMap_t &params)
+{
+	makeTexture(params,true);
+}
+
+/* Shaders made again point only to the new ones and to the textures of the
+ * table, so once all are made, and the render stopped by the edit, nothing
+ * points to the retired ones and the edit frees them. A shader failing to
+ * be made keeps the old one, which may point to retired ones, so then they
+ * are kept until clear().
+ */
+bool interfaceImpl_t::rebuildShaders()
+{
+	bool all=true;
+	map<const shader_t *,shader_t *> changed;
+	for(list<string>::iterator n=shader_order.begin();n!=shader_order.end();++n)
+	{
+		pair<paramMap_t,list<paramMap_t> > &sp=shader_params[*n];
+		string _type;
+		const string *type=&_type;
+		sp.first.getParam("type",type);
+		map<string,shader_factory_t *>::iterator f=shader_factory.find(*type);
+		shader_t *ns=NULL;
+		if(f!=shader_factory.end()) ns=f->second(sp.first,sp.second,*this);
+		if(ns==NULL)
+		{
+			WARNING<<"Wrong shader definition for "<<*n<<", old one kept\n";
+			all=false;
+			continue;
+		}
+		map<string,shader_t *>::iterator old=shader_table.find(*n);
+		if(old!=shader_table.end())
+		{
+			changed[old->second]=ns;
+			old_shaders.push_back(old->second);
+		}
+		shader_table[*n]=ns;
+	}
+	replaceShaders(changed);
+	INFO<<"Updated "<<changed.size()<<" shaders\n";
+	if(!all) WARNING<<old_shaders.size()<<" replaced shaders kept until the scene is cleared\n";
+	return all;
+}
+
+void interfaceImpl_t::replaceShaders(const map<const shader_t *,shader_t *> &changed)
+{
+	for(map<string,object3d_t *>::iterator i=object_table.begin();i!=object_table.end();++i)
+		i->second->replaceShaders(changed);
+	for(map<string,background_t *>::iterator i=background_table.begin();i!=background_table.end();++i)
+		i->second->replaceShaders(changed);
+}
+
+void interfaceImpl_t::transformObject(const string &name,float *m)
+{
+	map<string,object3d_t *>::iterator i=object_table.find(name);
+	if(i==object_table.end())
+	{
+		WARNING<<"Object "<<name<<" undefined\n";
+		return;
+	}
+	matrix4x4_t L;
+	for(int r=0;r<4;++r)
+		for(int c=0;c<4;++c)
+			L[r][c]=m[r*4+c];
+	if(!editBegin()) return;
+	// meshes build their tree again when the render starts, only this one
+	i->second->transform(L);
+	sceneDirty=true;
+	editEnd();
+}
+
+void interfaceImpl_t::removeObject(const string &name)
+{
+	if(object_table.find(name)==object_table.end())
+	{
+		WARNING<<"Object "<<name<<" undefined\n";
+		return;
+	}
+	if(!editBegin()) return;
+	dropObject(name);
+	sceneDirty=true;
+	editEnd();
+}
+
+void interfaceImpl_t::cancelRender()
+{
+	scene_lock.wait();
+	if(rendering!=NULL) rendering->cancel();
+	scene_lock.signal();
+}
+
+bool interfaceImpl_t::editBegin()
+{
+	scene_lock.wait();
+	// the render thread would wait for its own render, the outputs can't edit
+	bool self=(rendering!=NULL);
+#if HAVE_PTHREAD
+	self=self && pthread_equal(renderer,pthread_self());
+#endif
+	if(self)
+	{
+		scene_lock.signal();
+		ERRORMSG<<"Scene edits from the render thread are ignored\n";
+		return false;
+	}
+	editing++;
+	if(rendering!=NULL) rendering->cancel();
+	scene_lock.signal();
+	render_lock.wait();
+	scene_lock.wait();
+	editing--;
+	scene_lock.signal();
+	return true;
+}
+
+void interfaceImpl_t::watchRender(scene_t *s)
+{
+	scene_lock.wait();
+	rendering=s;
+#if HAVE_PTHREAD
+	if(s!=NULL) renderer=pthread_self();
+#endif
+	// an edit waiting for the render stops it before it starts
+	if((s!=NULL) && (editing>0)) s->cancel();
+	scene_lock.signal();
+}
+
+void interfaceImpl_t::dropObject(const string &name,object3d_t *replacement)
+{
+	object3d_t *obj=object_table[name];
+	map<string,object3d_t *>::iterator i=object_table.begin();
+	while(i!=object_table.end())
+	{
+		map<string,object3d_t *>::iterator r=i++;
+		if((r->second->type()!=REFERENCE) ||
+				(((referenceObject_t *)r->second)->getOriginal()!=obj)) continue;
+		if(replacement!=NULL)
+			((referenceObject_t *)r->second)->setOriginal(replacement);
+		else
+		{
+			WARNING<<"Reference "<<r->first<<" removed with "<<name<<endl;
+			delete r->second;
+			object_table.erase(r);
+		}
+	}
+	delete obj;
+	object_table.erase(name);
+}
+
+void interfaceImpl_t::freeRetired()
+{
+	for(list<shader_t *>::iterator i=old_shaders.begin();i!=old_shaders.end();++i)
+		delete *i;
+	old_shaders.clear();
+	for(list<texture_t *>::iterator i=old_textures.begin();i!=old_textures.end();++i)
+		delete *i;
+	old_textures.clear();
 }
 
 shader_t *interfaceImpl_t::getShader(const std::string name)const
@@ -35,6 +35,7 @@
 #include "light.h"
 #include "background.h"
 #include "yafsystem.h"
+#include "ccthreads.h"
 
 #include "interface.h"
 
@@ -56,6 +57,13 @@ class interfaceImpl_t : public yafrayInterface_t
 				const std::vector<std::string> &shaders, const std::vector<int> &faceshader,
 				float sm_angle, bool castShadows, bool useR, bool receiveR, bool caus, bool has_orco,
 				const color_t &caus_rcolor, const color_t &caus_tcolor, float caus_IOR);
+		virtual void addObject_trimeshSwap(const std::string &name,
+				std::vector<point3d_t> &verts, std::vector<int> &faces,
+				std::vector<GFLOAT> &uvcoords, std::vector<CFLOAT> &vcol,
+				const std::vector<std::string> &shaders, const std::vector<int> &faceshader,
+				float sm_angle, bool castShadows, bool useR, bool receiveR, bool caus, bool has_orco,
+				const color_t &caus_rcolor, const color_t &caus_tcolor, float caus_IOR);
+		virtual void compactMeshes(bool on) {compact=on;};
 
 		virtual void addObject_reference(const std::string &name,const std::string &original);
 
@@ -75,6 +83,14 @@ class interfaceImpl_t : public yafrayInterface_t
 		virtual void render(paramMap_t &p);
 		//render
 		virtual void render(paramMap_t &p,colorOutput_t &output);
+
+		virtual void updateCamera(paramMap_t &p);
+		virtual void updateShader(paramMap_t &p,std::list<paramMap_t> &modulators);
+		virtual void updateTexture(paramMap_t &p);
+		virtual void transformObject(const std::string &name,float *m);
+		virtual void removeObject(const std::string &name);
+		virtual void cancelRender();
+		virtual void setProgressOutput(progressOutput_t *p) {monitor=p;};
 		
 		virtual void clear();
 
@@ -90,6 +106,32 @@ class interfaceImpl_t : public yafrayInterface_t
 		virtual void registerFactory(const std::string &name,background_factory_t *f);
 
 	protected:
+		// makes the mesh taking verts, uvcoords and vcol
+		void addMesh(const std::string &name,
+				std::vector<point3d_t> &verts, const std::vector<int> &faces,
+				std::vector<GFLOAT> &uvcoords, std::vector<CFLOAT> &vcol,
+				const std::vector<std::string> &shaders, const std::vector<int> &faceshader,
+				float sm_angle, bool castShadows, bool useR, bool receiveR, bool caus, bool has_orco,
+				const color_t &caus_rcolor, const color_t &caus_tcolor, float caus_IOR);
+
+		/// adds the texture, rebuild makes the shaders again with it
+		void makeTexture(paramMap_t &params,bool rebuild);
+		/// deletes an object, its references go to replacement or are deleted too
+		void dropObject(const std::string &name,object3d_t *replacement=NULL);
+		/// makes all the shaders again, objects get the new ones. False if some failed
+		bool rebuildShaders();
+		/// objects and backgrounds change the shaders in m for the new ones
+		void replaceShaders(const std::map<const shader_t *,shader_t *> &m);
+		/// deletes the replaced shaders and textures, nothing may point to them
+		void freeRetired();
+		/** edits stop the render in flight and wait for it to return, every
+		 * change of the tables goes between these. They don't nest. False,
+		 * and no editEnd, when called from the thread doing the render
+		 */
+		bool editBegin();
+		void editEnd() {render_lock.signal();};
+		/// the scene being rendered, NULL when it is done
+		void watchRender(scene_t *s);
 
 		filter_t *filter_dof(paramMap_t &);
 		filter_t *filter_antinoise(paramMap_t &);
@@ -107,6 +149,24 @@ class interfaceImpl_t : public yafrayInterface_t
 		std::vector<matrix4x4_t> tstack;
 
 		bool cachedPathLight;
+		bool compact;
+		// geometry or lights changed since the last render
+		bool sceneDirty;
+		// held by a render, and by the edits so they don't change it under it
+		yafthreads::mutex_t render_lock, scene_lock;
+		scene_t *rendering;
+		int editing;
+#if HAVE_PTHREAD
+		// the thread calling render, valid while rendering isn't NULL
+		pthread_t renderer;
+#endif
+		progressOutput_t *monitor;
+		// parameters of the shaders, in the order they were added
+		std::map<std::string,std::pair<paramMap_t,std::list<paramMap_t> > > shader_params;
+		std::list<std::string> shader_order;
+		// replaced ones, shaders made before may still point to them
+		std::list<shader_t *> old_shaders;
+		std::list<texture_t *> old_textures;
 		std::list<sharedlibrary_t> pluginHandlers;
 		
 		std::map<std::string,light_factory_t *> light_factory;
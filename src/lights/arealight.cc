@@ -22,7 +22,6 @@
 
 #include "arealight.h"
 //#include <cmath>
-#include <cstdlib>
 
 using namespace std;
 
@@ -45,7 +44,7 @@ int areaLight_t::fillQuad(const point3d_t &a,const point3d_t &b,
 	int v_samp=(int)(( max_v / (max_v+max_h) )*2.0*std::sqrt(static_cast<PFLOAT>(samp)));
 	int h_samp=(int)(( max_h / (max_v+max_h) )*2.0*std::sqrt(static_cast<PFLOAT>(samp)));
 	
-	if (points_vector.size()==1) return 1;
+	if (points_vector.size()==1) {order.assign(1,0); return 1;}
 
 	vector3d_t inc_v_a= (d-a)/v_samp;
 	vector3d_t inc_v_b= (c-b)/v_samp;
@@ -69,14 +68,15 @@ int areaLight_t::fillQuad(const point3d_t &a,const point3d_t &b,
 		line_a=line_a+inc_v_a;
 		line_b=line_b+inc_v_b;
 	}
+	strataOrder(h_samp,v_samp,order);
 	return index;
 }
 
 areaLight_t::areaLight_t(const point3d_t &a,const point3d_t &b,
 												const point3d_t &c,const point3d_t &d,
 												int nsam, const color_t &col, 
-												CFLOAT inte,int fsam,bool dum):
-												points(nsam),jit(nsam),dummy(dum)
+												CFLOAT inte,int fsam,bool dum,PFLOAT thr):
+												points(nsam),jit(nsam),threshold(thr),dummy(dum)
 {
 	samples = fillQuad(a, b, c, d, points, jit, nsam);
 	direction = (b-a)^(d-a);
@@ -88,6 +88,7 @@ areaLight_t::areaLight_t(const point3d_t &a,const point3d_t &b,
 	corner = a;
 	toX = b-a;
 	toY = d-a;
+	samplerSlot = context_t::reserveSlot();
 }
 
 color_t areaLight_t::illuminate(renderState_t &state,const scene_t &s,const surfacePoint_t sp,
@@ -115,8 +116,9 @@ color_t areaLight_t::illuminate(renderState_t &state,const scene_t &s,const surf
 	const void *oldorigin=state.skipelement;
 	state.skipelement=sp.getOrigin();
 	
+	shadowSampler_t *sam=getShadowSampler(state,samplerSlot,sceneIndex());
 	if (samples==1) {
-		point3d_t sampleP = corner + toX*ourRandom() + toY*ourRandom();
+		point3d_t sampleP = corner + toX*sam->random() + toY*sam->random();
 		L = sampleP-sp.P();
 		if ((L*N)<0) { state.skipelement=oldorigin; return color_t(0.0); }
 		if (!s.isShadowed(state, sp, sampleP)) {
@@ -129,72 +131,50 @@ color_t areaLight_t::illuminate(renderState_t &state,const scene_t &s,const surf
 		state.skipelement = oldorigin;
 		return (plane_at*resul);
 	}
-	
-	int status=guessLight(state,s,sp,N);
-	switch(status)
+
+	// samples in the order of the strata until the lit fraction is known
+	int first = (fsamples>0) ? std::min(fsamples,samples) : std::min(8,samples);
+	sam->start();
+	for(int k=0;(k<samples) && !sam->done(first,threshold);++k)
 	{
-		case PENUMBRA:
-			for(int i=0;i<samples;++i)
-			{
-				PFLOAT dish=ourRandom()-0.5, disv=ourRandom()-0.5;
-				point3d_t sampleP = points[i] + jit[i].first*dish + jit[i].second*disv;
-				L = sampleP-sp.P();
-				if ((L*N)<0) continue;
-				if (!s.isShadowed(state, sp, sampleP))
-				{
-					dir = L;
-					CFLOAT LD2 = dir.normLenSqr();
-					LD2 = (LD2!=0) ? (1.0/LD2) : 1.0;
-					energy_t ene(dir, (pow*color)*LD2);
-					resul += sha->fromLight(state, sp, ene, eye);
-				}
-			}
-			state.skipelement=oldorigin;
-			return (plane_at*resul/ ((CFLOAT)samples));
-		case LIGHT:
-			for(int i=0;i<samples;++i)
-			{
-				L = points[i]-sp.P();
-				dir = L;
-				CFLOAT LD2 = dir.normLenSqr();
-				LD2 = (LD2!=0) ? (1.0/LD2) : 1.0;
-				energy_t ene(dir, (pow*color)*LD2);
-				resul += sha->fromLight(state, sp, ene, eye);
-			}
-			state.skipelement=oldorigin;
-			return (plane_at*resul/ ((CFLOAT)samples));
-		case SHADOW:
-			energy_t ene(direction, 0*color);
-			state.skipelement=oldorigin;
-			return sha->fromLight(state,sp,ene,eye);
+		int i=order[k];
+		PFLOAT dish=sam->random()-0.5, disv=sam->random()-0.5;
+		point3d_t sampleP = points[i] + jit[i].first*dish + jit[i].second*disv;
+		L = sampleP-sp.P();
+		if ((L*N)<0) { sam->add(false); continue; }
+		bool lit=!s.isShadowed(state, sp, sampleP);
+		sam->add(lit);
+		if (lit)
+		{
+			dir = L;
+			CFLOAT LD2 = dir.normLenSqr();
+			LD2 = (LD2!=0) ? (1.0/LD2) : 1.0;
+			energy_t ene(dir, (pow*color)*LD2);
+			resul += sha->fromLight(state, sp, ene, eye);
+		}
 	}
 	state.skipelement=oldorigin;
-	energy_t ene(direction, 0*color);
-	return sha->fromLight(state,sp,ene,eye);
-}
-
-int areaLight_t::guessLight(renderState_t &state,const scene_t &s,const surfacePoint_t &sp,const vector3d_t &N)const
-{
-	if(fsamples==0) return PENUMBRA;
-	bool luz=false,sombra=false;
-	vector3d_t L;
-	int randsamp;
-	
-	for(int i=0;i<fsamples;++i)
+	if (sam->allShadowed())
+	{
+		energy_t ene(direction, 0*color);
+		return sha->fromLight(state,sp,ene,eye);
+	}
+	if (sam->allLit() && (sam->taken==first))
 	{
-		if(luz && sombra) return PENUMBRA;
-		randsamp=rand()%samples;
-		L=points[randsamp]-sp.P();
-		if((L*N)<0)
-			sombra=true;
-		else if(s.isShadowed(state,sp,points[randsamp]))
-			sombra=true;
-		else
-			luz=true;
+		// fully lit, shade with all the samples without shadow rays
+		resul.black();
+		for(int i=0;i<samples;++i)
+		{
+			L = points[i]-sp.P();
+			dir = L;
+			CFLOAT LD2 = dir.normLenSqr();
+			LD2 = (LD2!=0) ? (1.0/LD2) : 1.0;
+			energy_t ene(dir, (pow*color)*LD2);
+			resul += sha->fromLight(state, sp, ene, eye);
+		}
+		return (plane_at*resul/ ((CFLOAT)samples));
 	}
-	if(luz && sombra) return PENUMBRA;
-	if(luz) return LIGHT;
-	return SHADOW;
+	return (plane_at*resul/ ((CFLOAT)sam->taken));
 }
 
 quadEmitter_t::quadEmitter_t(const point3d_t &corn,const vector3d_t &tox,
@@ -239,6 +219,7 @@ light_t *areaLight_t::factory(paramMap_t &params,renderEnvironment_t &render)
 	CFLOAT power=1.0;
 	int samples=50,psamples=0;
 	bool dummy=false;
+	PFLOAT threshold=0.02;
 
 	params.getParam("a",a);
 	params.getParam("b",b);
@@ -249,8 +230,9 @@ light_t *areaLight_t::factory(paramMap_t &params,renderEnvironment_t &render)
 	params.getParam("samples",samples);
 	params.getParam("psamples",psamples);
 	params.getParam("dummy",dummy);
+	params.getParam("threshold",threshold);
 
-	return new areaLight_t(a,b,c,d,samples,color,power,psamples,dummy);
+	return new areaLight_t(a,b,c,d,samples,color,power,psamples,dummy,threshold);
 }
 
 pluginInfo_t areaLight_t::info()
@@ -272,6 +254,8 @@ pluginInfo_t areaLight_t::info()
 	
 	info.params.push_back(buildInfo<INT>("psamples",0,1000,0,
 				"Number of samples to guess penumbra"));
+	info.params.push_back(buildInfo<FLOAT>("threshold",0.0f,1.0f,0.02f,
+				"Error of the lit fraction where penumbra sampling stops"));
 	info.params.push_back(buildInfo<BOOL>("dummy",
 				"Use only to shoot photons, no direct lighting"));
 
@@ -29,6 +29,7 @@
 
 #include "light.h"
 #include "params.h"
+#include "shadowsampler.h"
 
 __BEGIN_YAFRAY
 
@@ -70,13 +71,15 @@ class areaLight_t : public light_t
 		 * @param c is the color of the light
 		 * @param inte is the intensity of the light
 		 * @param fsam is the number of samples for penumbra prediction,if it's 0
-		 * then penumbra prediction is not used
+		 * a few are taken
+		 * @param thr is the error of the lit fraction where sampling of a
+		 * penumbra stops, 0 to take all the samples
 		 * 
 		 */
 		areaLight_t(const point3d_t &a,const point3d_t &b,
 												const point3d_t &,const point3d_t &d,
 												int nsam, const color_t &c,CFLOAT inte,
-												int fsam=0,bool dum=false);
+												int fsam=0,bool dum=false,PFLOAT thr=0.02);
 		///@see light_t
 		virtual color_t illuminate(renderState_t &state,const scene_t &s,const surfacePoint_t sp,
 															const vector3d_t &eye)const;
@@ -85,7 +88,7 @@ class areaLight_t : public light_t
 		///@see light_t
 		virtual void init(scene_t &scene) {};
 		/// Destructor
-		virtual ~areaLight_t() {};
+		virtual ~areaLight_t() { context_t::releaseSlot(samplerSlot); };
 
 		virtual emitter_t * getEmitter(int maxsamples)const 
 		{
@@ -99,18 +102,6 @@ class areaLight_t : public light_t
 		static light_t *factory(paramMap_t &params,renderEnvironment_t &render);
 		static pluginInfo_t info();
 	protected:
-		/** Penumbra predictor
-		 *
-		 * It tries to guess if the current shading point is in total shadow,
-		 * total light or penumbra.
-		 *
-		 * @param s is the scene being rendered
-		 * @param P is the surface point being shaded
-		 * @param N is the normal of the surface correctly fliped
-		 *
-		 */
-		int guessLight(renderState_t &state,const scene_t &s,
-				const surfacePoint_t &P,const vector3d_t &N)const;
 		/** Generates the samples in the quad
 		 *
 		 * Fills the given vectors with samples inside the quad, and also
@@ -134,6 +125,8 @@ class areaLight_t : public light_t
 		std::vector<point3d_t> points;
 		/// The jitter vectors, they are randomly added to the samples while shading
 		std::vector<std::pair<vector3d_t,vector3d_t> > jit;
+		/// Order the samples are taken in, any prefix spread over the quad
+		std::vector<int> order;
 		/// An average point to return as position
 		point3d_t from;
 		/// The normal of the quad
@@ -146,15 +139,15 @@ class areaLight_t : public light_t
 		int samples;
 		/// Number of penumbra prediction samples
 		int fsamples;
+		/// Error of the lit fraction where penumbra sampling stops
+		PFLOAT threshold;
+		/// Context slot of the per thread shadowSampler_t
+		int samplerSlot;
 		bool dummy;
 		point3d_t corner;
 		vector3d_t toX,toY;
 };
 
-#define SHADOW 0
-#define PENUMBRA 1
-#define LIGHT 2
-
 __END_YAFRAY
 
 #endif
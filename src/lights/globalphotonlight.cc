@@ -236,6 +236,25 @@ void globalPhotonLight_t::init(scene_t &scene)
 	found.reserve(search+1);
 	points.reserve(search);
 	radius=photonMap->getMaxRadius();
+	if(changed && photonMap->count())
+	{
+		delete photonMap;
+		delete irradiance;
+		photonMap=new globalPhotonMap_t(radius);
+		irradiance=new globalPhotonMap_t(radius);
+		hash.clear();
+	}
+	if(photonMap->count())
+		cout<<"Reusing "<<photonMap->count()<<" photons"<<endl;
+	else if(!shootAll(scene)) return;
+
+	scene.publishData("globalPhotonMap",photonMap);
+	scene.publishData("irradianceGlobalPhotonMap",irradiance);
+	scene.publishData("irradianceHashMap",&hash);
+}
+
+bool globalPhotonLight_t::shootAll(scene_t &scene)
+{
 	int numemitters=0;
 	for(scene_t::light_iterator i=scene.lightsBegin();i!=scene.lightsEnd();++i)
 	{
@@ -246,7 +265,7 @@ void globalPhotonLight_t::init(scene_t &scene)
 			numemitters++;
 		}
 	}
-	if(!numemitters) return;
+	if(!numemitters) return false;
 	int photonsperlight=numPhotons/numemitters;
 	list<emitter_t *> emitters;
 	for(scene_t::light_iterator i=scene.lightsBegin();i!=scene.lightsEnd();++i)
@@ -272,18 +291,14 @@ void globalPhotonLight_t::init(scene_t &scene)
 
 	for(list<emitter_t *>::iterator i=emitters.begin();i!=emitters.end();++i) delete *i;
 
-	photonMap->buildTree();
+	photonMap->buildTree(std::max(scene.getCPUs(),1));
 	cout<<"Stored "<<photonMap->count()<<endl;
 
 	cout<<"Pre-gathering ...";cout.flush();
 
 	computeIrradiances();
 	cout<<" "<<irradiance->count()<<" OK\n";
-
-	//hash.clear();
-	scene.publishData("globalPhotonMap",photonMap);
-	scene.publishData("irradianceGlobalPhotonMap",irradiance);
-	scene.publishData("irradianceHashMap",&hash);
+	return true;
 }
 		
 light_t *globalPhotonLight_t::factory(paramMap_t &params,renderEnvironment_t &render)
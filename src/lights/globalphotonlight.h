@@ -27,6 +27,7 @@ class globalPhotonLight_t: public light_t
 		virtual point3d_t position()const {return point3d_t(0,0,0);};
 
 		virtual void init(scene_t &scene);
+		virtual bool isIndirect()const {return true;};
 		
 		static light_t *factory(paramMap_t &params,renderEnvironment_t &render);
 		static pluginInfo_t info();
@@ -45,6 +46,8 @@ class globalPhotonLight_t: public light_t
 		void storeInHash(const runningPhoton_t &p,const vector3d_t &N);
 		void setIrradiance(compPhoton_t &p);
 		void computeIrradiances();
+		/// shoots and gathers the photons, false without emitters
+		bool shootAll(scene_t &scene);
 
 		hash3d_t<compPhoton_t> hash;
 		globalPhotonMap_t *photonMap;
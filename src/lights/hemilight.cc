@@ -47,7 +47,6 @@ hemiLight_t::hemiLight_t(int nsam, const color_t &c, CFLOAT pwr, PFLOAT mdist, b
 		}
 		grid = int(sqrt((float)samples));
 		gridiv = 1.0/PFLOAT(grid);
-		gridiv2pi = gridiv * 2.0 * M_PI;
 		HSEQ = NULL;
 	}
 	//sampdiv = 2.0*power/(PFLOAT)samples;	// unif.hemi pdf=2
@@ -69,18 +68,27 @@ color_t hemiLight_t::illuminate(renderState_t &state,const scene_t &sc, const su
 	const void *oldorigin=state.skipelement;
 	state.skipelement=sp.getOrigin();
 
+	// the shared sequences depend on the order the threads get here
+	unsigned int scramble = (use_QMC && sc.isDeterministic()) ? ourRandomI() : 0;
 	//CFLOAT totalocc = 0;
 	//vector3d_t avgdir(0, 0, 0);
 	for (int sm=0;sm<samples;sm++)
 	{
-		dir = getNext(N, sm, sp.NU(), sp.NV());
+		PFLOAT s1, s2, pdf=0;
+		getSamples(sm, scramble, s1, s2);
+		// backgrounds with a sampling distribution (sunsky table) pick the direction
+		if (!(use_background && sc.sampleBackground(s1, s2, dir, pdf)))
+			dir = getNext(N, s1, s2, sp.NU(), sp.NV());
 		CFLOAT occ = dir*N;
 		if ((occ>0) && (!((maxdistance>0) ?
 					sc.isShadowed(state, sp, sp.P()+maxdistance*dir) :
 					sc.isShadowed(state, sp, dir))))
 		{
 			
-			if (use_background)
+			// reweighted to the uniform hemisphere pdf the estimate below assumes
+			if (use_background && (pdf>0))
+				totalcolor += sc.getBackground(dir, state, true) * (occ/(pdf*2.0*M_PI));
+			else if (use_background)
 				totalcolor += sc.getBackground(dir, state, true) * occ;
 			else
 				totalcolor += color * occ;
@@ -99,17 +107,25 @@ color_t hemiLight_t::illuminate(renderState_t &state,const scene_t &sc, const su
 	*/
 }
 
-// returns new hemi vector with uniform distribution
-vector3d_t hemiLight_t::getNext(const vector3d_t &normal, int cursample, const vector3d_t &Ru, const vector3d_t &Rv) const
+// two sample values in [0,1), QMC or jittered, scrambled QMC of the point if scramble is set
+void hemiLight_t::getSamples(int cursample, unsigned int scramble, PFLOAT &s1, PFLOAT &s2) const
 {
-	PFLOAT z1, z2;
-	if (use_QMC) {
-		z1=HSEQ[0].getNext();  z2=HSEQ[1].getNext()*2.0*M_PI;
+	if (scramble) {
+		s1=RI_vdC(cursample, scramble);  s2=RI_S(cursample, scramble);
+	}
+	else if (use_QMC) {
+		s1=HSEQ[0].getNext();  s2=HSEQ[1].getNext();
 	}
 	else {
-		z1 = (PFLOAT(cursample / grid) + ourRandom()) * gridiv;
-		z2 = (PFLOAT(cursample % grid) + ourRandom()) * gridiv2pi;
+		s1 = (PFLOAT(cursample / grid) + ourRandom()) * gridiv;
+		s2 = (PFLOAT(cursample % grid) + ourRandom()) * gridiv;
 	}
+}
+
+// returns new hemi vector with uniform distribution
+vector3d_t hemiLight_t::getNext(const vector3d_t &normal, PFLOAT z1, PFLOAT s2, const vector3d_t &Ru, const vector3d_t &Rv) const
+{
+	PFLOAT z2 = s2*2.0*M_PI;
 	return (Ru*cos(z2) + Rv*sin(z2))*sqrt(1.0-z1*z1) + normal*z1;
 }
 
@@ -43,6 +43,7 @@ class hemiLight_t : public light_t
 		// has no position, return origin
 		virtual point3d_t position() const { return point3d_t(0, 0, 0); };
 		virtual void init(scene_t &scene) {};
+		virtual bool isIndirect()const {return true;};
 		virtual ~hemiLight_t() { if (HSEQ) delete[] HSEQ;  HSEQ=NULL; };
 
 		static light_t *factory(paramMap_t &params,renderEnvironment_t &render);
@@ -55,8 +56,9 @@ class hemiLight_t : public light_t
 		PFLOAT maxdistance;	// maximum occlusion distance
 		bool use_background;
 		int grid;
-		PFLOAT gridiv, gridiv2pi;
-		vector3d_t getNext(const vector3d_t &nrm, int cursam,
+		PFLOAT gridiv;
+		void getSamples(int cursam, unsigned int scramble, PFLOAT &s1, PFLOAT &s2) const;
+		vector3d_t getNext(const vector3d_t &nrm, PFLOAT s1, PFLOAT s2,
 					const vector3d_t &ru, const vector3d_t &Rv) const;
 		// QMC sampling
 		bool use_QMC;
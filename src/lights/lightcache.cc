@@ -8,51 +8,24 @@ using namespace std;
 __BEGIN_YAFRAY
 
 
-static bound_t path_calc_bound(const vector<const lightSample_t *> &v)
-{
-	int size=v.size();
-	if(size==0) return bound_t(point3d_t(),point3d_t());
-	PFLOAT maxx,maxy,maxz,minx,miny,minz;
-	//maxx=minx=v[0]->realPolar.x;
-	//maxy=miny=v[0]->realPolar.y;
-	//maxz=minz=v[0]->realPolar.z;
-	maxx=minx=v[0]->pP.x;
-	maxy=miny=v[0]->pP.y;
-	maxz=minz=v[0]->pP.z;
-	for(int i=0;i<size;++i)
-	{
-		//const point3d_t &p=v[i]->realPolar;
-		const point3d_t &p=v[i]->pP;
-		if(p.x>maxx) maxx=p.x;
-		if(p.y>maxy) maxy=p.y;
-		if(p.z>maxz) maxz=p.z;
-		if(p.x<minx) minx=p.x;
-		if(p.y<miny) miny=p.y;
-		if(p.z<minz) minz=p.z;
-	}
-	return bound_t(point3d_t(minx,miny,minz),point3d_t(maxx,maxy,maxz));
-}
-
-static bool path_is_in_bound(const lightSample_t * const & p,bound_t &b)
-{
-	//return b.includes(p->realPolar);
-	return b.includes(p->pP);
-}
-
-static point3d_t path_get_pos(const lightSample_t * const & p)
-{
-	//return p->realPolar;
-	return p->pP;
-}
-
-void lightCache_t::startUse()
+void lightCache_t::startUse(int threads)
 {
 	if(state!=USE)
 	{
+		for(map<int,vector<lightSample_t> >::iterator a=pending.begin();a!=pending.end();++a)
+			for(vector<lightSample_t>::iterator s=a->second.begin();s!=a->second.end();++s)
+			{
+				lightAccum_t &nuevo=hash.findBox(s->pP);
+				if(!nuevo.valid) nuevo.radiance.clear();
+				nuevo.radiance.push_front(*s);
+				nuevo.valid=true;
+				inserted++;
+			}
+		pending.clear();
 		vector<const lightSample_t *> pointers;
+		pointers.reserve(inserted);
 		for(iterator i=begin();i!=end();++i) pointers.push_back(&(*i));
-		tree=buildGenericTree(pointers,path_calc_bound,path_is_in_bound,
-				      path_get_pos,1);
+		tree.build(pointers,4,0,threads);
 		state=USE;
 	}
 }
@@ -133,7 +106,7 @@ CFLOAT lightCache_t::gatherSamples(const point3d_t &P,const point3d_t &pP,
 	while(repeat)
 	{
 		circle_t circle(pP,radius);
-		for(gObjectIterator_t<const lightSample_t *,circle_t,pointCross_f> 
+		for(pointTreeIterator_t<const lightSample_t *,samplePos_f,circle_t,pointCross_f> 
 				i(tree,circle);!i;++i)
 		{
 			//CFLOAT pD=polarDist(pP,(*i)->realPolar);
@@ -186,25 +159,41 @@ CFLOAT lightCache_t::gatherSamples(const point3d_t &P,const point3d_t &pP,
 
 bool lightCache_t::enoughFor(const point3d_t &P,const vector3d_t &N,const renderState_t &state,
 				CFLOAT (*W)(const lightSample_t &,const point3d_t &,const vector3d_t &,CFLOAT),
-				CFLOAT wlimit)
+				CFLOAT wlimit,lightFill_t *fill)
 {
 	//point3d_t pP=toPolar(P,sc);
 	point3d_t pP=toPolar(P,state);
-	int cx,cy,cz;
-	hash.getBox(pP,cx,cy,cz);
 	/*
 	PFLOAT corr=cos(pP.z);
 	if(corr>0) pP.y/=corr; // realPolar
 	*/
+	// nothing changes the cache in a deterministic fill, not even its order
+	if(fill!=NULL)
+		return findGood(hash,pP,P,N,W,wlimit,false) || findGood(fill->hash,pP,P,N,W,wlimit,true);
+	wait();
+	bool found=findGood(hash,pP,P,N,W,wlimit,true);
+	signal();
+	return found;
+}
+
+/* The first sample near pP good enough for P, searching the box of pP and
+ * its neighbours. With reorder it is moved to the front of its box, where
+ * the next searches find it sooner.
+ */
+bool lightCache_t::findGood(hash3d_t<lightAccum_t> &h,const point3d_t &pP,const point3d_t &P,
+		const vector3d_t &N,CFLOAT (*W)(const lightSample_t &,const point3d_t &,
+			const vector3d_t &,CFLOAT),CFLOAT wlimit,bool reorder)const
+{
+	int cx,cy,cz;
+	h.getBox(pP,cx,cy,cz);
 	lightAccum_t *a;
 	CFLOAT maxw=wlimit*2.0;
 
-	wait();
 	for(int i=cx;i<=(cx+1);i+=(i==cx) ? -1 : ((i<cx) ? 2 : 1) )
 		for(int j=cy;j<=(cy+1);j+=(j==cy) ? -1 : ((j<cy) ? 2 : 1) )
 			for(int k=cz;k<=(cz+1);k+=(k==cz) ? -1 : ((k<cz) ? 2 : 1) )
 			{
-				a=hash.findExistingBox(i,j,k);
+				a=h.findExistingBox(i,j,k);
 				if((a==NULL) || ! a->valid) continue;
 				for(list<lightSample_t>::iterator l=a->radiance.begin();
 							l!=a->radiance.end();++l)
@@ -213,20 +202,30 @@ bool lightCache_t::enoughFor(const point3d_t &P,const vector3d_t &N,const render
 					PFLOAT pD=polarDist(pP,l->pP);
 					if(pD>cache_size) continue;
 					if((W(*l,P,N,maxw))<wlimit) continue;
-					a->radiance.push_front(*l);
-					a->radiance.erase(l);
-					signal();
+					if(reorder)
+					{
+						a->radiance.push_front(*l);
+						a->radiance.erase(l);
+					}
 					return true;
 				}
 			}
-	signal();
 	return false;
 }
 
-void lightCache_t::insert(const point3d_t &P,const renderState_t &state,const lightSample_t &sample)
+void lightCache_t::insert(const point3d_t &P,const renderState_t &state,const lightSample_t &sample,
+		lightFill_t *fill)
 {
 	//point3d_t pP=toPolar(P,sc);
 	point3d_t pP=toPolar(P,state);
+	if(fill!=NULL)
+	{
+		lightAccum_t &nuevo=fill->hash.findBox(pP);
+		nuevo.radiance.push_front(sample);
+		nuevo.valid=true;
+		fill->added.push_back(sample);
+		return;
+	}
 	wait();
 	lightAccum_t &nuevo=hash.findBox(pP);
 	if(!nuevo.valid) nuevo.radiance.clear(); // This line could be removed
@@ -236,4 +235,22 @@ void lightCache_t::insert(const point3d_t &P,const renderState_t &state,const li
 	inserted++;
 }
 
+void lightCache_t::deposit(lightFill_t &fill)
+{
+	if(fill.added.empty()) return;
+	wait();
+	vector<lightSample_t> &p=pending[fill.key];
+	p.insert(p.end(),fill.added.begin(),fill.added.end());
+	signal();
+}
+
+lightFill_t::lightFill_t(lightCache_t &c,int k): cache(c), key(k), hash(c.cacheSize())
+{
+}
+
+lightFill_t::~lightFill_t()
+{
+	cache.deposit(*this);
+}
+
 __END_YAFRAY
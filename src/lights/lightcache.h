@@ -7,8 +7,10 @@
 
 #include "light.h"
 #include "hash3d.h"
-#include "bound.h"
+#include "pointtree.h"
 #include "ccthreads.h"
+#include<map>
+#include<vector>
 
 __BEGIN_YAFRAY
 
@@ -36,6 +38,12 @@ struct lightSample_t
 	CFLOAT devaluated;
 };
 
+/// position of a sample in the tree of the cache
+struct samplePos_f
+{
+	const point3d_t & operator()(const lightSample_t *s)const {return s->pP;};
+};
+
 struct foundSample_t
 {
 	const lightSample_t *S;
@@ -51,29 +59,48 @@ struct lightAccum_t
 	bool valid,resample;
 };
 
+class lightCache_t;
+
+/** Samples an area adds to the cache while it is filled in a deterministic
+ * render. Its searches see them and the cache as the pass found it. The
+ * cache only gets them when the pass is over, area after area in the order
+ * of their first pixels, so the threads can't change it.
+ */
+class lightFill_t : public context_t::destructible
+{
+	public:
+		lightFill_t(lightCache_t &c,int k);
+		virtual ~lightFill_t();
+
+		lightCache_t &cache;
+		int key;
+		hash3d_t<lightAccum_t> hash;
+		std::vector<lightSample_t> added;
+};
+
 class lightCache_t
 {
 	public:
 		lightCache_t(PFLOAT size):
-			state(FILL),cache_size(size),hash(size,50000),tree(NULL),
+			state(FILL),cache_size(size),hash(size,50000),
 			inserted(0) {};
-		~lightCache_t() {if(state==USE) delete tree;};
 
 		void setAspect(PFLOAT aspect) { ycorrection=1.0/aspect;};
 		void startFill()
 		{
 			if(state!=FILL)
 			{
-				delete tree;
-				tree=NULL;
+				tree.clear();
 				state=FILL;
 			}
 		}
-		void startUse();
+		void startUse(int threads=1);
 
 		typedef enum { FILL, USE } state_e;
 		bool ready()const {return state==USE;};
 		int size()const {return inserted;};
+		PFLOAT cacheSize()const {return cache_size;};
+		PFLOAT yCorrection()const {return ycorrection;};
 		
 		struct iterator
 		{
@@ -92,11 +119,16 @@ class lightCache_t
 		void wait() {hash_mutex.wait();};
 		void signal() {hash_mutex.signal();};
 
+		/// with fill the search is deterministic, see lightFill_t
 		bool enoughFor(const point3d_t &P,const vector3d_t &N,const renderState_t &state,
 				CFLOAT (*W)(const lightSample_t &,const point3d_t &,const vector3d_t &,CFLOAT),
-				CFLOAT wlimit);
+				CFLOAT wlimit,lightFill_t *fill=NULL);
 
-		void insert(const point3d_t &P,const renderState_t &state,const lightSample_t &sample);
+		/// with fill the sample is kept there until startUse()
+		void insert(const point3d_t &P,const renderState_t &state,const lightSample_t &sample,
+				lightFill_t *fill=NULL);
+		/// the samples of an area filled apart, to be merged by startUse()
+		void deposit(lightFill_t &fill);
 
 		CFLOAT gatherSamples(const point3d_t &P,const point3d_t &pP,
 				const vector3d_t &N,std::vector<foundSample_t> &found,
@@ -111,13 +143,19 @@ class lightCache_t
 		};
 		PFLOAT polarDist(const point3d_t &a,const point3d_t &b)const {return (a-b).length();};
 	protected:
+		bool findGood(hash3d_t<lightAccum_t> &h,const point3d_t &pP,const point3d_t &P,
+				const vector3d_t &N,CFLOAT (*W)(const lightSample_t &,const point3d_t &,
+					const vector3d_t &,CFLOAT),CFLOAT wlimit,bool reorder)const;
+
 		state_e state;
 		PFLOAT cache_size;
 		yafthreads::mutex_t hash_mutex;
 		hash3d_t<lightAccum_t> hash;
-		gBoundTreeNode_t<const lightSample_t *> *tree;
+		pointTree_t<const lightSample_t *,samplePos_f> tree;
 		int inserted;
 		PFLOAT ycorrection;
+		// samples of the areas filled apart, by their keys
+		std::map<int,std::vector<lightSample_t> > pending;
 };
 
 inline lightCache_t::iterator::iterator(hash3d_t<lightAccum_t> &h)
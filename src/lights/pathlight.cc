@@ -21,6 +21,7 @@
  */
 
 #include "pathlight.h"
+#include <new>
 using namespace std;
 
 __BEGIN_YAFRAY
@@ -37,6 +38,10 @@ pathLight_t::pathLight_t(int nsam, CFLOAT pwr, int depth,int cdepth,bool uQ,
 cache(ca),maxrefinement(ref),recalculate(recal),direct(di),show_samples(shows),
 gridsize(grids),threshold(thr), occmode(_occmode), occ_maxdistance(occdist), ignorms(_ignorms)
 {
+	samplerSlot = context_t::reserveSlot();
+	photonSlot = context_t::reserveSlot();
+	proxySlot = context_t::reserveSlot();
+	fillSlot = context_t::reserveSlot();
 	if(cache) 
 	{
 		if(lightcache!=NULL)
@@ -86,6 +91,10 @@ pathLight_t::~pathLight_t()
 { 
 	if (HSEQ) delete[] HSEQ;  HSEQ=NULL; 
 	if (cache) {delete lightcache;lightcache=NULL;};
+	context_t::releaseSlot(samplerSlot);
+	context_t::releaseSlot(photonSlot);
+	context_t::releaseSlot(proxySlot);
+	context_t::releaseSlot(fillSlot);
 }
 
 void pathLight_t::init(scene_t &scene)
@@ -124,12 +133,12 @@ photonData_t *pathLight_t::getPhotonData(renderState_t &state)const
 	photonData_t *data=NULL;
 	if(imap!=NULL)
 	{
-		bool present;
-		data=state.context.getDestructible(photonData,present);
-		if(!present)
+		data=(photonData_t *)state.context.getSlot(photonSlot);
+		if(data==NULL)
 		{
-			data=new photonData_t(imap->getMaxRadius(),new vector<foundPhoton_t>(5+1));
-			state.context.storeDestructible(photonData,data);
+			data=new (state.context.allocate(sizeof(photonData_t)))
+				photonData_t(imap->getMaxRadius(),new vector<foundPhoton_t>(5+1));
+			state.context.storeSlot(photonSlot,data);
 		}
 	}
 	return data;
@@ -595,27 +604,28 @@ color_t pathLight_t::interpolate(renderState_t &state,const scene_t &s,
 	}
 }
 
-void pathLight_t::setIrradiance(lightSample_t &sample,PFLOAT &radius)
+void pathLight_t::setIrradiance(lightSample_t &sample,PFLOAT &radius,
+		vector<foundSample_t> &found)const
 {
 	vector3d_t &N = sample.N;
 	//point3d_t &pP= sample.realPolar;
 	point3d_t &pP= sample.pP;
 	point3d_t &P= sample.P;
-	stsamples.clear();
+	found.clear();
 	CFLOAT farest;
 
-	farest=lightcache->gatherSamples(P,pP,N,stsamples,search,radius,searchRadius,
+	farest=lightcache->gatherSamples(P,pP,N,found,search,radius,searchRadius,
 																		2,pathLight_t::weightNoDev,weightLimit);
 	
-	if(stsamples.size()==1) farest=0;
+	if(found.size()==1) farest=0;
 	else if(farest>weightLimit) farest=weightLimit;
 
-	for(vector<foundSample_t>::iterator i=stsamples.begin();i!=stsamples.end();++i)
+	for(vector<foundSample_t>::iterator i=found.begin();i!=found.end();++i)
 		i->weight=(i->weight-farest)*(1.0-i->dis/searchRadius);
 
 	color_t total(0,0,0);
 	CFLOAT amount=0;
-	for(vector<foundSample_t>::iterator i=stsamples.begin();i!=stsamples.end();++i)
+	for(vector<foundSample_t>::iterator i=found.begin();i!=found.end();++i)
 	{
 		total+=i->weight*i->S->color;
 		amount+=i->weight;
@@ -624,34 +634,27 @@ void pathLight_t::setIrradiance(lightSample_t &sample,PFLOAT &radius)
 	sample.mixed=total*power*amount;
 }
 
-bool pathLight_t::testRefinement(const scene_t &sc)
+void pathLight_t::mixSamples(vector<lightSample_t *> &s,int from,int to)const
 {
-	if(threshold>=1.0) return false;
-	if(refined>=maxrefinement)
-	{
-		for(lightCache_t::iterator i=lightcache->begin();i!=lightcache->end();++i)
-			(*i).devaluated=1.0;
-		return false;
-	}
-	devaluated*=2;
-	refined++;
-	bool changed=false;
-	int change=0;
-	int num=0;
-
+	vector<foundSample_t> found;
 	PFLOAT mixradius=searchRadius;
-	for(lightCache_t::iterator i=lightcache->begin();i!=lightcache->end();++i)
-		setIrradiance(*i,mixradius);
+	for(int i=from;i<to;++i)
+		setIrradiance(*s[i],mixradius,found);
+}
 
+void pathLight_t::flagSamples(const scene_t &sc,vector<lightSample_t *> &s,
+		vector<char> &flags,int from,int to)const
+{
 	vector<foundSample_t> samples;
-	mixradius=searchRadius;
-	for(lightCache_t::iterator i=lightcache->begin();i!=lightcache->end();++i)
+	PFLOAT mixradius=searchRadius;
+	for(int k=from;k<to;++k)
 	{
+		lightSample_t &cur=*s[k];
 		CFLOAT minR=1000,minG=1000,minB=1000;
 		CFLOAT maxR=0,maxG=0,maxB=0;
 		samples.clear();
-		//lightcache->gatherSamples((*i).P,(*i).realPolar,(*i).N,samples,5,mixradius,searchRadius,
-		lightcache->gatherSamples((*i).P,(*i).pP,(*i).N,samples,5,mixradius,searchRadius,
+		//lightcache->gatherSamples(cur.P,cur.realPolar,cur.N,samples,5,mixradius,searchRadius,
+		lightcache->gatherSamples(cur.P,cur.pP,cur.N,samples,5,mixradius,searchRadius,
 				5,pathLight_t::weightNoDist,weightLimit);
 		for(vector<foundSample_t>::iterator j=samples.begin();j!=samples.end();++j)
 		{
@@ -670,16 +673,79 @@ bool pathLight_t::testRefinement(const scene_t &sc)
 		sc.adjustColor(max);
 		min.clampRGB01();
 		max.clampRGB01();
-		if((maxAbsDiff(max,min))>threshold)
-		{
-			(*i).devaluated=devaluated;
-			changed=true;
-			change++;
-		}
-		num++;
+		flags[k]=((maxAbsDiff(max,min))>threshold);
 	}
-	cout<<"\nRefinement:"<<change<<"/"<<num<<"   "<<endl;
-	return changed;
+}
+
+#define REFINE_BLOCK 256
+
+/** Shares the refinement test among threads
+ *
+ * Samples are handed out in fixed blocks, every block starting its search
+ * radius afresh, so the result does not depend on the number of threads.
+ * The first phase mixes the irradiance of every sample, the second one
+ * compares the mixes around each sample and only reads them.
+ */
+struct refineJob_t : public yafthreads::blockJob_t
+{
+	refineJob_t(const pathLight_t &l,const scene_t &s,vector<lightSample_t *> &v,
+			vector<char> &f):light(l),sc(s),samples(v),flags(f),phase(0)
+	{
+		blocks=(samples.size()+REFINE_BLOCK-1)/REFINE_BLOCK;
+	}
+	virtual void doBlock(int b)
+	{
+		int from=b*REFINE_BLOCK;
+		int to=from+REFINE_BLOCK;
+		if(to>(int)samples.size()) to=samples.size();
+		if(phase==0) light.mixSamples(samples,from,to);
+		else light.flagSamples(sc,samples,flags,from,to);
+	}
+
+	const pathLight_t &light;
+	const scene_t &sc;
+	vector<lightSample_t *> &samples;
+	vector<char> &flags;
+	int phase;
+};
+
+bool pathLight_t::testRefinement(scene_t &sc)
+{
+	if(threshold>=1.0) return false;
+	if(refined>=maxrefinement)
+	{
+		for(lightCache_t::iterator i=lightcache->begin();i!=lightcache->end();++i)
+			(*i).devaluated=1.0;
+		return false;
+	}
+	devaluated*=2;
+	refined++;
+
+	vector<lightSample_t *> all;
+	for(lightCache_t::iterator i=lightcache->begin();i!=lightcache->end();++i)
+		all.push_back(&(*i));
+	vector<char> flags(all.size(),0);
+	refineJob_t job(*this,sc,all,flags);
+	int threads=sc.getCPUs();
+	if(threads<1) threads=1;
+	job.run(threads);
+	job.phase=1;
+	job.run(threads);
+
+	// devaluate only now, weightNoDist and weightNoDev don't look at it anyway.
+	// The next first pass only needs to visit the pixels that could have
+	// taken one of these samples as good enough
+	int change=0;
+	PFLOAT ycorr=lightcache->yCorrection();
+	for(unsigned int i=0;i<all.size();++i)
+	{
+		if(!flags[i]) continue;
+		all[i]->devaluated=devaluated;
+		sc.setRepeatFirst(all[i]->pP.x,all[i]->pP.y/ycorr,lightcache->cacheSize());
+		change++;
+	}
+	cout<<"\nRefinement:"<<change<<"/"<<all.size()<<"   "<<endl;
+	return change>0;
 }
 
 color_t pathLight_t::cached(renderState_t &state,const scene_t &sc,
@@ -694,13 +760,14 @@ color_t pathLight_t::cached(renderState_t &state,const scene_t &sc,
 		N = FACE_FORWARD(sp.Ng(), sp.N(), eye);
 	PFLOAT rq=1.0/(state.raylevel+1);
 	color_t total(0,0,0);
-	if(!lightcache->enoughFor(sp.P(),N,state,pathLight_t::weightNoPrec,desiredWeight*rq))
+	lightFill_t *fill=getFill(state,sc);
+	if(!lightcache->enoughFor(sp.P(),N,state,pathLight_t::weightNoPrec,desiredWeight*rq,fill))
 	{
 		PFLOAT H,M;
 		total=takeSample(state,N,sp,sc,H,M,true);
 
 		lightcache->insert(sp.P(),state,lightSample_t(N,total,H, sp.P(),
-						lightcache->toPolar(sp.P(),state),M,state.traveled*sc.getWorldResolution(),devaluated));
+						lightcache->toPolar(sp.P(),state),M,state.traveled*sc.getWorldResolution(),devaluated),fill);
 						//toPolar(sp.P(),sc),M,state.traveled*sc.getWorldResolution(),devaluated));
 		total.set(1,1,1);
 	}
@@ -711,44 +778,54 @@ color_t pathLight_t::cached(renderState_t &state,const scene_t &sc,
 void pathLight_t::postInit(scene_t &scene)
 {
 	if(!cache) return;
-	lightcache->startUse();
+	lightcache->startUse(std::max(scene.getCPUs(),1));
 
 	if(!direct && testRefinement(scene))
-	{
-		scene.setRepeatFirst();
 		lightcache->startFill();
-	}
 	else
 		cout << lightcache->size() << " samples taken\n";
 }
 
 hemiSampler_t *pathLight_t::getSampler(renderState_t &state,const scene_t &sc)const
 {
-	bool present;
-	hemiSampler_t *sam=state.context.getDestructible(_sampler,present);
-	if(!present)
+	hemiSampler_t *sam=(hemiSampler_t *)state.context.getSlot(samplerSlot);
+	if(sam==NULL)
 	{
-		if((pmap!=NULL) && (samples>96)) sam=new photonSampler_t(samples,maxdepth,*pmap,gridsize);
+		context_t &c=state.context;
+		if((pmap!=NULL) && (samples>96))
+			sam=new (c.allocate(sizeof(photonSampler_t))) photonSampler_t(samples,maxdepth,*pmap,gridsize);
 		else 
-		if(use_QMC) sam=new haltonSampler_t(maxdepth,samples);
-		else sam=new randomSampler_t(samples);
-		state.context.storeDestructible(_sampler,sam);
+		if(use_QMC) sam=new (c.allocate(sizeof(haltonSampler_t))) haltonSampler_t(maxdepth,samples);
+		else sam=new (c.allocate(sizeof(randomSampler_t))) randomSampler_t(samples);
+		c.storeSlot(samplerSlot,sam);
 	}
 	return sam;
 }
 
 cacheProxy_t *pathLight_t::getProxy(renderState_t &state,const scene_t &sc)const
 {
-	bool present;
-	cacheProxy_t *proxy=state.context.getDestructible(_proxy,present);
-	if(!present)
+	cacheProxy_t *proxy=(cacheProxy_t *)state.context.getSlot(proxySlot);
+	if(proxy==NULL)
 	{
-		proxy=new cacheProxy_t(*lightcache,sc,searchRadius);
-		state.context.storeDestructible(_proxy,proxy);
+		proxy=new (state.context.allocate(sizeof(cacheProxy_t))) cacheProxy_t(*lightcache,sc,searchRadius);
+		state.context.storeSlot(proxySlot,proxy);
 	}
 	return proxy;
 }
 
+// areas fill the cache apart in deterministic renders
+lightFill_t *pathLight_t::getFill(renderState_t &state,const scene_t &sc)const
+{
+	if(!sc.isDeterministic()) return NULL;
+	lightFill_t *fill=(lightFill_t *)state.context.getSlot(fillSlot);
+	if(fill==NULL)
+	{
+		fill=new (state.context.allocate(sizeof(lightFill_t))) lightFill_t(*lightcache,state.pixelNumber);
+		state.context.storeSlot(fillSlot,fill);
+	}
+	return fill;
+}
+
 
 light_t *pathLight_t::factory(paramMap_t &params,renderEnvironment_t &render)
 {
@@ -84,6 +84,7 @@ class pathLight_t : public light_t
 		// has no position, return origin
 		virtual point3d_t position() const { return point3d_t(0, 0, 0); };
 		virtual void init(scene_t &scene);
+		virtual bool isIndirect()const {return true;};
 		virtual void postInit(scene_t &scene);
 		virtual ~pathLight_t();
 
@@ -111,15 +112,22 @@ class pathLight_t : public light_t
 		static CFLOAT weightNoDev(const lightSample_t &sample,const point3d_t &P,
 				const vector3d_t &N,CFLOAT maxweight);
 
-		void setIrradiance(lightSample_t &sample,PFLOAT &radius);
+		void setIrradiance(lightSample_t &sample,PFLOAT &radius,
+				std::vector<foundSample_t> &found)const;
+		// refinement test of the cache samples from .. to, see refineJob_t
+		void mixSamples(std::vector<lightSample_t *> &s,int from,int to)const;
+		void flagSamples(const scene_t &sc,std::vector<lightSample_t *> &s,
+				std::vector<char> &flags,int from,int to)const;
+		friend struct refineJob_t;
 
 		color_t getLight(renderState_t &state,const surfacePoint_t &sp,
 				const scene_t &sc,const vector3d_t &eye,photonData_t *data)const;
-		bool testRefinement(const scene_t &sc);
+		bool testRefinement(scene_t &sc);
 
 		hemiSampler_t *getSampler(renderState_t &state,const scene_t &sc)const;
 		photonData_t *getPhotonData(renderState_t &state)const;
 		cacheProxy_t *getProxy(renderState_t &state,const scene_t &sc)const;
+		lightFill_t *getFill(renderState_t &state,const scene_t &sc)const;
 
 		bool cache;
 		PFLOAT dist_to_sample;
@@ -129,18 +137,15 @@ class pathLight_t : public light_t
 		bool recalculate,direct,show_samples;
 		int search,gridsize;
 		PFLOAT lastRadius,searchRadius;
-		hemiSampler_t *_sampler;
+		// render state slots of the sampler, photon data, cache proxy and fill
+		int samplerSlot, photonSlot, proxySlot, fillSlot;
 		const globalPhotonMap_t *pmap;
 		const globalPhotonMap_t *imap;
 		const globalPhotonLight_t::irHash_t *irhash;
-		photonData_t *photonData;
 		CFLOAT threshold,devaluated,desiredWeight,weightLimit;
 		bool occmode;
 		PFLOAT occ_maxdistance;
 		bool ignorms;
-
-		std::vector<foundSample_t> stsamples;
-		cacheProxy_t *_proxy;
 };
 
 __END_YAFRAY
@@ -85,7 +85,6 @@ photonLight_t::photonLight_t(const point3d_t &f,const point3d_t _to,PFLOAT angle
 	mindepth=mind;
 	bias=b;
 	dispersion=K*disp*(angle/180.0);
-	tree=NULL;
 	hash=NULL;
 	mode=mod;
 	// QMC init
@@ -291,7 +290,7 @@ static PFLOAT fillArea(const vector<sample_t> &samples,PFLOAT offset)
 
 struct pointCross_f
 {
-	bool operator() (const point3d_t &p,const bound_t &b) {return b.includes(p);};
+	bool operator() (const point3d_t &p,const bound_t &b)const {return b.includes(p);};
 };
 
 color_t photonLight_t::illuminate(renderState_t &state,const scene_t &s,const surfacePoint_t sp,
@@ -304,7 +303,7 @@ color_t photonLight_t::illuminate(renderState_t &state,const scene_t &s,const su
 	vector<foundPhoton_t> found(0);
 	found.reserve(K);
 	vector3d_t N = FACE_FORWARD(sp.Ng(), sp.N(), eye);
-	gObjectIterator_t<photonMark_t *,point3d_t,pointCross_f> ite(tree,sp.P());
+	pointTreeIterator_t<photonMark_t *,markPos_f,point3d_t,pointCross_f> ite(tree,sp.P());
 	for(;!ite;++ite)
 	{
 		// First check if the direction of the photon is appropriate
@@ -410,48 +409,16 @@ void photonLight_t::preGathering()
 	}
 }
 
-static PFLOAT bound_add;
-
-bound_t photon_calc_bound_fixed(const vector<photonMark_t *> &v)
+void photonLight_t::init(scene_t &scene)
 {
-	int size=v.size();
-	if(size==0) return bound_t(point3d_t(),point3d_t());
-	PFLOAT maxx,maxy,maxz,minx,miny,minz;
-	maxx=minx=v[0]->position().x;
-	maxy=miny=v[0]->position().y;
-	maxz=minz=v[0]->position().z;
-	for(int i=0;i<size;++i)
+	if(!changed && (emitted>0))
 	{
-		const point3d_t &p=v[i]->position();
-		if(p.x>maxx) maxx=p.x;
-		if(p.y>maxy) maxy=p.y;
-		if(p.z>maxz) maxz=p.z;
-		if(p.x<minx) minx=p.x;
-		if(p.y<miny) miny=p.y;
-		if(p.z<minz) minz=p.z;
+		cerr<<"Reusing "<<photons.size()<<" photons\n";
+		return;
 	}
-	minx-=bound_add;
-	miny-=bound_add;
-	minz-=bound_add;
-	maxx+=bound_add;
-	maxy+=bound_add;
-	maxz+=bound_add;
-	return bound_t(point3d_t(minx,miny,minz),point3d_t(maxx,maxy,maxz));
-}
-
-bool photon_is_in_bound(photonMark_t * const & p,bound_t &b)
-{
-	return b.includes(p->position());
-}
-
-point3d_t photon_get_pos(photonMark_t * const & p)
-{
-	return p->position();
-}
-
-
-void photonLight_t::init(scene_t &scene)
-{
+	photons.clear();
+	tree.clear();
+	emitted=stored=0;
 	fprintf(stderr,"Shooting photons ... ");
 	vector3d_t dir;
 	vector3d_t light_dir=to-from;
@@ -491,10 +458,7 @@ void photonLight_t::init(scene_t &scene)
 	for(vector<photonMark_t>::iterator i=photons.begin();i!=photons.end();++i)
 		lpho[i-photons.begin()]=&(*i);
 
-	bound_add=fixedRadius;
-	if(tree!=NULL) delete tree;
-	tree=buildGenericTree(lpho,photon_calc_bound_fixed,photon_is_in_bound,
-				photon_get_pos,8);
+	tree.build(lpho,8,fixedRadius,std::max(scene.getCPUs(),1));
 
 	cerr<<"OK "<<photons.size()<<" photons kept\n";
 
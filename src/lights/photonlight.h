@@ -32,6 +32,7 @@
 #include "light.h"
 #include "mcqmc.h"
 #include "hash3d.h"
+#include "pointtree.h"
 #include<queue>
 
 __BEGIN_YAFRAY
@@ -144,6 +145,12 @@ class photonMap_t
 #define CAUSTIC 0
 #define DIFFUSE 1
 
+/// position of a mark in the tree of the light
+struct markPos_f
+{
+	const point3d_t & operator()(const photonMark_t *p)const {return p->position();};
+};
+
 class photonLight_t : public  light_t
 {
 	public:
@@ -155,9 +162,9 @@ class photonLight_t : public  light_t
 															const vector3d_t &eye)const;
 		virtual point3d_t position()const {return from;};
 		virtual void init(scene_t &scene);
+		virtual bool isIndirect()const {return true;};
 		virtual ~photonLight_t() 
 		{
-			if (tree!=NULL) delete tree;
 			if (hash!=NULL) delete hash;
 			if (HSEQ) { delete[] HSEQ;  HSEQ=NULL; }
 		}
@@ -186,7 +193,7 @@ class photonLight_t : public  light_t
 		PFLOAT randStep,cluster;
 		int mode;
 		std::vector<photonMark_t> photons;
-		gBoundTreeNode_t<photonMark_t *> *tree;
+		pointTree_t<photonMark_t *,markPos_f> tree;
 		//hash3d_t<photonMark_t> *hash;
 		hash3d_t<photoAccum_t> *hash;
 		// qmc Halton sampling
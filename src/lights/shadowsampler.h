@@ -0,0 +1,115 @@
+/****************************************************************************
+ *
+ *      shadowsampler.h: adaptive shadow sampling of area lights
+ *      This is part of the yafray package
+ *
+ *      This library is free software; you can redistribute it and/or
+ *      modify it under the terms of the GNU Lesser General Public
+ *      License as published by the Free Software Foundation; either
+ *      version 2.1 of the License, or (at your option) any later version.
+ *
+ *      This library is distributed in the hope that it will be useful,
+ *      but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *      MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *      Lesser General Public License for more details.
+ *
+ *      You should have received a copy of the GNU Lesser General Public
+ *      License along with this library; if not, write to the Free Software
+ *      Foundation,Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+ *
+ */
+
+#ifndef __SHADOWSAMPLER_H
+#define __SHADOWSAMPLER_H
+
+#ifdef HAVE_CONFIG_H
+#include<config.h>
+#endif
+
+#include <vector>
+#include <algorithm>
+#include "scene.h"
+#include "mcqmc.h"
+
+__BEGIN_YAFRAY
+
+/** Per thread state of the shadow sampling of an area light
+ *
+ * Lights keep one in a context slot of every render state, so it is never
+ * shared among threads. It has its own random numbers, seeded from the
+ * first pixel it shades so they don't depend on the threads, and counts the
+ * shadow rays of the point being shaded: samples are added until the
+ * first ones all agree, or the error of the lit fraction goes below the
+ * threshold, or there are none left.
+ *
+ */
+class shadowSampler_t : public context_t::destructible
+{
+	public:
+		shadowSampler_t(int s): seed(s), taken(0), lit(0) {};
+		virtual ~shadowSampler_t() {};
+
+		/// uniform in [0,1)
+		PFLOAT random()
+		{
+			const int a = 16807, m = 2147483647, q = 127773, r = 2836;
+			seed = a*(seed%q) - r*(seed/q);
+			if (seed<0) seed += m;
+			return (PFLOAT)seed/(PFLOAT)m;
+		}
+		void start() {taken=lit=0;};
+		void add(bool l) {taken++; if(l) lit++;};
+		bool allLit()const {return lit==taken;};
+		bool allShadowed()const {return lit==0;};
+		/// true when no more samples are needed, first is the size of the guess
+		bool done(int first,PFLOAT threshold)const
+		{
+			if (taken<first) return false;
+			if ((taken==first) && (allLit() || allShadowed())) return true;
+			PFLOAT p = (PFLOAT)lit/(PFLOAT)taken;
+			return p*(1.0-p) < threshold*threshold*(PFLOAT)taken;
+		}
+
+		int seed, taken, lit;
+};
+
+/// the sampler of the state in slot, made the first time, seeded with the light index
+inline shadowSampler_t * getShadowSampler(renderState_t &state,int slot,int light)
+{
+	shadowSampler_t *sam=(shadowSampler_t *)state.context.getSlot(slot);
+	if (sam==NULL)
+	{
+		context_t &c=state.context;
+		sam=new (c.allocate(sizeof(shadowSampler_t))) shadowSampler_t(indexSeed(state.pixelNumber,light));
+		c.storeSlot(slot,sam);
+	}
+	return sam;
+}
+
+/** Order of the w x h strata of a light
+ *
+ * Strata are taken as the points of a Halton sequence fall on them, so
+ * any prefix of the order is spread over the whole light.
+ *
+ */
+inline void strataOrder(int w,int h,std::vector<int> &order)
+{
+	int n=w*h;
+	std::vector<bool> used(n,false);
+	order.clear();
+	Halton hx(2), hy(3);
+	for(int k=0;((int)order.size()<n) && (k<16*n);++k)
+	{
+		int x=std::min((int)(hx.getNext()*w),w-1);
+		int y=std::min((int)(hy.getNext()*h),h-1);
+		if (used[y*w+x]) continue;
+		used[y*w+x]=true;
+		order.push_back(y*w+x);
+	}
+	for(int c=0;c<n;++c)
+		if (!used[c]) order.push_back(c);
+}
+
+__END_YAFRAY
+
+#endif
@@ -1,9 +1,62 @@
 
 #include "softlight.h"
+#include <vector>
 using namespace std;
 
 __BEGIN_YAFRAY
 
+// corner, end of the first row and end of the first column of every face
+static const GFLOAT faceCorners[6][3][3]=
+{
+	{{-1.0,-1.0, 1.0},{ 1.0,-1.0, 1.0},{-1.0,-1.0,-1.0}},
+	{{ 1.0,-1.0, 1.0},{ 1.0, 1.0, 1.0},{ 1.0,-1.0,-1.0}},
+	{{ 1.0, 1.0, 1.0},{-1.0, 1.0, 1.0},{ 1.0, 1.0,-1.0}},
+	{{-1.0, 1.0, 1.0},{-1.0,-1.0, 1.0},{-1.0, 1.0,-1.0}},
+	{{-1.0, 1.0, 1.0},{ 1.0, 1.0, 1.0},{-1.0,-1.0, 1.0}},
+	{{-1.0, 1.0,-1.0},{ 1.0, 1.0,-1.0},{-1.0,-1.0,-1.0}}
+};
+
+#define FILL_ROWS 8
+
+/// casts the rays of a face, rows shared among the threads
+struct sideFill_t : public yafthreads::blockJob_t
+{
+	sideFill_t(const scene_t &s,const point3d_t &f,int r,const GFLOAT c[3][3],
+			vector<GFLOAT> &d):sc(s),from(f),res(r),depth(d)
+	{
+		corner.set(c[0][0],c[0][1],c[0][2]);
+		incx=(vector3d_t(c[1][0],c[1][1],c[1][2])-corner)/res;
+		incy=(vector3d_t(c[2][0],c[2][1],c[2][2])-corner)/res;
+		blocks=(res+FILL_ROWS-1)/FILL_ROWS;
+	}
+	virtual void doBlock(int b)
+	{
+		surfacePoint_t sp;
+		renderState_t state;
+		int last=min((b+1)*FILL_ROWS,res);
+		for(int y=b*FILL_ROWS;y<last;++y)
+		{
+			vector3d_t dir=corner+incx/2+incy/2+incy*(GFLOAT)y;
+			for(int x=0;x<res;++x)
+			{
+				vector3d_t ray=dir;
+				ray.normalize();
+				if(!sc.firstHit(state,sp,from,ray,true))
+					depth[y*res+x]=-1;
+				else
+					depth[y*res+x]=sp.Z();
+				dir=dir+incx;
+			}
+		}
+	}
+
+	const scene_t &sc;
+	point3d_t from;
+	int res;
+	vector3d_t corner,incx,incy;
+	vector<GFLOAT> &depth;
+};
+
 softLight_t::softLight_t(const point3d_t &f, const color_t &c, CFLOAT p,
 			int resol, int radius, GFLOAT biass, CFLOAT gli, CFLOAT glo, int glt)
 {
@@ -22,13 +75,13 @@ softLight_t::softLight_t(const point3d_t &f, const color_t &c, CFLOAT p,
 	color=c;
 	res=resol;
 	bias=biass;
+	tiles=(res+SHADOW_TILE-1)/SHADOW_TILE;
 	for(int i=0;i<6;++i)
 	{
 		buffer[i].set(res,res);
 		//obj[i].set(res,res);
-		for(int y=0;y<res;++y)
-			for(int x=0;x<res;++x)
-				buffer[i](x,y)=i*10000+y*100+x;
+		tilemin[i].set(tiles,tiles);
+		tilemax[i].set(tiles,tiles);
 	}
 	R=radius;
 	R2=R*R;
@@ -150,12 +203,14 @@ softLight_t::softLight_t(const point3d_t &f, const color_t &c, CFLOAT p,
 		}
 }
 
+/* The faces are cast before the render, each with the rows shared by all
+ * the threads, so shadows only read them and take no lock. Faces seeing
+ * nothing of the scene are cheap, their rays miss the tree bound.
+ */
 void softLight_t::init(scene_t &scene)
 {
-	cout<<"Building shadow maps ... ";
-	cout.flush();
-	fillCube(scene);
-	cout<<"OK\n";
+	if(!changed) return;
+	for(int i=0;i<6;++i) fillSide(i,scene);
 }
 
 color_t softLight_t::illuminate(renderState_t &state,const scene_t &s,const surfacePoint_t sp,
@@ -171,6 +226,7 @@ color_t softLight_t::illuminate(renderState_t &state,const scene_t &s,const surf
 	int si = guessSide(shadowdir,x,y);
 	int ix=(int)x, iy=(int)y;
 	CFLOAT shadow = mixShadow(si, ix-R, iy-R, ix+R, iy+R, x, y, L.length());
+	s.mapShadow(state, 1.0-shadow);
 	const color_t lcol(shadow*pow*color);
 	energy_t ene(dir, lcol/(L*L));
 	color_t col = sha->fromLight(state, sp, ene, eye);
@@ -179,58 +235,44 @@ color_t softLight_t::illuminate(renderState_t &state,const scene_t &s,const surf
 	return col;
 }
 
-void softLight_t::fillSide(int s,const vector3d_t &corner,
-		const vector3d_t &cx,const vector3d_t &cy,scene_t &scene)
+void softLight_t::fillSide(int s,const scene_t &scene)
 {
-	vector3d_t incx=(cx-corner)/res;
-	vector3d_t incy=(cy-corner)/res;
-	vector3d_t diry=corner+incx/2+incy/2;
-	surfacePoint_t sp;
-	renderState_t state;
-	for(int y=0;y<res;++y)
+	vector<GFLOAT> depth(res*res);
+	sideFill_t job(scene,from,res,faceCorners[s],depth);
+	job.run(max(scene.getCPUs(),1));
+
+	GFLOAT lo=-1,hi=-1;
+	for(int i=0;i<res*res;++i)
 	{
-		vector3d_t dir=diry;
+		if(depth[i]<0) continue;
+		if((lo<0) || (depth[i]<lo)) lo=depth[i];
+		if(depth[i]>hi) hi=depth[i];
+	}
+	zmin[s]=max(lo,(GFLOAT)0.0);
+	zstep[s]=(hi>lo) ? (hi-lo)/(GFLOAT)(SHADOW_FAR-1) : 0.0;
+	for(int y=0;y<res;++y)
 		for(int x=0;x<res;++x)
 		{
-			vector3d_t ray=dir;
-			ray.normalize();
-			if(!scene.firstHit(state,sp,from,ray,true))
-			{
-				buffer[s](x,y)=-1;
-				//obj[s](x,y)=(object3d_t *)NULL;
-			}
-			else
-			{
-				buffer[s](x,y)=sp.Z();
-				//obj[s](x,y)=sp.getObject();
-			}
-			dir=dir+incx;
+			GFLOAT z=depth[y*res+x];
+			unsigned short code=SHADOW_FAR;
+			if(z>=0)
+				code=(zstep[s]>0) ? (unsigned short)((z-zmin[s])/zstep[s]+0.5) : 0;
+			buffer[s](x,y)=code;
 		}
-		diry=diry+incy;
-	}
-		
-}
 
-void softLight_t::fillCube(scene_t &scene)
-{
-	fillSide(0,vector3d_t(-1.0,-1.0 ,1.0),
-						vector3d_t ( 1.0,-1.0 ,1.0),
-						vector3d_t (-1.0,-1.0,-1.0),scene);
-	fillSide(1,vector3d_t( 1.0,-1.0 ,1.0),
-						vector3d_t ( 1.0 ,1.0 ,1.0),
-						vector3d_t ( 1.0,-1.0,-1.0),scene);
-	fillSide(2,vector3d_t( 1.0 ,1.0 ,1.0),
-						vector3d_t (-1.0 ,1.0 ,1.0),
-						vector3d_t ( 1.0 ,1.0,-1.0),scene);
-	fillSide(3,vector3d_t(-1.0 ,1.0 ,1.0),
-						vector3d_t (-1.0,-1.0 ,1.0),
-						vector3d_t (-1.0 ,1.0,-1.0),scene);
-	fillSide(4,vector3d_t(-1.0 ,1.0 ,1.0),
-						vector3d_t ( 1.0 ,1.0 ,1.0),
-						vector3d_t (-1.0,-1.0 ,1.0),scene);
-	fillSide(5,vector3d_t(-1.0 ,1.0,-1.0),
-						vector3d_t ( 1.0 ,1.0,-1.0),
-						vector3d_t (-1.0,-1.0,-1.0),scene);
+	for(int ty=0;ty<tiles;++ty)
+		for(int tx=0;tx<tiles;++tx)
+		{
+			unsigned short tlo=SHADOW_FAR, thi=0;
+			for(int y=ty*SHADOW_TILE;y<min((ty+1)*SHADOW_TILE,res);++y)
+				for(int x=tx*SHADOW_TILE;x<min((tx+1)*SHADOW_TILE,res);++x)
+				{
+					tlo=min(tlo,buffer[s](x,y));
+					thi=max(thi,buffer[s](x,y));
+				}
+			tilemin[s](tx,ty)=tlo;
+			tilemax[s](tx,ty)=thi;
+		}
 }
 
 light_t *softLight_t::factory(paramMap_t &params,renderEnvironment_t &render)
@@ -10,6 +10,8 @@
 #include"buffer.h"
 #include"object3d.h"
 #include"light.h"
+#include"ccthreads.h"
+#include<algorithm>
 
 __BEGIN_YAFRAY
 
@@ -18,6 +20,11 @@ __BEGIN_YAFRAY
 #define SIDE_DOWN 2
 #define SIDE_LEFT 3
 
+// side of the tiles keeping the depth bounds of a face
+#define SHADOW_TILE 8
+// depth code of the texels hitting nothing
+#define SHADOW_FAR 0xffff
+
 class softLight_t : public light_t
 {
 	public:
@@ -32,11 +39,14 @@ class softLight_t : public light_t
 		static light_t *factory(paramMap_t &params, renderEnvironment_t &render);
 		static pluginInfo_t info();
 	protected:
+		GFLOAT depth(int face,unsigned short code)const
+		{
+			if(code==SHADOW_FAR) return -1.0;
+			return zmin[face]+(GFLOAT)code*zstep[face];
+		}
 		GFLOAT getSample(int face,int x, int y/*,object3d_t * &o*/)const;
 		int guessSide(const vector3d_t &v,GFLOAT &x,GFLOAT &y)const;
-		void fillSide(int s,const vector3d_t &corner,const vector3d_t &cx,
-				const vector3d_t &y,scene_t &scene);
-		void fillCube(scene_t &scene);
+		void fillSide(int s,const scene_t &scene);
 		CFLOAT mixShadow(int face,int ix,int iy,int fx,int fy,
 				GFLOAT cx,GFLOAT cy,GFLOAT Z/*,const object3d_t *ob*/)const;
 		
@@ -50,7 +60,14 @@ class softLight_t : public light_t
 		CFLOAT pow;
 		point3d_t from;
 		color_t color;
-		fBuffer_t buffer[6];
+		/* Depths are stored in 16 bits as zmin+code*zstep, SHADOW_FAR when
+		 * the ray hit nothing, and every tile keeps the lowest and highest
+		 * code in it.
+		 */
+		Buffer_t<unsigned short> buffer[6];
+		Buffer_t<unsigned short> tilemin[6], tilemax[6];
+		GFLOAT zmin[6], zstep[6];
+		int tiles;
 		// glow
 		CFLOAT glow_int, glow_ofs;
 		int glow_type;
@@ -66,7 +83,7 @@ inline GFLOAT softLight_t::getSample(int face,int x, int y/*,object3d_t * &objec
 	if( SIDE_ISIN(x) && SIDE_ISIN(y)) 
 	{
 		//object=obj[face](x,y);
-		return buffer[face](x,y);
+		return depth(face,buffer[face](x,y));
 	}
 	if(SIDE_ISOUT(x) && SIDE_ISOUT(y)) 
 	{
@@ -100,13 +117,13 @@ inline GFLOAT softLight_t::getSample(int face,int x, int y/*,object3d_t * &objec
 	switch(os)
 	{
 		case SIDE_UP :
-			return buffer[of](in,out);
+			return depth(of,buffer[of](in,out));
 		case SIDE_RIGHT :
-			return buffer[of](res-out-1,in);
+			return depth(of,buffer[of](res-out-1,in));
 		case SIDE_DOWN :
-			return buffer[of](in,res-out-1);
+			return depth(of,buffer[of](in,res-out-1));
 		case SIDE_LEFT :
-			return buffer[of](out,in);
+			return depth(of,buffer[of](out,in));
 	}
 	return -1.0;
 }
@@ -172,6 +189,19 @@ inline int softLight_t::guessSide(const vector3d_t &v,GFLOAT &x,GFLOAT &y)const
 inline CFLOAT softLight_t::mixShadow(int face,int ix,int iy,int fx,int fy,
 		GFLOAT cx,GFLOAT cy,GFLOAT Z/*,const object3d_t *ob*/)const
 {
+	// a window inside the face may be all lit or all shadowed by its tiles
+	if((ix>=0) && (iy>=0) && (fx<res) && (fy<res))
+	{
+		unsigned short lo=SHADOW_FAR, hi=0;
+		for(int ty=iy/SHADOW_TILE;ty<=fy/SHADOW_TILE;++ty)
+			for(int tx=ix/SHADOW_TILE;tx<=fx/SHADOW_TILE;++tx)
+			{
+				lo=std::min(lo,tilemin[face](tx,ty));
+				hi=std::max(hi,tilemax[face](tx,ty));
+			}
+		if((lo==SHADOW_FAR) || (Z<=depth(face,lo)+bias)) return 1.0;
+		if((hi!=SHADOW_FAR) && (Z>depth(face,hi)+bias)) return 0.0;
+	}
 	GFLOAT num=0.0,den=0.0;
 	for(int y=iy;y<=fy;++y)
 		for(int x=ix;x<=fx;++x)
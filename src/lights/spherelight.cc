@@ -25,7 +25,8 @@
 __BEGIN_YAFRAY
 
 sphereLight_t::sphereLight_t(const point3d_t &p, PFLOAT r, int nsam, int psam,
-			const color_t &c, CFLOAT pw, int qmcm, bool dm, CFLOAT gli, CFLOAT glo, int glt)
+			const color_t &c, CFLOAT pw, int qmcm, bool dm, CFLOAT gli, CFLOAT glo, int glt,
+			PFLOAT thr)
 {
 	pos = p;
 	rad = r;
@@ -46,9 +47,13 @@ sphereLight_t::sphereLight_t(const point3d_t &p, PFLOAT r, int nsam, int psam,
 	samdiv = 1.0/(CFLOAT)samples;
 	color = c*pw;
 	qmc_method = qmcm;
-	HSEQ = new Halton[2];
-	HSEQ[0].setBase(2);
-	HSEQ[1].setBase(3);
+	Halton hu(2), hv(3);
+	for (int i=0;i<samples;++i) {
+		setu.push_back(hu.getNext());
+		setv.push_back(hv.getNext());
+	}
+	threshold = thr;
+	samplerSlot = context_t::reserveSlot();
 	dummy = dm;
 	glow_int = gli;
 	glow_ofs = glo;
@@ -85,40 +90,41 @@ color_t sphereLight_t::illuminate(renderState_t &state, const scene_t &s, const
 
 	createCS(dir, u, v);
 
-	if (qmc_method) {
-		HSEQ[0].setStart(ourRandomI());
-		HSEQ[1].setStart(ourRandomI());
-	}
-
-	int sm, Ltot=0;
+	/* Both methods take the points of the set in order, any prefix is
+	 * spread over the disk. The QMC method shifts the set at every point
+	 * shaded, the other one jitters every point alone.
+	 */
+	shadowSampler_t *sam = getShadowSampler(state, samplerSlot, sceneIndex());
+	PFLOAT shu = sam->random(), shv = sam->random();
+	int first = (pred_samples) ? std::min(pred_samples, samples) : std::min(8, samples);
+	const void *oldorigin = state.skipelement;
+	state.skipelement = sp.getOrigin();
+	sam->start();
 	point3d_t dp = pos;
-	for (sm=0;sm<samples;sm++)
+	for (int sm=0;(sm<samples) && !sam->done(first, threshold);sm++)
 	{
-		if ((pred_samples) && (sm==pred_samples)) {
-			// if points totally lit or totally shadowed, stop now
-			if (Ltot==sm) {
-				totalcolor *= (1.f/(CFLOAT)sm);
-				if (glow_int>0) totalcolor += glow_int * color * getGlow(pos, sp, eye, glow_ofs, glow_type);
-				return totalcolor;
-			}
-			else if (Ltot==0) return color_t(0.0);	// noglo
+		if (!qmc_method) {
+			shu = sam->random()/(PFLOAT)samples;
+			shv = sam->random()/(PFLOAT)samples;
 		}
-		ShirleyDisk(HSEQ[0].getNext(), HSEQ[1].getNext(), du, dv);
+		PFLOAT su = setu[sm]+shu, sv = setv[sm]+shv;
+		if (su>=1.0) su -= 1.0;
+		if (sv>=1.0) sv -= 1.0;
+		ShirleyDisk(su, sv, du, dv);
 		dp = pos + rad*(du*u + dv*v);
 		dir = dp - sp.P();
 		Ld = dir*dir;
 		if (Ld!=0.0) Ld=1.0/Ld;
 		dir.normalize();
-		const void *oldorigin=state.skipelement;
-		state.skipelement=sp.getOrigin();
-		if (!s.isShadowed(state, sp, dp)) {
-			Ltot++;
-			totalcolor += sha->fromLight(state, sp, energy_t(dir, color*Ld), eye);
-		}
-		state.skipelement=oldorigin;
+		bool lit = !s.isShadowed(state, sp, dp);
+		sam->add(lit);
+		if (lit) totalcolor += sha->fromLight(state, sp, energy_t(dir, color*Ld), eye);
 	}
-	totalcolor *= samdiv;
-	if (glow_int>0) totalcolor += ((CFLOAT)Ltot*samdiv) * glow_int * color * getGlow(pos, sp, eye, glow_ofs, glow_type);
+	state.skipelement = oldorigin;
+	if (sam->allShadowed()) return color_t(0.0);	// noglo
+	CFLOAT div = 1.0/(CFLOAT)sam->taken;
+	totalcolor *= div;
+	if (glow_int>0) totalcolor += ((CFLOAT)sam->lit*div) * glow_int * color * getGlow(pos, sp, eye, glow_ofs, glow_type);
 	return totalcolor;
 }
 
@@ -156,6 +162,7 @@ light_t *sphereLight_t::factory(paramMap_t &params, renderEnvironment_t &render)
 	int nsam=16, psam=0;
 	int qmcm = 0;
 	bool dm = false;
+	PFLOAT thr = 0.02;
 
 	params.getParam("from", p);
 	params.getParam("radius", r);
@@ -165,6 +172,7 @@ light_t *sphereLight_t::factory(paramMap_t &params, renderEnvironment_t &render)
 	params.getParam("psamples", psam);
 	params.getParam("qmc_method", qmcm);
 	params.getParam("dummy", dm);
+	params.getParam("threshold", thr);
 
 	// glow params
 	CFLOAT gli=0, glo=0;
@@ -173,7 +181,7 @@ light_t *sphereLight_t::factory(paramMap_t &params, renderEnvironment_t &render)
 	params.getParam("glow_type", glt);
 	params.getParam("glow_offset", glo);
 
-	return new sphereLight_t(p, r, nsam, psam, col, pw, qmcm, dm, gli, glo, glt);
+	return new sphereLight_t(p, r, nsam, psam, col, pw, qmcm, dm, gli, glo, glt, thr);
 }
 
 pluginInfo_t sphereLight_t::info()
@@ -191,6 +199,7 @@ pluginInfo_t sphereLight_t::info()
 	info.params.push_back(buildInfo<INT>("psamples",0,1000,0, "Minimum of samples to estimate shadowing"));
 	info.params.push_back(buildInfo<INT>("qmc_method",0, 1, 0, "The sampling method"));
 	info.params.push_back(buildInfo<BOOL>("dummy", "Use only to shoot photons, no direct lighting"));
+	info.params.push_back(buildInfo<FLOAT>("threshold", 0.0f, 1.0f, 0.02f, "Error of the lit fraction where penumbra sampling stops"));
 
 	return info;
 
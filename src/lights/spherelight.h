@@ -30,6 +30,7 @@
 #include "light.h"
 #include "params.h"
 #include "mcqmc.h"
+#include "shadowsampler.h"
 
 __BEGIN_YAFRAY
 
@@ -52,11 +53,12 @@ class sphereLight_t : public light_t
 {
 	public:
 		sphereLight_t(const point3d_t &p, PFLOAT r, int nsam, int psam,
-				const color_t &c, CFLOAT pw, int qmcm=0, bool dm=false, CFLOAT gli=0, CFLOAT glo=0, int glt=0);
+				const color_t &c, CFLOAT pw, int qmcm=0, bool dm=false, CFLOAT gli=0, CFLOAT glo=0, int glt=0,
+				PFLOAT thr=0.02);
 		virtual color_t illuminate(renderState_t &state, const scene_t &s, const surfacePoint_t sp, const vector3d_t &eye) const;
 		virtual point3d_t position() const { return pos; }
 		virtual void init(scene_t &scene) {}
-		virtual ~sphereLight_t() { delete[] HSEQ;  HSEQ=NULL; }
+		virtual ~sphereLight_t() { context_t::releaseSlot(samplerSlot); }
 
 		virtual emitter_t * getEmitter(int maxsamples) const { return new sphereEmitter_t(color, pos, rad); }
 
@@ -70,7 +72,10 @@ class sphereLight_t : public light_t
 		int qmc_method;
 		CFLOAT samdiv;
 		bool dummy;
-		Halton* HSEQ;
+		// Halton points on the unit square, randomly shifted at every point shaded
+		std::vector<PFLOAT> setu, setv;
+		PFLOAT threshold;
+		int samplerSlot;
 		CFLOAT glow_int, glow_ofs;
 		int glow_type;
 };
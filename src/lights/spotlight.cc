@@ -21,6 +21,7 @@
  */
 
 #include "spotlight.h"
+#include "ccthreads.h"
 
 __BEGIN_YAFRAY
 
@@ -47,8 +48,10 @@ color_t spotLight_t::illuminate(renderState_t &state,const scene_t &s,
 	if (ca>=cosout) {
 		if(use_map)
 		{
+			CFLOAT lit = getMappedLight(sp);
+			s.mapShadow(state, 1.0-lit);
 			atten = pow(ca, beamDist) * dist_atten * smoothstep(cosout, cosin, ca) * power;
-			energy_t ene(L, atten*getMappedLight(sp));
+			energy_t ene(L, atten*lit*color);
 			if (halo && !skipHalo)
 				return sha->fromLight(state,sp, ene, eye) + getVolume(s,sp,eye);
 			else return sha->fromLight(state,sp, ene, eye);
@@ -144,6 +147,11 @@ color_t spotLight_t::getVolume(const scene_t &s, const surfacePoint_t sp, const
 	return getFog(D2-D)*sumLine(rstart, rstart+(D2-D)*ray);
 }
 
+// steps of a halo line taken together
+#define HALO_BATCH 16
+// depth given to the misses in the map levels
+#define MAP_FAR 1e30
+
 color_t spotLight_t::sumLine(const point3d_t &s,const point3d_t &e)const
 {
 	vector3d_t start=toVector(s), end=toVector(e);
@@ -162,26 +170,59 @@ color_t spotLight_t::sumLine(const point3d_t &s,const point3d_t &e)const
 	bix *= L;
 	biy *= L;
 
-	PFLOAT curdist = ourRandom()*stepsize;
+	PFLOAT step = stepsize;
+	if (halo_steps>0)
+	{
+		if (dist<=0) return color_t(0.0);
+		step = dist/(PFLOAT)halo_steps;
+	}
+	PFLOAT curdist = ourRandom()*step;
 	int totsam = 0;
+	PFLOAT mx[HALO_BATCH], my[HALO_BATCH], pd[HALO_BATCH], pz[HALO_BATCH];
+	PFLOAT id2[HALO_BATCH], blur[HALO_BATCH];
 	while (curdist<dist)
 	{
-		vector3d_t pos = initpos + ldir*curdist;
-		curdist += stepsize;
-		PFLOAT d2 = pos.normLenSqr();
-		PFLOAT d = sqrt(d2);
-		if (d2!=0.0) d2=1.0/d2;
-		PFLOAT x = halfres + halfres*pos.x*isina, y = halfres + halfres*pos.y*isina;
-		if (hblur!=0.0)
+		int n=0;
+		for(;(n<HALO_BATCH) && (curdist<dist);++n,curdist+=step)
 		{
-			PFLOAT r2 = ourRandom();
-			PFLOAT dis = halfres*hblur*r2;
-			x += bix*dis;
-			y += biy*dis;
+			pd[n] = curdist;
+			blur[n] = (hblur!=0.0) ? halfres*hblur*ourRandom() : 0.0;
 		}
-		PFLOAT ca=pos.z;
-		if((shadow((int)x,(int)y)>d) || (shadow((int)x,(int)y)<0)) {
-			light += pow(ca, beamDist)*smoothstep(cosout, cosin, ca)*d2;
+		// positions of the batch on the map, no branches so it vectorizes
+		for(int i=0;i<n;++i)
+		{
+			PFLOAT x = initpos.x+ldir.x*pd[i];
+			PFLOAT y = initpos.y+ldir.y*pd[i];
+			PFLOAT z = initpos.z+ldir.z*pd[i];
+			PFLOAT d2 = x*x+y*y+z*z;
+			PFLOAT in = (d2!=0.0) ? 1.0/sqrt(d2) : 1.0;
+			x *= in;  y *= in;  z *= in;
+			pd[i] = sqrt(d2);
+			pz[i] = z;
+			id2[i] = (d2!=0.0) ? 1.0/d2 : d2;
+			mx[i] = (halfres + halfres*x*isina) + bix*blur[i];
+			my[i] = (halfres + halfres*y*isina) + biy*blur[i];
+		}
+		PFLOAT x0=mx[0], x1=mx[0], y0=my[0], y1=my[0], d0=pd[0], d1=pd[0];
+		for(int i=1;i<n;++i)
+		{
+			x0=std::min(x0,mx[i]);  x1=std::max(x1,mx[i]);
+			y0=std::min(y0,my[i]);  y1=std::max(y1,my[i]);
+			d0=std::min(d0,pd[i]);  d1=std::max(d1,pd[i]);
+		}
+		PFLOAT lo, hi;
+		mapRange((int)x0, (int)y0, (int)x1, (int)y1, lo, hi);
+		if (hi<=d0) continue;
+		bool alllit = (lo>d1);
+		for(int i=0;i<n;++i)
+		{
+			if (!alllit)
+			{
+				PFLOAT sh = shadow((int)mx[i], (int)my[i]);
+				if ((sh<=pd[i]) && (sh>=0)) continue;
+			}
+			PFLOAT ca=pz[i];
+			light += pow(ca, beamDist)*smoothstep(cosout, cosin, ca)*id2[i];
 			totsam++;
 		}
 	}
@@ -189,9 +230,47 @@ color_t spotLight_t::sumLine(const point3d_t &s,const point3d_t &e)const
 	return color*power*light;
 }
 
-color_t spotLight_t::getMappedLight(const surfacePoint_t &sp)const
+/* Out of the map shadow() gives 0, always shadowed, so a box going out
+ * of it can't be all lit.
+ */
+void spotLight_t::mapRange(int x0,int y0,int x1,int y1,PFLOAT &lo,PFLOAT &hi)const
+{
+	lo=MAP_FAR;
+	hi=0;
+	if ((x0<0) || (y0<0) || (x1>=resolution) || (y1>=resolution))
+	{
+		lo=0;
+		x0=std::max(x0,0);  y0=std::max(y0,0);
+		x1=std::min(x1,resolution-1);  y1=std::min(y1,resolution-1);
+		if ((x0>x1) || (y0>y1)) return;
+	}
+	int l=0;
+	while (((x1>>l)-(x0>>l)>1) || ((y1>>l)-(y0>>l)>1)) ++l;
+	if (l==0)
+	{
+		for(int y=y0;y<=y1;++y)
+			for(int x=x0;x<=x1;++x)
+			{
+				PFLOAT d=shadow(x,y);
+				if (d<0) d=MAP_FAR;
+				lo=std::min(lo,d);
+				hi=std::max(hi,d);
+			}
+		return;
+	}
+	const std::vector<PFLOAT> &lmin=levelmin[l-1], &lmax=levelmax[l-1];
+	int w=(resolution+(1<<l)-1)>>l;
+	for(int y=(y0>>l);y<=(y1>>l);++y)
+		for(int x=(x0>>l);x<=(x1>>l);++x)
+		{
+			lo=std::min(lo,lmin[y*w+x]);
+			hi=std::max(hi,lmax[y*w+x]);
+		}
+}
+
+CFLOAT spotLight_t::getMappedLight(const surfacePoint_t &sp)const
 {
-	if(!use_map) return color_t(0.0);
+	if(!use_map) return 0.0;
 
 	vector3d_t tvP=sp.P()-from;
 	vector3d_t vP(tvP*vx, tvP*vy, tvP*ndir);
@@ -199,7 +278,7 @@ color_t spotLight_t::getMappedLight(const surfacePoint_t &sp)const
 	vector3d_t vv(sp.NV()*vx, sp.NV()*vy, sp.NV()*ndir);
 	PFLOAT D = vP.z*tana*sblur;
 	
-	color_t light(0.0);
+	CFLOAT light=0.0;
 
 	int sqs = int(sqrt((PFLOAT)shadow_samples));
 	if (sqs<1) sqs=1;
@@ -211,35 +290,96 @@ color_t spotLight_t::getMappedLight(const surfacePoint_t &sp)const
 			vector3d_t pos = vP + D*(vu*r1 + vv*r2);
 			PFLOAT d = pos.normLen();
 			PFLOAT _x=halfres+halfres*pos.x*isina, _y=halfres+halfres*pos.y*isina;
-			if((shadow((int)_x,(int)_y)>(d-0.3)) || (shadow((int)_x,(int)_y)<0)) light += color;
+			if((shadow((int)_x,(int)_y)>(d-0.3)) || (shadow((int)_x,(int)_y)<0)) light += 1.0;
 		}
 	}
 	return light/((CFLOAT)(sqs*sqs));
 }
 
-void spotLight_t::buildShadowMap(scene_t &scene)
+#define MAP_ROWS 8
+
+/// casts the rays of the halo shadow map, rows shared among threads
+struct haloMapJob_t : public yafthreads::blockJob_t
 {
-	cerr << "Building volumetric shadow map... ";
-	cerr.flush();
-	surfacePoint_t sp;
-	renderState_t state;
-	for(int y=0;y<resolution;++y)
+	haloMapJob_t(const scene_t &s,const point3d_t &f,const vector3d_t &n,
+			const vector3d_t &x,const vector3d_t &y,PFLOAT sa,int r,vector<PFLOAT> &m)
+		:scene(s),from(f),ndir(n),vx(x),vy(y),sina(sa),resolution(r),map(m)
 	{
-		PFLOAT leny = 2*sina*((PFLOAT)y-halfres)/(PFLOAT)resolution;
-		for(int x=0;x<resolution;++x)
+		halfres=resolution*0.5;
+		blocks=(resolution+MAP_ROWS-1)/MAP_ROWS;
+	}
+	virtual void doBlock(int b)
+	{
+		surfacePoint_t sp;
+		renderState_t state;
+		int last=std::min((b+1)*MAP_ROWS,resolution);
+		for(int y=b*MAP_ROWS;y<last;++y)
 		{
-			PFLOAT lenx = 2*sina*((PFLOAT)x - halfres)/(PFLOAT)resolution;
-			PFLOAT lenz = sqrt(1.0 - lenx*lenx - leny*leny);
-			vector3d_t ray = ndir*lenz + vx*lenx + vy*leny;
-			if (!scene.firstHit(state, sp, from, ray, true))
-				shadow(x,y) = -1;
-			else
-				shadow(x,y) = sp.Z()+scene.selfBias();
+			PFLOAT leny = 2*sina*((PFLOAT)y-halfres)/(PFLOAT)resolution;
+			for(int x=0;x<resolution;++x)
+			{
+				PFLOAT lenx = 2*sina*((PFLOAT)x - halfres)/(PFLOAT)resolution;
+				PFLOAT lenz = sqrt(1.0 - lenx*lenx - leny*leny);
+				vector3d_t ray = ndir*lenz + vx*lenx + vy*leny;
+				if (!scene.firstHit(state, sp, from, ray, true))
+					map[y*resolution+x] = -1;
+				else
+					map[y*resolution+x] = sp.Z()+scene.selfBias();
+			}
 		}
 	}
+
+	const scene_t &scene;
+	point3d_t from;
+	vector3d_t ndir, vx, vy;
+	PFLOAT sina, halfres;
+	int resolution;
+	vector<PFLOAT> &map;
+};
+
+void spotLight_t::buildShadowMap(scene_t &scene)
+{
+	cerr << "Building volumetric shadow map... ";
+	cerr.flush();
+	haloMapJob_t job(scene, from, ndir, vx, vy, sina, resolution, shadow_map);
+	job.run(std::max(scene.getCPUs(),1));
+	buildMapLevels();
+	map_built = true;
 	cerr << "OK\n";
 }
 
+void spotLight_t::buildMapLevels()
+{
+	levelmin.clear();
+	levelmax.clear();
+	int w=resolution;
+	for(int l=1;w>1;++l)
+	{
+		int nw=(resolution+(1<<l)-1)>>l;
+		std::vector<PFLOAT> lmin(nw*nw,MAP_FAR), lmax(nw*nw,0);
+		for(int y=0;y<w;++y)
+			for(int x=0;x<w;++x)
+			{
+				PFLOAT a, b;
+				if (l==1)
+				{
+					a=b=shadow(x,y);
+					if (a<0) a=b=MAP_FAR;
+				}
+				else
+				{
+					a=levelmin[l-2][y*w+x];
+					b=levelmax[l-2][y*w+x];
+				}
+				int k=(y>>1)*nw+(x>>1);
+				lmin[k]=std::min(lmin[k],a);
+				lmax[k]=std::max(lmax[k],b);
+			}
+		levelmin.push_back(lmin);
+		levelmax.push_back(lmax);
+		w=nw;
+	}
+}
 
 void spotLight_t::setMap(int res, int ss, PFLOAT b)
 {
@@ -252,11 +392,12 @@ void spotLight_t::setMap(int res, int ss, PFLOAT b)
 	shadow_samples = ss;
 }
 
-void spotLight_t::setHalo(const color_t &f, CFLOAT d, PFLOAT b, PFLOAT s)
+void spotLight_t::setHalo(const color_t &f, CFLOAT d, PFLOAT b, PFLOAT s, int steps)
 {
 	halo = true;
 	hblur = b;
 	stepsize = s;
+	halo_steps = steps;
 	fog = f;
 	fden = d;
 }
@@ -297,6 +438,8 @@ light_t *spotLight_t::factory(paramMap_t &params,renderEnvironment_t &render)
 	int shadow_samples;
 	PFLOAT stepsize = 1;	//replacement for 'samples'
 	PFLOAT hblur=0, sblur=0;
+	int halo_steps = 0;
+	bool recalculate = true;
 
 	params.getParam("from", from);
 	params.getParam("to", to);
@@ -323,6 +466,8 @@ light_t *spotLight_t::factory(paramMap_t &params,renderEnvironment_t &render)
 	if (shadow_samples<1) shadow_samples=1;
 	params.getParam("halo_blur", hblur);
 	params.getParam("shadow_blur", sblur);
+	params.getParam("halo_steps", halo_steps);
+	params.getParam("recalculate", recalculate);
 
 	spotLight_t *spot=new spotLight_t(from, to, color, power, size, blend, falloff, shadows);
 	if(halo)
@@ -332,7 +477,8 @@ light_t *spotLight_t::factory(paramMap_t &params,renderEnvironment_t &render)
 		params.getParam("fog", fog);
 		params.getParam("fog_density", fden);
 		spot->setMap(res, shadow_samples, sblur);
-		spot->setHalo(fog, fden, hblur, stepsize);
+		spot->setHalo(fog, fden, hblur, stepsize, halo_steps);
+		spot->reuseMap(!recalculate);
 	}
 	return spot;
 }
@@ -351,6 +497,10 @@ pluginInfo_t spotLight_t::info()
 	info.params.push_back(buildInfo<FLOAT>("size", 0, 180, 45, "Aperture of the cone"));
 	
 	info.params.push_back(buildInfo<BOOL>("cast_shadows", "Whenever to cast shadows"));
+	info.params.push_back(buildInfo<INT>("halo_steps", 0, 4096, 0,
+				"Steps of every halo line, 0 to step by stepsize"));
+	info.params.push_back(buildInfo<BOOL>("recalculate",
+				"Rebuild the halo shadow map every render"));
 
 	return info;
 }
@@ -67,18 +67,26 @@ class spotLight_t : public light_t
 			if (isina!=0.0) isina = 1.0/isina;
 			cast_shadows = cs;
 			use_map = halo = false;
+			recalculate = true;
+			map_built = false;
+			halo_steps = 0;
 			createCS(ndir, vx, vy);
 		};
 
 		void setMap(int res, int ss, PFLOAT b);
-		void setHalo(const color_t &f, CFLOAT d, PFLOAT b=0, PFLOAT s=0.1);
+		void setHalo(const color_t &f, CFLOAT d, PFLOAT b=0, PFLOAT s=0.1, int steps=0);
+		/// keeps the halo shadow map of the previous render, for static scenes
+		void reuseMap(bool r) {recalculate=!r;};
 
 		virtual color_t illuminate(renderState_t &state,const scene_t &s, 
 				const surfacePoint_t sp, const vector3d_t &eye) const;
 		virtual point3d_t position() const { return from; };
 		virtual emitter_t * getEmitter(int maxsamples)const 
 		{return new spotEmitter_t(from,-dir,cosa,color*power*(angle/M_PI));};
-		virtual void init(scene_t &scene) {if(halo) buildShadowMap(scene);};
+		virtual void init(scene_t &scene) 
+		{
+			if(halo && ((recalculate && changed) || !map_built)) buildShadowMap(scene);
+		};
 		virtual ~spotLight_t() {};
 
 		static light_t *factory(paramMap_t &params,renderEnvironment_t &render);
@@ -105,20 +113,30 @@ class spotLight_t : public light_t
 				return noshadow;
 			return shadow_map[y*resolution+x];
 		};
-		color_t getMappedLight(const surfacePoint_t &sp)const;
+		/// lit fraction of the shadow map samples around sp
+		CFLOAT getMappedLight(const surfacePoint_t &sp)const;
 		color_t sumLine(const point3d_t &s,const point3d_t &e)const;
 		color_t getFog(PFLOAT d)const;
 		void buildShadowMap(scene_t &scene);
+		void buildMapLevels();
+		void mapRange(int x0,int y0,int x1,int y1,PFLOAT &lo,PFLOAT &hi)const;
 
 		vector3d_t vx,vy;
 		PFLOAT cosa, tana, sina, isina;
 		std::vector<PFLOAT> shadow_map;
+		/* Lowest and highest depth of the map in blocks of 2^(l+1) pixels,
+		 * misses taken as far away, so the halo can skip whole lengths of a
+		 * line that are all lit or all shadowed.
+		 */
+		std::vector< std::vector<PFLOAT> > levelmin, levelmax;
+		bool recalculate, map_built;
 		int resolution;
 		PFLOAT halfres;
 		PFLOAT noshadow;
 		PFLOAT sblur, hblur;
 		int shadow_samples;
 		PFLOAT stepsize;
+		int halo_steps;
 		color_t fog;
 		CFLOAT fden;
 };
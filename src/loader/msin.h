@@ -155,6 +155,7 @@ __BEGIN_YAFRAY
 #define A_ANGLE       51
 #define A_SEARCH      52
 #define A_ORCO        53
+#define A_COMPACT     70
 
 class ast_t
 {
@@ -511,8 +512,9 @@ class lpoint_data_t : public ast_t
 class face_data_t : public ast_t
 {
 	public:
-		face_data_t() {id=AST_FACE;};
+		face_data_t(): hasuv(false), has_vcol(false) {id=AST_FACE;};
 		triangle_t T;
+		bool hasuv, has_vcol;
 		GFLOAT uv[6];
 		CFLOAT vcol[9];
 		string shader;
@@ -536,6 +538,7 @@ class mesh_data_t : public ast_t
 		mesh_data_t() {id=AST_MESH;};
 		bool autosmooth;
 		bool orco;
+		bool compact;
 		PFLOAT angle;
 		lpoint_data_t *points;
 		lface_data_t *faces;
@@ -138,70 +138,70 @@ lval_t join_face(vector<lval_t>::iterator v)
 				attr.F-=(float)n;
 				if(attr.F!=0.0) WARNING<<"Trunccating non integer value for "<<
 															attr.I<<" attribute\n";
-				face->T.a=(point3d_t *)n;
+				face->T.va=n;
 				break;
 			case A_T_B :
 				n=(int)attr.F;
 				attr.F-=(float)n;
 				if(attr.F!=0.0) WARNING<<"Trunccating non integer value for "<<
 															attr.I<<" attribute\n";
-				face->T.b=(point3d_t *)n;
+				face->T.vb=n;
 				break;
 			case A_T_C :
 				n=(int)attr.F;
 				attr.F-=(float)n;
 				if(attr.F!=0.0) WARNING<<"Warning trunccating non integer value for "<<
 															attr.I<<" attribute\n";
-				face->T.c=(point3d_t *)n;
+				face->T.vc=n;
 				break;
 			case A_T_UA :
-				face->uv[0]=attr.F;  face->T.hasuv=true;
+				face->uv[0]=attr.F;  face->hasuv=true;
 				break;
 			case A_T_UB :
-				face->uv[2]=attr.F;  face->T.hasuv=true;
+				face->uv[2]=attr.F;  face->hasuv=true;
 				break;
 			case A_T_UC :
-				face->uv[4]=attr.F;  face->T.hasuv=true;
+				face->uv[4]=attr.F;  face->hasuv=true;
 				break;
 			case A_T_VA :
-				face->uv[1]=attr.F;  face->T.hasuv=true;
+				face->uv[1]=attr.F;  face->hasuv=true;
 				break;
 			case A_T_VB :
-				face->uv[3]=attr.F;  face->T.hasuv=true;
+				face->uv[3]=attr.F;  face->hasuv=true;
 				break;
 			case A_T_VC :
-				face->uv[5]=attr.F;  face->T.hasuv=true;
+				face->uv[5]=attr.F;  face->hasuv=true;
 				break;
 			case A_SHADER:
 				if(attr.f) WARNING<<"Only an identifier can be the name of a shader\n";
 				face->shader=attr.D;
 				break;
 			case A_T_VCOL_A_R:
-				face->vcol[0]=attr.F;  face->T.has_vcol=true;
+				face->vcol[0]=attr.F;  face->has_vcol=true;
 				break;
 			case A_T_VCOL_A_G:
-				face->vcol[1]=attr.F;  face->T.has_vcol=true;
+				face->vcol[1]=attr.F;  face->has_vcol=true;
 				break;
 			case A_T_VCOL_A_B:
-				face->vcol[2]=attr.F;  face->T.has_vcol=true;
+				face->vcol[2]=attr.F;  face->has_vcol=true;
 				break;
 			case A_T_VCOL_B_R:
-				face->vcol[3]=attr.F;  face->T.has_vcol=true;
+				face->vcol[3]=attr.F;  face->has_vcol=true;
 				break;
 			case A_T_VCOL_B_G:
-				face->vcol[4]=attr.F;  face->T.has_vcol=true;
+				face->vcol[4]=attr.F;  face->has_vcol=true;
 				break;
 			case A_T_VCOL_B_B:
-				face->vcol[5]=attr.F;  face->T.has_vcol=true;
+				face->vcol[5]=attr.F;  face->has_vcol=true;
 				break;
 			case A_T_VCOL_C_R:
-				face->vcol[6]=attr.F;  face->T.has_vcol=true;
+				face->vcol[6]=attr.F;  face->has_vcol=true;
 				break;
 			case A_T_VCOL_C_G:
-				face->vcol[7]=attr.F;  face->T.has_vcol=true;
+				face->vcol[7]=attr.F;  face->has_vcol=true;
 				break;
 			case A_T_VCOL_C_B:
-				face->vcol[8]=attr.F;  face->T.has_vcol=true;
+				face->vcol[8]=attr.F;  face->has_vcol=true;
 				break;
 			default:
 				WARNING<<"Unknown attribute for face >"<<attr.I<<endl;
@@ -220,10 +220,16 @@ lval_t join_lface(vector<lval_t>::iterator v)
 	lface_data_t *lf=(lface_data_t *)v[0].ast;
 	face_data_t *f=(face_data_t *)v[1].ast;
 	
-	if(f->T.hasuv)
+	if(f->hasuv)
+	{
+		f->T.setUV(lf->facesuv.size());
 		lf->facesuv.insert(lf->facesuv.end(), f->uv, f->uv+6);
-	if(f->T.has_vcol)
+	}
+	if(f->has_vcol)
+	{
+		f->T.setVCOL(lf->faces_vcol.size());
 		lf->faces_vcol.insert(lf->faces_vcol.end(), f->vcol, f->vcol+9);
+	}
 	if(f->shader=="") f->T.setShader((shader_t *)-1);
 	else
 	{
@@ -259,6 +265,7 @@ string_value_t mesh_attrs[]=
 {
 	{ "autosmooth", A_AUTOSMOOTH },
 	{ "has_orco", A_ORCO },
+	{ "compact", A_COMPACT },
 };
 
 //$mesh   = $st_mesh  $lattr   '>' $points  $faces  $en_mesh  &join_mesh  ;
@@ -269,6 +276,7 @@ lval_t join_mesh(vector<lval_t>::iterator v)
 	mesh_data_t *mesh=new mesh_data_t;
 	mesh->autosmooth=false;
 	mesh->orco=false;
+	mesh->compact=false;
 	check_ast(v[1].ast,AST_LATTRDATA);
 	check_ast(v[3].ast,AST_LPOINT);
 	check_ast(v[4].ast,AST_LFACE);
@@ -296,6 +304,10 @@ lval_t join_mesh(vector<lval_t>::iterator v)
 				if(!attr.f && attr.D=="on")
 					mesh->orco=true;
 				break;
+			case A_COMPACT:
+				if(!attr.f && attr.D=="on")
+					mesh->compact=true;
+				break;
 			default:
 				WARNING<<"Unknown attribute > "<<attr.I<<" for mesh\n";
 		}
@@ -36,6 +36,8 @@
 #define INFO cerr<<"[Loader]: "
 
 #include "yafsystem.h"
+#include "mipmap.h"
+#include "shadecache.h"
 
 __BEGIN_YAFRAY
 
@@ -721,48 +723,27 @@ void * render_t::mesh(ast_t *ast)
 		}
 		else shaders.push_back(shader_table[*i]);
 	}
+	unsigned int npoints=mesh->points->points.size();
 	for(vector<triangle_t>::iterator i=faces.begin();i!=faces.end();++i)
 	{
-		long int n=(long int)((*i).a);
-		if((n>=(long int)mesh->points->points.size()) || (n<0))
-			{ WARNING<<"Point "<<n<<" out of bounds in object\n"; n=0; }
-		(*i).a=&(mesh->points->points)[n];
-		n=(long int)((*i).b);
-		if((n>=(long int)mesh->points->points.size()) || (n<0))
-			{ WARNING<<"Point "<<n<<" out of bounds in object\n"; n=0; }
-		(*i).b=&(mesh->points->points)[n];
-		n=(long int)((*i).c);
-		if((n>=(long int)mesh->points->points.size()) || (n<0))
-			{ WARNING<<"Point "<<n<<" out of bounds in object\n"; n=0; }
-		(*i).c=&(mesh->points->points)[n];
-		
-		(*i).recNormal();
+		unsigned int *v[3]={&(*i).va,&(*i).vb,&(*i).vc};
+		for(int k=0;k<3;++k)
+			if(*v[k]>=npoints)
+				{ WARNING<<"Point "<<(int)*v[k]<<" out of bounds in object\n"; *v[k]=0; }
 		long int ishader=(long int)(*i).getShader();
 		if(ishader<0) 
 			(*i).setShader(NULL);
 		else
 			(*i).setShader(shaders[ishader]);
 	}
-	int uv_offset=0, vcol_offset=0;
-	for(vector<triangle_t>::iterator i=mesh->faces->faces.begin();
-				i!=mesh->faces->faces.end();++i) {
-		if(i->hasuv)
-		{
-			i->uv = mesh->faces->facesuv.begin() + uv_offset;
-			uv_offset += 6;
-		}
-		if(i->has_vcol)
-		{
-			i->vcol = mesh->faces->faces_vcol.begin() + vcol_offset;
-			vcol_offset += 9;
-		}
-	}
+	// the parsed data is not used again, the mesh takes it
 	vector<vector3d_t> normals;
-	meshObject_t *obj = meshObject_t::factory(mesh->orco, M, mesh->points->points, normals,
+	meshObject_t *obj = meshObject_t::factorySwap(mesh->orco, M, mesh->points->points, normals,
 						mesh->faces->faces, mesh->faces->facesuv, mesh->faces->faces_vcol);
 
-	if(mesh->autosmooth) obj->autoSmooth(mesh->angle);
-	obj->tangentsFromUV();
+	if(mesh->autosmooth) obj->autoSmooth(mesh->angle,cpus);
+	obj->tangentsFromUV(cpus);
+	if(mesh->compact) obj->compact();
 	
 	return obj;
 }
@@ -895,7 +876,6 @@ void * render_t::filter(ast_t *ast)
 
 filter_t * render_t::filter_dof(paramMap_t &params)
 {
-	/*
 	GFLOAT focus=1.0;
 	GFLOAT near_radius=1.0;
 	GFLOAT far_radius=1.0,scale=1.0;
@@ -904,20 +884,15 @@ filter_t * render_t::filter_dof(paramMap_t &params)
 	params.getParam("far_blur",far_radius);
 	params.getParam("scale",scale);
 	return new filterDOF_t(focus,near_radius,far_radius,scale);
-	*/
-	return NULL;
 }
 
 filter_t *render_t::filter_antinoise(paramMap_t &params)
 {
-	/*
 	GFLOAT radius=1.0;
 	GFLOAT delta=1.0;
 	params.getParam("radius",radius);
 	params.getParam("max_delta",delta);
 	return new filterAntiNoise_t(radius,delta);
-	*/
-	return NULL;
 }
 
 
@@ -1101,6 +1076,20 @@ void * render_t::render(ast_t *ast)
 		params.getParam("AA_threshold", AA_threshold);
 	bool AA_jitterfirst = false;
 	params.getParam("AA_jitterfirst", AA_jitterfirst);
+	CFLOAT AA_noise = 0;
+	params.getParam("AA_noise", AA_noise);
+	bool progressive = false;
+	PFLOAT progressive_time = 0;
+	params.getParam("progressive", progressive);
+	params.getParam("progressive_time", progressive_time);
+	bool preview = false;
+	params.getParam("preview", preview);
+	bool deterministic = false;
+	params.getParam("deterministic", deterministic);
+	// extra channels saved with the image, names separated by spaces
+	string _aovs="";
+	const string *aovs=&_aovs;
+	params.getParam("aovs", aovs);
 	bool clamp_rgb = false;
 	params.getParam("clamp_rgb", clamp_rgb);
 
@@ -1128,6 +1117,15 @@ void * render_t::render(ast_t *ast)
 	color_t fgcol(1.0);
 	params.getParam("fog_color", fgcol);
 
+	// memory for the tiles of paged image textures, in MB
+	int texture_cache = 256;
+	params.getParam("texture_cache", texture_cache);
+	if (texture_cache<1) texture_cache = 1;
+	tileCache_t::instance().setMemoryLimit((size_t)texture_cache<<20);
+	bool shade_cache = true;
+	params.getParam("shade_cache", shade_cache);
+	shadeCache_t::setEnabled(shade_cache);
+
 	scene_t *scene;
 	switch (strategy) {
 		case MONO:
@@ -1191,6 +1189,13 @@ void * render_t::render(ast_t *ast)
 			<< AA_minsamples << " minimum samples per pass, "
 			<< AA_passes*AA_minsamples << " samples total.\n";
 	else cout << "No anti-aliasing.\n";
+	if (AA_passes && (AA_noise>0))
+		cout << "Samples given to pixels by noise, down to a relative error of " << AA_noise << "\n";
+	if (progressive) {
+		cout << "Progressive rendering, ";
+		if (progressive_time>0) cout << "for " << progressive_time << " seconds.\n";
+		else cout << AA_passes << " passes at most.\n";
+	}
 
 	scene->setMaxRayDepth(raydepth);
 
@@ -1221,6 +1226,11 @@ void * render_t::render(ast_t *ast)
 
 	// set the AA params
 	scene->setAASamples(AA_passes, AA_minsamples, AA_pixelwidth, AA_threshold, AA_jitterfirst);
+	scene->setAANoise(AA_noise);
+	scene->setProgressive(progressive, progressive_time);
+	scene->setPreview(preview);
+	scene->setDeterministic(deterministic);
+	scene->setAOVs(*aovs);
 	scene->clampRGB(clamp_rgb);
 
 	scene->setBias(bias);
@@ -1230,32 +1240,28 @@ void * render_t::render(ast_t *ast)
 	scene->setCPUs(cpus);
 
 	// tone mapping bypassed when hdr/exr output is requested
-	if (*output_type=="hdr") {
-		outHDR_t hdrout(cam->resX(), cam->resY(), outfile->c_str());
-		scene->tonemap(false);
-		scene->render(hdrout);
-		hdrout.flush();
-	}
+	colorOutput_t *output;
+	bool tonemap=false;
+	if (*output_type=="hdr")
+		output=new outHDR_t(cam->resX(), cam->resY(), outfile->c_str());
 	else if (int((*output_type).find("exr"))!=-1) {
 #if HAVE_EXR
-		outEXR_t exrout(cam->resX(), cam->resY(), outfile->c_str(), *exr_flags);
-		scene->tonemap(false);
-		scene->render(exrout);
-		exrout.flush();
+		output=new outEXR_t(cam->resX(), cam->resY(), outfile->c_str(), *exr_flags);
 #else
 		cout << "Yafray was compiled without OpenEXR support.\nImage saved in hdr format instead." << endl;
-		outHDR_t hdrout(cam->resX(), cam->resY(), outfile->c_str());
-		scene->tonemap(false);
-		scene->render(hdrout);
-		hdrout.flush();
+		output=new outHDR_t(cam->resX(), cam->resY(), outfile->c_str());
 #endif
 	}
 	else {
-		outTga_t tgaout(cam->resX(), cam->resY(), outfile->c_str(), save_alpha);
-		scene->tonemap(true);
-		scene->render(tgaout);
-		tgaout.flush();
+		output=new outTga_t(cam->resX(), cam->resY(), outfile->c_str(), save_alpha);
+		tonemap=true;
 	}
+	scene->tonemap(tonemap);
+	scene->render(*output);
+	output->flush();
+	delete output;
+	tileCache_t::instance().printStats();
+	shadeCache_t::printStats();
 
 	delete scene;
 
@@ -0,0 +1,228 @@
+#!/usr/bin/env python
+# Golden image regression and benchmark suite.
+#
+# Renders the reference scenes of scenes.py with a built yafray, compares
+# the images with the goldens and appends the times and rays per second to
+# a json history. A scene fails when too many of its pixels differ from the
+# golden, or when it renders slower than the runs before it on the same
+# host. Scenes with post filters also keep the time of the filters. Run with
+# -h for the options, -u writes new goldens.
+
+from __future__ import print_function
+
+import json
+import optparse
+import os
+import platform
+import re
+import shutil
+import struct
+import subprocess
+import sys
+import time
+
+here=os.path.dirname(os.path.abspath(__file__))
+sys.path.insert(0,here)
+import scenes
+
+# width, height and rows of rgb pixels, top to bottom
+def readTga(name):
+	f=open(name,'rb')
+	d=bytearray(f.read())
+	f.close()
+	idlen,kind=d[0],d[2]
+	w,h=struct.unpack('<HH',bytes(d[12:16]))
+	n=d[16]//8
+	topdown=d[17]&0x20
+	if (kind not in (2,10)) or (n<3): raise ValueError('%s: not an rgb targa'%name)
+	p=18+idlen
+	px=[]
+	if kind==2:
+		for i in range(w*h): px.append(d[p+i*n:p+i*n+n])
+	else:
+		while len(px)<w*h:
+			c=d[p]
+			p+=1
+			if c&0x80:
+				px+=[d[p:p+n]]*((c&0x7f)+1)
+				p+=n
+			else:
+				for k in range((c&0x7f)+1):
+					px.append(d[p:p+n])
+					p+=n
+	rows=[[(q[2],q[1],q[0]) for q in px[r*w:(r+1)*w]] for r in range(h)]
+	if not topdown: rows.reverse()
+	return w,h,rows
+
+def writeTga(name,w,h,rows):
+	f=open(name,'wb')
+	f.write(struct.pack('<BBBHHBHHHHBB',0,0,2,0,0,0,0,0,w,h,24,0x20))
+	f.write(bytes(bytearray([c for r in rows for p in r for c in (p[2],p[1],p[0])])))
+	f.close()
+
+# mean difference, pixels differing more than threshold in some channel,
+# and the difference image, four times brighter
+def compare(a,b,threshold):
+	if a[:2]!=b[:2]: return None
+	total=0
+	bad=0
+	worst=0
+	diff=[]
+	for ra,rb in zip(a[2],b[2]):
+		row=[]
+		for pa,pb in zip(ra,rb):
+			d=[abs(x-y) for x,y in zip(pa,pb)]
+			total+=sum(d)
+			m=max(d)
+			if m>threshold: bad+=1
+			if m>worst: worst=m
+			row.append([min(255,4*x) for x in d])
+		diff.append(row)
+	n=a[0]*a[1]
+	return total/(3.0*n),worst,bad/float(n),diff
+
+statsLine=re.compile(r'Render time: ([0-9.e+-]+)s, ([0-9.e+-]+) samples, ([0-9.e+-]+) rays')
+filterLine=re.compile(r'Filter time: ([0-9.e+-]+)s')
+
+def render(opts,name,xml):
+	cmd=[opts.yafray,'-c',str(opts.cpus)]
+	if opts.plugins: cmd+=['-p',opts.plugins]
+	cmd.append(xml)
+	log=open(os.path.join(opts.out,name+'.log'),'w')
+	start=time.time()
+	status=subprocess.call(cmd,stdout=log,stderr=subprocess.STDOUT,cwd=opts.out)
+	wall=time.time()-start
+	log.close()
+	text=open(os.path.join(opts.out,name+'.log')).read()
+	found=statsLine.findall(text)
+	if status or not found: return None
+	t,samples,rays=[float(x) for x in found[-1]]
+	stats={'wall':wall,'render':t,'samples':samples,'rays':rays}
+	filters=filterLine.findall(text)
+	if filters: stats['filters']=float(filters[-1])
+	return stats
+
+def revision():
+	try:
+		p=subprocess.Popen(['git','describe','--always','--dirty'],cwd=here,
+				stdout=subprocess.PIPE,stderr=subprocess.PIPE)
+		out=p.communicate()[0].decode('ascii','replace').strip()
+		if p.returncode==0: return out
+	except OSError:
+		pass
+	return ''
+
+# median render time of the last runs of scene on this host and cpus
+def previous(history,scene,host,cpus,runs=5):
+	times=[]
+	for h in reversed(history):
+		if (h.get('host')!=host) or (h.get('cpus')!=cpus): continue
+		s=h.get('scenes',{}).get(scene)
+		if s and s.get('status')=='ok': times.append(s['render'])
+		if len(times)==runs: break
+	if not times: return None
+	times.sort()
+	return times[len(times)//2]
+
+def main():
+	parser=optparse.OptionParser(usage='%prog [options] [scene ...]')
+	parser.add_option('-y','--yafray',default='yafray',help='yafray program [%default]')
+	parser.add_option('-p','--plugins',default='',help='plugin directory')
+	parser.add_option('-c','--cpus',type='int',default=1,help='render threads [%default]')
+	parser.add_option('-o','--out',default='regress-out',help='directory of the renders [%default]')
+	parser.add_option('-g','--golden',default=os.path.join(here,'golden'),help='directory of the goldens')
+	parser.add_option('--grammar',default=os.path.join(os.path.dirname(here),'gram.yafray'),
+			help='gram.yafray, if yafray would not find it')
+	parser.add_option('--history',default='regress-history.json',help='json history [%default]')
+	parser.add_option('-u','--update',action='store_true',help='write the goldens instead of comparing')
+	parser.add_option('-t','--threshold',type='int',default=8,
+			help='levels a pixel channel can differ by [%default]')
+	parser.add_option('-f','--fraction',type='float',default=0.002,
+			help='fraction of pixels that can differ more [%default]')
+	parser.add_option('-m','--mean',type='float',default=0.5,help='highest mean difference [%default]')
+	parser.add_option('-s','--slowdown',type='float',default=1.3,
+			help='highest render time against the last runs, 0 not to check [%default]')
+	parser.add_option('--slack',type='float',default=0.05,
+			help='seconds a scene can always be slower by, timing noise [%default]')
+	parser.add_option('-r','--repeat',type='int',default=1,help='renders per scene, the fastest kept [%default]')
+	opts,args=parser.parse_args()
+
+	known=dict(scenes.scenes)
+	names=args or [n for n,f in scenes.scenes]
+	for n in names:
+		if n not in known: parser.error('unknown scene %s, there are %s'%(n,' '.join(known)))
+	if not os.path.isdir(opts.out): os.makedirs(opts.out)
+	if opts.update and not os.path.isdir(opts.golden): os.makedirs(opts.golden)
+	if os.path.isfile(opts.grammar): shutil.copy(opts.grammar,opts.out)
+	opts.yafray=os.path.abspath(opts.yafray) if os.path.exists(opts.yafray) else opts.yafray
+	if opts.plugins: opts.plugins=os.path.abspath(opts.plugins)
+
+	history=[]
+	if os.path.isfile(opts.history):
+		history=json.load(open(opts.history))
+	host=platform.node()
+	run={'date':time.strftime('%Y-%m-%d %H:%M:%S'),'host':host,'cpus':opts.cpus,
+		'revision':revision(),'scenes':{}}
+	failed=[]
+	for name in names:
+		xml=name+'.xml'
+		f=open(os.path.join(opts.out,xml),'w')
+		f.write(known[name]().replace('out.tga',name+'.tga'))
+		f.close()
+		stats=None
+		for i in range(max(opts.repeat,1)):
+			s=render(opts,name,xml)
+			if s is None:
+				stats=None
+				break
+			if (stats is None) or (s['render']<stats['render']): stats=s
+		image=os.path.join(opts.out,name+'.tga')
+		golden=os.path.join(opts.golden,name+'.tga')
+		if stats is None:
+			print('%-10s FAILED, see %s'%(name,os.path.join(opts.out,name+'.log')))
+			run['scenes'][name]={'status':'error'}
+			failed.append(name)
+			continue
+		stats['rays_per_sec']=stats['rays']/stats['render'] if stats['render']>0 else 0
+		status='ok'
+		note=''
+		if opts.update:
+			shutil.copy(image,golden)
+			note='golden written'
+		elif not os.path.isfile(golden):
+			status='no golden'
+		else:
+			c=compare(readTga(image),readTga(golden),opts.threshold)
+			if c is None:
+				status='size differs'
+			else:
+				mean,worst,bad,diff=c
+				stats.update({'diff_mean':mean,'diff_max':worst,'diff_fraction':bad})
+				note='diff mean %.3f max %d, %.2f%% over %d'%(mean,worst,100*bad,opts.threshold)
+				if (bad>opts.fraction) or (mean>opts.mean):
+					status='image differs'
+					writeTga(os.path.join(opts.out,name+'_diff.tga'),len(diff[0]),len(diff),diff)
+		last=previous(history,name,host,opts.cpus)
+		if last:
+			stats['slowdown']=stats['render']/last
+			note+=', %.2fx the last runs'%stats['slowdown']
+			if (status=='ok') and (opts.slowdown>0) and (stats['slowdown']>opts.slowdown) and \
+					(stats['render']-last>opts.slack):
+				status='slower'
+		if 'filters' in stats: note+=', filters %.3fs'%stats['filters']
+		stats['status']=status
+		run['scenes'][name]=stats
+		if status!='ok': failed.append(name)
+		print('%-10s %-13s %7.3fs %11.0f rays/s  %s'%(name,status,stats['render'],stats['rays_per_sec'],note))
+
+	history.append(run)
+	f=open(opts.history,'w')
+	json.dump(history,f,indent=1,sort_keys=True)
+	f.close()
+	if failed:
+		print('%d of %d scenes failed: %s'%(len(failed),len(names),' '.join(failed)))
+		return 1
+	return 0
+
+if __name__=='__main__':
+	sys.exit(main())
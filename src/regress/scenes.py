@@ -0,0 +1,186 @@
+# Reference scenes of the regression suite, each one exercising a part of
+# the renderer. They are made here instead of kept as xml files, the meshes
+# would take megabytes. Changing a scene needs new goldens (regress.py -u).
+
+import math
+
+def sphere(cx,cy,cz,r,nu=32,nv=16):
+	pts=[]
+	faces=[]
+	for j in range(nv+1):
+		th=math.pi*j/nv
+		for i in range(nu):
+			ph=2*math.pi*i/nu
+			pts.append((cx+r*math.sin(th)*math.cos(ph),cy+r*math.sin(th)*math.sin(ph),cz+r*math.cos(th)))
+	for j in range(nv):
+		for i in range(nu):
+			a=j*nu+i
+			b=j*nu+(i+1)%nu
+			c=(j+1)*nu+i
+			d=(j+1)*nu+(i+1)%nu
+			faces.append((a,c,b))
+			faces.append((b,c,d))
+	return pts,faces
+
+# n*n quads over [-s,s]^2, heights from h(x,y)
+def grid(s,n,h):
+	pts=[]
+	faces=[]
+	for j in range(n+1):
+		for i in range(n+1):
+			x=-s+2.0*s*i/n
+			y=-s+2.0*s*j/n
+			pts.append((x,y,h(x,y)))
+	for j in range(n):
+		for i in range(n):
+			a=j*(n+1)+i
+			faces.append((a,a+1,a+n+2))
+			faces.append((a,a+n+2,a+n+1))
+	return pts,faces
+
+def box(x0,y0,z0,x1,y1,z1):
+	pts=[(x0,y0,z0),(x1,y0,z0),(x1,y1,z0),(x0,y1,z0),
+		(x0,y0,z1),(x1,y0,z1),(x1,y1,z1),(x0,y1,z1)]
+	faces=[(0,2,1),(0,3,2),(4,5,6),(4,6,7),(0,1,5),(0,5,4),
+		(1,2,6),(1,6,5),(2,3,7),(2,7,6),(3,0,4),(3,4,7)]
+	return pts,faces
+
+def mesh(name,shader,geom,smooth=True,attrs='',labels=''):
+	pts,faces=geom
+	out=['<object name="%s" shader_name="%s" shadow="on" %s><attributes>%s</attributes>\n'%(name,shader,attrs,labels),
+		'<mesh %s>\n<points>\n'%(smooth and 'autosmooth="60"' or '')]
+	out+=['<p x="%.6f" y="%.6f" z="%.6f"/>\n'%p for p in pts]
+	out.append('</points>\n<faces>\n')
+	out+=['<f a="%d" b="%d" c="%d"/>\n'%f for f in faces]
+	out.append('</faces>\n</mesh>\n</object>\n')
+	return ''.join(out)
+
+def generic(name,color,extra='',modulators=''):
+	return ('<shader type="generic" name="%s"><attributes><color r="%g" g="%g" b="%g"/>%s</attributes>\n'
+		'%s</shader>\n')%((name,)+color+(extra,modulators))
+
+def pointlight(name='pl',power=20,at=(3,-3,5)):
+	return ('<light type="pointlight" name="%s" power="%g" cast_shadows="on">'
+		'<from x="%g" y="%g" z="%g"/><color r="1" g="1" b="1"/></light>\n')%((name,power)+at)
+
+def ground(shader='grey',size=6):
+	return mesh('ground',shader,([(-size,-size,0),(size,-size,0),(size,size,0),(-size,size,0)],
+		[(0,1,2),(0,2,3)]),False)
+
+def frame(body,resx=160,resy=120,aa='AA_passes="2" AA_minsamples="2"',camfrom=(0,-7,3),camto=(0,0,0.8)):
+	# deterministic, so the goldens don't depend on the threads
+	return ('<scene>\n%s'
+		'<background type="constant" name="bg"><color r="0.3" g="0.35" b="0.45"/></background>\n'
+		'<camera name="cam" resx="%d" resy="%d" focal="1.2"><from x="%g" y="%g" z="%g"/>'
+		'<to x="%g" y="%g" z="%g"/><up x="%g" y="%g" z="%g"/></camera>\n'
+		'<render camera_name="cam" raydepth="5" %s background_name="bg" deterministic="on">'
+		'<outfile value="out.tga"/></render>\n</scene>\n')%((body,resx,resy)+camfrom+camto+
+			(camfrom[0],camfrom[1],camfrom[2]+1)+(aa,))
+
+# about 62.6k triangles in a few meshes, for the kd-tree build and traversal
+def kdtree():
+	s=generic('grey',(0.8,0.8,0.8))
+	s+=generic('red',(0.9,0.3,0.2),'<specular r="0.4" g="0.4" b="0.4"/><hard value="30"/>')
+	s+=mesh('terrain','grey',grid(5,120,lambda x,y:0.25*math.sin(2.1*x)*math.cos(1.7*y)+0.1*math.sin(5.3*x*y)))
+	for k in range(6):
+		a=2*math.pi*k/6
+		s+=mesh('ball%d'%k,'red',sphere(2.2*math.cos(a),2.2*math.sin(a),0.9,0.5,64,32))
+	s+=mesh('center','red',sphere(0,0,1.2,0.9,96,48))
+	s+=pointlight()
+	return frame(s)
+
+# caustics of a glass ball, from the photonlight
+def caustics():
+	s=generic('grey',(0.8,0.8,0.8))
+	s+=generic('glass',(0.0,0.0,0.0),'<specular r="1" g="1" b="1"/><hard value="100"/>'
+		'<transmitted r="0.9" g="0.95" b="1"/><IOR value="1.5"/><min_refle value="0.05"/>')
+	s+=ground()
+	s+=mesh('ball','glass',sphere(0,0,1,1,48,24),True,'caus_IOR="1.5"',
+		'<caus_rcolor r="0.1" g="0.1" b="0.1"/><caus_tcolor r="0.9" g="0.95" b="1"/>')
+	s+=pointlight()
+	s+=('<light type="photonlight" name="caus" mode="caustic" power="20" photons="60000" search="60" '
+		'depth="3" angle="12" fixedradius="0.2" cluster="0.05"><from x="3" y="-3" z="5"/>'
+		'<to x="0" y="0" z="0"/><color r="1" g="1" b="1"/></light>\n')
+	return frame(s)
+
+# indirect light of a closed room, cached by the pathlight
+def pathcache():
+	s=generic('white',(0.8,0.8,0.8))
+	s+=generic('red',(0.8,0.2,0.2))
+	s+=generic('green',(0.2,0.8,0.2))
+	s+=mesh('floor','white',box(-3,-3,-0.2,3,3,0),False)
+	s+=mesh('ceiling','white',box(-3,-3,4,3,3,4.2),False)
+	s+=mesh('back','white',box(-3,3,0,3,3.2,4),False)
+	s+=mesh('left','red',box(-3.2,-3,0,-3,3,4),False)
+	s+=mesh('right','green',box(3,-3,0,3.2,3,4),False)
+	s+=mesh('ball','white',sphere(-1,1,1,1))
+	s+=mesh('block','white',box(0.5,-0.5,0,1.8,0.8,1.6),False)
+	s+=pointlight('pl',8,(0,0,3.6))
+	s+=('<light type="pathlight" name="gi" power="1" depth="2" samples="64" use_QMC="on" '
+		'cache="on" cache_size="0.02" angle_threshold="0.2" shadow_threshold="0.3"></light>\n')
+	return frame(s,camfrom=(0,-8.5,2),camto=(0,0,1.8))
+
+# subsurface scattering node under a phong block
+def sss():
+	s=generic('grey',(0.8,0.8,0.8))
+	s+=('<shader type="sss" name="skin_sss" radius="0.3" samples="16">'
+		'<attributes><color r="0.9" g="0.5" b="0.4"/></attributes></shader>\n')
+	s+='<shader type="phong" name="skin" color="skin_sss" hard="20"><attributes></attributes></shader>\n'
+	s+=ground()
+	s+=mesh('ball','skin',sphere(0,0,1,1,48,24))
+	s+=pointlight()
+	return frame(s)
+
+# the procedural textures, as modulators and as shader nodes
+def textures():
+	texs=[('clouds','<depth value="4"/>'),('marble','<depth value="4"/><turbulence value="5"/>'),
+		('wood','<depth value="3"/><turbulence value="2"/>'),('voronoi',''),('musgrave','<octaves value="4"/>'),
+		('distorted_noise','<distort value="2"/>')]
+	s=generic('grey',(0.8,0.8,0.8))
+	for k,(t,params) in enumerate(texs):
+		s+=('<texture name="t%d" type="%s">%s<color1 r="0.1" g="0.2" b="0.7"/>'
+			'<color2 r="1" g="0.9" b="0.6"/></texture>\n')%(k,t,params)
+		s+=generic('m%d'%k,(0.8,0.8,0.8),'',
+			'<modulator texname="t%d" mode="mix" color="1" size="0.4"></modulator>\n'%k)
+	s+=('<shader type="marble" name="nmarble" depth="4" turbulence="4" size="0.5">'
+		'<attributes></attributes></shader>\n')
+	s+='<shader type="phong" name="mnode" color="nmarble" hard="30"><attributes></attributes></shader>\n'
+	s+=ground()
+	for k in range(len(texs)+1):
+		x=-2.4+1.6*(k%4)
+		y=-0.6+1.8*(k//4)
+		s+=mesh('ball%d'%k,k<len(texs) and 'm%d'%k or 'mnode',sphere(x,y,0.7,0.7,32,16))
+	s+=pointlight('pl',40,(2,-4,7))
+	return frame(s,camfrom=(0,-8,5.5),camto=(0,0.6,0.4))
+
+# soft shadows of the softlight shadow map and the arealight
+def softarea():
+	s=generic('grey',(0.8,0.8,0.8))
+	s+=generic('red',(0.9,0.3,0.2))
+	s+=ground()
+	s+=mesh('ball','red',sphere(-1,0,1,1))
+	s+=mesh('block','grey',box(0.6,-0.6,0,2,0.8,1.5),False)
+	s+=('<light type="softlight" name="soft" power="30" res="200" radius="2">'
+		'<from x="-3" y="-3" z="5"/><color r="1" g="1" b="1"/></light>\n')
+	s+=('<light type="arealight" name="area" power="4" samples="16" psamples="4">'
+		'<a x="2" y="-3" z="5"/><b x="2" y="-1" z="5"/><c x="4" y="-1" z="5"/><d x="4" y="-3" z="5"/>'
+		'<color r="1" g="1" b="1"/></light>\n')
+	return frame(s)
+
+# the antinoise and dof post filters, balls going away from the focus.
+# Their time is in the log and the history, the filters benchmark
+def filters():
+	s=generic('grey',(0.8,0.8,0.8))
+	s+=generic('red',(0.9,0.3,0.2),'<specular r="0.4" g="0.4" b="0.4"/><hard value="30"/>')
+	s+=ground('grey',12)
+	for k in range(5):
+		s+=mesh('ball%d'%k,'red',sphere(-2+k,-3+2*k,0.6,0.6,32,16))
+	s+=('<light type="arealight" name="area" power="3" samples="4" psamples="0">'
+		'<a x="1" y="-2" z="6"/><b x="1" y="0" z="6"/><c x="3" y="0" z="6"/><d x="3" y="-2" z="6"/>'
+		'<color r="1" g="1" b="1"/></light>\n')
+	s+='<filter name="antinoise" type="antinoise" radius="2" max_delta="0.1"></filter>\n'
+	s+='<filter name="dof" type="dof" focus="8.3" near_blur="3" far_blur="4" scale="1"></filter>\n'
+	return frame(s,aa='AA_passes="1" AA_minsamples="1"')
+
+scenes=[('kdtree',kdtree),('caustics',caustics),('pathcache',pathcache),
+	('sss',sss),('textures',textures),('softarea',softarea),('filters',filters)]
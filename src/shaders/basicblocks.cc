@@ -7,7 +7,7 @@ __BEGIN_YAFRAY
 colorA_t floatToColor_t::stdoutColor(renderState_t &state,const surfacePoint_t &sp,
 		const vector3d_t &eye,const scene_t *scene)const
 {
-	CFLOAT f=input->stdoutFloat(state,sp,eye,scene);
+	CFLOAT f=input->cachedFloat(state,sp,eye,scene);
 	return colorA_t(f,f,f);
 }
 
@@ -105,8 +105,8 @@ colorA_t cloudsNode_t::stdoutColor(renderState_t &state,const surfacePoint_t &sp
 		rescol.set(intensidad, tex.getFloat(point3d_t(pt.y, pt.x, pt.z)), tex.getFloat(point3d_t(pt.y, pt.z, pt.x)), 1.0);
 	}
 	if ((input1==NULL) || (input2==NULL)) return rescol;
-	return input1->stdoutColor(state, sp, eye, scene)*intensidad
-			 + input2->stdoutColor(state, sp, eye, scene)*(1.0-intensidad);
+	return input1->cachedColor(state, sp, eye, scene)*intensidad
+			 + input2->cachedColor(state, sp, eye, scene)*(1.0-intensidad);
 }
 
 shader_t * cloudsNode_t::factory(paramMap_t &bparams,std::list<paramMap_t> &lparams,
@@ -154,8 +154,8 @@ colorA_t marbleNode_t::stdoutColor(renderState_t &state,const surfacePoint_t &sp
 	CFLOAT intensidad = tex.getFloat(sp.P());
 	if ((input1==NULL) || (input2==NULL))
 		return colorA_t(intensidad);
-	return (input1->stdoutColor(state,sp,eye,scene))*intensidad
-		+ (input2->stdoutColor(state,sp,eye,scene))*(1.0-intensidad);
+	return (input1->cachedColor(state,sp,eye,scene))*intensidad
+		+ (input2->cachedColor(state,sp,eye,scene))*(1.0-intensidad);
 }
 
 shader_t * marbleNode_t::factory(paramMap_t &bparams,std::list<paramMap_t> &lparams,
@@ -205,8 +205,8 @@ colorA_t woodNode_t::stdoutColor(renderState_t &state,const surfacePoint_t &sp,
 	CFLOAT intensidad = tex.getFloat(sp.P());
 	if ((input1==NULL) || (input2==NULL))
 		return colorA_t(intensidad);
-	return (input1->stdoutColor(state,sp,eye,scene))*intensidad
-		+ (input2->stdoutColor(state,sp,eye,scene))*(1.0-intensidad);
+	return (input1->cachedColor(state,sp,eye,scene))*intensidad
+		+ (input2->cachedColor(state,sp,eye,scene))*(1.0-intensidad);
 }
 
 shader_t * woodNode_t::factory(paramMap_t &bparams,std::list<paramMap_t> &lparams,
@@ -246,7 +246,7 @@ colorA_t colorBandNode_t::stdoutColor(renderState_t &state, const surfacePoint_t
 		const vector3d_t &eye, const scene_t *scene) const
 {
 	if (input==NULL) return colorA_t(0.0);
-	CFLOAT f = input->stdoutFloat(state, sp, eye, scene);
+	CFLOAT f = input->cachedFloat(state, sp, eye, scene);
 	unsigned int i;
 	for (i=0;i<band.size();++i) if (f<band[i].first) break;
 	if (i==0) return band.front().second;
@@ -310,7 +310,7 @@ color_t phongNode_t::fromRadiosity(renderState_t &state,const surfacePoint_t &sp
 		const energy_t &ene,const vector3d_t &eye)const
 {
 	if( ((FACE_FORWARD(sp.Ng(),sp.N(),eye) * ene.dir)<0) || (color==NULL)) return color_t(0.0);
-	return (color_t)color->stdoutColor(state, sp, eye)*ene.color;
+	return (color_t)color->cachedColor(state, sp, eye)*ene.color;
 }
 
 color_t phongNode_t::fromLight(renderState_t &state,const surfacePoint_t &sp,
@@ -322,14 +322,17 @@ color_t phongNode_t::fromLight(renderState_t &state,const surfacePoint_t &sp,
 	vector3d_t N = FACE_FORWARD(sp.Ng(), sp.N(), edir);
 	CFLOAT inte = N*energy.dir;
 	if (inte<=0.f) return color_t(0.0);
-	if (color!=NULL) C = inte * color->stdoutColor(state, sp, eye);
+	if (color!=NULL) C = inte * color->cachedColor(state, sp, eye);
+	color_t D(C), S(0.0);
 	if (specular!=NULL) {
 		CFLOAT refle = reflect(N, edir) VDOT energy.dir;
 		if (refle>0) {
 			refle = std::pow((CFLOAT)refle, (CFLOAT)hard);
-			C += refle * specular->stdoutColor(state, sp, eye);
+			S = refle * specular->cachedColor(state, sp, eye);
+			C += S;
 		}
 	}
+	if (state.aov.wanted) state.lightParts(D * energy.color, S * energy.color);
 	return C * energy.color;
 }
 
@@ -343,15 +346,15 @@ color_t phongNode_t::fromWorld(renderState_t &state,const surfacePoint_t &sp,con
 const color_t phongNode_t::getDiffuse(renderState_t &state,const surfacePoint_t &sp, const vector3d_t &eye)const
 {
 	vector3d_t eye2 = sp.N();
-	if(color!=NULL) return color->stdoutColor(state, sp, eye2);
+	if(color!=NULL) return color->cachedColor(state, sp, eye2);
 	return color_t(0.0);
 }
 
 bool phongNode_t::getCaustics(renderState_t &state, const surfacePoint_t &sp, const vector3d_t &eye,
 														color_t &ref, color_t &trans, PFLOAT &ior) const
 {
-	if (caus_rcolor!=NULL) ref = caus_rcolor->stdoutColor(state,sp,eye);
-	if (caus_tcolor!=NULL) trans = caus_tcolor->stdoutColor(state,sp,eye);
+	if (caus_rcolor!=NULL) ref = caus_rcolor->cachedColor(state,sp,eye);
+	if (caus_tcolor!=NULL) trans = caus_tcolor->cachedColor(state,sp,eye);
 	ior = IOR;
 	return (!(ref.null() && trans.null()));
 }
@@ -377,18 +380,18 @@ void phongNode_t::displace(renderState_t &state, surfacePoint_t &sp, const vecto
 
 	sp.P() = texpt-NU;
 	if (sp.hasUV()) { sp.u()=ou-sp.dudNU()*res;  sp.v()=ov-sp.dvdNU()*res; }
-	diru = bump->stdoutFloat(state, sp, eye);
+	diru = bump->cachedFloat(state, sp, eye);
 	sp.P() = texpt+NU;
 	if (sp.hasUV()) { sp.u()=ou+sp.dudNU()*res;  sp.v()=ov+sp.dvdNU()*res; }
-	diru -= bump->stdoutFloat(state, sp, eye);
+	diru -= bump->cachedFloat(state, sp, eye);
 	diru *= nfac;
 
 	sp.P() = texpt-NV;
 	if (sp.hasUV()) { sp.u()=ou-sp.dudNV()*res;  sp.v()=ov-sp.dvdNV()*res; }
-	dirv = bump->stdoutFloat(state, sp, eye);
+	dirv = bump->cachedFloat(state, sp, eye);
 	sp.P() = texpt+NV;
 	if (sp.hasUV()) { sp.u()=ou+sp.dudNV()*res;  sp.v()=ov+sp.dvdNV()*res; }
-	dirv -= bump->stdoutFloat(state, sp, eye);
+	dirv -= bump->cachedFloat(state, sp, eye);
 	dirv *= nfac;
 
 	PFLOAT nless = 1.0 - ((fabs(diru)>fabs(dirv))? fabs(diru) : fabs(dirv));
@@ -451,9 +454,9 @@ rgbNode_t::rgbNode_t(const shader_t *in1, const shader_t *in2, const shader_t *i
 
 colorA_t rgbNode_t::stdoutColor(renderState_t &state,const surfacePoint_t &sp,const vector3d_t &eye,const scene_t *scene)const
 {
-	return colorA_t((inputred == NULL) ? color.getR() : inputred->stdoutFloat(state, sp, eye, scene),
-					(inputgreen == NULL) ? color.getG() : inputgreen->stdoutFloat(state, sp, eye, scene),
-					(inputblue == NULL) ? color.getB() : inputblue->stdoutFloat(state, sp, eye, scene));
+	return colorA_t((inputred == NULL) ? color.getR() : inputred->cachedFloat(state, sp, eye, scene),
+					(inputgreen == NULL) ? color.getG() : inputgreen->cachedFloat(state, sp, eye, scene),
+					(inputblue == NULL) ? color.getB() : inputblue->cachedFloat(state, sp, eye, scene));
 }
 
 shader_t * rgbNode_t::factory(paramMap_t &bparams,std::list<paramMap_t> &lparams,
@@ -494,9 +497,9 @@ colorA_t hsvNode_t::stdoutColor(renderState_t &state,const surfacePoint_t &sp,
 	CFLOAT h,s,v;
 	CFLOAT red,green,blue;
 
-	if(inputhue!=NULL)			h = inputhue->stdoutFloat(state,sp,eye,scene);		else h = hue;
-	if(inputsaturation!=NULL)	s = inputsaturation->stdoutFloat(state,sp,eye,scene);	else s = saturation;
-	if(inputvalue!=NULL)		v = inputvalue->stdoutFloat(state,sp,eye,scene);		else v = value;
+	if(inputhue!=NULL)			h = inputhue->cachedFloat(state,sp,eye,scene);		else h = hue;
+	if(inputsaturation!=NULL)	s = inputsaturation->cachedFloat(state,sp,eye,scene);	else s = saturation;
+	if(inputvalue!=NULL)		v = inputvalue->cachedFloat(state,sp,eye,scene);		else v = value;
 
 	int i;
 	CFLOAT f, p, q, t;
@@ -600,6 +603,8 @@ coneTraceNode_t::coneTraceNode_t(const color_t &c, PFLOAT angle, int s, PFLOAT i
 colorA_t coneTraceNode_t::stdoutColor(renderState_t &state,const surfacePoint_t &sp,
 		const vector3d_t &eye,const scene_t *scene)const
 {
+	// jittered rays and depending on the ray level, never reused
+	state.shadecache.setVolatile();
 	if(scene==NULL) return colorA_t(0.0);
 	if (ref && ((sp.Ng()*eye)<=0) && (state.raylevel>0)) return colorA_t(0.0);
 	vector3d_t edir=eye;
@@ -684,8 +689,8 @@ colorA_t fresnelNode_t::stdoutColor(renderState_t &state,const surfacePoint_t &s
 	fast_fresnel(edir, N, IOR, fKr, fKt);
 	fKr+=minref;
 	if(fKr>1.0) fKr=1.0;
-	colorA_t R=(ref!=NULL) ? ref->stdoutColor(state,sp,eye,scene) : colorA_t(0.0);
-	colorA_t T=(trans!=NULL) ? trans->stdoutColor(state,sp,eye,scene) : colorA_t(0.0);
+	colorA_t R=(ref!=NULL) ? ref->cachedColor(state,sp,eye,scene) : colorA_t(0.0);
+	colorA_t T=(trans!=NULL) ? trans->cachedColor(state,sp,eye,scene) : colorA_t(0.0);
 	return R*fKr+T*fKt;
 }
 
@@ -711,12 +716,15 @@ shader_t * imageNode_t::factory(paramMap_t &bparams, std::list<paramMap_t> &lpar
 {
 	string _name, _intp="bilinear";	// default bilinear interpolation
 	const string *name=&_name, *intp=&_intp;
+	bool mipmap=true, tiled=false;
 	bparams.getParam("interpolate", intp);
 	bparams.getParam("filename", name);	
+	bparams.getParam("mipmap", mipmap);
+	bparams.getParam("tiled", tiled);
 	if (*name=="")
 		cerr << "Required argument filename not found for image block\n";
 	else
-		return new imageNode_t(name->c_str(), *intp);
+		return new imageNode_t(name->c_str(), *intp, mipmap, tiled);
 	return NULL;
 }
 
@@ -727,14 +735,14 @@ colorA_t goboNode_t::stdoutColor(renderState_t &state,const surfacePoint_t &sp,c
 	if(goboColor == NULL && goboFloat == NULL) return colorA_t(0,0,0);
 
 	colorA_t out,gobo,in1,in2;
-	in1 = input1->stdoutColor(state,sp,eye,scene);
-	in2 = input2->stdoutColor(state,sp,eye,scene);
+	in1 = input1->cachedColor(state,sp,eye,scene);
+	in2 = input2->cachedColor(state,sp,eye,scene);
 
 	if(goboColor != NULL)
-		gobo = goboColor->stdoutColor(state,sp,eye,scene);
+		gobo = goboColor->cachedColor(state,sp,eye,scene);
 	else
 	{
-		CFLOAT i = goboFloat->stdoutFloat(state,sp,eye,scene);
+		CFLOAT i = goboFloat->cachedFloat(state,sp,eye,scene);
 		gobo.set(i,i,i);
 	}
 
@@ -829,8 +837,8 @@ colorA_t voronoiNode_t::stdoutColor(renderState_t &state,const surfacePoint_t &s
 	colorA_t rescol = tex.getColor(sp.P());
 	if ((input1==NULL) || (input2==NULL)) return rescol;
 	colorA_t irescol(1.0-rescol.getR(), 1.0-rescol.getG(), 1.0-rescol.getB(), rescol.getA());
-	return (input1->stdoutColor(state, sp, eye, scene))*rescol
-			 + (input2->stdoutColor(state, sp, eye, scene))*irescol;
+	return (input1->cachedColor(state, sp, eye, scene))*rescol
+			 + (input2->cachedColor(state, sp, eye, scene))*irescol;
 }
 
 shader_t * voronoiNode_t::factory(paramMap_t &bparams,
@@ -897,8 +905,8 @@ colorA_t musgraveNode_t::stdoutColor(renderState_t &state,const surfacePoint_t &
 {
 	CFLOAT intensidad = tex.getFloat(sp.P());
 	if ((input1==NULL) || (input2==NULL)) return colorA_t(intensidad);
-	return (input1->stdoutColor(state, sp, eye, scene))*intensidad
-			 + (input2->stdoutColor(state, sp, eye, scene))*(1.0-intensidad);
+	return (input1->cachedColor(state, sp, eye, scene))*intensidad
+			 + (input2->cachedColor(state, sp, eye, scene))*(1.0-intensidad);
 }
 
 shader_t * musgraveNode_t::factory(paramMap_t &bparams,
@@ -954,8 +962,8 @@ colorA_t distortedNoiseNode_t::stdoutColor(renderState_t &state,const surfacePoi
 {
 	CFLOAT intensidad = tex.getFloat(sp.P());
 	if ((input1==NULL) || (input2==NULL)) return colorA_t(intensidad);
-	return (input1->stdoutColor(state, sp, eye, scene))*intensidad
-			 + (input2->stdoutColor(state, sp, eye, scene))*(1.0-intensidad);
+	return (input1->cachedColor(state, sp, eye, scene))*intensidad
+			 + (input2->cachedColor(state, sp, eye, scene))*(1.0-intensidad);
 }
 
 shader_t * distortedNoiseNode_t::factory(paramMap_t &bparams,
@@ -1005,8 +1013,8 @@ colorA_t gradientNode_t::stdoutColor(renderState_t &state,const surfacePoint_t &
 {
 	CFLOAT intensidad = tex.getFloat(sp.P());
 	if ((input1==NULL) || (input2==NULL)) return colorA_t(intensidad);
-	return (input1->stdoutColor(state, sp, eye, scene))*intensidad
-			 + (input2->stdoutColor(state, sp, eye, scene))*(1.0-intensidad);
+	return (input1->cachedColor(state, sp, eye, scene))*intensidad
+			 + (input2->cachedColor(state, sp, eye, scene))*(1.0-intensidad);
 }
 
 shader_t * gradientNode_t::factory(paramMap_t &bparams,
@@ -1044,16 +1052,18 @@ randomNoiseNode_t::randomNoiseNode_t(const shader_t *in1, const shader_t *in2, i
 CFLOAT randomNoiseNode_t::stdoutFloat(renderState_t &state, const surfacePoint_t &sp,
 				const vector3d_t &eye, const scene_t *scene) const
 {
+	state.shadecache.setVolatile();
 	return tex.getFloat(sp.P());
 }
 
 colorA_t randomNoiseNode_t::stdoutColor(renderState_t &state,const surfacePoint_t &sp,
 		const vector3d_t &eye, const scene_t *scene)const
 {
+	state.shadecache.setVolatile();
 	CFLOAT intensidad = tex.getFloat(sp.P());
 	if ((input1==NULL) || (input2==NULL)) return colorA_t(intensidad);
-	return (input1->stdoutColor(state, sp, eye, scene))*intensidad
-			 + (input2->stdoutColor(state, sp, eye, scene))*(1.0-intensidad);
+	return (input1->cachedColor(state, sp, eye, scene))*intensidad
+			 + (input2->cachedColor(state, sp, eye, scene))*(1.0-intensidad);
 }
 
 shader_t * randomNoiseNode_t::factory(paramMap_t &bparams,
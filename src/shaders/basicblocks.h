@@ -29,7 +29,7 @@ class colorToFloat_t : public shaderNode_t
 		colorToFloat_t(const shader_t *in):input(in) {};
 		virtual CFLOAT stdoutFloat(renderState_t &state,const surfacePoint_t &sp,const vector3d_t &eye,
 				const scene_t *scene=NULL)const
-		{return input->stdoutColor(state,sp,eye,scene).energy();};
+		{return input->cachedColor(state,sp,eye,scene).energy();};
 		static shader_t * factory(paramMap_t &,std::list<paramMap_t> &,
 				        renderEnvironment_t &);
 	protected:
@@ -148,8 +148,8 @@ class mulNode_t : public shaderNode_t
 				const scene_t *scene=NULL)const
 		{
 			CFLOAT res=value;
-			if(input1!=NULL) res*=input1->stdoutFloat(state,sp,eye,scene);
-			if(input2!=NULL) res*=input2->stdoutFloat(state,sp,eye,scene);
+			if(input1!=NULL) res*=input1->cachedFloat(state,sp,eye,scene);
+			if(input2!=NULL) res*=input2->cachedFloat(state,sp,eye,scene);
 			return res;
 		};
 		static shader_t * factory(paramMap_t &,std::list<paramMap_t> &,
@@ -167,7 +167,7 @@ class sinNode_t : public shaderNode_t
 		virtual CFLOAT stdoutFloat(renderState_t &state,const surfacePoint_t &sp,const vector3d_t &eye,
 				const scene_t *scene=NULL)const
 		{
-			return 0.5*sin(input->stdoutFloat(state,sp,eye,scene))+0.5;
+			return 0.5*sin(input->cachedFloat(state,sp,eye,scene))+0.5;
 		};
 		static shader_t * factory(paramMap_t &,std::list<paramMap_t> &,
 				        renderEnvironment_t &);
@@ -294,16 +294,18 @@ class fresnelNode_t : public shaderNode_t
 class imageNode_t : public shaderNode_t
 {
 	public:
-		imageNode_t(const char *filename, const std::string &intp):tex(filename, intp) {}
+		imageNode_t(const char *filename, const std::string &intp, bool mipmap, bool tiled)
+			:tex(filename, intp, mipmap, tiled) {}
+		// sp.P() holds the texture coords here, and filterWidth() their footprint
 		virtual CFLOAT stdoutFloat(renderState_t &state, const surfacePoint_t &sp,
 			const vector3d_t &eye, const scene_t *scene=NULL) const
 		{
-			return tex.getFloat(sp.P());
+			return tex.getFloatFiltered(sp.P(), sp.filterWidth());
 		}
 		virtual colorA_t stdoutColor(renderState_t &state,const surfacePoint_t &sp,
 			const vector3d_t &eye, const scene_t *scene=NULL) const
 		{
-			return tex.getColor(sp.P());
+			return tex.getColorFiltered(sp.P(), sp.filterWidth());
 		}
 		virtual bool discrete() const { return true; }
 		virtual ~imageNode_t() {}
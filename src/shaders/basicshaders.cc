@@ -66,7 +66,9 @@ color_t genericShader_t::fromLight(renderState_t &state,const surfacePoint_t &sp
 	CFLOAT refle=edir*energy.dir;
 	if (refle<0) refle=0; else refle=std::pow((CFLOAT)refle,(CFLOAT)lkh);
 
-	return (edif*inte*energy.color*lkc) + lks*refle*energy.color;
+	color_t dif=edif*inte*energy.color*lkc, spec=lks*refle*energy.color;
+	state.lightParts(dif, spec);
+	return dif + spec;
 }
 
 color_t genericShader_t::fromWorld(renderState_t &state,const surfacePoint_t &sp,const scene_t &s,
@@ -207,9 +209,11 @@ void genericShader_t::displace(renderState_t &state, surfacePoint_t &sp, const v
 {
 	if( ! mods.empty() )
 	{
+		// differences taken over the ray footprint when known
+		PFLOAT w = (sp.filterWidth()>0) ? sp.filterWidth() : res*sp.Z();
 		for(vector<modulator_t>::const_iterator ite=mods.begin();ite!=mods.end();++ite)
 		{
-			(*ite).displace(sp, eye, res*sp.Z());
+			(*ite).displace(sp, eye, w);
 		}
 	}
 }
@@ -23,6 +23,7 @@
 #include "basictex.h"
 #include "object3d.h"
 #include <iostream>
+#include <sys/stat.h>
 
 #include "targaIO.h"
 #include "HDR_io.h"
@@ -249,17 +250,45 @@ texture_t *textureWood_t::factory(paramMap_t &params,
 
 extern cBuffer_t* load_jpeg(const char *name);
 
-textureImage_t::textureImage_t(const char *filename, const string &intp)
+// a tiled file is reused while it is newer than the image it was made from
+static bool tiledUpToDate(const char *filename, const string &tiledname)
+{
+	struct stat src, til;
+	if (stat(tiledname.c_str(), &til)!=0) return false;
+	if (stat(filename, &src)!=0) return true;
+	return til.st_mtime>=src.st_mtime;
+}
+
+textureImage_t::textureImage_t(const char *filename, const string &intp, bool mipmap, bool tiled)
 {
 	// interpolation type, bilinear default
-	intp_type = BILINEAR;
+	intp_type = mipImage_t::BILINEAR;
 	if (intp=="none")
-		intp_type = NONE;
+		intp_type = mipImage_t::NONE;
 	else if (intp=="bicubic")
-		intp_type = BICUBIC;
-	
+		intp_type = mipImage_t::BICUBIC;
+
+	image = NULL;
+	prefilt = false;
+	failed = false;
+
 	// Load image, try to determine from extensions first
 	char *ext = strrchr(filename, '.');
+
+	// pre-tiled images are paged in as needed, never fully loaded
+	string tiledname = string(filename) + ".ytx";
+	if (ext && ((!strcmp(ext, ".ytx")) || (!strcmp(ext, ".YTX"))))
+		tiledname = filename;
+	if ((tiled || (tiledname==filename)) && tiledUpToDate(filename, tiledname))
+	{
+		image = mipImage_t::openTiled(tiledname);
+		if (image)
+		{
+			cout << "Using tiled image file " << tiledname << endl;
+			return;
+		}
+	}
+
 	bool jpg_tried = false;
 	bool tga_tried = false;
 	bool hdr_tried = false;
@@ -267,8 +296,8 @@ textureImage_t::textureImage_t(const char *filename, const string &intp)
 	bool exr_tried = false;
 #endif
 
-	image = NULL;
-	float_image = NULL;
+	cBuffer_t *byte_image = NULL;
+	fcBuffer_t *float_image = NULL;
 
 	cout << "Loading image file " << filename << endl;
 
@@ -286,7 +315,7 @@ textureImage_t::textureImage_t(const char *filename, const string &intp)
 			 (!strcmp(ext, ".JPG")) || (!strcmp(ext, ".JPEG")) )
 #ifdef HAVE_JPEG
 		{
-			image = load_jpeg(filename);
+			byte_image = load_jpeg(filename);
 			jpg_tried = true;
 		}
 #else
@@ -308,14 +337,14 @@ textureImage_t::textureImage_t(const char *filename, const string &intp)
 		if (((!strcmp(ext, ".tga")) || (!strcmp(ext, ".tpic"))) ||
 				((!strcmp(ext, ".TGA")) || (!strcmp(ext, ".TPIC")))) 
 		{
-			image = loadTGA(filename, false);
+			byte_image = loadTGA(filename, false);
 			tga_tried = true;
 		}
 
 	}
 	// if none was able to load (or no extension), try every type until one or none succeeds
 	// targa last (targa has no ID)
-	if ((float_image==NULL) && (image==NULL)) {
+	if ((float_image==NULL) && (byte_image==NULL)) {
 		std::cout << "unknown file extension, testing format...";
 		for(;;) {
 
@@ -330,8 +359,8 @@ textureImage_t::textureImage_t(const char *filename, const string &intp)
 
 #ifdef HAVE_JPEG
 			if (!jpg_tried) {
-				image = load_jpeg(filename);
-				if (image)
+				byte_image = load_jpeg(filename);
+				if (byte_image)
 				{
 					std::cout << "identified as Jpeg format!\n";
 					break;
@@ -351,8 +380,8 @@ textureImage_t::textureImage_t(const char *filename, const string &intp)
 #endif
 
 			if (!tga_tried) {
-				image = loadTGA(filename, true);
-				if (image)
+				byte_image = loadTGA(filename, true);
+				if (byte_image)
 				{
 					std::cout << "identified as Targa format!\n";
 					break;
@@ -367,16 +396,33 @@ textureImage_t::textureImage_t(const char *filename, const string &intp)
 
 	}
 
-	if (image || float_image) {
-		cout << "OK\n";
-		failed = false;
-	}
-	else {
+	if ((byte_image==NULL) && (float_image==NULL)) {
 		cout << "Could not load image\n";
 		failed = true;
+		return;
 	}
+	cout << "OK\n";
 
-	prefilt = false;
+	if (byte_image)
+		image = new mipImage_t(*byte_image, mipmap);
+	else
+		image = new mipImage_t(*float_image, mipmap);
+	delete byte_image;
+	delete float_image;
+
+	if (tiled)
+	{
+		mipImage_t *paged = NULL;
+		if (image->saveTiled(tiledname)) paged = mipImage_t::openTiled(tiledname);
+		if (paged)
+		{
+			cout << "Wrote tiled image file " << tiledname << endl;
+			delete image;
+			image = paged;
+		}
+		else
+			cout << "Could not write tiled image file " << tiledname << ", keeping the image in memory\n";
+	}
 }
 
 textureImage_t::~textureImage_t()
@@ -385,27 +431,15 @@ textureImage_t::~textureImage_t()
 		delete image;
 		image = NULL;
 	}
-	if (float_image) {
-		delete float_image;
-		float_image = NULL;
-	}
 }
 
 // for use as background, pre-integrate image, currently assumes angular map
 // based on "An Efficient Representation for Irradiance Environment Maps" by Ramamoorthi/Hanrahan.
 void textureImage_t::preFilter(bool spheremap)
 {
-	if ((!image) && (!float_image)) return;
+	if (!image) return;
 	cout << "Pre-filtering...";
-	int width, height;
-	if (image) {
-		width = image->resx();
-		height = image->resy();
-	}
-	else {
-		width = float_image->resx();
-		height = float_image->resy();
-	}
+	int width = image->resx(), height = image->resy();
 
 	float sa = 4.f*M_PI*M_PI/(width*height);
 	if (spheremap) sa *= 0.5f;
@@ -434,10 +468,7 @@ void textureImage_t::preFilter(bool spheremap)
 					domega = sa * ((phi==0.f)?1.f:(sinphi/phi)); // sinc(phi) -> probe
 					x=sinphi*cos(theta);  y=cos(phi);  z=sinphi*sin(theta);
 				}
-				if (image)
-					(*image)(i, (height-1)-j) >> col;
-				else
-					(*float_image)(i, (height-1)-j) >> col;
+				col = image->texel(0, i, (height-1)-j);
 				GFLOAT dc2=0.488603f*domega, dc3=1.092548f*domega;
 				SH_coeffs[0] += col * 0.282095f*domega;
 				SH_coeffs[1] += col * dc2 * y;
@@ -457,84 +488,23 @@ void textureImage_t::preFilter(bool spheremap)
 
 colorA_t textureImage_t::getColorSH(const vector3d_t &n) const
 {
-	if ((!image) && (!float_image)) return colorA_t(0.0);
+	if (!image) return colorA_t(0.0);
 	const float c1=0.429043f, c2=0.511664f, c3=0.743125f, c4=0.886227f, c5=0.247708f;
 	return M_1_PI * (c1*SH_coeffs[8]*(n.x*n.x - n.y*n.y) + c3*SH_coeffs[6]*n.z*n.z + c4*SH_coeffs[0] - c5*SH_coeffs[6]
 						+ 2.f*c1*(SH_coeffs[4]*n.x*n.y + SH_coeffs[7]*n.x*n.z + SH_coeffs[5]*n.y*n.z)
 						+ 2.f*c2*(SH_coeffs[3]*n.x + SH_coeffs[1]*n.y + SH_coeffs[2]*n.z));
 }
 
-colorA_t cubicInterpolate(const colorA_t &c1, const colorA_t &c2,
-													const colorA_t &c3, const colorA_t &c4, CFLOAT x)
-{
-	colorA_t t2(c3-c2);
-	colorA_t t1(t2 - (c2-c1));
-	t2 = (c4-c3) - t2;
-	CFLOAT ix = 1.f-x;
-	return x*c3 + ix*c2 + ((4.f*t2 - t1)*(x*x*x-x) + (4.f*t1 - t2)*(ix*ix*ix-ix))*0.06666667f;
-}
-
-template<typename T>
-colorA_t interpolateImage(T image, textureImage_t::INTERPOLATE_TYPE intp, const point3d_t &p)
-{
-	int x, y, x2, y2;
-	int resx=image->resx(), resy=image->resy();
-	CFLOAT xf = ((CFLOAT)resx * (p.x - floor(p.x)));
-	CFLOAT yf = ((CFLOAT)resy * (p.y - floor(p.y)));
-	if (intp!=textureImage_t::NONE) { xf -= 0.5f;  yf -= 0.5f; }
-	if ((x=(int)xf)<0) x = 0;
-	if ((y=(int)yf)<0) y = 0;
-	if (x>=resx) x = resx-1;
-	if (y>=resy) y = resy-1;
-	colorA_t c1;
-	(*image)(x, y) >> c1;
-	if (intp==textureImage_t::NONE) return c1;
-	colorA_t c2, c3, c4;
-	if ((x2=x+1)>=resx) x2 = resx-1;
-	if ((y2=y+1)>=resy) y2 = resy-1;
-	(*image)(x2, y)  >> c2;
-	(*image)(x,  y2) >> c3;
-	(*image)(x2, y2) >> c4;
-	CFLOAT dx=xf-floor(xf), dy=yf-floor(yf);
-	if (intp==textureImage_t::BILINEAR) {
-		CFLOAT w0=(1-dx)*(1-dy), w1=(1-dx)*dy, w2=dx*(1-dy), w3=dx*dy;
-		return colorA_t(w0*c1.getR() + w1*c3.getR() + w2*c2.getR() + w3*c4.getR(),
-										w0*c1.getG() + w1*c3.getG() + w2*c2.getG() + w3*c4.getG(),
-										w0*c1.getB() + w1*c3.getB() + w2*c2.getB() + w3*c4.getB(),
-										w0*c1.getA() + w1*c3.getA() + w2*c2.getA() + w3*c4.getA());
-	}
-	int x0=x-1, x3=x2+1, y0=y-1, y3=y2+1;
-	if (x0<0) x0 = 0;
-	if (y0<0) y0 = 0;
-	if (x3>=resx) x3 = resx-1;
-	if (y3>=resy) y3 = resy-1;
-	colorA_t c0, c5, c6, c7, c8, c9, cA, cB, cC, cD, cE, cF;
-	(*image)(x0, y0) >> c0;
-	(*image)(x,  y0) >> c5;
-	(*image)(x2, y0) >> c6;
-	(*image)(x3, y0) >> c7;
-	(*image)(x0, y)  >> c8;
-	(*image)(x3, y)  >> c9;
-	(*image)(x0, y2) >> cA;
-	(*image)(x3, y2) >> cB;
-	(*image)(x0, y3) >> cC;
-	(*image)(x,  y3) >> cD;
-	(*image)(x2, y3) >> cE;
-	(*image)(x3, y3) >> cF;
-	c0 = cubicInterpolate(c0, c5, c6, c7, dx);
-	c8 = cubicInterpolate(c8, c1, c2, c9, dx);
-	cA = cubicInterpolate(cA, c3, c4, cB, dx);
-	cC = cubicInterpolate(cC, cD, cE, cF, dx);
-	return cubicInterpolate(c0, c8, cA, cC, dy);
-}
-
 colorA_t textureImage_t::getColor(const point3d_t &p) const
 {
 	// p->x/y == u, v
-	if (image)
-		return interpolateImage(image, intp_type, p);
-	else if (float_image)
-		return interpolateImage(float_image, intp_type, p);
+	if (image) return image->lookup(p, 0, intp_type);
+	return color_t(0.0);
+}
+
+colorA_t textureImage_t::getColorFiltered(const point3d_t &p, GFLOAT width) const
+{
+	if (image) return image->lookup(p, width, intp_type);
 	return color_t(0.0);
 }
 
@@ -543,17 +513,25 @@ CFLOAT textureImage_t::getFloat(const point3d_t &p) const
 	return getColor(p).energy();
 }
 
+CFLOAT textureImage_t::getFloatFiltered(const point3d_t &p, GFLOAT width) const
+{
+	return getColorFiltered(p, width).energy();
+}
+
 texture_t *textureImage_t::factory(paramMap_t &params,
 		renderEnvironment_t &render)
 {
 	string _name, _intp="bilinear";	// default bilinear interpolation
 	const string *name=&_name, *intp=&_intp;
+	bool mipmap=true, tiled=false;
 	params.getParam("interpolate", intp);
 	params.getParam("filename", name);	
+	params.getParam("mipmap", mipmap);
+	params.getParam("tiled", tiled);
 	if (*name=="")
 		cerr << "Required argument filename not found for image texture\n";
 	else
-		return new textureImage_t(name->c_str(), *intp);
+		return new textureImage_t(name->c_str(), *intp, mipmap, tiled);
 	return NULL;
 }
 
@@ -25,6 +25,7 @@
 #include "texture.h"
 #include "params.h"
 #include "noise.h"
+#include "mipmap.h"
 
 #ifdef HAVE_CONFIG_H
 #include<config.h>
@@ -234,12 +235,13 @@ class textureRandomNoise_t : public texture_t
 class textureImage_t : public texture_t
 {
 	public:
-		enum INTERPOLATE_TYPE {NONE, BILINEAR, BICUBIC};
-		textureImage_t(const char *filename, const std::string &intp);
+		textureImage_t(const char *filename, const std::string &intp, bool mipmap=true, bool tiled=false);
 		virtual ~textureImage_t();
 
 		virtual colorA_t getColor(const point3d_t &sp) const;
 		virtual CFLOAT getFloat(const point3d_t &p) const;
+		virtual colorA_t getColorFiltered(const point3d_t &p, GFLOAT width) const;
+		virtual CFLOAT getFloatFiltered(const point3d_t &p, GFLOAT width) const;
 
 		// for Spherical harmonic coefficients
 		virtual void preFilter(bool spheremap);
@@ -260,10 +262,10 @@ class textureImage_t : public texture_t
 		}
 		static texture_t *factory(paramMap_t &params,renderEnvironment_t &render);
 	protected:
-		cBuffer_t *image;
-		fcBuffer_t *float_image;
+		// all levels, resident or paged from a tiled file
+		mipImage_t *image;
 		bool failed, prefilt;
-		INTERPOLATE_TYPE intp_type;
+		mipImage_t::interpolation_t intp_type;
 		color_t SH_coeffs[9];
 };
 
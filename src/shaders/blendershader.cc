@@ -232,6 +232,20 @@ bool blenderMapperNode_t::doMapping(const surfacePoint_t &sp, const vector3d_t &
 	return outside;
 }
 
+// footprint of sp in the mapped space, passed on for image filtering
+GFLOAT blenderMapperNode_t::filterWidth(const surfacePoint_t &sp, const vector3d_t &eye,
+		const point3d_t &texpt) const
+{
+	if ((sp.filterWidth()<=0) || !mapped->discrete()) return 0;
+	surfacePoint_t dsp;
+	point3d_t tu, tv;
+	footprintOffset(sp, false, dsp);
+	if (doMapping(dsp, eye, tu)) return 0;
+	footprintOffset(sp, true, dsp);
+	if (doMapping(dsp, eye, tv)) return 0;
+	return footprintWidth(texpt, tu, tv);
+}
+
 CFLOAT blenderMapperNode_t::stdoutFloat(renderState_t &state,
 		const surfacePoint_t &sp, const vector3d_t &eye,
 		const scene_t *scene) const
@@ -240,7 +254,8 @@ CFLOAT blenderMapperNode_t::stdoutFloat(renderState_t &state,
 	if (doMapping(sp, eye, mpoint)) return 0.0;
 	surfacePoint_t tempsp(sp);
 	tempsp.P() = mpoint;
-	return mapped->stdoutFloat(state, tempsp, eye, scene);
+	tempsp.setFilterWidth(filterWidth(sp, eye, mpoint));
+	return mapped->cachedFloat(state, tempsp, eye, scene);
 }
 
 colorA_t blenderMapperNode_t::stdoutColor(renderState_t &state,
@@ -251,7 +266,8 @@ colorA_t blenderMapperNode_t::stdoutColor(renderState_t &state,
 	if (doMapping(sp, eye, mpoint)) return color_t(0.0);
 	surfacePoint_t tempsp(sp);
 	tempsp.P() = mpoint;
-	return mapped->stdoutColor(state, tempsp, eye, scene);
+	tempsp.setFilterWidth(filterWidth(sp, eye, mpoint));
+	return mapped->cachedColor(state, tempsp, eye, scene);
 }
 
 void blenderMapperNode_t::string2maptype(const std::string &mapname)
@@ -508,7 +524,7 @@ void blenderModulator_t::blenderModulate(colorA_t &col, colorA_t &colspec, color
 		CFLOAT &stencilTin, renderState_t &state,const surfacePoint_t &sp,
 		const vector3d_t &eye) const
 {
-	colorA_t texcolor = input->stdoutColor(state, sp, eye);
+	colorA_t texcolor = input->cachedColor(state, sp, eye);
 	CFLOAT Tin=texcolor.energy(), Ta=texcolor.getA();
 	bool Talpha = true;
 
@@ -635,7 +651,7 @@ void blenderModulator_t::blenderDisplace(renderState_t &state,surfacePoint_t &sp
 
 	PFLOAT nfac = _displace/res;
 	if (rgbnormap) {
-		color_t nc = input->stdoutColor(state, sp, eye, NULL);
+		color_t nc = input->cachedColor(state, sp, eye, NULL);
 		vector3d_t dno((nc.getR()-0.5)*2.0, (nc.getG()-0.5)*2.0, nc.getB());
 		vector3d_t Ru=sp.NU()*nfac, Rv=sp.NV()*nfac, N=sp.N();
 		dno.set(dno.x*Ru.x + dno.y*Rv.x + dno.z*N.x,
@@ -664,18 +680,18 @@ void blenderModulator_t::blenderDisplace(renderState_t &state,surfacePoint_t &sp
 
 	sp.P() = texpt-NU;
 	if (sp.hasUV()) { sp.u()=ou-sp.dudNU()*res;  sp.v()=ov-sp.dvdNU()*res; }
-	diru = input->stdoutFloat(state, sp, eye);
+	diru = input->cachedFloat(state, sp, eye);
 	sp.P() = texpt+NU;
 	if (sp.hasUV()) { sp.u()=ou+sp.dudNU()*res;  sp.v()=ov+sp.dvdNU()*res; }
-	diru -= input->stdoutFloat(state, sp, eye);
+	diru -= input->cachedFloat(state, sp, eye);
 	diru *= nfac;
 
 	sp.P() = texpt-NV;
 	if (sp.hasUV()) { sp.u()=ou-sp.dudNV()*res;  sp.v()=ov-sp.dvdNV()*res; }
-	dirv = input->stdoutFloat(state, sp, eye);
+	dirv = input->cachedFloat(state, sp, eye);
 	sp.P() = texpt+NV;
 	if (sp.hasUV()) { sp.u()=ou+sp.dudNV()*res;  sp.v()=ov+sp.dvdNV()*res; }
-	dirv -= input->stdoutFloat(state, sp, eye);
+	dirv -= input->cachedFloat(state, sp, eye);
 	dirv *= nfac;
 
 	PFLOAT nless = 1.0 - ((fabs(diru)>fabs(dirv))? fabs(diru) : fabs(dirv));
@@ -885,6 +901,8 @@ color_t blenderShader_t::fromLight(renderState_t &state, const surfacePoint_t &s
 
 	// alpha modulation is separated in a fromLight() and fromWorld() part
 	// positive alpha part here
+	if (state.aov.wanted)
+		state.lightParts((colorA_t)energy.color*(al*diff), (colorA_t)energy.color*spec);
 	return (colorA_t)energy.color*(al*diff + spec);
 }
 
@@ -1087,9 +1105,11 @@ void blenderShader_t::displace(renderState_t &state,surfacePoint_t &sp, const ve
 {
 	if (!mods.empty())
 	{
+		// differences taken over the ray footprint when known
+		PFLOAT w = (sp.filterWidth()>0) ? sp.filterWidth() : res*state.traveled;
 		for(vector<blenderModulator_t>::const_iterator ite=mods.begin();ite!=mods.end();++ite)
 		{
-			(*ite).blenderDisplace(state, sp, eye, res*state.traveled);
+			(*ite).blenderDisplace(state, sp, eye, w);
 		}
 	}
 }
@@ -29,6 +29,7 @@ class blenderMapperNode_t : public shaderNode_t
 	protected:
 
 		bool doMapping(const surfacePoint_t &sp, const vector3d_t &eye,point3d_t &texpt) const;
+		GFLOAT filterWidth(const surfacePoint_t &sp, const vector3d_t &eye, const point3d_t &texpt) const;
 		// size factors
 		void sizeX(GFLOAT c) { _sizex=c; }
 		void sizeY(GFLOAT c) { _sizey=c; }
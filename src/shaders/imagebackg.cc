@@ -8,7 +8,8 @@ __BEGIN_YAFRAY
 imageBackground_t::imageBackground_t(const char* fname, const std::string &intp,
 				CFLOAT bri_adj, const matrix4x4_t &m, mappingType mt, bool prefilt)
 {
-	img = new textureImage_t(fname, intp);
+	// no footprint for background lookups, so no mip levels either
+	img = new textureImage_t(fname, intp, false);
 	if (img->loadFailed()) {
 		delete img;
 		img = NULL;
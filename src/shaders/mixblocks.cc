@@ -8,8 +8,8 @@ colorA_t mixModeNode_t::stdoutColor(renderState_t &state,
 		const vector3d_t &eye,const scene_t *scene)const
 {
 	colorA_t c1,c2,out;
-	c1 = input1->stdoutColor(state,sp,eye,scene);
-	c2 = input2->stdoutColor(state,sp,eye,scene);
+	c1 = input1->cachedColor(state,sp,eye,scene);
+	c2 = input2->cachedColor(state,sp,eye,scene);
 
 	switch(type)
 	{
@@ -61,6 +61,7 @@ point3d_t sssNode_t::getSamplingPoint(renderState_t &state,const surfacePoint_t
 colorA_t sssNode_t::stdoutColor(renderState_t &state,const surfacePoint_t &sp,
 		const vector3d_t &eye,const scene_t *scene)const
 {
+	state.shadecache.setVolatile();
 	if(scene==NULL) return colorA_t(0,0,0);
 	if(state.rayDivision>1) return colorA_t(0,0,0); // avoid indirect recursion
 	state.rayDivision+=samples;
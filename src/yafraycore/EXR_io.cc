@@ -20,7 +20,9 @@ using namespace Imath;
 
 __BEGIN_YAFRAY
 
-bool saveEXR(const char* fname, fcBuffer_t* fbuf, gBuf_t<float, 1>* zbuf, int width, int height, const std::string &outflags)
+// the AOVs go to layers of their own, name.R name.G name.B
+bool saveEXR(const char* fname, fcBuffer_t* fbuf, gBuf_t<float, 1>* zbuf, int width, int height, const std::string &outflags,
+		const vector<string> &aovnames, const vector<fcBuffer_t*> &aovbuf)
 {
 	PixelType pt = HALF;
 	int chan_size = sizeof(half);
@@ -68,6 +70,24 @@ bool saveEXR(const char* fname, fcBuffer_t* fbuf, gBuf_t<float, 1>* zbuf, int wi
 	fb.insert("B", Slice(pt, tbufp + 2*chan_size, totchan_size, width*totchan_size));
 	fb.insert("A", Slice(pt, tbufp + 3*chan_size, totchan_size, width*totchan_size));
 
+	// AOV layers, alpha of their buffers unused
+	Array<half> abuf;
+	if (pt==HALF) abuf.resizeErase(aovbuf.size()*num_colchan*width*height);
+	for (unsigned int a=0;a<aovbuf.size();++a) {
+		char* abufp = (char*)(*aovbuf[a])(0, 0);
+		if (pt==HALF) {
+			half* hp = &abuf[a*num_colchan*width*height];
+			float* fp = (*aovbuf[a])(0, 0);
+			for (int i=0;i<num_colchan*width*height;++i) hp[i] = fp[i];
+			abufp = (char*)hp;
+		}
+		const char* chan[3] = {".R", ".G", ".B"};
+		for (int c=0;c<3;++c) {
+			header.channels().insert((aovnames[a]+chan[c]).c_str(), Channel(pt));
+			fb.insert((aovnames[a]+chan[c]).c_str(), Slice(pt, abufp + c*chan_size, totchan_size, width*totchan_size));
+		}
+	}
+
 	// zbuffer
 	if (zbuf) {
 		header.channels().insert("Z", Channel(FLOAT));
@@ -132,7 +152,16 @@ YAFRAYCORE_EXPORT fcBuffer_t* loadEXR(const char* fname)
 
 bool outEXR_t::SaveEXR()
 {
-	return saveEXR(filename, fbuf, zbuf, sizex, sizey, out_flags);
+	return saveEXR(filename, fbuf, zbuf, sizex, sizey, out_flags, aovnames, aovbuf);
+}
+
+void outEXR_t::setAOVs(const std::vector<std::string> &names)
+{
+	for (unsigned int i=0;i<aovbuf.size();++i) delete aovbuf[i];
+	aovbuf.clear();
+	aovnames = names;
+	for (unsigned int i=0;i<names.size();++i)
+		aovbuf.push_back(new fcBuffer_t(sizex, sizey));
 }
 
 __END_YAFRAY
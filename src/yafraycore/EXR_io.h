@@ -28,6 +28,13 @@ class YAFRAYCORE_EXPORT outEXR_t : public colorOutput_t
 			if (zbuf) *(*zbuf)(x, y) = depth;
 			return true;
 		}
+		// every AOV is saved in a layer of its own
+		virtual void setAOVs(const std::vector<std::string> &names);
+		virtual bool putAOVs(int x, int y, const color_t *planes)
+		{
+			for (unsigned int i=0;i<aovbuf.size();++i) (*aovbuf[i])(x, y) << planes[i];
+			return true;
+		}
 		void flush() { SaveEXR(); }
 		virtual ~outEXR_t()
 		{
@@ -35,6 +42,7 @@ class YAFRAYCORE_EXPORT outEXR_t : public colorOutput_t
 			zbuf = NULL;
 			if (fbuf) delete fbuf;
 			fbuf = NULL;
+			for (unsigned int i=0;i<aovbuf.size();++i) delete aovbuf[i];
 		}
 	protected:
 		outEXR_t(const outEXR_t &o) {}; //forbidden
@@ -44,6 +52,8 @@ class YAFRAYCORE_EXPORT outEXR_t : public colorOutput_t
 		int sizex, sizey;
 		const char* filename;
 		std::string out_flags;
+		std::vector<std::string> aovnames;
+		std::vector<fcBuffer_t *> aovbuf;
 };
 
 YAFRAYCORE_EXPORT fcBuffer_t* loadEXR(const char* fname);
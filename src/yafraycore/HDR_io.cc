@@ -131,12 +131,12 @@ int HDRwrite_t::fwritecolrs(float* fpscan)
 	return(ferror(file) ? -1 : 0);
 }
 
-bool outHDR_t::saveHDR()
+static bool writeHDR(const char *filename, fcBuffer_t *fbuf)
 {
-	if (fbuf==NULL) return false;
 	int width = fbuf->resx();
 	int height = fbuf->resy();
 	FILE* file = fopen(filename, "wb");
+	if (file==NULL) return false;
 	fprintf(file, "#?RADIANCE");
 	fputc(10, file);
 	fprintf(file, "# %s", "Created with YafRay");
@@ -159,6 +159,34 @@ bool outHDR_t::saveHDR()
 	return true;
 }
 
+void outHDR_t::setAOVs(const std::vector<std::string> &names)
+{
+	for (unsigned int i=0;i<aovbuf.size();++i) delete aovbuf[i];
+	aovbuf.clear();
+	aovnames = names;
+	for (unsigned int i=0;i<names.size();++i)
+		aovbuf.push_back(new fcBuffer_t(sizex, sizey));
+}
+
+// the AOVs go to name_aov.hdr for an image name.hdr
+bool outHDR_t::saveHDR()
+{
+	if (fbuf==NULL) return false;
+	if (!writeHDR(filename, fbuf)) return false;
+	std::string base(filename), ext;
+	std::string::size_type dot = base.rfind('.');
+	if ((dot!=std::string::npos) && (base.find('/', dot)==std::string::npos)) {
+		ext = base.substr(dot);
+		base.erase(dot);
+	}
+	for (unsigned int i=0;i<aovbuf.size();++i) {
+		std::string name = base + "_" + aovnames[i] + ext;
+		std::cout << "Saving AOV " << aovnames[i] << " as " << name << std::endl;
+		if (!writeHDR(name.c_str(), aovbuf[i])) return false;
+	}
+	return true;
+}
+
 //---------------------------------------------------------------------------
 // START OF HDR LOADER
 
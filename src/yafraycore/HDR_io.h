@@ -77,16 +77,26 @@ class YAFRAYCORE_EXPORT outHDR_t : public colorOutput_t
 			(*fbuf)(x, y) << c;
 			return true;
 		}
+		// every AOV goes to a file of its own, named after the image
+		virtual void setAOVs(const std::vector<std::string> &names);
+		virtual bool putAOVs(int x, int y, const color_t *planes)
+		{
+			for (unsigned int i=0;i<aovbuf.size();++i) (*aovbuf[i])(x, y) << planes[i];
+			return true;
+		}
 		void flush() { saveHDR(); }
 		virtual ~outHDR_t()
 		{
 			if (fbuf) delete fbuf;
 			fbuf = NULL;
+			for (unsigned int i=0;i<aovbuf.size();++i) delete aovbuf[i];
 		}
 	protected:
 		outHDR_t(const outHDR_t &o) {}; //forbidden
 		bool saveHDR();
 		fcBuffer_t* fbuf;
+		std::vector<std::string> aovnames;
+		std::vector<fcBuffer_t *> aovbuf;
 		int sizex, sizey;
 		const char* filename;
 };
@@ -0,0 +1,61 @@
+/****************************************************************************
+ *
+ * 			aov.cc: extra channels of the render (AOVs)
+ *      This is part of the yafray package
+ *
+ *      This library is free software; you can redistribute it and/or
+ *      modify it under the terms of the GNU Lesser General Public
+ *      License as published by the Free Software Foundation; either
+ *      version 2.1 of the License, or (at your option) any later version.
+ *
+ *      This library is distributed in the hope that it will be useful,
+ *      but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *      MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *      Lesser General Public License for more details.
+ *
+ *      You should have received a copy of the GNU Lesser General Public
+ *      License along with this library; if not, write to the Free Software
+ *      Foundation,Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+ *
+ */
+
+#include "aov.h"
+#include <vector>
+
+using namespace std;
+
+__BEGIN_YAFRAY
+
+static vector<string> & channelNames()
+{
+	static const char *builtin[AOV_BUILTIN]=
+		{"diffuse", "specular", "shadow", "indirect", "reflect", "normal"};
+	static vector<string> names(builtin, builtin+AOV_BUILTIN);
+	return names;
+}
+
+int aovChannel(const string &name)
+{
+	vector<string> &names=channelNames();
+	for(unsigned int i=0;i<names.size();++i)
+		if(names[i]==name) return i;
+	return -1;
+}
+
+// registered by plugins while loading, before any render starts
+int aovRegister(const string &name)
+{
+	int c=aovChannel(name);
+	if(c>=0) return c;
+	vector<string> &names=channelNames();
+	if(names.size()>=AOV_MAX) return -1;
+	names.push_back(name);
+	return names.size()-1;
+}
+
+const string & aovName(int c)
+{
+	return channelNames()[c];
+}
+
+__END_YAFRAY
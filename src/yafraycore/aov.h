@@ -0,0 +1,92 @@
+/****************************************************************************
+ *
+ * 			aov.h: extra channels of the render (AOVs)
+ *      This is part of the yafray package
+ *
+ *      This library is free software; you can redistribute it and/or
+ *      modify it under the terms of the GNU Lesser General Public
+ *      License as published by the Free Software Foundation; either
+ *      version 2.1 of the License, or (at your option) any later version.
+ *
+ *      This library is distributed in the hope that it will be useful,
+ *      but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *      MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *      Lesser General Public License for more details.
+ *
+ *      You should have received a copy of the GNU Lesser General Public
+ *      License along with this library; if not, write to the Free Software
+ *      Foundation,Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+ *
+ */
+#ifndef __AOV_H
+#define __AOV_H
+
+#ifdef HAVE_CONFIG_H
+#include<config.h>
+#endif
+
+#include <string>
+#include "color.h"
+
+__BEGIN_YAFRAY
+
+/// the channels the render fills itself, plugins may register more
+enum
+{
+	AOV_DIFFUSE,	// direct light, diffuse part
+	AOV_SPECULAR,	// direct light, specular part
+	AOV_SHADOW,		// fraction of the shadow tests of direct lights blocked, rays or maps
+	AOV_INDIRECT,	// light of the indirect lights (path, hemi, photons)
+	AOV_REFLECT,	// reflected and refracted rays
+	AOV_NORMAL,		// shading normal
+	AOV_BUILTIN
+};
+#define AOV_MAX 32
+
+/// id of a channel by name, -1 if there is none
+YAFRAYCORE_EXPORT int aovChannel(const std::string &name);
+/// id of the channel name, adding it if new, -1 when there is no room
+YAFRAYCORE_EXPORT int aovRegister(const std::string &name);
+YAFRAYCORE_EXPORT const std::string & aovName(int c);
+
+/** Values of the channels for the camera sample being traced
+ *
+ * The render clears it before tracing a camera ray. Lights and shaders
+ * shading the camera hit add their part with renderState_t::addAOV(), only
+ * the channels wanted are kept. The direct light is split in diffuse and
+ * specular as the shaders tell in lightDiffuse and lightSpecular while
+ * called from a light, those not telling give it all to diffuse.
+ *
+ */
+struct YAFRAYCORE_EXPORT aovState_t
+{
+	aovState_t():wanted(0),direct(false) {};
+
+	void start(unsigned int mask)
+	{
+		wanted=mask;
+		for(int i=0;i<AOV_MAX;++i) if(wanted&(1u<<i)) channel[i].black();
+		shadowTests=shadowBlocked=0;
+		direct=false;
+	}
+	void finish()
+	{
+		if(want(AOV_SHADOW) && shadowTests)
+			channel[AOV_SHADOW]=color_t(shadowBlocked/(CFLOAT)shadowTests);
+	}
+	bool want(int c)const {return (wanted&(1u<<c))!=0;};
+
+	color_t channel[AOV_MAX];
+	// what the shader gave to the diffuse and specular parts for the current light
+	color_t lightDiffuse, lightSpecular;
+	int shadowTests;
+	// shadow maps block a fraction of a test
+	CFLOAT shadowBlocked;
+	unsigned int wanted;
+	// true while a direct light is shading the camera hit
+	bool direct;
+};
+
+__END_YAFRAY
+
+#endif
@@ -1,6 +1,7 @@
 #ifndef __BACKGROUND_H
 #define __BACKGROUND_H
 
+#include <map>
 #include "color.h"
 #include "vector3d.h"
 
@@ -11,11 +12,17 @@
 __BEGIN_YAFRAY
 
 struct renderState_t;
+class shader_t;
 
 class YAFRAYCORE_EXPORT background_t
 {
 	public:
 		virtual color_t operator() (const vector3d_t &dir, renderState_t &state, bool filtered=false) const=0;
+		// importance sampling, s1 & s2 uniform in [0,1), pdf is per unit solid angle.
+		// returns false when the background has no sampling distribution
+		virtual bool sample(PFLOAT s1, PFLOAT s2, vector3d_t &dir, PFLOAT &pdf) const { return false; }
+		/// changes the shaders found in m for the ones they map to
+		virtual void replaceShaders(const std::map<const shader_t *,shader_t *> &m) {}
 		virtual ~background_t() {};
 };
 
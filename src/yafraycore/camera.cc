@@ -143,48 +143,75 @@ void camera_t::getLensUV(PFLOAT r1, PFLOAT r2, PFLOAT &u, PFLOAT &v) const
 	}
 }
 
-vector3d_t camera_t::shootRay(PFLOAT px, PFLOAT py, PFLOAT &wt)
+// direction for the spherical and lightprobe cameras, wt=0 outside the probe
+vector3d_t camera_t::angularDir(PFLOAT px, PFLOAT py, PFLOAT &wt) const
 {
 	vector3d_t ray;
+	wt = 1;
+	if (camtype==CM_SPHERICAL) {
+		PFLOAT theta = M_PI_2 - M_PI * (1.0 - 2.0 * (px/(PFLOAT)(resx-1)));
+		PFLOAT phi = M_PI - M_PI * (py/(PFLOAT)(resy-1));
+		PFLOAT sp = sin(phi);
+		ray.set(sp*cos(theta), cos(phi), sp*sin(theta));
+	}
+	else {
+		PFLOAT u = 1.0 - 2.0 * (px/(PFLOAT)(resx-1));
+		PFLOAT v = 2.0 * (py/(PFLOAT)(resy-1)) - 1.0;
+		PFLOAT insphere = sqrt(u*u + v*v);
+		if (insphere>1) { wt=0; return ray; }
+		PFLOAT theta=0;
+		if (!((u==0) && (v==0))) theta = atan2(v,u);
+		PFLOAT phi = insphere * M_PI;
+		PFLOAT sp = sin(phi);
+		ray.set(sp*cos(theta), sp*sin(theta), cos(phi));
+	}
+	return vector3d_t(ray.x*camu.x + ray.y*camv.x + ray.z*camw.x,
+						ray.x*camu.y + ray.y*camv.y + ray.z*camw.y,
+						ray.x*camu.z + ray.y*camv.z + ray.z*camw.z);
+}
+
+vector3d_t camera_t::shootRay(PFLOAT px, PFLOAT py, PFLOAT &wt)
+{
+	rayDifferentials_t diff;
+	return shootRay(px, py, wt, diff);
+}
+
+vector3d_t camera_t::shootRay(PFLOAT px, PFLOAT py, PFLOAT &wt, rayDifferentials_t &diff)
+{
+	// unnormalized ray and its derivatives
+	vector3d_t ray, drdx, drdy;
+	diff.dPdx.set(0, 0, 0);
+	diff.dPdy.set(0, 0, 0);
+	diff.valid = true;
+	diff.atHit = false;
 	wt = 1;	// for now always 1, except 0 for probe when outside sphere
 	switch (camtype) {
 		case CM_ORTHO: {
 			_position = vright_O*px + vup_O*py + eye_O;
 			ray = dir_O;
+			diff.dPdx = vright_O;
+			diff.dPdy = vup_O;
 			break;
 		}
-		case CM_SPHERICAL: {
-			_position = _eye;
-			PFLOAT theta = M_PI_2 - M_PI * (1.0 - 2.0 * (px/(PFLOAT)(resx-1)));
-			PFLOAT phi = M_PI - M_PI * (py/(PFLOAT)(resy-1));
-			PFLOAT sp = sin(phi);
-			ray.set(sp*cos(theta), cos(phi), sp*sin(theta));
-			ray.set(ray.x*camu.x + ray.y*camv.x + ray.z*camw.x,
-							ray.x*camu.y + ray.y*camv.y + ray.z*camw.y,
-							ray.x*camu.z + ray.y*camv.z + ray.z*camw.z);
-			break;
-		}
+		case CM_SPHERICAL:
 		case CM_LIGHTPROBE: {
 			_position = _eye;
-			PFLOAT u = 1.0 - 2.0 * (px/(PFLOAT)(resx-1));
-			PFLOAT v = 2.0 * (py/(PFLOAT)(resy-1)) - 1.0;
-			PFLOAT insphere = sqrt(u*u + v*v);
-			if (insphere>1) { wt=0; return ray; }
-			PFLOAT theta=0;
-			if (!((u==0) && (v==0))) theta = atan2(v,u);
-			PFLOAT phi = insphere * M_PI;
-			PFLOAT sp = sin(phi);
-			ray.set(sp*cos(theta), sp*sin(theta), cos(phi));
-			ray.set(ray.x*camu.x + ray.y*camv.x + ray.z*camw.x,
-							ray.x*camu.y + ray.y*camv.y + ray.z*camw.y,
-							ray.x*camu.z + ray.y*camv.z + ray.z*camw.z);
+			ray = angularDir(px, py, wt);
+			if (wt==0) { diff.valid=false;  return ray; }
+			// one pixel differences, backwards when the next one is outside the probe
+			PFLOAT nwt;
+			drdx = angularDir(px+1, py, nwt) - ray;
+			if (nwt==0) drdx = ray - angularDir(px-1, py, nwt);
+			drdy = angularDir(px, py+1, nwt) - ray;
+			if (nwt==0) drdy = ray - angularDir(px, py-1, nwt);
 			break;
 		}
 		default:
 		case CM_PERSPECTIVE: {
 			_position = _eye;
 			ray = vright*px + vup*py + vto;
-			ray.normalize();
+			drdx = vright;
+			drdy = vup;
 			break;
 		}
 	}
@@ -202,10 +229,14 @@ vector3d_t camera_t::shootRay(PFLOAT px, PFLOAT py, PFLOAT &wt)
 		getLensUV(r1, r2, u, v);
 		vector3d_t LI = dof_rt * u + dof_up * v;
 		_position += point3d_t(LI);
-		ray = (ray * dof_distance) - LI;
-		ray.normalize();
+		// lens sample is fixed, the pixel only moves the focus point
+		diff.setDirection(ray, drdx, drdy);
+		ray = (diff.D * dof_distance) - LI;
+		drdx = diff.dDdx * dof_distance;
+		drdy = diff.dDdy * dof_distance;
 	}
 
-	return ray;
+	diff.setDirection(ray, drdx, drdy);
+	return diff.D;
 }
 __END_YAFRAY
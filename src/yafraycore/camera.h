@@ -30,6 +30,7 @@
 #include "vector3d.h"
 #include "matrix4.h"
 #include "mcqmc.h"
+#include "raydiff.h"
 #include <vector>
 
 __BEGIN_YAFRAY
@@ -50,8 +51,11 @@ class YAFRAYCORE_EXPORT camera_t
 		int resY() const { return resy; }
 		const point3d_t & position() const { return _position; }
 		vector3d_t shootRay(PFLOAT px, PFLOAT py, PFLOAT &wt);
+		// same, also returning the differentials of the ray per pixel
+		vector3d_t shootRay(PFLOAT px, PFLOAT py, PFLOAT &wt, rayDifferentials_t &diff);
 		PFLOAT getFocal() const { return focal_distance; }
 	protected:
+		vector3d_t angularDir(PFLOAT px, PFLOAT py, PFLOAT &wt) const;
 		void biasDist(PFLOAT &r) const;
 		void sampleTSD(PFLOAT r1, PFLOAT r2, PFLOAT &u, PFLOAT &v) const;
 		void getLensUV(PFLOAT r1, PFLOAT r2, PFLOAT &u, PFLOAT &v) const;
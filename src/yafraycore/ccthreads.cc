@@ -1,5 +1,6 @@
 #include"ccthreads.h"
 #include<iostream>
+#include<vector>
 
 using namespace std;
 
@@ -145,6 +146,45 @@ mysemaphore_t::~mysemaphore_t()
 #endif
 }
 
+class blockWorker_t : public thread_t
+{
+	public:
+		blockWorker_t(blockJob_t &j): job(j) {};
+		virtual void body() { job.work(); };
+	protected:
+		blockJob_t &job;
+};
+
+#endif
+
+void blockJob_t::work()
+{
+	while(true)
+	{
+		m.wait();
+		int b=next++;
+		m.signal();
+		if(b>=blocks) return;
+		doBlock(b);
+	}
+}
+
+void blockJob_t::run(int threads)
+{
+	next=0;
+	if(threads>blocks) threads=blocks;
+#if HAVE_PTHREAD
+	if(threads>1)
+	{
+		vector<blockWorker_t *> workers(threads);
+		for(int i=0;i<threads;++i) workers[i]=new blockWorker_t(*this);
+		for(int i=0;i<threads;++i) workers[i]->run();
+		for(int i=0;i<threads;++i) workers[i]->wait();
+		for(int i=0;i<threads;++i) delete workers[i];
+		return;
+	}
 #endif
+	work();
+}
 
 } // yafthreads
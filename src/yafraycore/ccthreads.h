@@ -94,6 +94,26 @@ class thread_t
 
 #endif
 
+/** Work split in numbered blocks
+ *
+ * run() hands the blocks out in order to up to the given number of
+ * threads and returns when all are done. Without pthreads, or with one
+ * thread, they are done in the calling one.
+ */
+class YAFRAYCORE_EXPORT blockJob_t
+{
+	public:
+		blockJob_t(int n=0): blocks(n), next(0) {};
+		virtual ~blockJob_t() {};
+		virtual void doBlock(int b)=0;
+		void run(int threads);
+		/// done by each thread, takes blocks until there are none left
+		void work();
+	protected:
+		int blocks, next;
+		mutex_t m;
+};
+
 } // yafthreads
 
 #endif
@@ -21,131 +21,239 @@
  */
 #include "filter.h"
 #include "color.h"
+#include "ccthreads.h"
 using namespace std;
 #include <iostream>
 #include <cstdio>
+#include <vector>
+#include <algorithm>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
 //#include <cmath>
 
 __BEGIN_YAFRAY
 
-color_t mix_circle(cBuffer_t &colorBuffer,fBuffer_t &ZBuffer,GFLOAT minz,
-													int x,int y,GFLOAT rad,GFLOAT tol)
+// the colors operator >> gives for every byte
+static struct byteColor_t
 {
+	byteColor_t() { for(int i=0;i<256;++i) f[i]=((CFLOAT)i)/((CFLOAT)255); }
+	CFLOAT f[256];
+} byteColor;
 
-	int minx=x-(int)rad;
-	if(minx<0) minx=0;
-	int maxx=x+(int)rad;
-	if(maxx>=colorBuffer.resx()) maxx=colorBuffer.resx()-1;
-	
-	int miny=y-(int)rad;
-	if(miny<0) miny=0;
-	int maxy=y+(int)rad;
-	if(maxy>=colorBuffer.resy()) maxy=colorBuffer.resy()-1;
+/* The image is copied to an area, to which the filter is applied with the
+ * threads given, and then copied back.
+ */
+void filter_t::apply(cBuffer_t &colorBuffer,fBuffer_t &ZBuffer,
+											fBuffer_t &ABuffer)const
+{
+	int resx=colorBuffer.resx(), resy=colorBuffer.resy();
+	renderArea_t area(0,0,resx,resy);
+	const CFLOAT *f=byteColor.f;
+	for(int i=0;i<resy;++i)
+		for(int j=0;j<resx;++j)
+		{
+			const unsigned char *c=colorBuffer(j,i);
+			area.imagePixel(j,i).set(f[c[0]],f[c[1]],f[c[2]],ABuffer(j,i));
+			area.depthPixel(j,i)=ZBuffer(j,i);
+		}
+	apply(area,threads);
+	for(int i=0;i<resy;++i)
+		for(int j=0;j<resx;++j)
+			colorBuffer(j,i)<<(color_t)area.imagePixel(j,i);
+}
+
+// average of the pixels around x,y not in front of it
+static inline color_t mix_circle(const vector<colorA_t> &image,const vector<PFLOAT> &depth,
+		int W,int H,int x,int y,GFLOAT tol)
+{
+	int minx=(x>0) ? x-1 : 0, maxx=(x<W-1) ? x+1 : W-1;
+	int miny=(y>0) ? y-1 : 0, maxy=(y<H-1) ? y+1 : H-1;
+	PFLOAT minz=depth[y*W+x]-tol;
 
 	GFLOAT div=0;
-	color_t color(0.0,0.0,0.0);
-	color_t pixel;
+	color_t color(0.0);
 	for(int i=miny;i<=maxy;++i)
 		for(int j=minx;j<=maxx;++j)
-		{
-			if( (ZBuffer(j,i)>=(minz-tol)) )
+			if(depth[i*W+j]>=minz)
 			{
-				colorBuffer(j,i)>>pixel;
-				color=color+pixel;
+				color+=image[i*W+j];
 				div+=1.0;
 			}
-		}
 	if(div>1.0)
 		color=color/((CFLOAT)div);
 	return color;
 }
 
-void filterDOF_t::apply(cBuffer_t &colorBuffer,fBuffer_t &ZBuffer,
-											fBuffer_t &ABuffer)const
+#define FILTER_BLOCK 4096
+
+// one pass of the DOF blur over the pixels still blurring
+class dofPass_t : public yafthreads::blockJob_t
 {
-	cBuffer_t temp(ZBuffer.resx(),ZBuffer.resy());
-	GFLOAT maxradius,radius;
+	public:
+		dofPass_t(const vector<colorA_t> &s,vector<colorA_t> &d,const renderArea_t &a,
+				const vector<int> &ac,GFLOAT t):
+			src(s),dst(d),area(a),active(ac),tol(t)
+		{
+			blocks=(active.size()+FILTER_BLOCK-1)/FILTER_BLOCK;
+		}
+		virtual void doBlock(int b)
+		{
+			int W=area.W;
+			int to=(b+1)*FILTER_BLOCK;
+			if(to>(int)active.size()) to=active.size();
+			for(int n=b*FILTER_BLOCK;n<to;++n)
+			{
+				int k=active[n];
+				color_t c=mix_circle(src,area.depth,W,area.H,k%W,k/W,tol);
+				dst[k].set(c.getR(),c.getG(),c.getB(),src[k].getA());
+			}
+		}
+	protected:
+		const vector<colorA_t> &src;
+		vector<colorA_t> &dst;
+		const renderArea_t &area;
+		const vector<int> &active;
+		GFLOAT tol;
+};
 
-	maxradius=(near_radius>far_radius) ? near_radius : far_radius;
+int filterDOF_t::halo()const
+{
+	// a pixel reads one further every pass
+	return (int)((near_radius>far_radius) ? near_radius : far_radius);
+}
 
-	printf("Applying DOF filter ... ");
-	fflush(stdout);
-	for(int t=0;t<(int)maxradius;++t)
+/* Pass t blurs the pixels whose radius reaches t, so each is blurred
+ * as many times as its radius. The radii are worked out once, and a pass
+ * only visits the pixels still blurring: once a pixel stops, it is copied
+ * to the other buffer and both keep it from then on.
+ * Pixels of the area up to the number of passes left from its cut border
+ * are wrong, the halo keeps them out of the real part.
+ */
+void filterDOF_t::apply(renderArea_t &area,int threads)const
+{
+	int npix=area.W*area.H;
+	int passes=halo();
+	GFLOAT radius;
+
+	vector<GFLOAT> rad(npix);
+	vector<int> active, still;
+	for(int k=0;k<npix;++k)
 	{
-		printf("\rApplying DOF filter [ %d / %d ] ...   ",t,(int)maxradius);
-		fflush(stdout);
-		for(int i=0;i<ZBuffer.resy();++i)
-			for(int j=0;j<ZBuffer.resx();++j)
-			{
-				GFLOAT dis=ZBuffer(j,i)-focus;
-				if(dis<0) radius=near_radius;
-				else radius=far_radius;
-				dis=(fabs(dis)-0.1*focus*exponent)/focus;
-				GFLOAT rad=dis*radius;
-				color_t color;
-				if(rad>=(GFLOAT)t)
-					color=mix_circle(colorBuffer,ZBuffer,ZBuffer(j,i),j,i,1,focus*0.1);
-				else
-					colorBuffer(j,i)>>color;
-				temp(j,i)<<color;
-			}
-		colorBuffer=temp;
+		GFLOAT dis=area.depth[k]-focus;
+		if(dis<0) radius=near_radius;
+		else radius=far_radius;
+		dis=(fabs(dis)-0.1*focus*exponent)/focus;
+		rad[k]=dis*radius;
+		if(rad[k]>=0) active.push_back(k);
+	}
+	vector<colorA_t> temp(area.image);
+	vector<colorA_t> *src=&area.image, *dst=&temp;
+
+	for(int t=0;t<passes;++t)
+	{
+		still.clear();
+		for(unsigned int n=0;n<active.size();++n)
+		{
+			int k=active[n];
+			if(rad[k]>=(GFLOAT)t) still.push_back(k);
+			else (*dst)[k]=(*src)[k];
+		}
+		active.swap(still);
+		dofPass_t pass(*src,*dst,area,active,focus*0.1);
+		pass.run(threads);
+		std::swap(src,dst);
 	}
-	printf("\rApplying DOF filter [ %d / %d ] ...   ",(int)maxradius,
-					(int)maxradius);
-	fflush(stdout);
-	cout<<"OK\n";
+	if(src!=&area.image) area.image.swap(temp);
 }
 
-void filterAntiNoise_t::apply(cBuffer_t &colorBuffer,fBuffer_t &ZBuffer,
-												fBuffer_t &ABuffer)const
+// rows of the antinoise filter, the area as floats with a pad channel
+class antiNoiseRows_t : public yafthreads::blockJob_t
 {
-	int i;
-	cBuffer_t temp(colorBuffer.resx(),colorBuffer.resy());
+	public:
+		antiNoiseRows_t(const vector<float> &c,renderArea_t &a,int r,GFLOAT dl):
+			col(c),area(a),radius(r),delta(dl)
+		{
+			blocks=area.realH;
+		}
+		virtual void doBlock(int b);
+	protected:
+		const vector<float> &col;
+		renderArea_t &area;
+		int radius;
+		GFLOAT delta;
+};
 
-	printf("Applying AntiNoise filter ... ");
-	fflush(stdout);
-	for(i=0;i<colorBuffer.resy();++i)
+/* Averages the pixels in a diamond around each one, those not differing
+ * in any channel by delta or more. The sums run in the same order as
+ * color_t would do them.
+ */
+void antiNoiseRows_t::doBlock(int b)
+{
+	int W=area.W, H=area.H;
+	int i=area.realY-area.Y+b;
+	int from_j=area.realX-area.X;
+	for(int j=from_j;j<from_j+area.realW;++j)
 	{
-		printf("\rApplying AntiNoise filter [ %d / %d ] ...   ",i,colorBuffer.resy());
-		fflush(stdout);
-		for(int j=0;j<colorBuffer.resx();++j)
+		const float *actual=&col[(i*W+j)*4];
+		color_t color(0.0,0.0,0.0);
+		int ncolor=0;
+#ifdef __SSE2__
+		__m128 a=_mm_loadu_ps(actual);
+		__m128 d=_mm_set1_ps(delta);
+		__m128 sign=_mm_castsi128_ps(_mm_set1_epi32(0x80000000));
+		__m128 sum=_mm_setzero_ps();
+#endif
+		for(int auxi=i-radius;auxi<=(i+radius);auxi++)
 		{
-			color_t color(0.0,0.0,0.0);
-			color_t pixel;
-			int ncolor=0;
-			GFLOAT auxradius=0;
-			color_t actual;
-			colorBuffer(j,i)>>actual;
-
-			for(int auxi=(i-(int)fabs(radius));auxi<=(i+(int)fabs(radius));auxi++)
+			int auxradius=radius-abs(auxi-i);
+			if((auxi<0) || (auxi>=H)) continue;
+			int from=j-auxradius, to=j+auxradius;
+			if(from<0) from=0;
+			if(to>=W) to=W-1;
+			const float *pixel=&col[(auxi*W+from)*4];
+			for(int auxj=from;auxj<=to;auxj++,pixel+=4)
 			{
-				for(int auxj=(j-(int)auxradius);auxj<=(j+(int)auxradius);auxj++)
+#ifdef __SSE2__
+				__m128 p=_mm_loadu_ps(pixel);
+				__m128 diff=_mm_andnot_ps(sign,_mm_sub_ps(p,a));
+				__m128 in=_mm_cmplt_ps(diff,d);
+				if((_mm_movemask_ps(in)&7)==7)
+				{
+					sum=_mm_add_ps(sum,p);
+					ncolor++;
+				}
+#else
+				if((fabs(pixel[0]-actual[0])<delta) && (fabs(pixel[1]-actual[1])<delta)
+						&& (fabs(pixel[2]-actual[2])<delta))
 				{
-					if(auxi>=0 && auxj>=0 && auxi<colorBuffer.resy() && auxj<colorBuffer.resx())
-					{
-						colorBuffer(auxj,auxi)>>pixel;
-						GFLOAT max=maxAbsDiff(pixel,actual);
-						if(max < delta)
-						{
-							color=color+pixel;
-							ncolor++;
-						}
-					}
-				}	
-				
-				if (auxi < i)
-						auxradius++;
-				else
-						auxradius--;
+					color=color+color_t(pixel[0],pixel[1],pixel[2]);
+					ncolor++;
+				}
+#endif
 			}
-			color=color/(CFLOAT)ncolor;
-			temp(j,i)<<color;
 		}
+#ifdef __SSE2__
+		float s[4];
+		_mm_storeu_ps(s,sum);
+		color.set(s[0],s[1],s[2]);
+#endif
+		color=color/(CFLOAT)ncolor;
+		colorA_t &dst=area.image[i*W+j];
+		dst.set(color.getR(),color.getG(),color.getB(),dst.getA());
+	}
+}
+
+void filterAntiNoise_t::apply(renderArea_t &area,int threads)const
+{
+	int npix=area.W*area.H;
+	vector<float> col(npix*4);
+	for(int k=0;k<npix;++k)
+	{
+		float *p=&col[k*4];
+		p[0]=area.image[k].getR();  p[1]=area.image[k].getG();  p[2]=area.image[k].getB();  p[3]=0;
 	}
-	colorBuffer=temp;
-	printf("\rApplying AntiNoise filter [ %d / %d ] ...   ",i,colorBuffer.resy());
-	fflush(stdout);
-	cout<<"OK\n";
+	antiNoiseRows_t rows(col,area,halo(),delta);
+	rows.run(threads);
 }
 __END_YAFRAY
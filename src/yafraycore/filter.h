@@ -27,15 +27,32 @@
 #endif
 
 #include "buffer.h"
+#include "renderblock.h"
 
 __BEGIN_YAFRAY
 
+/** Post process of the rendered image
+ *
+ * A filter works on a renderArea_t: it changes the pixels of its real part,
+ * reading up to halo() pixels around them, the area being cut there or at
+ * the image borders. This way the frame buffer can filter each tile as soon
+ * as it and its neighbours are done.
+ *
+ */
 class YAFRAYCORE_EXPORT filter_t
 {
 	public :
+		filter_t():threads(1) {};
 		virtual ~filter_t() {};
-		virtual void apply(cBuffer_t &colorBuffer,fBuffer_t &ZBuffer,
-											fBuffer_t &ABuffer)const=0;
+		/// pixels around the real part of an area apply() reads
+		virtual int halo()const=0;
+		virtual void apply(renderArea_t &area,int threads)const=0;
+		/// filters a whole 8 bit image, using the threads set
+		void apply(cBuffer_t &colorBuffer,fBuffer_t &ZBuffer,
+											fBuffer_t &ABuffer)const;
+		void setThreads(int n) {threads=(n>0) ? n : 1;};
+	protected :
+		int threads;
 };
 
 class YAFRAYCORE_EXPORT filterDOF_t : public filter_t
@@ -44,8 +61,9 @@ class YAFRAYCORE_EXPORT filterDOF_t : public filter_t
 		filterDOF_t ( GFLOAT ffocus,GFLOAT nrad,GFLOAT frad,GFLOAT scale=1.0 ) 
 		{focus=ffocus;near_radius=nrad;far_radius=frad;exponent=scale;};
 		virtual ~filterDOF_t () {};
-		virtual void apply(cBuffer_t &colorBuffer,fBuffer_t &ZBuffer,
-											fBuffer_t &ABuffer)const;
+		virtual int halo()const;
+		virtual void apply(renderArea_t &area,int threads)const;
+		using filter_t::apply;
 	protected :
 		GFLOAT near_radius,far_radius,focus,exponent;
 };
@@ -56,8 +74,9 @@ class YAFRAYCORE_EXPORT filterAntiNoise_t : public filter_t
 		filterAntiNoise_t ( GFLOAT rad, GFLOAT tol ) {radius=rad;
 																		delta=tol;};
 		virtual ~filterAntiNoise_t () {};
-		virtual void apply(cBuffer_t &colorBuffer,fBuffer_t &ZBuffer,
-											fBuffer_t &ABuffer)const;
+		virtual int halo()const {return (int)fabs(radius);};
+		virtual void apply(renderArea_t &area,int threads)const;
+		using filter_t::apply;
 	protected :
 		GFLOAT radius, delta;
 };
@@ -184,7 +184,10 @@ void forkedscene_t::render(colorOutput_t &out)
 	// Do final processing while children finish up
 	for(list<filter_t *>::iterator ite=filter_list.begin();ite!=filter_list.end();
 			ite++)
+	{
+		(*ite)->setThreads(cpus);
 		(*ite)->apply(colorBuffer,ZBuffer,ABuffer);
+	}
 
 	for(int i=0;i<resy;++i)
 		for(int j=0;j<resx;++j)
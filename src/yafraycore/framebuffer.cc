@@ -0,0 +1,153 @@
+/****************************************************************************
+ *
+ * 			framebuffer.cc: float image of the render, post processed by tiles
+ *      This is part of the yafray package
+ *
+ *      This library is free software; you can redistribute it and/or
+ *      modify it under the terms of the GNU Lesser General Public
+ *      License as published by the Free Software Foundation; either
+ *      version 2.1 of the License, or (at your option) any later version.
+ *
+ *      This library is distributed in the hope that it will be useful,
+ *      but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *      MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *      Lesser General Public License for more details.
+ *
+ *      You should have received a copy of the GNU Lesser General Public
+ *      License along with this library; if not, write to the Free Software
+ *      Foundation,Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+ *
+ */
+
+#include "framebuffer.h"
+#include "tools.h"
+
+using namespace std;
+
+__BEGIN_YAFRAY
+
+void frameBuffer_t::start(int w,int h,int t,const list<filter_t *> &filters,int naovs)
+{
+	clear();
+	if((w!=resx) || (h!=resy))
+	{
+		image.assign(w*h,colorA_t(0.0));
+		zbuf.assign(w*h,0);
+	}
+	if((w!=resx) || (h!=resy) || (naovs!=nplanes))
+		planes.assign(w*h*naovs,color_t(0.0));
+	nplanes=naovs;
+	resx=w;
+	resy=h;
+	tile=t;
+	tilesx=(resx+tile-1)/tile;
+	tilesy=(resy+tile-1)/tile;
+	filter_list=filters;
+	halo=0;
+	for(list<filter_t *>::const_iterator i=filter_list.begin();i!=filter_list.end();++i)
+		halo+=(*i)->halo();
+	tilehalo=(halo+tile-1)/tile;
+	filtertime=0;
+
+	waiting.resize(tilesx*tilesy);
+	for(int ty=0;ty<tilesy;++ty)
+		for(int tx=0;tx<tilesx;++tx)
+		{
+			int nx=min(tx+tilehalo,tilesx-1)-max(tx-tilehalo,0)+1;
+			int ny=min(ty+tilehalo,tilesy-1)-max(ty-tilehalo,0)+1;
+			waiting[ty*tilesx+tx]=nx*ny;
+		}
+}
+
+void frameBuffer_t::put(const renderArea_t &area)
+{
+	int sx=area.realX-area.X, sy=area.realY-area.Y;
+	for(int y=0;y<area.realH;++y)
+	{
+		int k=(sy+y)*area.W+sx;
+		int f=(area.realY+y)*resx+area.realX;
+		for(int x=0;x<area.realW;++x,++k,++f)
+		{
+			image[f]=area.image[k];
+			zbuf[f]=area.depth[k];
+			for(int p=0;p<nplanes;++p) planes[f*nplanes+p]=area.planes[k*nplanes+p];
+		}
+	}
+
+	int tx=area.realX/tile, ty=area.realY/tile;
+	vector<int> ready;
+	mutex.wait();
+	for(int y=max(ty-tilehalo,0);y<=min(ty+tilehalo,tilesy-1);++y)
+		for(int x=max(tx-tilehalo,0);x<=min(tx+tilehalo,tilesx-1);++x)
+			if(--waiting[y*tilesx+x]==0) ready.push_back(y*tilesx+x);
+	mutex.signal();
+
+	for(unsigned int i=0;i<ready.size();++i)
+	{
+		renderArea_t *a=new renderArea_t;
+		double t=post(ready[i],*a);
+		mutex.wait();
+		filtertime+=t;
+		posted.push_back(a);
+		mutex.signal();
+	}
+}
+
+/* Every filter reads its halo around the pixels it changes, so the first
+ * ones change the tile plus the halos of those coming after.
+ */
+double frameBuffer_t::post(int t,renderArea_t &area)const
+{
+	int tx=(t%tilesx)*tile, ty=(t/tilesx)*tile;
+	int tw=min(tile,resx-tx), th=min(tile,resy-ty);
+	int x0=max(tx-halo,0), y0=max(ty-halo,0);
+	int x1=min(tx+tw+halo,resx), y1=min(ty+th+halo,resy);
+	area.set(x0,y0,x1-x0,y1-y0);
+	area.setPlanes(nplanes);
+	for(int y=y0;y<y1;++y)
+		for(int x=x0;x<x1;++x)
+		{
+			area.imagePixel(x,y)=image[y*resx+x];
+			area.depthPixel(x,y)=zbuf[y*resx+x];
+			color_t *p=area.planePixel(x,y);
+			for(int i=0;i<nplanes;++i) p[i]=planes[(y*resx+x)*nplanes+i];
+		}
+
+	int after=halo;
+	double start=filter_list.empty() ? 0 : getTime();
+	for(list<filter_t *>::const_iterator i=filter_list.begin();i!=filter_list.end();++i)
+	{
+		after-=(*i)->halo();
+		int rx=max(tx-after,x0), ry=max(ty-after,y0);
+		area.setReal(rx,ry,min(tx+tw+after,x1)-rx,min(ty+th+after,y1)-ry);
+		(*i)->apply(area,1);
+	}
+	area.setReal(tx,ty,tw,th);
+	return filter_list.empty() ? 0 : getTime()-start;
+}
+
+bool frameBuffer_t::flush(colorOutput_t &out)
+{
+	list<renderArea_t *> tiles;
+	mutex.wait();
+	tiles.swap(posted);
+	mutex.signal();
+	bool ok=true;
+	for(list<renderArea_t *>::iterator i=tiles.begin();i!=tiles.end();++i)
+	{
+		if(ok) ok=(*i)->out(out);
+		delete *i;
+	}
+	return ok;
+}
+
+void frameBuffer_t::clear()
+{
+	mutex.wait();
+	for(list<renderArea_t *>::iterator i=posted.begin();i!=posted.end();++i)
+		delete *i;
+	posted.clear();
+	mutex.signal();
+}
+
+__END_YAFRAY
@@ -0,0 +1,90 @@
+/****************************************************************************
+ *
+ * 			framebuffer.h: float image of the render, post processed by tiles
+ *      This is part of the yafray package
+ *
+ *      This library is free software; you can redistribute it and/or
+ *      modify it under the terms of the GNU Lesser General Public
+ *      License as published by the Free Software Foundation; either
+ *      version 2.1 of the License, or (at your option) any later version.
+ *
+ *      This library is distributed in the hope that it will be useful,
+ *      but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *      MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *      Lesser General Public License for more details.
+ *
+ *      You should have received a copy of the GNU Lesser General Public
+ *      License along with this library; if not, write to the Free Software
+ *      Foundation,Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+ *
+ */
+#ifndef __FRAMEBUFFER_H
+#define __FRAMEBUFFER_H
+
+#ifdef HAVE_CONFIG_H
+#include<config.h>
+#endif
+
+#include <vector>
+#include <list>
+#include "renderblock.h"
+#include "filter.h"
+#include "ccthreads.h"
+
+__BEGIN_YAFRAY
+
+/** Float image of the render, post processed by tiles
+ *
+ * Finished areas are stored with put(). The frame is cut in tiles as the
+ * block spliter cuts it, and a tile is ready for the post stage once it and
+ * every tile within the halo of the filters are stored. The thread storing
+ * the last of them takes the tile with its halo and filters it, so the
+ * post stage runs on the render threads while the rest of the frame is
+ * still rendering. Posted tiles wait in a queue for the output.
+ *
+ */
+class YAFRAYCORE_EXPORT frameBuffer_t
+{
+	public:
+		frameBuffer_t():resx(0),resy(0),nplanes(0),filtertime(0) {};
+		~frameBuffer_t() {clear();};
+
+		/// starts a frame of w x h cut in tiles of size tile, filtered by filters
+		void start(int w,int h,int tile,const std::list<filter_t *> &filters,int naovs=0);
+		/// stores the real part of area, and posts the tiles it makes ready
+		void put(const renderArea_t &area);
+		/// sends the posted tiles to out, false if the output aborted
+		bool flush(colorOutput_t &out);
+		/// drops the posted tiles not yet sent
+		void clear();
+
+		int resX()const {return resx;};
+		int resY()const {return resy;};
+		const colorA_t & color(int x,int y)const {return image[y*resx+x];};
+		PFLOAT depth(int x,int y)const {return zbuf[y*resx+x];};
+		const color_t * aovs(int x,int y)const {return &planes[(y*resx+x)*nplanes];};
+		/// seconds the filters took on this frame, summed over the threads
+		double filterTime()const {return filtertime;};
+	protected:
+		frameBuffer_t(const frameBuffer_t &f) {}; //forbiden
+		/// filters tile t into area, returns the seconds of the filters
+		double post(int t,renderArea_t &area)const;
+
+		int resx, resy, tile, tilesx, tilesy;
+		// pixels and tiles around a tile the filters read
+		int halo, tilehalo;
+		std::vector<colorA_t> image;
+		std::vector<PFLOAT> zbuf;
+		int nplanes;
+		std::vector<color_t> planes;
+		// for every tile, the tiles within its halo not stored yet
+		std::vector<int> waiting;
+		std::list<filter_t *> filter_list;
+		yafthreads::mutex_t mutex;
+		std::list<renderArea_t *> posted;
+		double filtertime;
+};
+
+__END_YAFRAY
+
+#endif
@@ -46,8 +46,6 @@ inline int Y_Float2Int(double val) {
 #endif
 }
 
-int Kd_inodes=0, Kd_leaves=0, _emptyKd_leaves=0, Kd_prims=0, _clip=0, _bad_clip=0, _null_clip=0;
-
 bound_t getTriBound(const triangle_t tri);
 //int triBoxOverlap(double boxcenter[3],double boxhalfsize[3],double triverts[3][3]);
 int triBoxClip(const double b_min[3], const double b_max[3], const double triverts[3][3], bound_t &box);
@@ -58,9 +56,11 @@ kdTree_t::kdTree_t(const triangle_t **v, int np, int depth, int leafSize,
 			float cost_ratio, float emptyBonus)
 	: costRatio(cost_ratio), eBonus(emptyBonus), maxDepth(depth), maxLeafSize(leafSize)
 {
+#if Y_LONG_STATS > 0
 	std::cout << "starting build of kd-tree\n";
 	clock_t c_start, c_end;
 	c_start = clock();
+#endif
 	Kd_inodes=0, Kd_leaves=0, _emptyKd_leaves=0, Kd_prims=0, depthLimitReached=0, NumBadSplits=0,
 		_clip=0, _bad_clip=0, _null_clip=0;
 	totalPrims = np;
@@ -118,17 +118,16 @@ kdTree_t::kdTree_t(const triangle_t **v, int np, int depth, int leafSize,
 	delete[] rightPrims;
 	delete[] allBounds;
 	for (int i = 0; i < 3; ++i) delete[] edges[i];
-	//print some stats:
+	//print some stats, trees are built by several threads at once so only
+	//when asked for
+#if Y_LONG_STATS > 0
 	c_end = clock() - c_start;
 	std::cout << "\n=== kd-tree stats ("<< float(c_end) / (float)CLOCKS_PER_SEC <<"s) ===\n";
-#if Y_LONG_STATS > 0
 	std::cout << "used/allocated kd-tree nodes: " << nextFreeNode << "/" << allocatedNodesCount
 		<< " (" << 100.f * float(nextFreeNode)/allocatedNodesCount << "%)\n";
-#endif
 	std::cout << "primitives in tree: " << totalPrims << std::endl;
 	std::cout << "interior nodes: " << Kd_inodes << " / " << "leaf nodes: " << Kd_leaves
 		<< " (empty: " << _emptyKd_leaves << " = " << 100.f * float(_emptyKd_leaves)/Kd_leaves << "%)\n";
-#if Y_LONG_STATS > 0
 	std::cout << "leaf prims: " << Kd_prims << " (" << float(Kd_prims)/totalPrims << "x prims in tree, leaf size:"<< maxLeafSize<<")\n";
 	std::cout << "   => " << float(Kd_prims)/ (Kd_leaves-_emptyKd_leaves) << " prims per non-empty leaf\n";
 	std::cout << "leaves due to depth limit/bad splits: " << depthLimitReached << "/" << NumBadSplits << "\n";
@@ -148,12 +147,12 @@ kdTree_t::~kdTree_t()
 bound_t getTriBound(const triangle_t tri)
 {
 	point3d_t a, b;
-	a.x = Y_MIN3(tri.a->x, tri.b->x, tri.c->x);
-	a.y = Y_MIN3(tri.a->y, tri.b->y, tri.c->y);
-	a.z = Y_MIN3(tri.a->z, tri.b->z, tri.c->z);
-	b.x = Y_MAX3(tri.a->x, tri.b->x, tri.c->x);
-	b.y = Y_MAX3(tri.a->y, tri.b->y, tri.c->y);
-	b.z = Y_MAX3(tri.a->z, tri.b->z, tri.c->z);
+	a.x = Y_MIN3(tri.A().x, tri.B().x, tri.C().x);
+	a.y = Y_MIN3(tri.A().y, tri.B().y, tri.C().y);
+	a.z = Y_MIN3(tri.A().z, tri.B().z, tri.C().z);
+	b.x = Y_MAX3(tri.A().x, tri.B().x, tri.C().x);
+	b.y = Y_MAX3(tri.A().y, tri.B().y, tri.C().y);
+	b.z = Y_MAX3(tri.A().z, tri.B().z, tri.C().z);
 	return bound_t(a, b);
 }
 
@@ -447,9 +446,9 @@ int kdTree_t::buildTree(u_int32 nPrims, bound_t &nodeBound, u_int32 *primNums,
 			const triangle_t *ct = prims[ primNums[i] ];
 			for(int j=0; j<3; ++j)
 			{
-				tPoints[0][j] = (*ct->a)[j];
-				tPoints[1][j] = (*ct->b)[j];
-				tPoints[2][j] = (*ct->c)[j];
+				tPoints[0][j] = ct->A()[j];
+				tPoints[1][j] = ct->B()[j];
+				tPoints[2][j] = ct->C()[j];
 			}
 //			if( triBoxOverlap(bCenter, bHalfSize, tPoints) )
 #if _TRI_CLIP > 0
@@ -476,6 +475,7 @@ int kdTree_t::buildTree(u_int32 nPrims, bound_t &nodeBound, u_int32 *primNums,
 	if(nPrims <= (u_int32)maxLeafSize || depth >= maxDepth)
 	{
 		nodes[nextFreeNode].createLeaf(primNums, nPrims, prims, primsArena);
+		countLeaf(nPrims);
 		nextFreeNode++;
 		if( depth >= maxDepth ) depthLimitReached++; //stat
 		return 0;
@@ -498,6 +498,7 @@ int kdTree_t::buildTree(u_int32 nPrims, bound_t &nodeBound, u_int32 *primNums,
 	if ((split.bestCost > 1.6f * split.oldCost && nPrims < 16) ||
 		split.bestAxis == -1 || badRefines == 2) {
 		nodes[nextFreeNode].createLeaf(primNums, nPrims, prims, primsArena);
+		countLeaf(nPrims);
 		nextFreeNode++;
 		if( badRefines == 2) ++NumBadSplits; //stat
 		return 0;
@@ -561,6 +562,7 @@ int kdTree_t::buildTree(u_int32 nPrims, bound_t &nodeBound, u_int32 *primNums,
 	
 	u_int32 curNode = nextFreeNode;
 	nodes[curNode].createInterior(split.bestAxis, splitPos);
+	Kd_inodes++; //stat
 	++nextFreeNode;
 	bound_t boundL = nodeBound, boundR = nodeBound;
 	switch(split.bestAxis){
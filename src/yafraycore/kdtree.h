@@ -13,8 +13,6 @@
 
 __BEGIN_YAFRAY
 
-extern int Kd_inodes, Kd_leaves, _emptyKd_leaves, Kd_prims;
-
 // ============================================================
 /*! kd-tree nodes, kept as small as possible
     double precision float and/or 64 bit system: 12bytes
@@ -32,18 +30,14 @@ public:
 		{
 			primitives = (triangle_t **)arena.Alloc(np * sizeof(triangle_t *));
 			for(int i=0;i<np;i++) primitives[i] = (triangle_t *)prims[primIdx[i]];
-			Kd_prims+=np; //stat
 		}
 		else if(np==1)
 		{
 			onePrimitive = (triangle_t *)prims[primIdx[0]];
-			Kd_prims++; //stat
 		}
-		else _emptyKd_leaves++; //stat
-		Kd_leaves++; //stat
 	}
 	void createInterior(int axis, PFLOAT d)
-	{	division = d; flags = (flags & ~3) | axis; Kd_inodes++; }
+	{	division = d; flags = (flags & ~3) | axis; }
 	PFLOAT 	SplitPos() const { return division; }
 	int 	SplitAxis() const { return flags & 3; }
 	int 	nPrimitives() const { return flags >> 2; }
@@ -138,6 +132,8 @@ private:
 	int buildTree(u_int32 nPrims, bound_t &nodeBound, u_int32 *primNums,
 		u_int32 *leftPrims, u_int32 *rightPrims, boundEdge *edges[3],
 		u_int32 rightMemSize, int depth, int badRefines );
+	void countLeaf(int np)
+	{	Kd_leaves++; Kd_prims+=np; if(!np) _emptyKd_leaves++; }
 	
 	float 		costRatio; 	//!< node traversal cost divided by primitive intersection cost
 	float 		eBonus; 	//!< empty bonus
@@ -151,8 +147,9 @@ private:
 	const triangle_t **prims;
 	bound_t *allBounds;
 	
-	// some statistics:
+	// some statistics, kept by each tree so trees can be built at once:
 	int depthLimitReached, NumBadSplits;
+	int Kd_inodes, Kd_leaves, _emptyKd_leaves, Kd_prims, _clip, _bad_clip, _null_clip;
 };
 
 
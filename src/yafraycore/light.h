@@ -58,7 +58,7 @@ class YAFRAYCORE_EXPORT light_t
 {
 	public:
 		/// Constructor common for all lights
-		light_t() {use_in_render=true;use_in_indirect=true;};
+		light_t() {use_in_render=true;use_in_indirect=true;changed=true;index=0;};
 		virtual ~light_t() {};
 		/** Returns the color for a given point.
 		 *
@@ -87,15 +87,33 @@ class YAFRAYCORE_EXPORT light_t
 		 */
 		virtual void init(scene_t &scene)=0;
 		virtual void postInit(scene_t &scene) {};
+		/** Whether the geometry or the lights changed since the last init().
+		 * Lights keeping photon or shadow maps only compute them again when
+		 * it is true, the scene clears it after init().
+		 */
+		bool sceneChanged()const {return changed;};
+		void sceneChanged(bool c) {changed=c;};
+
+		/// true for lights giving indirect light, their light goes to that AOV
+		virtual bool isIndirect()const {return false;};
 
 		bool useInRender()const {return use_in_render;};
 		void useInRender(bool u) {use_in_render=u;};
 		bool useInIndirect()const {return use_in_indirect;};
 		void useInIndirect(bool u) {use_in_indirect=u;};
 
+		/** Position of the light in the scene, set when it is added. The
+		 * interface adds them by name, so it only depends on the scene, and
+		 * lights seed their samplers with it.
+		 */
+		int sceneIndex()const {return index;};
+		void sceneIndex(int i) {index=i;};
+
 	protected:
 		bool use_in_render;
 		bool use_in_indirect;
+		bool changed;
+		int index;
 };
 
 
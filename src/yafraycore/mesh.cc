@@ -40,26 +40,26 @@ bound_t face_calc_bound(const vector<triangle_t *> &v)
 	int size=v.size();
 	if(size==0) return bound_t(point3d_t(),point3d_t());
 	PFLOAT maxx,maxy,maxz,minx,miny,minz;
-	maxx=minx=v[0]->a->x;
-	maxy=miny=v[0]->a->y;
-	maxz=minz=v[0]->a->z;
+	maxx=minx=v[0]->A().x;
+	maxy=miny=v[0]->A().y;
+	maxz=minz=v[0]->A().z;
 	for(int i=0;i<size;++i)
 	{
-		point3d_t p=*(v[i]->a);
+		point3d_t p=v[i]->A();
 		if(p.x>maxx) maxx=p.x;
 		if(p.y>maxy) maxy=p.y;
 		if(p.z>maxz) maxz=p.z;
 		if(p.x<minx) minx=p.x;
 		if(p.y<miny) miny=p.y;
 		if(p.z<minz) minz=p.z;
-		p=*(v[i]->b);
+		p=v[i]->B();
 		if(p.x>maxx) maxx=p.x;
 		if(p.y>maxy) maxy=p.y;
 		if(p.z>maxz) maxz=p.z;
 		if(p.x<minx) minx=p.x;
 		if(p.y<miny) miny=p.y;
 		if(p.z<minz) minz=p.z;
-		p=*(v[i]->c);
+		p=v[i]->C();
 		if(p.x>maxx) maxx=p.x;
 		if(p.y>maxy) maxy=p.y;
 		if(p.z>maxz) maxz=p.z;
@@ -78,17 +78,17 @@ bound_t face_calc_bound(const vector<triangle_t *> &v)
 
 bool face_is_in_bound(triangle_t * const & t,bound_t &b)
 {
-	if(b.includes(*(t->a))) return true;
-	if(b.includes(*(t->b))) return true;
-	if(b.includes(*(t->c))) return true;
+	if(b.includes(t->A())) return true;
+	if(b.includes(t->B())) return true;
+	if(b.includes(t->C())) return true;
 	return false;
 }
 
 point3d_t face_get_pos(triangle_t * const & t)
 {
-	point3d_t r=*(t->a);
-	r=r+ *(t->b);
-	r=r+ *(t->c);
+	point3d_t r=t->A();
+	r=r+ t->B();
+	r=r+ t->C();
 	r=r/3;
 	return r;
 }
@@ -99,20 +99,6 @@ typedef pureBspTree_t<vector<triangle_t*> > tnode_t;
 
 static PFLOAT foo1,foo2;
 
-template<class T>
-inline typename vector<T>::iterator convertIterator(vector<T> &d,const vector<T> &v,
-		typename vector<T>::const_iterator i)
-{
-	if(i==v.end()) return d.end();
-	return (i-v.begin())+d.begin();
-}
-
-template<class T>
-inline T * convertPointer(vector<T> &d,const vector<T> &v,const T *p)
-{
-	return (T *)((p-&v[0])+&d[0]);
-}
-
 tnode_t * buildTriangleTree(std::vector<triangle_t*> *v, unsigned int maxdepth,
 		const bound_t &bound,unsigned int dtol=1,unsigned int depth=1,unsigned int lostd=0,
 		PFLOAT &avgdepth=foo1, PFLOAT &avgsize=foo2);
@@ -120,32 +106,18 @@ tnode_t * buildTriangleTree(std::vector<triangle_t*> *v, unsigned int maxdepth,
 meshObject_t::meshObject_t(const vector<point3d_t> &ver, const vector<vector3d_t> &nor,
 				const vector<triangle_t> &ts, const vector<GFLOAT> &fuv, const vector<CFLOAT> &fvcol)
 {
-	vertices=ver;
-	normals=nor;
+	data.vertices=ver;
+	data.normals=nor;
 	triangles=ts;
 	unt=true;
 	hasorco=false;
 	if ( (ver.empty()) || (ts.empty()))
 		cout<<"Error null mesh\n";
 	shader=NULL;
+	data.facesuv = fuv;
+	data.faces_vcol = fvcol;
+	setFaces();
 	if(ver.size()) recalcBound();
-	facesuv = fuv;
-	faces_vcol = fvcol;
-
-	for(vector<triangle_t>::iterator i=triangles.begin();i!=triangles.end();++i)
-	{
-		i->a=convertPointer(vertices,ver,i->a);
-		i->b=convertPointer(vertices,ver,i->b);
-		i->c=convertPointer(vertices,ver,i->c);
-		if(normals.size())
-		{
-			i->na=convertPointer(normals,nor,i->na);
-			i->nb=convertPointer(normals,nor,i->nb);
-			i->nc=convertPointer(normals,nor,i->nc);
-		}
-		i->uv=convertIterator(facesuv,fuv,i->uv);
-		i->vcol=convertIterator(faces_vcol,fvcol,i->vcol);
-	}
 		
 //	vector<triangle_t *> *ltri=new vector<triangle_t *>(ts.size());
 //	for(vector<triangle_t>::iterator i=triangles.begin();i!=triangles.end();++i)
@@ -154,215 +126,316 @@ meshObject_t::meshObject_t(const vector<point3d_t> &ver, const vector<vector3d_t
 	//tree=buildGenericTree(ltri,face_calc_bound,face_is_in_bound,face_get_pos,10);
 //	unsigned int maxdepth = (unsigned int)(8.0 + 1.8755035531556525*log((PFLOAT)triangles.size()));
 //	tree=buildTriangleTree(ltri, maxdepth, face_calc_bound(*ltri),4);
-	
-	// Lynx ->
-	const triangle_t **tris=new const triangle_t*[triangles.size()];
-	for(unsigned int i=0;i<triangles.size();++i)
-		tris[i] = &(triangles[i]);
-	n_tree = new kdTree_t(tris, triangles.size(), -1, -1, 1.2, 0.40 );
-	delete[] tris;
+
+	// the kd-tree is built by prepare() when the render starts
+	tree=NULL;
+	n_tree=0;
 }
 
 meshObject_t::meshObject_t(bool _hasorco, const matrix4x4_t &M, const vector<point3d_t> &ver, const vector<vector3d_t> &nor,
 				const vector<triangle_t> &ts, const vector<GFLOAT> &fuv, const vector<CFLOAT> &fvcol)
 {
 	hasorco = _hasorco;
-	vertices = ver;
-	normals = nor;
+	data.vertices = ver;
+	data.normals = nor;
 	triangles = ts;
 	unt = true;
 	if ((ver.empty()) || (ts.empty()))
 		cout << "Error null mesh\n";
 	shader = NULL;
 	//if(ver!=NULL) recalcBound();
-	facesuv = fuv;
-	faces_vcol = fvcol;
+	data.facesuv = fuv;
+	data.faces_vcol = fvcol;
+	setFaces();
 
+	tree=NULL;
+	n_tree=0;
+	transform(M);
+}
+
+void meshObject_t::setFaces()
+{
 	for(vector<triangle_t>::iterator i=triangles.begin();i!=triangles.end();++i)
 	{
-		i->a=convertPointer(vertices,ver,i->a);
-		i->b=convertPointer(vertices,ver,i->b);
-		i->c=convertPointer(vertices,ver,i->c);
-		if(normals.size())
-		{
-			i->na=convertPointer(normals,nor,i->na);
-			i->nb=convertPointer(normals,nor,i->nb);
-			i->nc=convertPointer(normals,nor,i->nc);
-		}
-		i->uv=convertIterator(facesuv,fuv,i->uv);
-		i->vcol=convertIterator(faces_vcol,fvcol,i->vcol);
+		i->setMesh(&data);
+		i->recNormal();
 	}
+}
 
-	tree=NULL;
-	n_tree=0;
-	transform(M);
+void meshObject_t::vertexCorners(vector<unsigned int> &first,vector<unsigned int> &corner)const
+{
+	unsigned int nv=data.vertices.size();
+	first.assign(nv+1,0);
+	for(vector<triangle_t>::const_iterator tri=triangles.begin();tri!=triangles.end();++tri)
+	{
+		first[tri->va+1]++;
+		first[tri->vb+1]++;
+		first[tri->vc+1]++;
+	}
+	for(unsigned int v=0;v<nv;++v) first[v+1]+=first[v];
+	// filled in face order, so sums over a vertex add in the same order as before
+	vector<unsigned int> fill(first.begin(),first.end()-1);
+	corner.resize(3*triangles.size());
+	for(unsigned int t=0;t<triangles.size();++t)
+	{
+		corner[fill[triangles[t].va]++]=3*t;
+		corner[fill[triangles[t].vb]++]=3*t+1;
+		corner[fill[triangles[t].vc]++]=3*t+2;
+	}
 }
 
-void meshObject_t::autoSmooth(PFLOAT angle)
+#define MESH_BLOCK 4096
+
+/* First pass: smoothed normals of the corners of a block of vertices, the
+ * equal ones of a vertex kept once. Second pass, once the blocks know where
+ * their normals go: copies them and points the corners to them.
+ */
+struct smoothJob_t : public yafthreads::blockJob_t
+{
+	smoothJob_t(vector<triangle_t> &t,const vector<unsigned int> &f,
+			const vector<unsigned int> &c,PFLOAT angle)
+		: triangles(t), first(f), corner(c), local(c.size()), out(NULL)
+	{
+		cosa=cos(angle*M_PI/180.0);
+		blocks=(f.size()-1+MESH_BLOCK-1)/MESH_BLOCK;
+		normals.resize(blocks);
+		start.resize(blocks);
+	}
+	virtual void doBlock(int b)
+	{
+		unsigned int v0=b*MESH_BLOCK, v1=min((unsigned int)first.size()-1,v0+MESH_BLOCK);
+		if(out!=NULL) place(b,v0,v1);
+		else smooth(b,v0,v1);
+	}
+	void smooth(int b,unsigned int v0,unsigned int v1)
+	{
+		vector<vector3d_t> &bn=normals[b];
+		// normals of the faces around a vertex
+		vector<vector3d_t> fn;
+		for(unsigned int v=v0;v<v1;++v)
+		{
+			unsigned int c0=first[v], nc=first[v+1]-c0, vfirst=bn.size();
+			fn.resize(nc);
+			for(unsigned int i=0;i<nc;++i) fn[i]=triangles[corner[c0+i]/3].N();
+			for(unsigned int i=0;i<nc;++i)
+			{
+				vector3d_t sn(0,0,0);
+				for(unsigned int j=0;j<nc;++j)
+					if((fn[j]*fn[i])>cosa) sn+=fn[j];
+				sn.normalize();
+				unsigned int k;
+				for(k=vfirst;k<bn.size();++k)
+					if((bn[k].x==sn.x) && (bn[k].y==sn.y) && (bn[k].z==sn.z)) break;
+				if(k==bn.size()) bn.push_back(sn);
+				local[c0+i]=k;
+			}
+		}
+	}
+	void place(int b,unsigned int v0,unsigned int v1)
+	{
+		copy(normals[b].begin(),normals[b].end(),out->begin()+start[b]);
+		for(unsigned int c=first[v0];c<first[v1];++c)
+		{
+			triangle_t &t=triangles[corner[c]/3];
+			unsigned int n=start[b]+local[c];
+			switch(corner[c]%3)
+			{
+				case 0: t.na=n; break;
+				case 1: t.nb=n; break;
+				default: t.nc=n;
+			}
+		}
+		vector<vector3d_t>().swap(normals[b]);
+	}
+	vector<triangle_t> &triangles;
+	const vector<unsigned int> &first, &corner;
+	// index of the normal of each corner in the normals of its block
+	vector<unsigned int> local;
+	vector<vector<vector3d_t> > normals;
+	vector<unsigned int> start;
+	vector<vector3d_t> *out;
+	PFLOAT cosa;
+};
+
+void meshObject_t::autoSmooth(PFLOAT angle,int threads)
 {
 	// if no smoothing needed, normal equal to geometric normal,
 	// is returned automatically in surfacepoint, no calculation needed
 	if (angle<1) return;
-	unsigned int i1, i2, i3;
-	vector<triangle_t>::iterator tri;
+	bool packed=data.isCompact();
+	if (packed) data.unpack();
+	vector<vector3d_t> &normals=data.normals;
 	// if everything is smoothed, only need as many normals as there are vertices
 	if (angle>=180)
 	{
-		normals.resize(vertices.size());
-		for (tri=triangles.begin();tri!=triangles.end();tri++)
+		normals.assign(data.vertices.size(), vector3d_t(0, 0, 0));
+		for (vector<triangle_t>::iterator tri=triangles.begin();tri!=triangles.end();tri++)
 		{
-			i1 = tri->a - (&vertices[0]);
-			i2 = tri->b - (&vertices[0]);
-			i3 = tri->c - (&vertices[0]);
-			normals[i1] += tri->N();
-			normals[i2] += tri->N();
-			normals[i3] += tri->N();
-			tri->na = &normals[i1];
-			tri->nb = &normals[i2];
-			tri->nc = &normals[i3];
+			normals[tri->va] += tri->N();
+			normals[tri->vb] += tri->N();
+			normals[tri->vc] += tri->N();
+			tri->setNormals(tri->va, tri->vb, tri->vc);
 		}
-		for (i1=0;i1<normals.size();i1++)
-			normals[i1].normalize();
+		for (unsigned int i=0;i<normals.size();i++)
+			normals[i].normalize();
+		if (packed) data.pack();
 		return;
 	}
 
-	// angle dependant smoothing
-	PFLOAT cosa = cos(angle*M_PI/180.0);
-	vector<vector<triangle_t*> > cnx(vertices.size());
-	for (tri=triangles.begin();tri!=triangles.end();tri++)
+	// angle dependant smoothing, in parallel over the vertices. Corners of
+	// a vertex smoothed alike share their normal
+	vector<unsigned int> first, corner;
+	vertexCorners(first,corner);
+	smoothJob_t job(triangles,first,corner,angle);
+	job.run(threads);
+	unsigned int total=0;
+	for(unsigned int b=0;b<job.start.size();++b)
 	{
-		cnx[tri->a - (&vertices[0])].push_back(&(*tri));
-		cnx[tri->b - (&vertices[0])].push_back(&(*tri));
-		cnx[tri->c - (&vertices[0])].push_back(&(*tri));
-	}
-	vector<triangle_t*>::const_iterator vtri;
-
-	// Concerning memory usage, since depending on smoothing angle, normals could be shared,
-	// this could be further optimized to add only as many normals as needed.
-	// Similarly, faces which are not smoothed at all don't need vtxnorms so could be skipped.
-	// Array size of 3*number_of_triangles is really only the worst possible case.
-	// However, for a minimum storage triangle class (index only),
-	// for efficient access, it would probably be better to have a consistent layout.
-	// Another optimization is to only store normals in 2D form for all normals
-	// ie. only xy (or any other pair), z=sqrt(1-x^2-y^2) at runtime when needed, or in polar form (discard r),
-	// though both could be more overhead in terms of extra decoding time needed, first one less so probably.
-	normals.resize(3*triangles.size());
-	unsigned int idx=0;
-	for (tri=triangles.begin();tri!=triangles.end();tri++)
-	{
-		vector3d_t N = tri->N();
-		i1 = tri->a - (&vertices[0]);
-		i2 = tri->b - (&vertices[0]);
-		i3 = tri->c - (&vertices[0]);
-
-		vector3d_t sn(0, 0, 0);
-		for (vtri=cnx[i1].begin();vtri!=cnx[i1].end();++vtri)
-			if (((*vtri)->N()*N)>cosa) sn += (*vtri)->N();
-		sn.normalize();
-		normals[idx] = sn;
-		tri->na = &normals[idx];
-
-		sn.set(0, 0, 0);
-		for (vtri=cnx[i2].begin();vtri!=cnx[i2].end();++vtri)
-			if (((*vtri)->N()*N)>cosa) sn += (*vtri)->N();
-		sn.normalize();
-		normals[idx+1] = sn;
-		tri->nb = &normals[idx+1];
-
-		sn.set(0, 0, 0);
-		for (vtri=cnx[i3].begin();vtri!=cnx[i3].end();++vtri)
-			if (((*vtri)->N()*N)>cosa) sn += (*vtri)->N();
-		sn.normalize();
-		normals[idx+2] = sn;
-		tri->nc = &normals[idx+2];
-		idx += 3;
+		job.start[b]=total;
+		total+=job.normals[b].size();
 	}
+	normals.resize(total);
+	job.out=&normals;
+	job.run(threads);
+	if (packed) data.pack();
 }
 
-// tangents, derived from uv, if no uv, orco coords instead
-// call after autosmooth() and setting orco flag
-void meshObject_t::tangentsFromUV()
+/// tangent of each face, from its uvs or orco
+struct tangentJob_t : public yafthreads::blockJob_t
 {
-	bool hasuv = (!facesuv.empty());
-	if (!(hasuv || hasorco)) return;
-	tangents.resize(vertices.size());
-	vector3d_t sdir, tdir;
-	vector<triangle_t>::iterator tri;
-	for(tri=triangles.begin();tri!=triangles.end();tri++)
+	tangentJob_t(const vector<triangle_t> &t,const meshData_t &d)
+		: triangles(t), data(d), sdir(t.size())
 	{
-		tri->ta = &tangents[tri->a - (&vertices[0])];
-		tri->tb = &tangents[tri->b - (&vertices[0])];
-		tri->tc = &tangents[tri->c - (&vertices[0])];
+		blocks=(t.size()+MESH_BLOCK-1)/MESH_BLOCK;
 	}
-	PFLOAT s1, s2, t1, t2;
-	unsigned int i0, i1, i2;
-	for(tri=triangles.begin();tri!=triangles.end();tri++)
+	virtual void doBlock(int b)
 	{
-		if (hasuv) {
-			// from uv
-			if (tri->hasuv) {
-				s1 = tri->uv[2] - tri->uv[0];
-				s2 = tri->uv[4] - tri->uv[0];
-				t1 = tri->uv[3] - tri->uv[1];
-				t2 = tri->uv[5] - tri->uv[1];
+		const vector<point3d_t> &vertices=data.vertices;
+		bool hasuv=!data.facesuv.empty();
+		vector3d_t tdir;
+		PFLOAT s1, s2, t1, t2;
+		unsigned int i0, i1, i2;
+		unsigned int last=min((unsigned int)triangles.size(),(unsigned int)(b+1)*MESH_BLOCK);
+		for(unsigned int t=b*MESH_BLOCK;t<last;++t)
+		{
+			const triangle_t *tri=&triangles[t];
+			if (hasuv) {
+				// from uv
+				if (tri->hasUV()) {
+					const GFLOAT *uv = &data.facesuv[tri->uv];
+					s1 = uv[2] - uv[0];
+					s2 = uv[4] - uv[0];
+					t1 = uv[3] - uv[1];
+					t2 = uv[5] - uv[1];
+				}
+				else {
+					// no uv coords assigned to this tri
+					s1 = s2 = t1 = t2 = 0;
+				}
 			}
 			else {
-				// no uv coords assigned to this tri
-				s1 = s2 = t1 = t2 = 0;
+				// from orco
+				i0 = tri->va+1;
+				i1 = tri->vb+1;
+				i2 = tri->vc+1;
+				s1 = 0.5*(vertices[i1].x - vertices[i0].x);
+				s2 = 0.5*(vertices[i2].x - vertices[i0].x);
+				t1 = 0.5*(vertices[i1].y - vertices[i0].y);
+				t2 = 0.5*(vertices[i2].y - vertices[i0].y);
+			}
+			PFLOAT r = s1*t2 - s2*t1;
+			if (r==0.0)
+				createCS(tri->N(), sdir[t], tdir);
+			else {
+				vector3d_t e1 = tri->B() - tri->A();
+				vector3d_t e2 = tri->C() - tri->A();
+				sdir[t] = (t2*e1 - t1*e2)/r;
+				tdir = (s1*e2 - s2*e1)/r;
+				if (((sdir[t]^tdir)*tri->N())<0.0) sdir[t] *= -1.0;
 			}
 		}
-		else {
-			// from orco
-			i0 = (tri->a - (&vertices[0]))+1;
-			i1 = (tri->b - (&vertices[0]))+1;
-			i2 = (tri->c - (&vertices[0]))+1;
-			s1 = 0.5*(vertices[i1].x - vertices[i0].x);
-			s2 = 0.5*(vertices[i2].x - vertices[i0].x);
-			t1 = 0.5*(vertices[i1].y - vertices[i0].y);
-			t2 = 0.5*(vertices[i2].y - vertices[i0].y);
-		}
-		PFLOAT r = s1*t2 - s2*t1;
-		if (r==0.0)
-			createCS(tri->N(), sdir, tdir);
-		else {
-			vector3d_t e1 = *(tri->b) - *(tri->a);
-			vector3d_t e2 = *(tri->c) - *(tri->a);
-			sdir = (t2*e1 - t1*e2)/r;
-			tdir = (s1*e2 - s2*e1)/r;
-			if (((sdir^tdir)*tri->N())<0.0) sdir *= -1.0;
-		}
-		*(tri->ta) += sdir;
-		*(tri->tb) += sdir;
-		*(tri->tc) += sdir;
+	}
+	const vector<triangle_t> &triangles;
+	const meshData_t &data;
+	vector<vector3d_t> sdir;
+};
+
+// tangents, derived from uv, if no uv, orco coords instead
+// call after autosmooth() and setting orco flag
+void meshObject_t::tangentsFromUV(int threads)
+{
+	bool packed=data.isCompact();
+	if (packed) data.unpack();
+	if (data.facesuv.empty() && !hasorco)
+	{
+		if (packed) data.pack();
+		return;
+	}
+	// the tangents of the faces are found in parallel, the vertices
+	// add them in face order
+	tangentJob_t job(triangles,data);
+	job.run(threads);
+	vector<vector3d_t> &tangents=data.tangents;
+	tangents.assign(data.vertices.size(), vector3d_t(0, 0, 0));
+	for(unsigned int t=0;t<triangles.size();++t)
+	{
+		tangents[triangles[t].va] += job.sdir[t];
+		tangents[triangles[t].vb] += job.sdir[t];
+		tangents[triangles[t].vc] += job.sdir[t];
 	}
 	// could adjust to make orthogonal, but not really needed for shading
 	for (unsigned int i=0;i<tangents.size();i++)
 		tangents[i].normalize();	
+	if (packed) data.pack();
+}
+
+void meshObject_t::replaceShaders(const map<const shader_t *,shader_t *> &m)
+{
+	object3d_t::replaceShaders(m);
+	// faces of a mesh mostly share a few shaders
+	const shader_t *last=NULL, *lastnew=NULL;
+	for(vector<triangle_t>::iterator tri=triangles.begin();tri!=triangles.end();++tri)
+	{
+		const shader_t *s=tri->getShader();
+		if(s==NULL) continue;
+		if(s!=last)
+		{
+			map<const shader_t *,shader_t *>::const_iterator i=m.find(s);
+			last=s;
+			lastnew=(i==m.end()) ? s : i->second;
+		}
+		tri->setShader(lastnew);
+	}
+}
+
+void meshObject_t::compact()
+{
+	if (!data.isCompact()) data.pack();
 }
 
 void meshObject_t::recalcBound()
 {
 	PFLOAT maxx,maxy,maxz,minx,miny,minz;
-	maxx=minx=triangles.front().a->x;
-	maxy=miny=triangles.front().a->y;
-	maxz=minz=triangles.front().a->z;
+	maxx=minx=triangles.front().A().x;
+	maxy=miny=triangles.front().A().y;
+	maxz=minz=triangles.front().A().z;
 	for(vector<triangle_t>::iterator i=triangles.begin();i!=triangles.end();++i)
 	{
-		point3d_t p=*(i->a);
+		point3d_t p=i->A();
 		if(p.x>maxx) maxx=p.x;
 		if(p.y>maxy) maxy=p.y;
 		if(p.z>maxz) maxz=p.z;
 		if(p.x<minx) minx=p.x;
 		if(p.y<miny) miny=p.y;
 		if(p.z<minz) minz=p.z;
-		p=*(i->b);
+		p=i->B();
 		if(p.x>maxx) maxx=p.x;
 		if(p.y>maxy) maxy=p.y;
 		if(p.z>maxz) maxz=p.z;
 		if(p.x<minx) minx=p.x;
 		if(p.y<miny) miny=p.y;
 		if(p.z<minz) minz=p.z;
-		p=*(i->c);
+		p=i->C();
 		if(p.x>maxx) maxx=p.x;
 		if(p.y>maxy) maxy=p.y;
 		if(p.z>maxz) maxz=p.z;
@@ -423,6 +496,10 @@ void meshObject_t::transform(const matrix4x4_t &m)
 {
 	matrix4x4_t mnotras=m;
 	int step=(hasorco)? 2 :1;
+	bool packed=data.isCompact();
+	if (packed) data.unpack();
+	vector<point3d_t> &vertices=data.vertices;
+	vector<vector3d_t> &normals=data.normals;
 	if(!unt)
 	{
 		for(vector<point3d_t>::iterator ite=vertices.begin();
@@ -467,6 +544,7 @@ void meshObject_t::transform(const matrix4x4_t &m)
 			ite!=triangles.end();ite++)
 		(*ite).recNormal();
 	unt=false;
+	if (packed) data.pack();
 
 //	vector<triangle_t *> *ltri=new vector<triangle_t *>(triangles.size());
 //	for(vector<triangle_t>::iterator i=triangles.begin();
@@ -478,13 +556,9 @@ void meshObject_t::transform(const matrix4x4_t &m)
 //	tree=buildTriangleTree(ltri, maxdepth, face_calc_bound(*ltri),4);
 	recalcBound();
 	
-	
-	// Lynx ->
-	const triangle_t **tris=new const triangle_t*[triangles.size()];
-	for(unsigned int i=0;i<triangles.size();++i)
-		tris[i] = &(triangles[i]);
+	// Lynx -> the tree is no longer valid, prepare() builds it again
 	if(n_tree != 0) delete n_tree;
-	n_tree = new kdTree_t(tris, triangles.size(), -1, -1, 1.2, 0.40 );
+	n_tree = 0;
 	
 	// backOrco, replace translation with (transformed!) bound center
 	bound.get(p1, p2);
@@ -494,6 +568,19 @@ void meshObject_t::transform(const matrix4x4_t &m)
 
 }
 
+void meshObject_t::prepare()
+{
+	treeMutex.wait();
+	if(n_tree == 0)
+	{
+		const triangle_t **tris=new const triangle_t*[triangles.size()];
+		for(unsigned int i=0;i<triangles.size();++i)
+			tris[i] = &(triangles[i]);
+		n_tree = new kdTree_t(tris, triangles.size(), -1, -1, 1.2, 0.40 );
+		delete[] tris;
+	}
+	treeMutex.signal();
+}
 
 point3d_t meshObject_t::toObject(const point3d_t &p)const
 {
@@ -645,7 +732,7 @@ static bool crossQuadXY(const point3d_t &a, const point3d_t &b,
 
 static bool checkTriangleInPlane(triangle_t *t,point3d_t min,point3d_t max,int axis,bool verb=false)
 {
-	point3d_t linea,lineb,a=*(t->a),b=*(t->b),c=*(t->c);
+	point3d_t linea,lineb,a=t->A(),b=t->B(),c=t->C();
 	switch(axis)
 	{
 		case XAXIS:
@@ -918,8 +1005,8 @@ tnode_t * buildTriangleTree(std::vector<triangle_t*> *v, unsigned int maxdepth,
 		/*
 		if(pos==trianglePosition_t::NONE)
 		{
-			if(triBoxOverlap(bl,*((*i)->a),*((*i)->b),*((*i)->c))) pos=trianglePosition_t::LOWER;
-			if(triBoxOverlap(br,*((*i)->a),*((*i)->b),*((*i)->c)))
+			if(triBoxOverlap(bl,(*i)->A(),(*i)->B(),(*i)->C())) pos=trianglePosition_t::LOWER;
+			if(triBoxOverlap(br,(*i)->A(),(*i)->B(),(*i)->C()))
 			{
 				if(pos!=trianglePosition_t::NONE)	pos=trianglePosition_t::INTERSECT;
 				else pos=trianglePosition_t::HIGHER;
@@ -1039,9 +1126,9 @@ tnode_t * buildTriangleTree(const std::vector<triangle_t*> &v,
 	gbr.grow(MIN_RAYDIST);
 	for(vector_const_iterator i=v.begin();i!=v.end();++i)
 	{
-		if(triBoxOverlap(gbl,*((*i)->a),*((*i)->b),*((*i)->c)))
+		if(triBoxOverlap(gbl,(*i)->A(),(*i)->B(),(*i)->C()))
 			vl.push_back(*i);
-		if(triBoxOverlap(gbr,*((*i)->a),*((*i)->b),*((*i)->c)))
+		if(triBoxOverlap(gbr,(*i)->A(),(*i)->B(),(*i)->C()))
 			vr.push_back(*i);
 	}
 
@@ -1098,4 +1185,22 @@ meshObject_t *meshObject_t::factory(bool _hasorco, const matrix4x4_t &M, const s
 	return new meshObject_t(_hasorco, M, ver,nor,ts,fuv,fvcol);
 }
 
+meshObject_t *meshObject_t::factorySwap(bool _hasorco, const matrix4x4_t &M, std::vector<point3d_t> &ver,
+		std::vector<vector3d_t> &nor, std::vector<triangle_t> &ts,
+		std::vector<GFLOAT> &fuv, std::vector<CFLOAT> &fvcol)
+{
+	if ((ver.empty()) || (ts.empty()))
+		cout << "Error null mesh\n";
+	meshObject_t *obj=new meshObject_t();
+	obj->hasorco=_hasorco;
+	obj->data.vertices.swap(ver);
+	obj->data.normals.swap(nor);
+	obj->triangles.swap(ts);
+	obj->data.facesuv.swap(fuv);
+	obj->data.faces_vcol.swap(fvcol);
+	obj->setFaces();
+	obj->transform(M);
+	return obj;
+}
+
 __END_YAFRAY
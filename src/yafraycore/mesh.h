@@ -30,6 +30,7 @@
 #include "vector3d.h"
 #include "triangle.h"
 #include "kdtree.h" //Lynx
+#include "ccthreads.h"
 #include <vector>
 
 
@@ -53,8 +54,10 @@ class YAFRAYCORE_EXPORT meshObject_t : public object3d_t
 {
 	public:
 		void hasOrco(bool b) { hasorco=b; }
-		void autoSmooth(PFLOAT angle);
-		void tangentsFromUV();
+		void autoSmooth(PFLOAT angle,int threads=1);
+		void tangentsFromUV(int threads=1);
+		/// keeps normals, tangents, uvs and colors quantized, see meshData_t
+		void compact();
 		virtual ~meshObject_t();
 		virtual int type() const {return MESH;};
 		virtual void transform(const matrix4x4_t &m);
@@ -64,12 +67,20 @@ class YAFRAYCORE_EXPORT meshObject_t : public object3d_t
 		virtual bool shoot(renderState_t &state,surfacePoint_t &where,const point3d_t &from,
 				const vector3d_t &ray,bool shadow=false,PFLOAT dis=-1) const;
 		virtual bound_t getBound() const {return bound;};
+		virtual void prepare();
+		virtual int prepareCost() const {return n_tree ? 0 : triangles.size();};
+		virtual void replaceShaders(const std::map<const shader_t *,shader_t *> &m);
 
 		static meshObject_t *factory(const std::vector<point3d_t> &ver, const std::vector<vector3d_t> &nor,
 				        const std::vector<triangle_t> &ts, const std::vector<GFLOAT> &fuv, const std::vector<CFLOAT> &fvcol);
 		static meshObject_t *factory(bool _hasorco, const matrix4x4_t &M, const std::vector<point3d_t> &ver,
 				const std::vector<vector3d_t> &nor, const std::vector<triangle_t> &ts,
 				const std::vector<GFLOAT> &fuv, const std::vector<CFLOAT> &fvcol);
+		/** Takes the contents of the vectors instead of copying them, they are
+		 * left empty. Faces index ver, nor, fuv and fvcol as given. */
+		static meshObject_t *factorySwap(bool _hasorco, const matrix4x4_t &M, std::vector<point3d_t> &ver,
+				std::vector<vector3d_t> &nor, std::vector<triangle_t> &ts,
+				std::vector<GFLOAT> &fuv, std::vector<CFLOAT> &fvcol);
 
 	protected:
 		meshObject_t(const std::vector<point3d_t> &ver, const std::vector<vector3d_t> &nor,
@@ -88,11 +99,12 @@ class YAFRAYCORE_EXPORT meshObject_t : public object3d_t
 		meshObject_t(const meshObject_t &m) {}; //forbiden
 		
 		void recalcBound();
-		std::vector<point3d_t> vertices;
-		std::vector<vector3d_t> normals, tangents;
+		/// points the faces to data and computes their normals
+		void setFaces();
+		/// corners (3*face+k) of each vertex v, from corner[first[v]] to corner[first[v+1]-1]
+		void vertexCorners(std::vector<unsigned int> &first,std::vector<unsigned int> &corner)const;
+		meshData_t data;
 		std::vector<triangle_t> triangles;
-		std::vector<GFLOAT> facesuv;
-		std::vector<CFLOAT> faces_vcol;
 		bound_t bound;
 		bool unt,hasorco;
 		// backRot -> rotation only matrix
@@ -102,6 +114,8 @@ class YAFRAYCORE_EXPORT meshObject_t : public object3d_t
 		//geomeTree_t<std::vector<triangle_t*> > *tree;
 		pureBspTree_t<std::vector<triangle_t*> > *tree;
 		kdTree_t *n_tree; //Lynx
+		// references may prepare the same mesh from another thread
+		yafthreads::mutex_t treeMutex;
 };
 
 __END_YAFRAY
@@ -0,0 +1,415 @@
+/****************************************************************************
+ *
+ * 			mipmap.cc: mip-mapped, tiled image storage and tile cache
+ *      This is part of the yafray package
+ *
+ *      This library is free software; you can redistribute it and/or
+ *      modify it under the terms of the GNU Lesser General Public
+ *      License as published by the Free Software Foundation; either
+ *      version 2.1 of the License, or (at your option) any later version.
+ *
+ *      This library is distributed in the hope that it will be useful,
+ *      but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *      MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *      Lesser General Public License for more details.
+ *
+ *      You should have received a copy of the GNU Lesser General Public
+ *      License along with this library; if not, write to the Free Software
+ *      Foundation,Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+ *
+ */
+
+#include "mipmap.h"
+#include <iostream>
+#include <cstring>
+#include <cmath>
+
+using namespace std;
+
+__BEGIN_YAFRAY
+
+//-----------------------------------------------------------------------------------------
+// tile cache
+
+tileCache_t & tileCache_t::instance()
+{
+	static tileCache_t cache;
+	return cache;
+}
+
+tileCache_t::tileCache_t()
+{
+	limit = 256<<20;
+}
+
+tileCache_t::~tileCache_t()
+{
+	for (int i=0;i<SHARDS;++i)
+		for (list<texTile_t *>::iterator j=shards[i].lru.begin();j!=shards[i].lru.end();++j)
+			delete *j;
+}
+
+const texTile_t * tileCache_t::acquire(const mipImage_t *img, int level, int index)
+{
+	tileKey_t key(img, level, index);
+	shard_t &s = shards[key.hash() % SHARDS];
+	s.mutex.wait();
+	map<tileKey_t, texTile_t *>::iterator i = s.tiles.find(key);
+	if (i!=s.tiles.end())
+	{
+		texTile_t *t = i->second;
+		t->pins++;
+		s.lru.splice(s.lru.begin(), s.lru, t->lru);
+		s.hits++;
+		s.mutex.signal();
+		return t;
+	}
+	s.misses++;
+	s.mutex.signal();
+
+	// read outside the lock, so the rest of the shard stays usable meanwhile
+	texTile_t *t = new texTile_t(img, level, index, img->tileBytes());
+	img->loadTile(*t);
+
+	s.mutex.wait();
+	i = s.tiles.find(key);
+	if (i!=s.tiles.end())
+	{
+		// another thread loaded it first
+		delete t;
+		t = i->second;
+		s.lru.splice(s.lru.begin(), s.lru, t->lru);
+	}
+	else
+	{
+		s.tiles[key] = t;
+		s.lru.push_front(t);
+		t->lru = s.lru.begin();
+		s.bytes += t->data.size();
+	}
+	t->pins++;
+	evict(s);
+	s.mutex.signal();
+	return t;
+}
+
+void tileCache_t::release(const texTile_t *tile)
+{
+	shard_t &s = shards[tileKey_t(tile->owner, tile->level, tile->index).hash() % SHARDS];
+	s.mutex.wait();
+	const_cast<texTile_t *>(tile)->pins--;
+	s.mutex.signal();
+}
+
+// called with the shard locked
+void tileCache_t::evict(shard_t &s)
+{
+	size_t budget = limit/SHARDS;
+	list<texTile_t *>::iterator i = s.lru.end();
+	while ((s.bytes>budget) && (i!=s.lru.begin()))
+	{
+		--i;
+		texTile_t *t = *i;
+		if (t->pins>0) continue;
+		s.tiles.erase(tileKey_t(t->owner, t->level, t->index));
+		s.bytes -= t->data.size();
+		i = s.lru.erase(i);
+		s.evictions++;
+		delete t;
+	}
+}
+
+void tileCache_t::forget(const mipImage_t *img)
+{
+	for (int n=0;n<SHARDS;++n)
+	{
+		shard_t &s = shards[n];
+		s.mutex.wait();
+		map<tileKey_t, texTile_t *>::iterator i = s.tiles.lower_bound(tileKey_t(img, -1, -1));
+		while ((i!=s.tiles.end()) && (i->first.img==img))
+		{
+			texTile_t *t = i->second;
+			s.lru.erase(t->lru);
+			s.bytes -= t->data.size();
+			delete t;
+			s.tiles.erase(i++);
+		}
+		s.mutex.signal();
+	}
+}
+
+void tileCache_t::printStats() const
+{
+	unsigned long hits=0, misses=0, evictions=0;
+	size_t bytes=0;
+	for (int i=0;i<SHARDS;++i)
+	{
+		hits += shards[i].hits;
+		misses += shards[i].misses;
+		evictions += shards[i].evictions;
+		bytes += shards[i].bytes;
+	}
+	if (misses==0) return;
+	cout << "Texture cache: " << hits << " hits, " << misses << " misses ("
+		<< (100.0*hits)/(double)(hits+misses) << "% hit rate), " << evictions << " evictions, "
+		<< (bytes>>20) << "/" << (limit>>20) << " MB in use" << endl;
+}
+
+//-----------------------------------------------------------------------------------------
+// mip-mapped image
+
+// "YTX1" header followed by per level sizes and the tiles, level after level
+static const char ytx_magic[4] = {'Y', 'T', 'X', '1'};
+static const int ytx_endian = 0x01020304;
+
+static bool seekTile(FILE *f, double offset)
+{
+#if defined(WIN32)
+	return _fseeki64(f, (__int64)offset, SEEK_SET)==0;
+#else
+	return fseeko(f, (off_t)offset, SEEK_SET)==0;
+#endif
+}
+
+template<class T> inline T toTexel(float v) { return (T)v; }
+template<> inline unsigned char toTexel<unsigned char>(float v) { return (unsigned char)(v+0.5f); }
+
+mipImage_t::mipImage_t():ts(0), tw(0), channel(1), file(NULL), headerSize(0)
+{
+}
+
+mipImage_t::mipImage_t(cBuffer_t &img, bool mipmap, int tilesize)
+	:ts(tilesize), tw(tilesize+2*MIP_BORDER), channel(1), file(NULL), headerSize(0)
+{
+	build(img(0, 0), img.resx(), img.resy(), mipmap);
+}
+
+mipImage_t::mipImage_t(fcBuffer_t &img, bool mipmap, int tilesize)
+	:ts(tilesize), tw(tilesize+2*MIP_BORDER), channel(4), file(NULL), headerSize(0)
+{
+	build(img(0, 0), img.resx(), img.resy(), mipmap);
+}
+
+mipImage_t::~mipImage_t()
+{
+	if (file)
+	{
+		tileCache_t::instance().forget(this);
+		fclose(file);
+	}
+	for (unsigned int i=0;i<tiles.size();++i) delete tiles[i];
+}
+
+void mipImage_t::addLevel(int w, int h)
+{
+	level_t l;
+	l.w = w;
+	l.h = h;
+	l.tilesx = (w+ts-1)/ts;
+	l.tilesy = (h+ts-1)/ts;
+	l.base = lev.empty() ? 0 : (lev.back().base + lev.back().tilesx*lev.back().tilesy);
+	lev.push_back(l);
+}
+
+template<class T> void mipImage_t::build(const T *src, int w, int h, bool mipmap)
+{
+	vector<T> prev, cur;
+	for (;;)
+	{
+		addLevel(w, h);
+		tileLevel(src, (int)lev.size()-1);
+		if ((!mipmap) || ((w==1) && (h==1))) break;
+		// box filter, each texel of the next level averages the ones it covers
+		int nw = max(1, w/2), nh = max(1, h/2);
+		cur.resize(nw*nh*4);
+		for (int y=0;y<nh;++y)
+		{
+			int y0 = (y*h)/nh, y1 = ((y+1)*h)/nh;
+			for (int x=0;x<nw;++x)
+			{
+				int x0 = (x*w)/nw, x1 = ((x+1)*w)/nw;
+				float sum[4] = {0, 0, 0, 0};
+				for (int j=y0;j<y1;++j)
+					for (int i=x0;i<x1;++i)
+						for (int c=0;c<4;++c) sum[c] += (float)src[(j*w+i)*4+c];
+				float inv = 1.f/(float)((x1-x0)*(y1-y0));
+				for (int c=0;c<4;++c) cur[(y*nw+x)*4+c] = toTexel<T>(sum[c]*inv);
+			}
+		}
+		prev.swap(cur);
+		src = &prev[0];
+		w = nw;
+		h = nh;
+	}
+}
+
+template<class T> void mipImage_t::tileLevel(const T *src, int level)
+{
+	const level_t &l = lev[level];
+	for (int ty=0;ty<l.tilesy;++ty)
+		for (int tx=0;tx<l.tilesx;++tx)
+		{
+			texTile_t *t = new texTile_t(this, level, ty*l.tilesx+tx, tileBytes());
+			T *d = (T *)&t->data[0];
+			for (int ly=0;ly<tw;++ly)
+			{
+				int sy = ty*ts - MIP_BORDER + ly;
+				if (sy<0) sy = 0; else if (sy>=l.h) sy = l.h-1;
+				for (int lx=0;lx<tw;++lx)
+				{
+					int sx = tx*ts - MIP_BORDER + lx;
+					if (sx<0) sx = 0; else if (sx>=l.w) sx = l.w-1;
+					memcpy(d, &src[(sy*l.w+sx)*4], 4*sizeof(T));
+					d += 4;
+				}
+			}
+			tiles.push_back(t);
+		}
+}
+
+bool mipImage_t::saveTiled(const string &fname) const
+{
+	if (file) return false;
+	FILE *f = fopen(fname.c_str(), "wb");
+	if (f==NULL) return false;
+	int head[6] = {lev[0].w, lev[0].h, ts, MIP_BORDER, levels(), channel};
+	bool ok = (fwrite(ytx_magic, 4, 1, f)==1) && (fwrite(&ytx_endian, sizeof(int), 1, f)==1)
+		&& (fwrite(head, sizeof(int), 6, f)==6);
+	for (int i=0;ok && (i<levels());++i)
+	{
+		int wh[2] = {lev[i].w, lev[i].h};
+		ok = (fwrite(wh, sizeof(int), 2, f)==2);
+	}
+	for (unsigned int i=0;ok && (i<tiles.size());++i)
+		ok = (fwrite(&tiles[i]->data[0], tileBytes(), 1, f)==1);
+	if (fclose(f)!=0) ok = false;
+	if (!ok) remove(fname.c_str());
+	return ok;
+}
+
+mipImage_t * mipImage_t::openTiled(const string &fname)
+{
+	FILE *f = fopen(fname.c_str(), "rb");
+	if (f==NULL) return NULL;
+	char magic[4];
+	int endian, head[6];
+	if ((fread(magic, 4, 1, f)!=1) || memcmp(magic, ytx_magic, 4) ||
+			(fread(&endian, sizeof(int), 1, f)!=1) || (endian!=ytx_endian) ||
+			(fread(head, sizeof(int), 6, f)!=6) || (head[3]!=MIP_BORDER) ||
+			(head[2]<=0) || (head[4]<=0) || ((head[5]!=1) && (head[5]!=4)))
+	{
+		fclose(f);
+		return NULL;
+	}
+	mipImage_t *img = new mipImage_t();
+	img->ts = head[2];
+	img->tw = head[2]+2*MIP_BORDER;
+	img->channel = head[5];
+	for (int i=0;i<head[4];++i)
+	{
+		int wh[2];
+		if ((fread(wh, sizeof(int), 2, f)!=2) || (wh[0]<=0) || (wh[1]<=0))
+		{
+			fclose(f);
+			delete img;
+			return NULL;
+		}
+		img->addLevel(wh[0], wh[1]);
+	}
+	img->headerSize = ftell(f);
+	img->file = f;
+	return img;
+}
+
+void mipImage_t::loadTile(texTile_t &t) const
+{
+	double offset = (double)headerSize + (double)(lev[t.level].base+t.index)*(double)tileBytes();
+	fileMutex.wait();
+	bool ok = seekTile(file, offset) && (fread(&t.data[0], tileBytes(), 1, file)==1);
+	fileMutex.signal();
+	if (!ok)
+	{
+		cerr << "Error reading texture tile " << t.index << " of level " << t.level << endl;
+		memset(&t.data[0], 0, tileBytes());
+	}
+}
+
+colorA_t mipImage_t::texel(int level, int x, int y) const
+{
+	const level_t &l = lev[level];
+	int tx = x/ts, ty = y/ts;
+	const texTile_t *t = getTile(level, ty*l.tilesx+tx);
+	colorA_t c = fetch(t, x-tx*ts+MIP_BORDER, y-ty*ts+MIP_BORDER);
+	releaseTile(t);
+	return c;
+}
+
+static colorA_t cubicInterpolate(const colorA_t &c1, const colorA_t &c2,
+													const colorA_t &c3, const colorA_t &c4, CFLOAT x)
+{
+	colorA_t t2(c3-c2);
+	colorA_t t1(t2 - (c2-c1));
+	t2 = (c4-c3) - t2;
+	CFLOAT ix = 1.f-x;
+	return x*c3 + ix*c2 + ((4.f*t2 - t1)*(x*x*x-x) + (4.f*t1 - t2)*(ix*ix*ix-ix))*0.06666667f;
+}
+
+colorA_t mipImage_t::lookup(const point3d_t &p, int level, interpolation_t intp) const
+{
+	const level_t &l = lev[level];
+	int x, y;
+	CFLOAT xf = ((CFLOAT)l.w * (p.x - floor(p.x)));
+	CFLOAT yf = ((CFLOAT)l.h * (p.y - floor(p.y)));
+	if (intp!=NONE) { xf -= 0.5f;  yf -= 0.5f; }
+	if ((x=(int)xf)<0) x = 0;
+	if ((y=(int)yf)<0) y = 0;
+	if (x>=l.w) x = l.w-1;
+	if (y>=l.h) y = l.h-1;
+	// the tile border holds the neighbours, clamped at the image edges
+	int tx = x/ts, ty = y/ts;
+	const texTile_t *t = getTile(level, ty*l.tilesx+tx);
+	x += MIP_BORDER - tx*ts;
+	y += MIP_BORDER - ty*ts;
+	colorA_t c1 = fetch(t, x, y);
+	if (intp==NONE)
+	{
+		releaseTile(t);
+		return c1;
+	}
+	colorA_t c2 = fetch(t, x+1, y), c3 = fetch(t, x, y+1), c4 = fetch(t, x+1, y+1);
+	CFLOAT dx=xf-floor(xf), dy=yf-floor(yf);
+	if (intp==BILINEAR)
+	{
+		releaseTile(t);
+		CFLOAT w0=(1-dx)*(1-dy), w1=(1-dx)*dy, w2=dx*(1-dy), w3=dx*dy;
+		return colorA_t(w0*c1.getR() + w1*c3.getR() + w2*c2.getR() + w3*c4.getR(),
+										w0*c1.getG() + w1*c3.getG() + w2*c2.getG() + w3*c4.getG(),
+										w0*c1.getB() + w1*c3.getB() + w2*c2.getB() + w3*c4.getB(),
+										w0*c1.getA() + w1*c3.getA() + w2*c2.getA() + w3*c4.getA());
+	}
+	colorA_t c0 = fetch(t, x-1, y-1), c5 = fetch(t, x, y-1), c6 = fetch(t, x+1, y-1), c7 = fetch(t, x+2, y-1);
+	colorA_t c8 = fetch(t, x-1, y),   c9 = fetch(t, x+2, y);
+	colorA_t cA = fetch(t, x-1, y+1), cB = fetch(t, x+2, y+1);
+	colorA_t cC = fetch(t, x-1, y+2), cD = fetch(t, x, y+2), cE = fetch(t, x+1, y+2), cF = fetch(t, x+2, y+2);
+	releaseTile(t);
+	c0 = cubicInterpolate(c0, c5, c6, c7, dx);
+	c8 = cubicInterpolate(c8, c1, c2, c9, dx);
+	cA = cubicInterpolate(cA, c3, c4, cB, dx);
+	cC = cubicInterpolate(cC, cD, cE, cF, dx);
+	return cubicInterpolate(c0, c8, cA, cC, dy);
+}
+
+colorA_t mipImage_t::lookup(const point3d_t &p, GFLOAT width, interpolation_t intp) const
+{
+	int last = levels()-1;
+	if ((width<=0) || (last==0)) return lookup(p, 0, intp);
+	// level whose texels match the footprint, blending the two nearest ones
+	GFLOAT lambda = log(width*(GFLOAT)max(lev[0].w, lev[0].h)) * M_LOG2E;
+	if (lambda<=0) return lookup(p, 0, intp);
+	int l0 = (int)lambda;
+	if (l0>=last) return lookup(p, last, intp);
+	CFLOAT f = lambda-(GFLOAT)l0;
+	return (1.f-f)*lookup(p, l0, intp) + f*lookup(p, l0+1, intp);
+}
+
+__END_YAFRAY
@@ -0,0 +1,192 @@
+/****************************************************************************
+ *
+ * 			mipmap.h: mip-mapped, tiled image storage and tile cache api
+ *      This is part of the yafray package
+ *
+ *      This library is free software; you can redistribute it and/or
+ *      modify it under the terms of the GNU Lesser General Public
+ *      License as published by the Free Software Foundation; either
+ *      version 2.1 of the License, or (at your option) any later version.
+ *
+ *      This library is distributed in the hope that it will be useful,
+ *      but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *      MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *      Lesser General Public License for more details.
+ *
+ *      You should have received a copy of the GNU Lesser General Public
+ *      License along with this library; if not, write to the Free Software
+ *      Foundation,Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+ *
+ */
+#ifndef __MIPMAP_H
+#define __MIPMAP_H
+
+#ifdef HAVE_CONFIG_H
+#include<config.h>
+#endif
+
+#include "color.h"
+#include "vector3d.h"
+#include "buffer.h"
+#include "ccthreads.h"
+#include <cstdio>
+#include <vector>
+#include <list>
+#include <map>
+#include <string>
+
+__BEGIN_YAFRAY
+
+class mipImage_t;
+
+/** Square block of one mip level
+ *
+ * Texels are RGBA, bytes or floats like the image they come from.
+ * Every tile carries a border of MIP_BORDER texels (clamped at the image edges)
+ * so a bicubic lookup never needs a neighbour tile.
+ *
+ */
+struct YAFRAYCORE_EXPORT texTile_t
+{
+	texTile_t(const mipImage_t *o, int l, int i, size_t bytes)
+		:owner(o), level(l), index(i), pins(0), data(bytes) {};
+	const mipImage_t *owner;
+	int level, index;
+	// tiles in use can't be evicted
+	int pins;
+	std::list<texTile_t *>::iterator lru;
+	std::vector<unsigned char> data;
+};
+
+/** Memory bounded tile cache shared by all paged images
+ *
+ * Split in shards with their own lock and LRU list so render threads
+ * rarely wait on each other. Tiles are loaded lazily on first use.
+ *
+ */
+class YAFRAYCORE_EXPORT tileCache_t
+{
+	public:
+		static tileCache_t & instance();
+		void setMemoryLimit(size_t bytes) { limit=bytes; }
+		size_t memoryLimit() const { return limit; }
+		/// Returns the tile pinned, loading it if needed. Must be released
+		const texTile_t * acquire(const mipImage_t *img, int level, int index);
+		void release(const texTile_t *tile);
+		/// Drops every tile of img, used when the image is destroyed
+		void forget(const mipImage_t *img);
+		void printStats() const;
+	protected:
+		tileCache_t();
+		~tileCache_t();
+		tileCache_t(const tileCache_t &c) {}; //forbiden
+
+		struct tileKey_t
+		{
+			tileKey_t(const mipImage_t *i, int l, int n):img(i), level(l), index(n) {};
+			bool operator < (const tileKey_t &k) const
+			{
+				if (img!=k.img) return img<k.img;
+				if (level!=k.level) return level<k.level;
+				return index<k.index;
+			}
+			unsigned int hash() const
+			{ return (unsigned int)(((size_t)img)>>4) ^ (level*31) ^ (index*2654435761u); }
+			const mipImage_t *img;
+			int level, index;
+		};
+		struct shard_t
+		{
+			shard_t():bytes(0), hits(0), misses(0), evictions(0) {};
+			yafthreads::mutex_t mutex;
+			std::map<tileKey_t, texTile_t *> tiles;
+			std::list<texTile_t *> lru;
+			size_t bytes;
+			unsigned long hits, misses, evictions;
+		};
+		enum { SHARDS=16 };
+
+		void evict(shard_t &s);
+
+		shard_t shards[SHARDS];
+		size_t limit;
+};
+
+#define MIP_BORDER 2
+
+/** Mip-mapped image
+ *
+ * The pyramid is either resident, built from a loaded image, or paged
+ * from a pre-tiled file through the tile cache, so only the tiles
+ * actually looked up take memory.
+ *
+ */
+class YAFRAYCORE_EXPORT mipImage_t
+{
+	public:
+		enum interpolation_t {NONE, BILINEAR, BICUBIC};
+
+		/// Resident pyramid, with mipmap false only the base level is kept
+		mipImage_t(cBuffer_t &img, bool mipmap=true, int tilesize=64);
+		mipImage_t(fcBuffer_t &img, bool mipmap=true, int tilesize=64);
+		~mipImage_t();
+
+		/// Opens a pre-tiled file for paging, NULL if it can't be used
+		static mipImage_t * openTiled(const std::string &fname);
+		/// Writes all tiles of a resident pyramid to a file openTiled() can read
+		bool saveTiled(const std::string &fname) const;
+
+		int levels() const { return (int)lev.size(); }
+		int resx(int level=0) const { return lev[level].w; }
+		int resy(int level=0) const { return lev[level].h; }
+		bool paged() const { return file!=NULL; }
+
+		colorA_t texel(int level, int x, int y) const;
+		/// Lookup at one level, p.x & p.y are wrapped to [0,1)
+		colorA_t lookup(const point3d_t &p, int level, interpolation_t intp) const;
+		/// Trilinear lookup, width is the filter width in texture space
+		colorA_t lookup(const point3d_t &p, GFLOAT width, interpolation_t intp) const;
+
+		size_t tileBytes() const { return tw*tw*4*channel; }
+		void loadTile(texTile_t &t) const;
+	protected:
+		mipImage_t();
+		mipImage_t(const mipImage_t &m) {}; //forbiden
+
+		struct level_t
+		{
+			int w, h, tilesx, tilesy, base;
+		};
+		void addLevel(int w, int h);
+		template<class T> void build(const T *src, int w, int h, bool mipmap);
+		template<class T> void tileLevel(const T *src, int level);
+
+		const texTile_t * getTile(int level, int index) const
+		{
+			if (file==NULL) return tiles[lev[level].base+index];
+			return tileCache_t::instance().acquire(this, level, index);
+		}
+		void releaseTile(const texTile_t *t) const
+		{ if (file!=NULL) tileCache_t::instance().release(t); }
+		colorA_t fetch(const texTile_t *t, int lx, int ly) const
+		{
+			colorA_t c;
+			unsigned char *d = const_cast<unsigned char *>(&t->data[(ly*tw+lx)*4*channel]);
+			if (channel==1) d >> c; else ((float *)d) >> c;
+			return c;
+		}
+
+		std::vector<level_t> lev;
+		int ts, tw;	// tile size and stored width with border
+		int channel;	// bytes per channel, 1 or 4
+		// resident tiles
+		std::vector<texTile_t *> tiles;
+		// paged tiles
+		FILE *file;
+		long headerSize;
+		mutable yafthreads::mutex_t fileMutex;
+};
+
+__END_YAFRAY
+
+#endif
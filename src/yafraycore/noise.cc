@@ -1,5 +1,9 @@
 #include "noise.h"
 
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
 __BEGIN_YAFRAY
 
 // needed for voronoi
@@ -155,10 +159,29 @@ static float hashvectf[768]= {
 
 #define lerp(t, a, b) ((a)+(t)*((b)-(a)))
 
+void noiseGenerator_t::evaluate(const point3d_t *pt, PFLOAT *res, int n) const
+{
+	for (int i=0;i<n;i++) res[i] = (*this)(pt[i]);
+}
+
+#ifdef __SSE2__
+#define SSE_SELECT(m, a, b) _mm_or_ps(_mm_and_ps(m, a), _mm_andnot_ps(m, b))
+
+// floor of 4 floats, the truncation corrected for negative values
+static inline __m128 sseFloor(__m128 x, __m128i &ix)
+{
+	ix = _mm_cvttps_epi32(x);
+	__m128 f = _mm_cvtepi32_ps(ix);
+	__m128 neg = _mm_cmpgt_ps(f, x);
+	ix = _mm_add_epi32(ix, _mm_castps_si128(neg));	// mask is -1 where corrected
+	return _mm_sub_ps(f, _mm_and_ps(neg, _mm_set1_ps(1.f)));
+}
+#endif
+
 //------------------------------------------------------------------------------------
 // New Perlin noise
 
-PFLOAT newPerlin_t::operator() (const point3d_t &pt) const
+PFLOAT newPerlin_t::eval(const point3d_t &pt) const
 {
 	PFLOAT x=pt.x, y=pt.y, z=pt.z;
 	PFLOAT u=floor(x), v=floor(y), w=floor(z);
@@ -182,6 +205,77 @@ PFLOAT newPerlin_t::operator() (const point3d_t &pt) const
 	return (0.5 + 0.5*nv);
 }
 
+#ifdef __SSE2__
+static inline __m128 sseFade(__m128 t)
+{
+	__m128 p = _mm_add_ps(_mm_mul_ps(t, _mm_sub_ps(_mm_mul_ps(t, _mm_set1_ps(6.f)), _mm_set1_ps(15.f))), _mm_set1_ps(10.f));
+	return _mm_mul_ps(_mm_mul_ps(_mm_mul_ps(t, t), t), p);
+}
+
+static inline __m128 sseGrad(const int *hs, __m128 x, __m128 y, __m128 z)
+{
+	__m128i h = _mm_and_si128(_mm_loadu_si128((const __m128i *)hs), _mm_set1_epi32(15));
+	__m128 lt8 = _mm_castsi128_ps(_mm_cmplt_epi32(h, _mm_set1_epi32(8)));
+	__m128 lt4 = _mm_castsi128_ps(_mm_cmplt_epi32(h, _mm_set1_epi32(4)));
+	__m128 hx = _mm_castsi128_ps(_mm_or_si128(_mm_cmpeq_epi32(h, _mm_set1_epi32(12)),
+																					_mm_cmpeq_epi32(h, _mm_set1_epi32(14))));
+	__m128 u = SSE_SELECT(lt8, x, y);
+	__m128 v = SSE_SELECT(lt4, y, SSE_SELECT(hx, x, z));
+	// bits 0 and 1 of the hash flip the signs
+	__m128 su = _mm_castsi128_ps(_mm_slli_epi32(h, 31));
+	__m128 sv = _mm_castsi128_ps(_mm_slli_epi32(_mm_srli_epi32(h, 1), 31));
+	return _mm_add_ps(_mm_xor_ps(u, su), _mm_xor_ps(v, sv));
+}
+
+#define SSE_LERP(t, a, b) _mm_add_ps(a, _mm_mul_ps(t, _mm_sub_ps(b, a)))
+#endif
+
+void newPerlin_t::eval4(const point3d_t *pt, PFLOAT *res) const
+{
+#ifdef __SSE2__
+	__m128 x = _mm_setr_ps(pt[0].x, pt[1].x, pt[2].x, pt[3].x);
+	__m128 y = _mm_setr_ps(pt[0].y, pt[1].y, pt[2].y, pt[3].y);
+	__m128 z = _mm_setr_ps(pt[0].z, pt[1].z, pt[2].z, pt[3].z);
+	__m128i ix, iy, iz;
+	x = _mm_sub_ps(x, sseFloor(x, ix));
+	y = _mm_sub_ps(y, sseFloor(y, iy));
+	z = _mm_sub_ps(z, sseFloor(z, iz));
+	__m128i m = _mm_set1_epi32(255);
+	int X[4], Y[4], Z[4];
+	_mm_storeu_si128((__m128i *)X, _mm_and_si128(ix, m));
+	_mm_storeu_si128((__m128i *)Y, _mm_and_si128(iy, m));
+	_mm_storeu_si128((__m128i *)Z, _mm_and_si128(iz, m));
+	// the table lookups stay scalar, one row per cube corner
+	int h[8][4];
+	for (int i=0;i<4;i++)
+	{
+		int A=hash[X[i]  ]+Y[i], AA=hash[A]+Z[i], AB=hash[A+1]+Z[i],
+		    B=hash[X[i]+1]+Y[i], BA=hash[B]+Z[i], BB=hash[B+1]+Z[i];
+		h[0][i]=hash[AA];  h[1][i]=hash[BA];  h[2][i]=hash[AB];  h[3][i]=hash[BB];
+		h[4][i]=hash[AA+1];  h[5][i]=hash[BA+1];  h[6][i]=hash[AB+1];  h[7][i]=hash[BB+1];
+	}
+	__m128 u=sseFade(x), v=sseFade(y), w=sseFade(z);
+	__m128 one = _mm_set1_ps(1.f);
+	__m128 x1=_mm_sub_ps(x, one), y1=_mm_sub_ps(y, one), z1=_mm_sub_ps(z, one);
+	__m128 nv = SSE_LERP(w, SSE_LERP(v, SSE_LERP(u, sseGrad(h[0], x, y, z), sseGrad(h[1], x1, y, z)),
+																SSE_LERP(u, sseGrad(h[2], x, y1, z), sseGrad(h[3], x1, y1, z))),
+													SSE_LERP(v, SSE_LERP(u, sseGrad(h[4], x, y, z1), sseGrad(h[5], x1, y, z1)),
+																SSE_LERP(u, sseGrad(h[6], x, y1, z1), sseGrad(h[7], x1, y1, z1))));
+	float n[4];
+	_mm_storeu_ps(n, nv);
+	for (int i=0;i<4;i++) res[i] = (0.5 + 0.5*n[i]);
+#else
+	for (int i=0;i<4;i++) res[i] = eval(pt[i]);
+#endif
+}
+
+void newPerlin_t::evaluate(const point3d_t *pt, PFLOAT *res, int n) const
+{
+	int i=0;
+	for (; i+4<=n; i+=4) eval4(pt+i, res+i);
+	for (; i<n; i++) res[i] = eval(pt[i]);
+}
+
 //------------------------------------------------------------------------------------
 // Standard (old) Perlin noise
 
@@ -380,7 +474,7 @@ static float stdp_g[512+2][3]= {
         r0 = t - (int)t; \
         r1 = r0 - 1.0;
 
-PFLOAT stdPerlin_t::operator() (const point3d_t &pt) const
+PFLOAT stdPerlin_t::eval(const point3d_t &pt) const
 {
 	int bx0, bx1, by0, by1, bz0, bz1, b00, b10, b01, b11;
 	float rx0, rx1, ry0, ry1, rz0, rz1, *q, sx, sy, sz, a, b, c, d, t, u, v;
@@ -436,7 +530,7 @@ PFLOAT stdPerlin_t::operator() (const point3d_t &pt) const
 //------------------------------------------------------------------------------------
 // Blender noise, similar to 'standard' perlin
 
-PFLOAT blenderNoise_t::operator() (const point3d_t &pt) const
+PFLOAT blenderNoise_t::eval(const point3d_t &pt) const
 {
 	//PFLOAT cn1, cn2, cn3, cn4, cn5, cn6, i, *h;
 	//PFLOAT ox, oy, oz, jx, jy, jz;
@@ -509,11 +603,99 @@ PFLOAT blenderNoise_t::operator() (const point3d_t &pt) const
 	return n;
 }
 
+#ifdef __SSE2__
+// hermite weights of the blender noise, 1-3t^2+2t^3 for the near corner and
+// 1-3t^2-2t^3 for the far one, t being negative there. eval() sums them in
+// double, so this does too, two lanes at a time, to give the same floats.
+static inline __m128d bnWeight2(__m128 t, __m128 t2, __m128d s)
+{
+	__m128d c = _mm_cvtps_pd(t2);
+	__m128d p = _mm_mul_pd(_mm_mul_pd(_mm_set1_pd(2.0), c), _mm_cvtps_pd(t));
+	return _mm_add_pd(_mm_sub_pd(_mm_set1_pd(1.0), _mm_mul_pd(_mm_set1_pd(3.0), c)), _mm_mul_pd(s, p));
+}
+
+static inline __m128 bnWeight(__m128 t, double sign)
+{
+	__m128 t2 = _mm_mul_ps(t, t);
+	__m128d s = _mm_set1_pd(sign);
+	__m128 lo = _mm_cvtpd_ps(bnWeight2(t, t2, s));
+	__m128 hi = _mm_cvtpd_ps(bnWeight2(_mm_movehl_ps(t, t), _mm_movehl_ps(t2, t2), s));
+	return _mm_movelh_ps(lo, hi);
+}
+
+static inline __m128 bnNear(__m128 t) { return bnWeight(t, 1.0); }
+static inline __m128 bnFar(__m128 t) { return bnWeight(t, -1.0); }
+#endif
+
+void blenderNoise_t::eval4(const point3d_t *pt, PFLOAT *res) const
+{
+#ifdef __SSE2__
+	__m128 x = _mm_setr_ps(pt[0].x, pt[1].x, pt[2].x, pt[3].x);
+	__m128 y = _mm_setr_ps(pt[0].y, pt[1].y, pt[2].y, pt[3].y);
+	__m128 z = _mm_setr_ps(pt[0].z, pt[1].z, pt[2].z, pt[3].z);
+	__m128i ix, iy, iz;
+	__m128 ox = _mm_sub_ps(x, sseFloor(x, ix));
+	__m128 oy = _mm_sub_ps(y, sseFloor(y, iy));
+	__m128 oz = _mm_sub_ps(z, sseFloor(z, iz));
+	__m128 one = _mm_set1_ps(1.f);
+	__m128 jx=_mm_sub_ps(ox, one), jy=_mm_sub_ps(oy, one), jz=_mm_sub_ps(oz, one);
+	__m128 cn1=bnNear(ox), cn2=bnNear(oy), cn3=bnNear(oz);
+	__m128 cn4=bnFar(jx), cn5=bnFar(jy), cn6=bnFar(jz);
+	int IX[4], IY[4], IZ[4];
+	_mm_storeu_si128((__m128i *)IX, ix);
+	_mm_storeu_si128((__m128i *)IY, iy);
+	_mm_storeu_si128((__m128i *)IZ, iz);
+	// gradient vectors of the 8 corners, one lane per point
+	float g[8][3][4];
+	for (int i=0;i<4;i++)
+	{
+		int b00= hash[ hash[IX[i] & 255]+(IY[i] & 255)];
+		int b10= hash[ hash[(IX[i]+1) & 255]+(IY[i] & 255)];
+		int b01= hash[ hash[IX[i] & 255]+((IY[i]+1) & 255)];
+		int b11= hash[ hash[(IX[i]+1) & 255]+((IY[i]+1) & 255)];
+		int b20=IZ[i] & 255, b21= (IZ[i]+1) & 255;
+		const int c[8] = { b20+b00, b21+b00, b20+b01, b21+b01, b20+b10, b21+b10, b20+b11, b21+b11 };
+		for (int k=0;k<8;k++)
+		{
+			const float *h = hashvectf + 3*hash[c[k]];
+			g[k][0][i]=h[0];  g[k][1][i]=h[1];  g[k][2][i]=h[2];
+		}
+	}
+	__m128 n = _mm_set1_ps(0.5f);
+#define BN_CORNER(k, a, b, c, px, py, pz) \
+	n = _mm_add_ps(n, _mm_mul_ps(_mm_mul_ps(_mm_mul_ps(a, b), c), \
+		_mm_add_ps(_mm_add_ps(_mm_mul_ps(_mm_loadu_ps(g[k][0]), px), _mm_mul_ps(_mm_loadu_ps(g[k][1]), py)), \
+							_mm_mul_ps(_mm_loadu_ps(g[k][2]), pz))))
+	BN_CORNER(0, cn1, cn2, cn3, ox, oy, oz);
+	BN_CORNER(1, cn1, cn2, cn6, ox, oy, jz);
+	BN_CORNER(2, cn1, cn5, cn3, ox, jy, oz);
+	BN_CORNER(3, cn1, cn5, cn6, ox, jy, jz);
+	BN_CORNER(4, cn4, cn2, cn3, jx, oy, oz);
+	BN_CORNER(5, cn4, cn2, cn6, jx, oy, jz);
+	BN_CORNER(6, cn4, cn5, cn3, jx, jy, oz);
+	BN_CORNER(7, cn4, cn5, cn6, jx, jy, jz);
+#undef BN_CORNER
+	n = _mm_min_ps(_mm_max_ps(n, _mm_setzero_ps()), one);
+	_mm_storeu_ps(res, n);
+#else
+	for (int i=0;i<4;i++) res[i] = eval(pt[i]);
+#endif
+}
+
+void blenderNoise_t::evaluate(const point3d_t *pt, PFLOAT *res, int n) const
+{
+	int i=0;
+	for (; i+4<=n; i+=4) eval4(pt+i, res+i);
+	for (; i<n; i++) res[i] = eval(pt[i]);
+}
+
 //------------------------------------------------------------------------------------
 // Voronoi/Worley/Celullar basis
 
 void voronoi_t::setDistM(dMetricType dm)
 {
+	if (distfunc) delete distfunc;
+	dmType = dm;
 	switch(dm) {
 		case DIST_SQUARED:
 			distfunc = new dist_Squared();
@@ -543,13 +725,14 @@ void voronoi_t::setDistM(dMetricType dm)
 voronoi_t::voronoi_t(voronoiType vt, dMetricType dm, PFLOAT mex)
 {
 	vType = vt;
-	dmType = dm;
 	mk_exp = mex;
-	setDistM(dmType);
+	distfunc = NULL;
+	setDistM(dm);
 }
 
-void voronoi_t::getFeatures(const point3d_t &pt) const
+template<class D> void voronoi_t::features(const point3d_t &pt) const
 {
+	D dist;
 	int xx, yy, zz, xi, yi, zi;
 	//PFLOAT xd, yd, zd, d, *p;
 	//PFLOAT x=pt.x, y=pt.y, z=pt.z;
@@ -566,7 +749,7 @@ void voronoi_t::getFeatures(const point3d_t &pt) const
 				xd = x - (p[0] + xx);
 				yd = y - (p[1] + yy);
 				zd = z - (p[2] + zz);
-				d = (*distfunc)(xd, yd, zd, mk_exp);
+				d = dist(xd, yd, zd, mk_exp);
 				if (d<da[0]) {
 					da[3]=da[2];  da[2]=da[1];  da[1]=da[0];  da[0]=d;
 					pa[3]=pa[2];  pa[2]=pa[1];  pa[1]=pa[0];  pa[0].set(p[0]+xx, p[1]+yy, p[2]+zz);
@@ -588,6 +771,20 @@ void voronoi_t::getFeatures(const point3d_t &pt) const
 	}
 }
 
+void voronoi_t::getFeatures(const point3d_t &pt) const
+{
+	switch(dmType) {
+		case DIST_SQUARED:	features<dist_Squared>(pt); break;
+		case DIST_MANHATTAN:	features<dist_Manhattan>(pt); break;
+		case DIST_CHEBYCHEV:	features<dist_Chebychev>(pt); break;
+		case DIST_MINKOVSKY_HALF:	features<dist_MinkovskyH>(pt); break;
+		case DIST_MINKOVSKY_FOUR:	features<dist_Minkovsky4>(pt); break;
+		case DIST_MINKOVSKY:	features<dist_Minkovsky>(pt); break;
+		default:
+		case DIST_REAL:	features<dist_Real>(pt); break;
+	}
+}
+
 PFLOAT voronoi_t::operator() (const point3d_t &pt) const
 {
 	getFeatures(pt);
@@ -624,6 +821,61 @@ PFLOAT cellNoise_t::operator() (const point3d_t &pt) const
 //------------------------------------------------------------------------------------
 // Musgrave
 
+// any generator in the templated loops, one virtual call per point
+struct anyNoise_t
+{
+	anyNoise_t(const noiseGenerator_t *g): gen(g) {}
+	PFLOAT eval(const point3d_t &pt) const { return (*gen)(pt); }
+	void eval4(const point3d_t *pt, PFLOAT *res) const { gen->evaluate(pt, res, 4); }
+	const noiseGenerator_t *gen;
+};
+
+// noise of successive octaves, the point scaled by lacunarity each time.
+// Octaves don't depend on each other, so they are evaluated four at once;
+// n is the number needed in total so no more than those are computed.
+template<class N> class octaves_t
+{
+	public:
+		octaves_t(const N &g, const point3d_t &pt, PFLOAT lacu, int n)
+			:ng(g), tp(pt), lacunarity(lacu), left(n), pos(4) {}
+		PFLOAT next()
+		{
+			if (pos==4) fill();
+			return val[pos++];
+		}
+		PFLOAT nextSigned() { return (PFLOAT)2.0 * next() - (PFLOAT)1.0; }
+	protected:
+		void fill()
+		{
+			int n = (left<4) ? left : 4;
+			if (n<1) n = 1;
+			for (int i=0;i<n;i++) { p[i]=tp;  tp*=lacunarity; }
+			if (n==4) ng.eval4(p, val);
+			else for (int i=0;i<n;i++) val[i] = ng.eval(p[i]);
+			left -= n;
+			pos = 0;
+		}
+		const N &ng;
+		point3d_t tp, p[4];
+		PFLOAT lacunarity, val[4];
+		int left, pos;
+};
+
+// calls the loop of f instanced for the basis of gen
+template<class F> static inline PFLOAT basisDispatch(const F &f, const noiseGenerator_t *gen, const point3d_t &pt)
+{
+	switch (gen->getBasis()) {
+		case noiseGenerator_t::N_NEWPERLIN:
+			return f.loop(*static_cast<const newPerlin_t *>(gen), pt);
+		case noiseGenerator_t::N_STDPERLIN:
+			return f.loop(*static_cast<const stdPerlin_t *>(gen), pt);
+		case noiseGenerator_t::N_BLENDER:
+			return f.loop(*static_cast<const blenderNoise_t *>(gen), pt);
+		default:
+			return f.loop(anyNoise_t(gen), pt);
+	}
+}
+
 
 /*
  * Procedural fBm evaluated at "point"; returns value stored in "value".
@@ -636,16 +888,20 @@ PFLOAT cellNoise_t::operator() (const point3d_t &pt) const
  *    ``octaves''  is the number of frequencies in the fBm
  */
 PFLOAT fBm_t::operator() (const point3d_t &pt) const
+{
+	return basisDispatch(*this, nGen, pt);
+}
+
+template<class N> PFLOAT fBm_t::loop(const N &ng, const point3d_t &pt) const
 {
 	PFLOAT value=0, pwr=1, pwHL=pow(lacunarity, -H);
-	point3d_t tp(pt);
+	PFLOAT rmd = octaves - floor(octaves);
+	octaves_t<N> oct(ng, pt, lacunarity, (int)octaves + (rmd!=0.f));
 	for (int i=0; i<(int)octaves; i++) {
-		value += getSignedNoise(nGen, tp) * pwr;
+		value += oct.nextSigned() * pwr;
 		pwr *= pwHL;
-		tp *= lacunarity;
 	}
-	PFLOAT rmd = octaves - floor(octaves);
-	if (rmd!=0.f) value += rmd * getSignedNoise(nGen, tp) * pwr;
+	if (rmd!=0.f) value += rmd * oct.nextSigned() * pwr;
 	return value;
 }
 
@@ -666,16 +922,20 @@ PFLOAT fBm_t::operator() (const point3d_t &pt) const
  	* there seem to be errors in the original source code (in all three versions of proc.text&mod),
 	* I modified it to something that made sense to me, so it might be wrong... */
 PFLOAT mFractal_t::operator() (const point3d_t &pt) const
+{
+	return basisDispatch(*this, nGen, pt);
+}
+
+template<class N> PFLOAT mFractal_t::loop(const N &ng, const point3d_t &pt) const
 {
 	PFLOAT value=1, pwr=1, pwHL=pow(lacunarity, -H);
-	point3d_t tp(pt);
+	PFLOAT rmd = octaves - floor(octaves);
+	octaves_t<N> oct(ng, pt, lacunarity, (int)octaves + (rmd!=(PFLOAT)0.0));
 	for (int i=0; i<(int)octaves; i++) {
-		value *= (pwr*getSignedNoise(nGen, tp) + (PFLOAT)1.0);
+		value *= (pwr*oct.nextSigned() + (PFLOAT)1.0);
 		pwr *= pwHL;
-		tp *= lacunarity;
 	}
-	PFLOAT rmd = octaves - floor(octaves);
-	if (rmd!=(PFLOAT)0.0) value *= (rmd * getSignedNoise(nGen, tp) * pwr + (PFLOAT)1.0);
+	if (rmd!=(PFLOAT)0.0) value *= (rmd * oct.nextSigned() * pwr + (PFLOAT)1.0);
 	return value;
 }
 
@@ -693,25 +953,28 @@ PFLOAT mFractal_t::operator() (const point3d_t &pt) const
  *       ``offset''  raises the terrain from `sea level'
  */
 PFLOAT heteroTerrain_t::operator() (const point3d_t &pt) const
+{
+	return basisDispatch(*this, nGen, pt);
+}
+
+template<class N> PFLOAT heteroTerrain_t::loop(const N &ng, const point3d_t &pt) const
 {
 	PFLOAT pwHL = pow(lacunarity, -H);
 	PFLOAT pwr = pwHL;	// starts with i=1 instead of 0
-	point3d_t tp(pt);
+	PFLOAT rmd = octaves - floor(octaves);
+	octaves_t<N> oct(ng, pt, lacunarity, (int)octaves + (rmd!=(PFLOAT)0.0));
 
 	// first unscaled octave of function; later octaves are scaled
-	PFLOAT value = offset + getSignedNoise(nGen, tp);
-	tp *= lacunarity;
+	PFLOAT value = offset + oct.nextSigned();
 	PFLOAT increment;
 	for (int i=1; i<(int)octaves; i++) {
-		increment = (getSignedNoise(nGen, tp) + offset) * pwr * value;
+		increment = (oct.nextSigned() + offset) * pwr * value;
 		value += increment;
 		pwr *= pwHL;
-		tp *= lacunarity;
 	}
 
-	PFLOAT rmd = octaves - floor(octaves);
 	if (rmd!=(PFLOAT)0.0) {
-		increment = (getSignedNoise(nGen, tp) + offset) * pwr * value;
+		increment = (oct.nextSigned() + offset) * pwr * value;
 		value += rmd * increment;
 	}
 
@@ -729,26 +992,30 @@ PFLOAT heteroTerrain_t::operator() (const point3d_t &pt) const
  *      offset:      0.7
  */
 PFLOAT hybridMFractal_t::operator() (const point3d_t &pt) const
+{
+	return basisDispatch(*this, nGen, pt);
+}
+
+template<class N> PFLOAT hybridMFractal_t::loop(const N &ng, const point3d_t &pt) const
 {
 	PFLOAT pwHL = pow(lacunarity, -H);
 	PFLOAT pwr = pwHL;	// starts with i=1 instead of 0
-	point3d_t tp(pt);
+	PFLOAT rmd = octaves - floor(octaves);
+	// the loop may stop early, some octaves of the last block are then wasted
+	octaves_t<N> oct(ng, pt, lacunarity, (int)octaves + (rmd!=(PFLOAT)0.0));
 
-	PFLOAT result = getSignedNoise(nGen, tp) + offset;
+	PFLOAT result = oct.nextSigned() + offset;
 	PFLOAT weight = gain * result;
-	tp *= lacunarity;
 
 	for (int i=1; (weight>(PFLOAT)0.001) && (i<(int)octaves); i++) {
 		if (weight>(PFLOAT)1.0)  weight=(PFLOAT)1.0;
-		PFLOAT signal = (getSignedNoise(nGen, tp) + offset) * pwr;
+		PFLOAT signal = (oct.nextSigned() + offset) * pwr;
 		pwr *= pwHL;
 		result += weight * signal;
 		weight *= gain * signal;
-		tp *= lacunarity;
 	}
 
-	PFLOAT rmd = octaves - floor(octaves);
-	if (rmd!=(PFLOAT)0.0) result += rmd * ((getSignedNoise(nGen, tp) + offset) * pwr);
+	if (rmd!=(PFLOAT)0.0) result += rmd * ((oct.nextSigned() + offset) * pwr);
 
 	return result;
 
@@ -766,21 +1033,25 @@ PFLOAT hybridMFractal_t::operator() (const point3d_t &pt) const
  *      gain:        2.0
  */
 PFLOAT ridgedMFractal_t::operator() (const point3d_t &pt) const
+{
+	return basisDispatch(*this, nGen, pt);
+}
+
+template<class N> PFLOAT ridgedMFractal_t::loop(const N &ng, const point3d_t &pt) const
 {
 	PFLOAT pwHL = pow(lacunarity, -H);
 	PFLOAT pwr = pwHL;	// starts with i=1 instead of 0
-	point3d_t tp(pt);
+	octaves_t<N> oct(ng, pt, lacunarity, (int)octaves);
 
-	PFLOAT signal = offset - fabs(getSignedNoise(nGen, tp));
+	PFLOAT signal = offset - fabs(oct.nextSigned());
 	signal *= signal;
 	PFLOAT result = signal;
 	PFLOAT weight = 1.0;
 
 	for(int i=1; i<(int)octaves; i++ ) {
-		tp *= lacunarity;
 		weight = signal * gain;
 		if (weight>(PFLOAT)1.0) weight=(PFLOAT)1.0; else if (weight<(PFLOAT)0.0) weight=(PFLOAT)0.0;
-		signal = offset - fabs(getSignedNoise(nGen, tp));
+		signal = offset - fabs(oct.nextSigned());
 		signal *= signal;
 		signal *= weight;
 		result += signal * pwr;
@@ -805,16 +1076,28 @@ colorA_t cellNoiseColor(const point3d_t &pt)
 }
 
 // turbulence function used by basic blocks
+struct turbulence_t
+{
+	turbulence_t(int o, bool h): oct(o), hard(h) {}
+	template<class N> PFLOAT loop(const N &ng, const point3d_t &tp) const
+	{
+		PFLOAT val, amp=1, sum=0;
+		octaves_t<N> octs(ng, tp, 2.0, oct+1);
+		for (int i=0;i<=oct;i++, amp*=0.5) {
+			val = octs.next();
+			if (hard) val = fabs(2.0*val-1.0);
+			sum += amp*val;
+		}
+		return sum;
+	}
+	int oct;
+	bool hard;
+};
+
 CFLOAT turbulence(const noiseGenerator_t* ngen, const point3d_t &pt, int oct, PFLOAT size, bool hard)
 {
-	PFLOAT val, amp=1, sum=0;
 	point3d_t tp = ngen->offset(pt)*size;	// only blendernoise adds offset
-	for (int i=0;i<=oct;i++, amp*=0.5, tp*=2.0) {
-		val = (*ngen)(tp);
-		if (hard) val = fabs(2.0*val-1.0);
-		sum += amp*val;
-	}
-	
+	PFLOAT sum = basisDispatch(turbulence_t(oct, hard), ngen, tp);
 	return sum*((PFLOAT)(1<<oct)/(PFLOAT)((1<<(oct+1))-1));
 }
 
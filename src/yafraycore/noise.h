@@ -14,11 +14,18 @@ __BEGIN_YAFRAY
 class YAFRAYCORE_EXPORT noiseGenerator_t
 {
 public:
-	noiseGenerator_t() {}
+	// bases the fractal loops have a specialized version for
+	enum basisType {N_GENERIC, N_NEWPERLIN, N_STDPERLIN, N_BLENDER};
+	noiseGenerator_t(basisType b=N_GENERIC): basis(b) {}
 	virtual ~noiseGenerator_t() {}
 	virtual PFLOAT operator() (const point3d_t &pt) const=0;
+	// evaluates n points at once, the default just loops over operator()
+	virtual void evaluate(const point3d_t *pt, PFLOAT *res, int n) const;
 	// offset only added by blendernoise
 	virtual point3d_t offset(const point3d_t &pt) const { return pt; }
+	basisType getBasis() const { return basis; }
+protected:
+	basisType basis;
 };
 
 //---------------------------------------------------------------------------
@@ -26,9 +33,13 @@ public:
 class YAFRAYCORE_EXPORT newPerlin_t : public noiseGenerator_t
 {
 public:
-	newPerlin_t() {}
+	newPerlin_t(): noiseGenerator_t(N_NEWPERLIN) {}
 	virtual ~newPerlin_t() {}
-	virtual PFLOAT operator() (const point3d_t &pt) const;
+	virtual PFLOAT operator() (const point3d_t &pt) const { return eval(pt); }
+	virtual void evaluate(const point3d_t *pt, PFLOAT *res, int n) const;
+	// non virtual versions, the 4 point one uses SSE2 when available
+	PFLOAT eval(const point3d_t &pt) const;
+	void eval4(const point3d_t *pt, PFLOAT *res) const;
 private:
 	PFLOAT fade(PFLOAT t) const { return t*t*t*(t*(t*6 - 15) + 10); }
 	PFLOAT grad(int hash, PFLOAT x, PFLOAT y, PFLOAT z) const
@@ -45,18 +56,24 @@ private:
 class YAFRAYCORE_EXPORT stdPerlin_t : public noiseGenerator_t
 {
 public:
-	stdPerlin_t() {}
+	stdPerlin_t(): noiseGenerator_t(N_STDPERLIN) {}
 	virtual ~stdPerlin_t() {}
-	virtual PFLOAT operator() (const point3d_t &pt) const;
+	virtual PFLOAT operator() (const point3d_t &pt) const { return eval(pt); }
+	PFLOAT eval(const point3d_t &pt) const;
+	void eval4(const point3d_t *pt, PFLOAT *res) const
+	{ for (int i=0;i<4;i++) res[i] = eval(pt[i]); }
 };
 
 // Blender noise, similar to Perlin's
 class YAFRAYCORE_EXPORT blenderNoise_t : public noiseGenerator_t
 {
 public:
-	blenderNoise_t() {}
+	blenderNoise_t(): noiseGenerator_t(N_BLENDER) {}
 	virtual ~blenderNoise_t() {}
-	virtual PFLOAT operator() (const point3d_t &pt) const;
+	virtual PFLOAT operator() (const point3d_t &pt) const { return eval(pt); }
+	virtual void evaluate(const point3d_t *pt, PFLOAT *res, int n) const;
+	PFLOAT eval(const point3d_t &pt) const;
+	void eval4(const point3d_t *pt, PFLOAT *res) const;
 	// offset texture point coordinates by one
 	virtual point3d_t offset(const point3d_t &pt) const { return pt+point3d_t(1.0, 1.0, 1.0); }
 };
@@ -147,6 +164,8 @@ public:
 	void getFeatures(const point3d_t &pt) const;
 	void setDistM(dMetricType dm);
 protected:
+	// the search loop instanced per metric, avoids a virtual call per cell
+	template<class D> void features(const point3d_t &pt) const;
 	voronoiType vType;
 	dMetricType dmType;
 	PFLOAT mk_exp, w1, w2, w3,w4;
@@ -182,6 +201,8 @@ public:
 			: H(_H), lacunarity(_lacu), octaves(_octs), nGen(_nGen) {}
 	virtual ~fBm_t() {}
 	virtual PFLOAT operator() (const point3d_t &pt) const;
+	// the octave loop, instanced per noise basis
+	template<class N> PFLOAT loop(const N &ng, const point3d_t &pt) const;
 protected:
 	PFLOAT H, lacunarity, octaves;
 	const noiseGenerator_t* nGen;
@@ -194,6 +215,7 @@ public:
 			: H(_H), lacunarity(_lacu), octaves(_octs), nGen(_nGen) {}
 	virtual ~mFractal_t() {}
 	virtual PFLOAT operator() (const point3d_t &pt) const;
+	template<class N> PFLOAT loop(const N &ng, const point3d_t &pt) const;
 protected:
 	PFLOAT H, lacunarity, octaves;
 	const noiseGenerator_t* nGen;
@@ -206,6 +228,7 @@ public:
 			: H(_H), lacunarity(_lacu), octaves(_octs), offset(_offs), nGen(_nGen) {}
 	virtual ~heteroTerrain_t() {}
 	virtual PFLOAT operator() (const point3d_t &pt) const;
+	template<class N> PFLOAT loop(const N &ng, const point3d_t &pt) const;
 protected:
 	PFLOAT H, lacunarity, octaves, offset;
 	const noiseGenerator_t* nGen;
@@ -218,6 +241,7 @@ public:
 			: H(_H), lacunarity(_lacu), octaves(_octs), offset(_offs), gain(_gain), nGen(_nGen) {}
 	virtual ~hybridMFractal_t() {}
 	virtual PFLOAT operator() (const point3d_t &pt) const;
+	template<class N> PFLOAT loop(const N &ng, const point3d_t &pt) const;
 protected:
 	PFLOAT H, lacunarity, octaves, offset, gain;
 	const noiseGenerator_t* nGen;
@@ -230,6 +254,7 @@ public:
 			: H(_H), lacunarity(_lacu), octaves(_octs), offset(_offs), gain(_gain), nGen(_nGen) {}
 	virtual ~ridgedMFractal_t() {}
 	virtual PFLOAT operator() (const point3d_t &pt) const;
+	template<class N> PFLOAT loop(const N &ng, const point3d_t &pt) const;
 protected:
 	PFLOAT H, lacunarity, octaves, offset, gain;
 	const noiseGenerator_t* nGen;
@@ -33,6 +33,7 @@ __END_YAFRAY
 #include "surface.h"
 #include "shader.h"
 #include "bound.h"
+#include <map>
 //#include "spectrum.h"
 
 __BEGIN_YAFRAY
@@ -63,8 +64,18 @@ class YAFRAYCORE_EXPORT object3d_t
 		virtual bool shoot(renderState_t &state,surfacePoint_t &where, const point3d_t &from,
 				const vector3d_t &ray,bool shadow=false,PFLOAT dis=-1)const=0;
 		virtual bound_t getBound() const =0;
+		/// builds what shoot() needs, called by the scene before rendering
+		virtual void prepare() {};
+		/// amount of work left to prepare(), larger objects are started first
+		virtual int prepareCost() const {return 0;};
 		void setShader(shader_t *shad) {shader=shad;};
 		shader_t *getShader() const {return shader;};
+		/// changes the shaders found in m for the ones they map to
+		virtual void replaceShaders(const std::map<const shader_t *,shader_t *> &m)
+		{
+			std::map<const shader_t *,shader_t *>::const_iterator i=m.find(shader);
+			if(i!=m.end()) shader=i->second;
+		};
 		bool useForRadiosity() const  {return radiosity;};
 		void useForRadiosity(bool r) {radiosity=r;};
 		bool reciveRadiosity() const  {return rad_pasive;};
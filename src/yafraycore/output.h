@@ -26,6 +26,8 @@
 #include<config.h>
 #endif
 
+#include <vector>
+#include <string>
 #include "color.h"
 
 __BEGIN_YAFRAY
@@ -36,6 +38,34 @@ class YAFRAYCORE_EXPORT colorOutput_t
 		virtual bool putPixel(int x, int y,const color_t &c, 
 				CFLOAT alpha=0,PFLOAT depth=0)=0;
 		virtual void flush()=0;
+		/// names of the AOV planes putAOVs() will get, told before the render
+		virtual void setAOVs(const std::vector<std::string> &names)
+		{
+			std::cout<<"[WARNING]: The output can't save AOVs, they are lost\n";
+		};
+		virtual bool putAOVs(int x, int y, const color_t *planes) {return true;};
+};
+
+/// how far a render is, told after every area
+struct renderProgress_t
+{
+	/// "fake", "refine", "preview", "progressive" or "render"
+	std::string pass;
+	/// areas finished and total of the pass
+	int done, total;
+	/// camera samples and rays traced since the render started
+	double samples, rays;
+	/// seconds since the render started, and guessed to the end of the pass (negative if unknown)
+	double elapsed, eta;
+};
+
+/** Gets the progress of the renders. It is called from the thread calling
+ * render, the areas are rendered meanwhile */
+class YAFRAYCORE_EXPORT progressOutput_t
+{
+	public:
+		virtual ~progressOutput_t() {};
+		virtual void progress(const renderProgress_t &p)=0;
 };
 
 __END_YAFRAY
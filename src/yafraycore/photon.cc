@@ -36,44 +36,6 @@ void runningPhoton_t::position(const point3d_t &_pos,PFLOAT bias)
 }
 
 
-// BEGIN OF FUNCTIONS FOR THE TEMPLATED BINARY TREE BUILD FUNTION
-//
-// --------------------------------------------------------------
-
-static bound_t global_photon_calc_bound(const vector<const storedPhoton_t *> &v)
-{
-	int size=v.size();
-	if(size==0) return bound_t(point3d_t(),point3d_t());
-	PFLOAT maxx,maxy,maxz,minx,miny,minz;
-	maxx=minx=v[0]->position().x;
-	maxy=miny=v[0]->position().y;
-	maxz=minz=v[0]->position().z;
-	for(int i=0;i<size;++i)
-	{
-		const point3d_t &p=v[i]->position();
-		if(p.x>maxx) maxx=p.x;
-		if(p.y>maxy) maxy=p.y;
-		if(p.z>maxz) maxz=p.z;
-		if(p.x<minx) minx=p.x;
-		if(p.y<miny) miny=p.y;
-		if(p.z<minz) minz=p.z;
-	}
-	return bound_t(point3d_t(minx,miny,minz),point3d_t(maxx,maxy,maxz));
-}
-
-static bool global_photon_is_in_bound(const storedPhoton_t * const & p,bound_t &b)
-{
-	return b.includes(p->position());
-}
-
-static point3d_t global_photon_get_pos(const storedPhoton_t * const & p)
-{
-	return p->position();
-}
-
-// END OF FUNCTIONS FOR THE TEMPLATED BINARY TREE BUILD FUNTION
-//
-// --------------------------------------------------------------
 /*
 void globalPhotonMap_t::store(const runningPhoton_t &p,const vector3d_t &N) 
 {
@@ -95,13 +57,12 @@ void globalPhotonMap_t::store(const runningPhoton_t &p,const vector3d_t &N)
 }
 */
 
-globalPhotonMap_t::globalPhotonMap_t(PFLOAT r):maxradius(r),tree(NULL)
+globalPhotonMap_t::globalPhotonMap_t(PFLOAT r):maxradius(r)
 {
 }
 
 globalPhotonMap_t::~globalPhotonMap_t()
 {
-	if(tree) delete tree;
 }
 
 void globalPhotonMap_t::store(const storedPhoton_t &p)
@@ -109,7 +70,7 @@ void globalPhotonMap_t::store(const storedPhoton_t &p)
 	photons.push_back(p);
 }
 
-void globalPhotonMap_t::buildTree()
+void globalPhotonMap_t::buildTree(int threads)
 {
 	/*
 	photons.clear();
@@ -128,9 +89,7 @@ void globalPhotonMap_t::buildTree()
 	for(unsigned int i=0;i<photons.size();++i)
 		lpho[i]=&photons[i];
 
-	if(tree!=NULL) delete tree;
-	tree=buildGenericTree(lpho,global_photon_calc_bound,global_photon_is_in_bound,
-				global_photon_get_pos,8);
+	tree.build(lpho,8,0,threads);
 
 }
 
@@ -178,7 +137,7 @@ void globalPhotonMap_t::gather(const point3d_t &P,const vector3d_t &N,
 		//found.clear();
 		found.resize(0);
 		searchCircle_t circle(P,radius);
-		for(gObjectIterator_t<const storedPhoton_t *,searchCircle_t,circleCross_f> 
+		for(pointTreeIterator_t<const storedPhoton_t *,photonPos_f,searchCircle_t,circleCross_f> 
 				i(tree,circle);!i;++i)
 		{
 			vector3d_t sep=(*i)->position()-P;
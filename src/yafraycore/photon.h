@@ -9,6 +9,7 @@
 #include "hash3d.h"
 #include "params.h"
 #include "scene.h"
+#include "pointtree.h"
 
 __BEGIN_YAFRAY
 
@@ -118,6 +119,12 @@ struct foundPhoton_t
 };
 
 
+/// position of a photon in the tree of the map
+struct photonPos_f
+{
+	const point3d_t & operator()(const storedPhoton_t *p)const {return p->position();};
+};
+
 class YAFRAYCORE_EXPORT globalPhotonMap_t
 {
 	public:
@@ -130,7 +137,7 @@ class YAFRAYCORE_EXPORT globalPhotonMap_t
 
 		//void store(const runningPhoton_t &p,const vector3d_t &N);
 		void store(const storedPhoton_t &p);
-		void buildTree();
+		void buildTree(int threads=1);
 
 		void gather(const point3d_t &P,const vector3d_t &N,
 				std::vector<foundPhoton_t> &found,
@@ -149,7 +156,7 @@ class YAFRAYCORE_EXPORT globalPhotonMap_t
 		PFLOAT maxradius;
 		//hash3d_t<storedPhoton_t> hash;
 		std::vector<storedPhoton_t> photons;
-		gBoundTreeNode_t<const storedPhoton_t *> *tree;
+		pointTree_t<const storedPhoton_t *,photonPos_f> tree;
 };
 
 
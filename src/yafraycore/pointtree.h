@@ -0,0 +1,208 @@
+/****************************************************************************
+ *
+ * 			pointtree.h: spatial index of points built in place
+ *      This is part of the yafray package
+ *
+ *      This library is free software; you can redistribute it and/or
+ *      modify it under the terms of the GNU Lesser General Public
+ *      License as published by the Free Software Foundation; either
+ *      version 2.1 of the License, or (at your option) any later version.
+ *
+ *      This library is distributed in the hope that it will be useful,
+ *      but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *      MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *      Lesser General Public License for more details.
+ *
+ *      You should have received a copy of the GNU Lesser General Public
+ *      License along with this library; if not, write to the Free Software
+ *      Foundation,Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+ *
+ */
+#ifndef __POINTTREE_H
+#define __POINTTREE_H
+
+#ifdef HAVE_CONFIG_H
+#include<config.h>
+#endif
+
+#include <vector>
+#include <algorithm>
+#include "bound.h"
+#include "ccthreads.h"
+
+__BEGIN_YAFRAY
+
+/** Spatial index of elements with a position
+ *
+ * POS is a functor giving the position of an element. The elements are
+ * copied once and sorted in place: every node splits its range at the
+ * median of its longest axis with nth_element. Nodes are kept flat in
+ * depth first order, the left child of a node just after it, and the size
+ * of a subtree only depends on its element count, so subtrees can be built
+ * by different threads on their own part of the arrays.
+ *
+ * Bounds of the nodes are grown by grow, for elements that reach that far
+ * around their position.
+ *
+ */
+template<class T,class POS>
+class pointTree_t
+{
+	public:
+		struct node_t
+		{
+			bound_t bound;
+			// index of the right child, 0 for leaves
+			int right;
+			// elements of a leaf
+			int begin, end;
+		};
+
+		pointTree_t(): leaf(1) {};
+		/// builds the tree of v, leaves with at most leafsize elements
+		void build(const std::vector<T> &v,int leafsize=1,PFLOAT grow=0,int threads=1);
+		void clear() {items.clear(); nodes.clear();};
+		bool empty()const {return nodes.empty();};
+
+		std::vector<T> items;
+		std::vector<node_t> nodes;
+	protected:
+		int countNodes(int n)const
+		{
+			return (n<=leaf) ? 1 : 1+countNodes(n/2)+countNodes(n-n/2);
+		};
+		void buildNode(int node,int begin,int end,int threads);
+
+		struct axisLess_f
+		{
+			axisLess_f(int a): axis(a) {};
+			bool operator()(const T &a,const T &b)const
+			{
+				POS pos;
+				return pos(a)[axis]<pos(b)[axis];
+			}
+			int axis;
+		};
+#if HAVE_PTHREAD
+		struct builder_t;
+		friend struct builder_t;
+		struct builder_t : public yafthreads::thread_t
+		{
+			builder_t(pointTree_t<T,POS> &t,int n,int b,int e,int th)
+				: tree(t), node(n), begin(b), end(e), threads(th) {};
+			virtual void body() {tree.buildNode(node,begin,end,threads);};
+			pointTree_t<T,POS> &tree;
+			int node, begin, end, threads;
+		};
+#endif
+		int leaf;
+		PFLOAT margin;
+};
+
+template<class T,class POS>
+void pointTree_t<T,POS>::build(const std::vector<T> &v,int leafsize,PFLOAT grow,int threads)
+{
+	leaf=(leafsize<1) ? 1 : leafsize;
+	margin=grow;
+	items=v;
+	nodes.clear();
+	if (items.empty()) return;
+	nodes.resize(countNodes(items.size()));
+	buildNode(0,0,items.size(),threads);
+}
+
+template<class T,class POS>
+void pointTree_t<T,POS>::buildNode(int node,int begin,int end,int threads)
+{
+	node_t &n=nodes[node];
+	POS pos;
+	point3d_t a=pos(items[begin]), g=a;
+	for(int i=begin+1;i<end;++i)
+	{
+		const point3d_t &p=pos(items[i]);
+		a.x=std::min(a.x,p.x);  g.x=std::max(g.x,p.x);
+		a.y=std::min(a.y,p.y);  g.y=std::max(g.y,p.y);
+		a.z=std::min(a.z,p.z);  g.z=std::max(g.z,p.z);
+	}
+	n.bound.set(a,g);
+	n.bound.grow(margin);
+	n.begin=begin;
+	n.end=end;
+	if ((end-begin)<=leaf)
+	{
+		n.right=0;
+		return;
+	}
+	int axis=0;
+	if ((g.y-a.y)>(g.x-a.x)) axis=1;
+	if ((g.z-a.z)>(g[axis]-a[axis])) axis=2;
+	int mid=begin+(end-begin)/2;
+	std::nth_element(items.begin()+begin,items.begin()+mid,items.begin()+end,
+			axisLess_f(axis));
+	n.right=node+1+countNodes(mid-begin);
+#if HAVE_PTHREAD
+	if (threads>1)
+	{
+		builder_t left(*this,node+1,begin,mid,threads/2);
+		left.run();
+		buildNode(n.right,mid,end,threads-threads/2);
+		left.wait();
+		return;
+	}
+#endif
+	buildNode(node+1,begin,mid,1);
+	buildNode(n.right,mid,end,1);
+}
+
+#define POINTTREE_STACK 64
+
+/** Iterates over the elements of the leaves crossed
+ *
+ * CROSS tells if the query d reaches a bound. Nodes waiting to be visited
+ * are kept in a fixed stack, never deeper than the tree.
+ *
+ */
+template<class T,class POS,class D,class CROSS>
+class pointTreeIterator_t
+{
+	public:
+		pointTreeIterator_t(const pointTree_t<T,POS> &t,const D &d)
+			: tree(t), dir(d), top(0), cur(0), last(0)
+		{
+			if (!tree.empty()) stack[top++]=0;
+			nextLeaf();
+		};
+		bool operator ! ()const {return cur<last;};
+		const T & operator * ()const {return tree.items[cur];};
+		void operator ++ () {if (++cur>=last) nextLeaf();};
+		void operator ++ (int) {++(*this);};
+	protected:
+		void nextLeaf()
+		{
+			while (top>0)
+			{
+				int i=stack[--top];
+				const typename pointTree_t<T,POS>::node_t &n=tree.nodes[i];
+				if (!cross(dir,n.bound)) continue;
+				if (n.right==0)
+				{
+					cur=n.begin;
+					last=n.end;
+					return;
+				}
+				stack[top++]=n.right;
+				stack[top++]=i+1;
+			}
+			cur=last=0;
+		};
+
+		const pointTree_t<T,POS> &tree;
+		const D &dir;
+		CROSS cross;
+		int stack[POINTTREE_STACK];
+		int top, cur, last;
+};
+
+__END_YAFRAY
+
+#endif
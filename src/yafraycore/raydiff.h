@@ -0,0 +1,134 @@
+/****************************************************************************
+ *
+ * 			raydiff.h: Ray differentials api
+ *      This is part of the yafray package
+ *
+ *      This library is free software; you can redistribute it and/or
+ *      modify it under the terms of the GNU Lesser General Public
+ *      License as published by the Free Software Foundation; either
+ *      version 2.1 of the License, or (at your option) any later version.
+ *
+ *      This library is distributed in the hope that it will be useful,
+ *      but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *      MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *      Lesser General Public License for more details.
+ *
+ *      You should have received a copy of the GNU Lesser General Public
+ *      License along with this library; if not, write to the Free Software
+ *      Foundation,Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+ *
+ */
+#ifndef __RAYDIFF_H
+#define __RAYDIFF_H
+
+#ifdef HAVE_CONFIG_H
+#include<config.h>
+#endif
+
+#include "vector3d.h"
+
+__BEGIN_YAFRAY
+
+/** Ray differentials
+ *
+ * Derivatives of the ray position and direction with respect to the
+ * image x & y, following Igehy, "Tracing Ray Differentials".
+ * The camera creates them, transfer() moves them to a hit point and
+ * bounce() carries them to the reflected or refracted ray leaving it.
+ * Other rays, diffuse or glossy, spread much more than a mirror would,
+ * specular() tells them apart so they can drop the differentials.
+ * Derivatives of the normal are not tracked, so curved mirrors spread
+ * less than they should.
+ *
+ */
+struct YAFRAYCORE_EXPORT rayDifferentials_t
+{
+	rayDifferentials_t():valid(false), atHit(false) {};
+
+	/// derivatives of the normalized direction, from those of the unnormalized r
+	void setDirection(const vector3d_t &r, const vector3d_t &drdx, const vector3d_t &drdy)
+	{
+		PFLOAT rr = r*r;
+		PFLOAT il = 1.0/sqrt(rr), il3 = il/rr;
+		D = r*il;
+		dDdx = drdx*il - r*((r*drdx)*il3);
+		dDdy = drdy*il - r*((r*drdy)*il3);
+	}
+
+	/// moves the differentials along D by t, to the plane with normal n, s the shading normal there
+	void transfer(PFLOAT t, const vector3d_t &n, const vector3d_t &s)
+	{
+		dPdx += dDdx*t;
+		dPdy += dDdy*t;
+		PFLOAT dn = D*n;
+		if (fabs(dn)>1e-6)
+		{
+			dPdx -= D*((dPdx*n)/dn);
+			dPdy -= D*((dPdy*n)/dn);
+		}
+		N = n;
+		S = s;
+		atHit = true;
+	}
+
+	/// whether R leaving the hit is a mirror reflection or a refraction of D
+	bool specular(const vector3d_t &R) const
+	{
+		if ((R*D)>0.9999) return true;	// passing through
+		return specularAbout(R, N) || specularAbout(R, S);
+	}
+
+	/// differentials of ray R leaving the hit point, reflected or refracted
+	void bounce(const vector3d_t &R)
+	{
+		// normal facing the incoming ray
+		vector3d_t n = ((D*N)>0) ? -N : N;
+		PFLOAT dDNx = dDdx*n, dDNy = dDdy*n;
+		PFLOAT Rn = R*n;
+		if (Rn>=0)
+		{
+			dDdx -= n*(2*dDNx);
+			dDdy -= n*(2*dDNy);
+		}
+		else
+		{
+			// relative ior from the bending of the ray itself
+			PFLOAT sini = (D^n).length(), sint = (R^n).length();
+			PFLOAT eta = (sini>1e-6) ? (sint/sini) : 1.0;
+			PFLOAT dmu = eta - eta*eta*(D*n)/Rn;
+			dDdx = dDdx*eta - n*(dmu*dDNx);
+			dDdy = dDdy*eta - n*(dmu*dDNy);
+		}
+		D = R;
+		atHit = false;
+	}
+
+	/// width of the footprint, the larger of the two position derivatives
+	PFLOAT footprint() const
+	{
+		PFLOAT x = dPdx*dPdx, y = dPdy*dPdy;
+		return sqrt((x>y) ? x : y);
+	}
+
+	/// R reflected about m, or refracted: in the plane of D and m, across it
+	bool specularAbout(const vector3d_t &R, const vector3d_t &m) const
+	{
+		vector3d_t n = ((D*m)>0) ? -m : m;
+		PFLOAT Dn = D*n;
+		if ((R*(D-n*(2*Dn)))>0.9999) return true;
+		if ((R*n)>=0) return false;
+		vector3d_t a = D^n, b = R^n;
+		PFLOAT ab = a*b, aa = a*a, bb = b*b;
+		return (ab>0) && (ab*ab>0.9998*aa*bb);
+	}
+
+	bool valid;
+	// true after transfer(), N and S are then the normals at the hit
+	bool atHit;
+	vector3d_t D, N, S;
+	vector3d_t dPdx, dPdy, dDdx, dDdy;
+};
+
+__END_YAFRAY
+
+#endif
@@ -12,10 +12,14 @@ bool renderArea_t::out(colorOutput_t &o)
 	startY=realY-Y;
 	for(int x=0;x<realW;++x)
 		for(int y=0;y<realH;++y)
+		{
 			if(!o.putPixel(realX+x, realY+y,
 				image[(startY+y)*W+startX+x], image[(startY+y)*W+startX+x].getA(), 
 				depth[(startY+y)*W+startX+x]))
 				return false;
+			if(nplanes && !o.putAOVs(realX+x, realY+y, &planes[((startY+y)*W+startX+x)*nplanes]))
+				return false;
+		}
 	return true;
 }
 
@@ -68,7 +72,7 @@ bool renderArea_t::checkResample(CFLOAT threshold)
 	return need;
 }
 
-blockSpliter_t::blockSpliter_t(int w,int h,int b):
+blockSpliter_t::blockSpliter_t(int w,int h,int b,const vector<bool> *mask):
 width(w),height(h),block(b)
 {
 	int bw=width/b;
@@ -76,14 +80,12 @@ width(w),height(h),block(b)
 	if(width%b) bw++;
 	if(height%b) bh++;
 
-	regions.resize(bh*bw);
-	vector<int> scram(bh*bw);
-	for(int i=0;i<(bh*bw);++i) scram[i]=i;
-	for(int i=0;i<(bh*bw);++i) swap(scram[i],scram[rand()%(bh*bw)]);
-	int sec=0;
+	vector<region_t> kept;
+	kept.reserve(bh*bw);
 	for(int i=0;i<bh;++i)
 		for(int j=0;j<bw;++j)
 		{
+			if(mask && !(*mask)[i*bw+j]) continue;
 			region_t region;
 			region.x=region.rx=j*block;
 			region.y=region.ry=i*block;
@@ -95,9 +97,14 @@ width(w),height(h),block(b)
 			if(region.y>0) {region.y--;region.h++;}
 			if((region.x+region.w)<(width-1)) region.w++;
 			if((region.y+region.h)<(height-1)) region.h++;
-			regions[scram[sec]]=region;
-			sec++;
+			kept.push_back(region);
 		}
+	int n=kept.size();
+	regions.resize(n);
+	vector<int> scram(n);
+	for(int i=0;i<n;++i) scram[i]=i;
+	for(int i=0;i<n;++i) swap(scram[i],scram[rand()%n]);
+	for(int i=0;i<n;++i) regions[scram[i]]=kept[i];
 }
 
 void blockSpliter_t::getArea(renderArea_t &area)
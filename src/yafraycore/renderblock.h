@@ -14,9 +14,10 @@ __BEGIN_YAFRAY
 struct renderArea_t
 {
 	renderArea_t(int x,int y,int w,int h):X(x),Y(y),W(w),H(h),
-		realX(x),realY(y),realW(w),realH(h),image(w*h),depth(w*h),resample(w*h),fake(false)
+		realX(x),realY(y),realW(w),realH(h),image(w*h),depth(w*h),resample(w*h),nplanes(0),fake(false),
+		samples(0),rays(0)
 	{};
-	renderArea_t():fake(false) {};
+	renderArea_t():nplanes(0),fake(false),samples(0),rays(0) {};
 
 	void set(int x,int y,int w,int h)
 	{
@@ -38,22 +39,66 @@ struct renderArea_t
 	bool checkResample(CFLOAT threshold);
 	bool out(colorOutput_t &o);
 
+	/// running statistics for adaptive sampling, the first sample already in image
+	void startStats()
+	{
+		m2.assign(W*H,0);
+		nsamples.assign(W*H,1);
+	}
+	/// adds a sample to the mean in image and to the variance of its brightness
+	void addSample(int k,const colorA_t &c,const color_t *aovs=NULL)
+	{
+		CFLOAT n=++nsamples[k];
+		CFLOAT d=c.col2bri()-image[k].col2bri();
+		image[k]+=(c-image[k])*(1.0/n);
+		m2[k]+=d*(c.col2bri()-image[k].col2bri());
+		if(aovs)
+			for(int p=0;p<nplanes;++p)
+				planes[k*nplanes+p]+=(aovs[p]-planes[k*nplanes+p])*(1.0/n);
+	}
+
+	/// room for n planes of AOVs per pixel
+	void setPlanes(int n)
+	{
+		nplanes=n;
+		planes.assign(W*H*n,color_t(0.0));
+	}
+	/** Half width of the 95% confidence interval of the brightness, relative
+	 * to it. Below 0.1 the error is taken as absolute, noise in the dark
+	 * can't be seen. */
+	CFLOAT relativeError(int k)const
+	{
+		int n=nsamples[k];
+		if(n<2) return 0;
+		CFLOAT se=sqrt(m2[k]/(CFLOAT)(n*(n-1)));
+		CFLOAT b=image[k].col2bri();
+		return 1.96*se/((b>0.1) ? b : 0.1);
+	}
+
 	colorA_t & imagePixel(int x,int y) {return image[(y-Y)*W+(x-X)];};
 	PFLOAT & depthPixel(int x,int y)   {return depth[(y-Y)*W+(x-X)];};
 	bool  resamplePixel(int x,int y)  {return resample[(y-Y)*W+(x-X)];};
+	color_t * planePixel(int x,int y)  {return &planes[((y-Y)*W+(x-X))*nplanes];};
 
 	int X,Y,W,H,realX,realY,realW,realH;
 	std::vector<colorA_t> image;
 	std::vector<PFLOAT> depth;
 	std::vector<bool> resample;
+	std::vector<CFLOAT> m2;
+	std::vector<int> nsamples;
+	int nplanes;
+	std::vector<color_t> planes;
 	bool fake;
+	// camera samples and rays traced the last time it was rendered
+	unsigned int samples, rays;
 };
 
 
 class blockSpliter_t
 {
 	public:
-		blockSpliter_t(int w,int h,int b);
+		/// with a mask, only the blocks set in it (row by row) are given
+		blockSpliter_t(int w,int h,int b,const std::vector<bool> *mask=NULL);
 		
 		void getArea(renderArea_t &area);
 
@@ -25,6 +25,8 @@
 #include <cstdio>
 #include <cstdlib>
 #include<fstream>
+#include<algorithm>
+#include<functional>
 #include "ipc.h"
 #include "renderblock.h"
 #include "geometree.h"
@@ -39,7 +41,7 @@ int pcount;
 
 renderState_t::renderState_t() :raylevel(0),depth(0),contribution(1.0),/*lastobject(NULL)
 	,lastobjectelement(NULL),*/ skipelement(NULL),currentPass(0),rayDivision(1),traveled(0)
-	,pixelNumber(0), chromatic(true), cur_ior(1)
+	,pixelNumber(0), chromatic(true), cur_ior(1), samples(0), rays(0)
 {
 }
 
@@ -59,7 +61,15 @@ scene_t::scene_t()
 	radio_light=NULL;
 	BTree=NULL;
 	background=NULL;
-	repeatFirst=false;
+	repeatFirst=repeatAll=false;
+	AA_noise=0;
+	progressive=false;
+	progressive_time=0;
+	preview=cancelled=false;
+	deterministic=false;
+	monitor=NULL;
+	render_start=samples_done=rays_done=0;
+	aov_mask=0;
 	scymin=scxmin=-2;
 	scymax=scxmax=2;
 	alpha_maskbackground = alpha_premultiply = false;
@@ -84,6 +94,7 @@ void scene_t::addObject(object3d_t *obj)
 
 void scene_t::addLight(light_t *light) 
 {
+	light->sceneIndex(light_list.size());
 	light_list.push_back(light);
 }
 
@@ -92,6 +103,28 @@ void scene_t::addFilter(filter_t *filter)
 	filter_list.push_back(filter);
 }
 
+void scene_t::setRepeatFirst(PFLOAT sx,PFLOAT sy,PFLOAT radius)
+{
+	repeatFirst=true;
+	if(repeatAll) return;
+	int resx=render_camera->resX();
+	int resy=render_camera->resY();
+	int cw=(resx+REPEAT_CELL-1)/REPEAT_CELL;
+	int ch=(resy+REPEAT_CELL-1)/REPEAT_CELL;
+	if((int)repeatCells.size()!=(cw*ch)) repeatCells.assign(cw*ch,false);
+	// pixels are square, so the radius is the same in x & y
+	PFLOAT px=(sx+1.0)*0.5*resx, py=(1.0-sy)*0.5*resy, pr=radius*0.5*resx+1.0;
+	int x0=(int)floor(px-pr), x1=(int)floor(px+pr);
+	int y0=(int)floor(py-pr), y1=(int)floor(py+pr);
+	if(x0<0) x0=0;
+	if(y0<0) y0=0;
+	if(x1>=resx) x1=resx-1;
+	if(y1>=resy) y1=resy-1;
+	for(int i=y0/REPEAT_CELL;i<=y1/REPEAT_CELL;++i)
+		for(int j=x0/REPEAT_CELL;j<=x1/REPEAT_CELL;++j)
+			repeatCells[i*cw+j]=true;
+}
+
 void scene_t::publishVoidData(const std::string &key,const void *data)
 {
 	published[key]=data;
@@ -107,6 +140,7 @@ void scene_t::setCamera(camera_t *cam)
 bool scene_t::isShadowed(renderState_t &state,const surfacePoint_t &sp,
 		const point3d_t &l)const
 {
+	++state.rays;
 	point3d_t p=sp.P();
 	surfacePoint_t temp;
 	vector3d_t ray=(l-p);
@@ -135,19 +169,20 @@ bool scene_t::isShadowed(renderState_t &state,const surfacePoint_t &sp,
 
 			if(*ite==sp.getObject())
 			{
-				if((*ite)->shoot(state,temp,self,ray,true,dist)) {/*lasto=*ite;*/return true;}
+				if((*ite)->shoot(state,temp,self,ray,true,dist)) {/*lasto=*ite;*/return countShadow(state,true);}
 			}
 			else
-				if((*ite)->shoot(state,temp,p,ray,true,dist)) {/*lasto=*ite;*/return true;}
+				if((*ite)->shoot(state,temp,p,ray,true,dist)) {/*lasto=*ite;*/return countShadow(state,true);}
 		}
 	}
 	//lasto=NULL;
-	return false;
+	return countShadow(state,false);
 }
 
 bool scene_t::isShadowed(renderState_t &state,const surfacePoint_t &sp,
 		const vector3d_t &dir)const
 {
+	++state.rays;
 	point3d_t p=sp.P();
 	surfacePoint_t temp;
 	vector3d_t ray=dir;
@@ -174,14 +209,14 @@ bool scene_t::isShadowed(renderState_t &state,const surfacePoint_t &sp,
 		{
 			if(*ite==sp.getObject())
 			{
-				if((*ite)->shoot(state,temp,self,ray,true)) {/*lasto=*ite;*/return true;}
+				if((*ite)->shoot(state,temp,self,ray,true)) {/*lasto=*ite;*/return countShadow(state,true);}
 			}
 			else
-				if((*ite)->shoot(state,temp,p,ray,true)) {/*lasto=*ite;*/return true;}
+				if((*ite)->shoot(state,temp,p,ray,true)) {/*lasto=*ite;*/return countShadow(state,true);}
 		}
 	}
 	//lasto=NULL;
-	return false;
+	return countShadow(state,false);
 }
 
 // simple exponential fog
@@ -208,6 +243,19 @@ color_t scene_t::raytrace(renderState_t &state, const point3d_t &from, const vec
 		l_depth=-1;
 		return color_t(0,0,0);
 	}
+	++state.rays;
+	// differentials of this ray, from the ones at the point it leaves.
+	// Restored on return, the shader may trace more rays from the same point
+	rayDifferentials_t olddiff=state.raydiff;
+	rayDifferentials_t &diff=state.raydiff;
+	// only mirrors and refractions keep them, the rest filters by distance
+	if (diff.atHit)
+	{
+		if (diff.specular(ray)) diff.bounce(ray);
+		else diff.valid = false;
+	}
+	else if ((diff.D*ray)<0.9999)
+		diff.valid = false;	// not the camera ray they were made for
 	point3d_t f=from+ray*min_raydis;
 	surfacePoint_t sp,temp;
 	bool found=false;
@@ -238,15 +286,25 @@ color_t scene_t::raytrace(renderState_t &state, const point3d_t &from, const vec
 		eye.normalize();
 		PFLOAT oldtraveled = state.traveled;
 		state.traveled += sp.Z();
+		// pixel footprint at the hit, for texture filtering
+		if (diff.valid) {
+			diff.transfer((sp.P()-from).length(), sp.Ng(), sp.N());
+			sp.setDifferentials(diff.dPdx, diff.dPdy);
+			sp.setFilterWidth(diff.footprint());
+		}
+		else sp.setFilterWidth(state.traveled*world_resolution);
 		sp.getShader()->displace(state, sp, eye, world_resolution);
+		state.addAOV(AOV_NORMAL,color_t(sp.N().x,sp.N().y,sp.N().z));
 		color_t res=light(state,sp,from);
 		l_raylevel--;
 		l_depth = (from-sp.P()).length();
 		// add simple fog if enabled
 		fog_addToCol(l_depth, res);
 		state.traveled = oldtraveled;
+		state.raydiff = olddiff;
 		return res;
 	}
+	state.raydiff = olddiff;
 	l_raylevel--;
 	l_depth=-1;
 	// don't include background if alpha_maskbackground flag set (only primary rays)
@@ -265,17 +323,109 @@ color_t scene_t::light(renderState_t &state,const surfacePoint_t &sp,const point
 			return color_t(0,0,0);
 		color_t flights(0,0,0);
 		vector3d_t eye=from-sp.P();
+		aovState_t &aov=state.aov;
+		bool aovs=!indirect && aov.wanted && (state.raylevel==0);
 		for(list<light_t *>::const_iterator ite=light_list.begin();
 				ite!=light_list.end();++ite)
 		{
 			if(!indirect && !((*ite)->useInRender())) continue;
 			if(indirect && !((*ite)->useInIndirect())) continue;
-			flights+=(*ite)->illuminate(state,*this,sp,eye);
+			if(!aovs)
+			{
+				flights+=(*ite)->illuminate(state,*this,sp,eye);
+				continue;
+			}
+			aov.lightDiffuse.black();
+			aov.lightSpecular.black();
+			aov.direct=!(*ite)->isIndirect();
+			color_t col=(*ite)->illuminate(state,*this,sp,eye);
+			aov.direct=false;
+			if((*ite)->isIndirect()) state.addAOV(AOV_INDIRECT,col);
+			else splitLight(state,col);
+			flights+=col;
+		}
+		if(!indirect)
+		{
+			color_t col=sha->fromWorld(state,sp,*this,eye);
+			if(aovs) state.addAOV(AOV_REFLECT,col);
+			flights+=col;
 		}
-		if(!indirect) flights+=sha->fromWorld(state,sp,*this,eye);
 		return flights;
 }
 
+/* The shader tells the parts of the light it gave to diffuse and specular,
+ * but the light may average or scale what it got, so col is split in
+ * the same proportion. What the shader didn't tell of goes to diffuse.
+ */
+void scene_t::splitLight(renderState_t &state,const color_t &col)const
+{
+	const color_t &d=state.aov.lightDiffuse, &s=state.aov.lightSpecular;
+	CFLOAT c[3]={col.getR(), col.getG(), col.getB()};
+	CFLOAT dc[3]={d.getR(), d.getG(), d.getB()};
+	CFLOAT sc[3]={s.getR(), s.getG(), s.getB()};
+	for(int i=0;i<3;++i)
+	{
+		CFLOAT t=dc[i]+sc[i];
+		CFLOAT f=(t>0) ? c[i]/t : 0;
+		dc[i]=(t>0) ? dc[i]*f : c[i];
+		sc[i]*=f;
+	}
+	state.addAOV(AOV_DIFFUSE,color_t(dc));
+	state.addAOV(AOV_SPECULAR,color_t(sc));
+}
+
+// builds the objects, one object by block, largest first
+struct objectJob_t : public yafthreads::blockJob_t
+{
+	objectJob_t(const vector<pair<int,object3d_t *> > &o)
+		: objects(o), times(o.size(),0.0) {blocks=o.size();};
+	virtual void doBlock(int b)
+	{
+		double start=getTime();
+		objects[b].second->prepare();
+		times[b]=getTime()-start;
+	}
+	const vector<pair<int,object3d_t *> > &objects;
+	vector<double> times;
+};
+
+struct costGreater_f
+{
+	bool operator()(const pair<int,object3d_t *> &a,const pair<int,object3d_t *> &b)const
+	{
+		return a.first>b.first;
+	}
+};
+
+void scene_t::prepareObjects()
+{
+	vector<pair<int,object3d_t *> > objects;
+	for(list<object3d_t *>::iterator i=obj_list.begin();i!=obj_list.end();++i)
+	{
+		int cost=(*i)->prepareCost();
+		if(cost>0) objects.push_back(make_pair(cost,*i));
+	}
+	if(objects.empty()) return;
+	stable_sort(objects.begin(),objects.end(),costGreater_f());
+
+	int threads=max(cpus,1);
+	double start=getTime();
+	objectJob_t job(objects);
+	job.run(threads);
+	// one line for all of them, scenes can have thousands of objects
+	double total=0,slowest=0;
+	long faces=0;
+	for(unsigned int i=0;i<objects.size();++i)
+	{
+		faces+=objects[i].first;
+		total+=job.times[i];
+		slowest=max(slowest,job.times[i]);
+	}
+	cout<<"Built "<<objects.size()<<" object trees, "<<faces<<" faces, in "<<(getTime()-start)
+		<<"s with "<<threads<<" threads ("<<total<<"s of build, largest "<<objects[0].first
+		<<" faces, slowest "<<slowest<<"s)"<<endl;
+}
+
 void scene_t::setupLights()
 {
 	fprintf(stderr,"Setting up lights ...\n");
@@ -283,6 +433,7 @@ void scene_t::setupLights()
 			++ite)
 	{
 		(*ite)->init(*this);
+		(*ite)->sceneChanged(false);
 	}
 	fprintf(stderr,"Finished setting up lights\n");
 }
@@ -546,6 +697,10 @@ void scene_t::render(colorOutput_t &out)
 
 	renderArea_t area;
 
+	render_start=getTime();
+	samples_done=rays_done=0;
+	tellAOVs(out);
+	prepareObjects();
 	cout<<"Building bounding tree ... ";cout.flush();
 	//BTree=new boundTree_t (obj_list);
 	BTree=buildObjectTree (obj_list);
@@ -558,18 +713,22 @@ void scene_t::render(colorOutput_t &out)
 	
 	while(repeatFirst)
 	{
-		cout<<"\rFake   pass: [";
+		bool partial=!repeatAll && !repeatCells.empty();
+		cout<<(partial ? "\rRefine pass: [" : "\rFake   pass: [");
 		cout.flush();
-		repeatFirst=false;
-		blockSpliter_t fakespliter(resx,resy,64);
-		int finished=0;
+		blockSpliter_t fakespliter(resx,resy,partial ? REPEAT_CELL : 64,
+				partial ? &repeatCells : NULL);
+		repeatFirst=repeatAll=false;
+		repeatCells.assign(repeatCells.size(),false);
+		int finished=0, total=fakespliter.size();
+		double start=getTime();
 		
 		while(!fakespliter.empty())
 		{
 			if((finished>0) && !(finished%10)) {cout<<"#";cout.flush();}
 			fakespliter.getArea(area);
 			fakeRender(area);
-			if(!area.out(out))
+			if(cancelled || !area.out(out))
 			{
 				cout<<"Aborted"<<endl;
 				delete BTree;
@@ -577,21 +736,94 @@ void scene_t::render(colorOutput_t &out)
 				return;
 			}
 			finished++;
+			areaDone(partial ? "refine" : "fake",area,finished,total,start);
 		}
 		cout<<"#]"<<endl;
 		postSetupLights();
 	}
 	cout<<endl;
 
+	if(preview)
+	{
+		previewFrame.set(0,0,resx,resy);
+		double start=getTime();
+		for(int step=PREVIEW_STEP;step>1;step/=2)
+		{
+			blockSpliter_t prespliter(resx,resy,64);
+			int finished=0, total=prespliter.size();
+			double levelstart=getTime();
+			while(!prespliter.empty())
+			{
+				prespliter.getArea(area);
+				previewPass(area,step);
+				if(cancelled || !area.out(out))
+				{
+					cout<<"Aborted"<<endl;
+					previewFrame=renderArea_t();
+					delete BTree;
+					BTree=NULL;
+					return;
+				}
+				areaDone("preview",area,++finished,total,levelstart);
+			}
+			cout<<"Preview 1/"<<step<<" "<<(getTime()-start)<<"s"<<endl;
+		}
+		previewFrame=renderArea_t();
+	}
+
+	if(progressive)
+	{
+		progressFrame.set(0,0,resx,resy);
+		progressFrame.startStats();
+		progressFrame.setPlanes(aov_list.size());
+		double start=getTime();
+		for(int pass=0;;++pass)
+		{
+			cout<<"\rProgressive pass "<<(pass+1)<<": [";
+			cout.flush();
+			blockSpliter_t passpliter(resx,resy,64);
+			frame.start(resx,resy,64,filter_list,aov_list.size());
+			int finished=0, total=passpliter.size();
+			double passtart=getTime();
+			while(!passpliter.empty())
+			{
+				if((finished>0) && !(finished%10)) {cout<<"#";cout.flush();}
+				passpliter.getArea(area);
+				progressivePass(area,pass);
+				frame.put(area);
+				if(cancelled || !frame.flush(out))
+				{
+					cout<<"Aborted"<<endl;
+					progressFrame=renderArea_t();
+					delete BTree;
+					BTree=NULL;
+					return;
+				}
+				finished++;
+				areaDone("progressive",area,finished,total,passtart);
+			}
+			cout<<"#] "<<(getTime()-start)<<"s"<<endl;
+			if(progressiveDone(pass,start)) break;
+		}
+		progressFrame=renderArea_t();
+		delete BTree;
+		BTree=NULL;
+		renderStats();
+		return;
+	}
+
 	cout<<"\rRender pass: [";
 	cout.flush();
-	int finished=0;
+	frame.start(resx,resy,64,filter_list,aov_list.size());
+	int finished=0, total=spliter.size();
+	double start=getTime();
 	while(!spliter.empty())
 	{
 		if((finished>0) && !(finished%10)) {cout<<"#";cout.flush();}
 		spliter.getArea(area);
 		render(area);
-		if(!area.out(out))
+		frame.put(area);
+		if(cancelled || !frame.flush(out))
 		{
 			cout<<"Aborted"<<endl;
 			delete BTree;
@@ -599,10 +831,12 @@ void scene_t::render(colorOutput_t &out)
 			return;
 		}
 		finished++;
+		areaDone("render",area,finished,total,start);
 	}
 	cout<<"#]"<<endl;
 	delete BTree;
 	BTree=NULL;
+	renderStats();
 	/*
 	int resx,resy;
 	int steps;
@@ -688,6 +922,7 @@ void scene_t::render(colorOutput_t &out)
 bool scene_t::firstHit(renderState_t &state,surfacePoint_t &sp,const point3d_t &from,
 											const vector3d_t &ray,bool shadow)const
 {
+	++state.rays;
 	surfacePoint_t temp;
 	bool found=false;
 	point3d_t f=from+ray*min_raydis;
@@ -714,6 +949,7 @@ bool scene_t::firstHit(renderState_t &state,surfacePoint_t &sp,const point3d_t &
 		eye.normalize();
 		PFLOAT oldtraveled=state.traveled;
 		state.traveled+=sp.Z();
+		sp.setFilterWidth(state.traveled*world_resolution);
 		sp.getShader()->displace(state, sp, eye, world_resolution);
 		state.traveled=oldtraveled;
 	}
@@ -735,6 +971,9 @@ void scene_t::render(renderArea_t &area) const
 	colorA_t fcol;
 
 	PFLOAT fx=0.5, fy=0.5;
+	int naov=aov_list.size();
+	vector<color_t> aovs, totaov(naov);
+	area.setPlanes(naov);
 
 	//First pass
 	unsigned int sc1=0, sc2=0;
@@ -743,8 +982,11 @@ void scene_t::render(renderArea_t &area) const
 		for(int j=area.X;j<(area.X+area.W);++j)
 		{
 			if (AA_jitterfirst && (AA_passes!=0)) {
-				fx = RI_vdC(++sc1);
-				fy = RI_S(++sc2);
+				// deterministic, the jitter only depends on the pixel
+				if (deterministic) sc1 = sc2 = j+i*resx+1;
+				else { ++sc1;  ++sc2; }
+				fx = RI_vdC(sc1);
+				fy = RI_S(sc2);
 			}
 			state.screenpos.set(2.0*(((PFLOAT)j+fx)/(PFLOAT)resx)-1.0, 
 					1.0-2.0*(((PFLOAT)i+fy)/(PFLOAT)resy), 0);
@@ -752,18 +994,22 @@ void scene_t::render(renderArea_t &area) const
 					(state.screenpos.y>=scymin) && (state.screenpos.y<scymax))
 			{
 				state.raylevel = -1;
-				vector3d_t ray = render_camera->shootRay((PFLOAT)j+fx, (PFLOAT)i+fy, wt);
+				if (deterministic) myseed = indexSeed(j+i*resx, 0);
+				vector3d_t ray = render_camera->shootRay((PFLOAT)j+fx, (PFLOAT)i+fy, wt, state.raydiff);
 				contri = 1.0;
 				globalpass = 0;
 				state.pixelNumber = j+i*resx;
 				if (wt!=0.0) {
+					state.samples++;
 					chroma = true;
 					cur_ior = 1.0;
+					state.aov.start(aov_mask);
 					fcol = raytrace(state, render_camera->position(), ray);
 					if (do_tonemap) fcol.expgam_Adjust(exposure, gamma_R, clamp_rgb);
 					if (pdep>=0) fcol.setAlpha(1.0); else fcol.setAlpha(0.0);
 					area.imagePixel(j,i) = fcol;
 					area.depthPixel(j,i) = pdep;
+					if (sampleAOVs(state, aovs)) copy(aovs.begin(), aovs.end(), area.planePixel(j,i));
 				}
 				else {
 					area.imagePixel(j,i) = color_t(0.0);
@@ -775,7 +1021,10 @@ void scene_t::render(renderArea_t &area) const
 
 	PFLOAT totsamdiv = AA_minsamples*AA_passes;
 	if (totsamdiv!=0) totsamdiv = 1.0/totsamdiv;
-	for (int pass=0;pass<AA_passes;pass++)
+	// noise driven AA replaces the fixed passes
+	bool adaptive = (AA_noise>0) && (AA_passes>0);
+	if (adaptive) adaptiveSampling(state, area);
+	for (int pass=0;(pass<AA_passes) && !adaptive && !cancelled;pass++)
 	{
 		area.checkResample(AA_threshold);
 		for (int i=area.Y;i<(area.Y+area.H);++i)
@@ -783,35 +1032,23 @@ void scene_t::render(renderArea_t &area) const
 			{
 				if (!area.resamplePixel(j,i)) continue;
 				colorA_t totcol(0.0);
-				state.pixelNumber = j+i*resx;
-				unsigned int cursam=0;
-
 				int totnumsam = 0;
+				totaov.assign(naov, color_t(0.0));
 				for (int ms=0;ms<AA_minsamples;ms++) 
 				{
-					globalpass = cursam = pass*AA_minsamples + ms;
-					state.raylevel = -1;
-					fx = 0.5 + AA_pixelwidth*(RI_LP(cursam+state.pixelNumber) - 0.5);
-					fy = 0.5 + AA_pixelwidth*(cursam*totsamdiv - 0.5);
-					//fx = 0.5 + AA_pixelwidth*(HSEQ1.getNext() - 0.5);
-					//fy = 0.5 + AA_pixelwidth*(HSEQ2.getNext() - 0.5);
-					state.screenpos.set(2.0*(((PFLOAT)j+fx)/(PFLOAT)resx)-1.0, 
-							1.0-2.0*(((PFLOAT)i+fy)/(PFLOAT)resy), 0);
-					vector3d_t ray = render_camera->shootRay((PFLOAT)j+fx, (PFLOAT)i+fy, wt);
-					if ((wt!=0.0) && (state.screenpos.x>=scxmin) && (state.screenpos.x<scxmax) &&
-							(state.screenpos.y>=scymin) && (state.screenpos.y<scymax))
+					if (samplePixel(state, j, i, pass*AA_minsamples + ms, totsamdiv, fcol))
 					{
-						chroma = true;
-						cur_ior = 1.0;
-						fcol = raytrace(state,render_camera->position(), ray);
-						if (do_tonemap) fcol.expgam_Adjust(exposure, gamma_R, clamp_rgb);
-						if (pdep>=0) fcol.setAlpha(1.0); else fcol.setAlpha(0.0);
 						totcol += fcol;
 						totnumsam++;
+						if (sampleAOVs(state, aovs))
+							for (int a=0;a<naov;++a) totaov[a] += aovs[a];
 					}
 				}
 				CFLOAT mf = (CFLOAT)(pass*totnumsam+1);
 				area.imagePixel(j,i) = (mf*area.imagePixel(j,i) + totcol) / (mf+(CFLOAT)totnumsam);
+				color_t *planes = naov ? area.planePixel(j,i) : NULL;
+				for (int a=0;a<naov;++a)
+					planes[a] = (mf*planes[a] + totaov[a]) / (mf+(CFLOAT)totnumsam);
 			}
 	}
 
@@ -820,6 +1057,250 @@ void scene_t::render(renderArea_t &area) const
 		for (int j=area.X;j<(area.X+area.W);++j)
 			area.imagePixel(j, i).alphaPremultiply();
 	}
+	area.samples = state.samples;
+	area.rays = state.rays;
+}
+
+void scene_t::setAOVs(const string &names)
+{
+	aov_list.clear();
+	aov_mask=0;
+	string::size_type from=0;
+	while(from<names.size())
+	{
+		string::size_type to=names.find_first_of(" ,",from);
+		if(to==string::npos) to=names.size();
+		string name=names.substr(from,to-from);
+		from=to+1;
+		if(name.empty()) continue;
+		int c=aovChannel(name);
+		if(c<0) cout<<"[WARNING]: Unknown AOV "<<name<<endl;
+		else if(!(aov_mask&(1u<<c)))
+		{
+			aov_list.push_back(c);
+			aov_mask|=1u<<c;
+		}
+	}
+}
+
+// gives the names of the planes to the output
+void scene_t::tellAOVs(colorOutput_t &out)const
+{
+	if(aov_list.empty()) return;
+	vector<string> names;
+	for(unsigned int i=0;i<aov_list.size();++i) names.push_back(aovName(aov_list[i]));
+	out.setAOVs(names);
+}
+
+// the channels of the sample just traced in the order of the planes, NULL if none
+color_t * scene_t::sampleAOVs(renderState_t &state,vector<color_t> &aovs)const
+{
+	if(aov_list.empty()) return NULL;
+	state.aov.finish();
+	aovs.resize(aov_list.size());
+	for(unsigned int i=0;i<aov_list.size();++i)
+		aovs[i]=state.aov.channel[aov_list[i]];
+	return &aovs[0];
+}
+
+// one AA sample of pixel x,y, false if outside the camera or the region
+bool scene_t::samplePixel(renderState_t &state,int x,int y,unsigned int cursam,
+		PFLOAT totsamdiv,colorA_t &col)const
+{
+	int resx=render_camera->resX();
+	int resy=render_camera->resY();
+	PFLOAT wt;
+	state.pixelNumber = x+y*resx;
+	state.currentPass = cursam;
+	state.raylevel = -1;
+	if (deterministic) myseed = indexSeed(state.pixelNumber, cursam+1);
+	// without a total, as in progressive passes, the first one at the center
+	bool center = (totsamdiv<=0) && (cursam==0);
+	PFLOAT fx = center ? 0.5 : 0.5 + AA_pixelwidth*(RI_LP(cursam+state.pixelNumber) - 0.5);
+	PFLOAT sy = (totsamdiv>0) ? cursam*totsamdiv : RI_vdC(cursam)+0.5;
+	PFLOAT fy = 0.5 + AA_pixelwidth*(sy - floor(sy) - 0.5);
+	//fx = 0.5 + AA_pixelwidth*(HSEQ1.getNext() - 0.5);
+	//fy = 0.5 + AA_pixelwidth*(HSEQ2.getNext() - 0.5);
+	state.screenpos.set(2.0*(((PFLOAT)x+fx)/(PFLOAT)resx)-1.0, 
+			1.0-2.0*(((PFLOAT)y+fy)/(PFLOAT)resy), 0);
+	vector3d_t ray = render_camera->shootRay((PFLOAT)x+fx, (PFLOAT)y+fy, wt, state.raydiff);
+	if ((wt==0.0) || (state.screenpos.x<scxmin) || (state.screenpos.x>=scxmax) ||
+			(state.screenpos.y<scymin) || (state.screenpos.y>=scymax))
+		return false;
+	state.samples++;
+	state.chromatic = true;
+	state.cur_ior = 1.0;
+	state.aov.start(aov_mask);
+	col = raytrace(state,render_camera->position(), ray);
+	if (do_tonemap) col.expgam_Adjust(exposure, gamma_R, clamp_rgb);
+	if (state.depth>=0) col.setAlpha(1.0); else col.setAlpha(0.0);
+	return true;
+}
+
+/* The fixed passes add AA_minsamples to every pixel differing from its
+ * neighbours, pass after pass. Here every pixel is first sampled by itself,
+ * AA_minsamples at a time, until it is under AA_noise or has the samples
+ * the fixed passes would give it at most. The samples saved on the quiet
+ * pixels then go by rounds to those still noisy, the noisiest first, up to
+ * four times the fixed amount for a pixel.
+ */
+void scene_t::adaptiveSampling(renderState_t &state,renderArea_t &area)const
+{
+	int npix = area.W*area.H;
+	int persam = AA_passes*AA_minsamples;
+	long budget = (long)persam*npix;
+	int maxsam = 1 + 4*persam;
+	// too few samples tell nothing of the variance
+	int minsam = (persam/4>4) ? persam/4 : 4;
+	PFLOAT totsamdiv = 1.0/(PFLOAT)persam;
+	colorA_t col;
+	vector<color_t> aovs;
+	area.startStats();
+	area.checkResample(AA_threshold);
+	for (int k=0;(k<npix) && !cancelled;++k)
+	{
+		int x = area.X + k%area.W, y = area.Y + k/area.W;
+		// edges get all the samples of the fixed passes
+		int mins = area.resample[k] ? persam : minsam;
+		while ((area.nsamples[k]<=persam) && 
+				((area.nsamples[k]<=mins) || (area.relativeError(k)>AA_noise)))
+		{
+			for (int ms=0;ms<AA_minsamples;ms++)
+				if (samplePixel(state, x, y, area.nsamples[k]-1, totsamdiv, col))
+					area.addSample(k, col, sampleAOVs(state, aovs));
+				else { area.nsamples[k]=maxsam;  break; } // never seen
+			budget -= AA_minsamples;
+		}
+	}
+	vector<pair<CFLOAT,int> > noisy;
+	while ((budget>0) && !cancelled)
+	{
+		noisy.clear();
+		for (int k=0;k<npix;++k)
+		{
+			if (area.nsamples[k]>=maxsam) continue;
+			CFLOAT err = area.relativeError(k);
+			if (err>AA_noise) noisy.push_back(make_pair(err,k));
+		}
+		if (noisy.empty()) break;
+		sort(noisy.begin(), noisy.end(), greater<pair<CFLOAT,int> >());
+		for (vector<pair<CFLOAT,int> >::iterator n=noisy.begin();(n!=noisy.end()) && (budget>0);++n)
+		{
+			int k = n->second;
+			int x = area.X + k%area.W, y = area.Y + k/area.W;
+			for (int ms=0;(ms<AA_minsamples) && (area.nsamples[k]<maxsam);ms++)
+				if (samplePixel(state, x, y, area.nsamples[k]-1, totsamdiv, col))
+					area.addSample(k, col, sampleAOVs(state, aovs));
+			budget -= AA_minsamples;
+		}
+	}
+}
+
+// passes before the noise of a pixel is trusted
+#define PROGRESSIVE_MINSAM 4
+
+void scene_t::progressivePass(renderArea_t &area, int pass)
+{
+	renderState_t state;
+	int resx=render_camera->resX();
+	int spp=(AA_minsamples>0) ? AA_minsamples : 1;
+	int naov=aov_list.size();
+	colorA_t col;
+	vector<color_t> aovs;
+	area.setPlanes(naov);
+	for(int i=area.realY;i<(area.realY+area.realH);++i)
+		for(int j=area.realX;j<(area.realX+area.realW);++j)
+		{
+			int k=j+i*resx;
+			int &n=progressFrame.nsamples[k];
+			if(pass==0)
+			{
+				if(samplePixel(state, j, i, 0, 0, col))
+				{
+					progressFrame.image[k]=col;
+					progressFrame.depth[k]=state.depth;
+					if(sampleAOVs(state, aovs))
+						copy(aovs.begin(), aovs.end(), &progressFrame.planes[k*naov]);
+				}
+				else
+				{
+					// never sampled again
+					progressFrame.image[k]=colorA_t(0.0);
+					progressFrame.depth[k]=numeric_limits<PFLOAT>::infinity();
+					n=0;
+				}
+			}
+			else if((n>0) && ((AA_noise<=0) || (pass<PROGRESSIVE_MINSAM) ||
+						(progressFrame.relativeError(k)>AA_noise)))
+			{
+				for(int ms=0;ms<spp;++ms)
+					if(samplePixel(state, j, i, n, 0, col))
+						progressFrame.addSample(k, col, sampleAOVs(state, aovs));
+			}
+			area.imagePixel(j,i)=progressFrame.image[k];
+			if(alpha_premultiply) area.imagePixel(j,i).alphaPremultiply();
+			area.depthPixel(j,i)=progressFrame.depth[k];
+			if(naov) copy(&progressFrame.planes[k*naov], &progressFrame.planes[k*naov]+naov,
+					area.planePixel(j,i));
+		}
+	area.samples=state.samples;
+	area.rays=state.rays;
+}
+
+/* Pixels on the corners of the cells are traced, unless they were at the
+ * coarser level already, and copied over their whole cells. Cells never
+ * cross areas, as the step divides the size of the blocks.
+ */
+void scene_t::previewPass(renderArea_t &area, int step)
+{
+	renderState_t state;
+	int resx=render_camera->resX();
+	int x1=area.realX+area.realW, y1=area.realY+area.realH;
+	colorA_t col;
+	area.setPlanes(0);
+	for(int i=area.realY;i<y1;i+=step)
+		for(int j=area.realX;j<x1;j+=step)
+		{
+			int k=j+i*resx;
+			if((step==PREVIEW_STEP) || (i%(2*step)) || (j%(2*step)))
+			{
+				if(samplePixel(state, j, i, 0, 0, col))
+				{
+					if(alpha_premultiply) col.alphaPremultiply();
+					previewFrame.image[k]=col;
+					previewFrame.depth[k]=state.depth;
+				}
+				else
+				{
+					previewFrame.image[k]=colorA_t(0.0);
+					previewFrame.depth[k]=numeric_limits<PFLOAT>::infinity();
+				}
+			}
+			for(int y=i;y<min(i+step,y1);++y)
+				for(int x=j;x<min(j+step,x1);++x)
+				{
+					area.imagePixel(x,y)=previewFrame.image[k];
+					area.depthPixel(x,y)=previewFrame.depth[k];
+				}
+		}
+	area.samples=state.samples;
+	area.rays=state.rays;
+}
+
+// true if no more progressive passes are needed after pass
+bool scene_t::progressiveDone(int pass, double start)const
+{
+	if(progressive_time>0)
+	{
+		if((getTime()-start)>=progressive_time) return true;
+	}
+	else if(pass>=AA_passes) return true;
+	if((AA_noise<=0) || (pass<PROGRESSIVE_MINSAM)) return false;
+	int size=progressFrame.nsamples.size();
+	for(int k=0;k<size;++k)
+		if((progressFrame.nsamples[k]>0) && (progressFrame.relativeError(k)>AA_noise))
+			return false;
+	return true;
 }
 
 void scene_t::fakeRender(renderArea_t &area)const
@@ -840,7 +1321,8 @@ void scene_t::fakeRender(renderArea_t &area)const
 			state.raylevel = -1;
 			state.screenpos.set(2.0*(((PFLOAT)j+0.5)/(PFLOAT)resx)-1.0, 
 					1.0-2.0*(((PFLOAT)i+0.5)/(PFLOAT)resy), 0);
-			vector3d_t ray = render_camera->shootRay((PFLOAT)j+0.5, (PFLOAT)i+0.5, wt);
+			if (deterministic) myseed = indexSeed(j+i*resx, 0);
+			vector3d_t ray = render_camera->shootRay((PFLOAT)j+0.5, (PFLOAT)i+0.5, wt, state.raydiff);
 			contri = 1.0;
 			globalpass = 0;
 			state.pixelNumber = j+i*resx;
@@ -848,9 +1330,42 @@ void scene_t::fakeRender(renderArea_t &area)const
 			cur_ior = 1.0;
 			if ((wt!=0.0) && (state.screenpos.x>=scxmin) && (state.screenpos.x<scxmax) &&
 					(state.screenpos.y>=scymin) && (state.screenpos.y<scymax))
+			{
+				state.samples++;
 				area.imagePixel(j, i) = raytrace(state, render_camera->position(), ray);
+			}
 			else area.imagePixel(j, i) = colorA_t(0.0);
 		}
+	area.samples = state.samples;
+	area.rays = state.rays;
+}
+
+void scene_t::areaDone(const char *pass,const renderArea_t &area,int done,int total,double start)
+{
+	samples_done+=area.samples;
+	rays_done+=area.rays;
+	if(monitor==NULL) return;
+	double now=getTime();
+	renderProgress_t p;
+	p.pass=pass;
+	p.done=done;
+	p.total=total;
+	p.samples=samples_done;
+	p.rays=rays_done;
+	p.elapsed=now-render_start;
+	// areas take about the same time on average, they are given shuffled
+	p.eta=(done>0) ? (now-start)*(PFLOAT)(total-done)/(PFLOAT)done : -1.0;
+	monitor->progress(p);
+}
+
+void scene_t::renderStats()const
+{
+	double t=getTime()-render_start;
+	cout<<"Render time: "<<t<<"s, "<<samples_done<<" samples, "<<rays_done<<" rays";
+	if(t>0) cout<<" ("<<(rays_done/t)<<" rays/s)";
+	cout<<endl;
+	if(!filter_list.empty())
+		cout<<"Filter time: "<<frame.filterTime()<<"s of the render threads"<<endl;
 }
 
 scene_t *scene_t::factory()
@@ -41,6 +41,9 @@
 #include <list>
 
 #include "tools.h"
+#include "raydiff.h"
+#include "shadecache.h"
+#include "aov.h"
 
 __BEGIN_YAFRAY
 class renderArea_t;
@@ -67,6 +70,31 @@ struct YAFRAYCORE_EXPORT renderState_t
 	point3d_t screenpos;
 	bool chromatic;
 	PFLOAT cur_ior;
+	// differentials of the ray being traced, at its hit point while shading it
+	rayDifferentials_t raydiff;
+	// node results of the shading point, see shader_t::cachedColor()
+	shadeCache_t shadecache;
+	// extra channels of the camera sample
+	aovState_t aov;
+	// camera samples taken with this state
+	unsigned int samples;
+	// rays traced with it, shadow rays included
+	unsigned int rays;
+
+	/// adds col to channel c, when shading the camera hit
+	void addAOV(int c,const color_t &col)
+	{
+		if((raylevel==0) && aov.want(c)) aov.channel[c]+=col;
+	}
+	/// the diffuse and specular parts a shader gives to the light calling it
+	void lightParts(const color_t &dif,const color_t &spec)
+	{
+		if((raylevel==0) && aov.wanted)
+		{
+			aov.lightDiffuse+=dif;
+			aov.lightSpecular+=spec;
+		}
+	}
 
 	protected:
 		renderState_t(const renderState_t &r) {};//forbiden
@@ -91,6 +119,7 @@ __END_YAFRAY
   #include <stdio.h>
 
 #include "renderblock.h"
+#include "framebuffer.h"
 
 __BEGIN_YAFRAY
 
@@ -109,6 +138,16 @@ class YAFRAYCORE_EXPORT scene_t
 				const point3d_t &l)const;
 		bool isShadowed(renderState_t &state,const surfacePoint_t &p,
 				const vector3d_t &dir)const;
+		/// lights with shadow maps tell the shadowed fraction of a test here
+		void mapShadow(renderState_t &state,CFLOAT blocked)const
+		{
+			if(state.aov.direct && (state.raylevel==0))
+			{
+				++state.aov.shadowTests;
+				state.aov.shadowBlocked+=blocked;
+			}
+		}
+		void prepareObjects();
 		void setupLights();
 		void postSetupLights();
 
@@ -155,8 +194,14 @@ class YAFRAYCORE_EXPORT scene_t
 			if (background==NULL) return color_t(0.0);
 			return (*background)(dir, state, filtered);
 		}
+		bool sampleBackground(PFLOAT s1, PFLOAT s2, vector3d_t &dir, PFLOAT &pdf) const
+		{
+			if (background==NULL) return false;
+			return background->sample(s1, s2, dir, pdf);
+		}
 
 		void setCPUs(const int num) { cpus = num; }
+		int getCPUs()const { return cpus; }
 
 		// gamma & exposure
 		void setGamma(CFLOAT g) { gamma_R=0.0;  if (g!=0.0) gamma_R=1.0/g; }
@@ -177,6 +222,38 @@ class YAFRAYCORE_EXPORT scene_t
 			AA_threshold = th;
 			AA_jitterfirst = jf;
 		}
+		/** Noise driven AA, 0 disables it. Pixels are sampled until the relative
+		 * error of their brightness falls under this. A render area spends the
+		 * samples the fixed passes would take on all its pixels, the noisiest first */
+		void setAANoise(CFLOAT n) { AA_noise=n; }
+		/** Progressive rendering. Every pass adds AA_minsamples to all the pixels
+		 * of the frame and sends the image to the output. Passes go on until
+		 * seconds of wall clock time are spent, or AA_passes are done if no time
+		 * is given, or sooner if every pixel is under AA_noise */
+		void setProgressive(bool p, PFLOAT seconds=0) { progressive=p;  progressive_time=seconds; }
+		/// one progressive pass over area, the frame so far is copied into it
+		void progressivePass(renderArea_t &area, int pass);
+		/** Preview before the render. The frame is traced at one pixel in
+		 * PREVIEW_STEP x PREVIEW_STEP, then in half the step, down to 2x2,
+		 * every level sent to the output with the pixels repeated over their
+		 * cells. The pixels of a level are kept for the finer ones */
+		void setPreview(bool p) { preview=p; }
+		/** Deterministic render, the same image whatever the number of threads.
+		 * The random numbers restart at every camera sample from the indices
+		 * of the pixel and the sample, and lights filling caches keep what
+		 * every area adds apart to merge it in the same order */
+		void setDeterministic(bool d) { deterministic=d; }
+		bool isDeterministic()const { return deterministic; }
+		/// one preview level over area, step pixels per cell side
+		void previewPass(renderArea_t &area, int step);
+		/// stops the render at the next area, it can be called from any thread
+		void cancel() { cancelled=true; }
+		bool isCancelled()const { return cancelled; }
+		/// gets the progress after every area, NULL for none
+		void setProgressOutput(progressOutput_t *p) { monitor=p; }
+		/** Extra channels to output, their names separated by spaces or commas.
+		 * They are averaged as the image and given to the output in planes */
+		void setAOVs(const std::string &names);
 
 		// for LDR output, it is useful to clamp light values in AA sampling
 		// so that AA will look better in parts of the image where fast high contrast differences occur
@@ -187,7 +264,14 @@ class YAFRAYCORE_EXPORT scene_t
 		void alphaPremultiply(bool ap) { alpha_premultiply=ap; }
 		void alphaMaskBackground(bool abm) { alpha_maskbackground=abm; }
 
-		void setRepeatFirst() {repeatFirst=true;};
+		void setRepeatFirst() {repeatFirst=true;repeatAll=true;};
+		/** Repeats the first pass only around a screen position
+		 *
+		 * Marks for the next first pass the pixels within radius of sx,sy,
+		 * in the units of renderState_t::screenpos.x. Unless the whole pass is
+		 * also asked for, only the blocks holding marked pixels are traced again.
+		 */
+		void setRepeatFirst(PFLOAT sx,PFLOAT sy,PFLOAT radius);
 		bool getRepeatFirst()const {return repeatFirst;};
 		PFLOAT getWorldResolution()const {return world_resolution;};
 		point3d_t getCenterOfView()const {return render_camera->position();};
@@ -248,10 +332,49 @@ class YAFRAYCORE_EXPORT scene_t
 		int AA_passes, AA_minsamples;
 		bool AA_jitterfirst;
 		PFLOAT AA_pixelwidth, AA_threshold, AA_samdiv;
+		CFLOAT AA_noise;
+		bool samplePixel(renderState_t &state,int x,int y,unsigned int cursam,
+				PFLOAT totsamdiv,colorA_t &col)const;
+		// AOVs, channels wanted in the order of the planes
+		std::vector<int> aov_list;
+		unsigned int aov_mask;
+		color_t * sampleAOVs(renderState_t &state,std::vector<color_t> &aovs)const;
+		void tellAOVs(colorOutput_t &out)const;
+		void splitLight(renderState_t &state,const color_t &col)const;
+		// counts a shadow test of a direct light for the shadow channel
+		bool countShadow(renderState_t &state,bool blocked)const
+		{
+			mapShadow(state,blocked ? 1.0 : 0.0);
+			return blocked;
+		}
+		void adaptiveSampling(renderState_t &state,renderArea_t &area)const;
+		// progressive mode, the samples of all passes gathered in progressFrame
+		bool progressive;
+		PFLOAT progressive_time;
+		renderArea_t progressFrame;
+		// the rendered image, filtered and sent to the output by tiles
+		frameBuffer_t frame;
+		bool progressiveDone(int pass, double start)const;
+		// preview levels, the pixels traced so far in previewFrame
+		enum { PREVIEW_STEP=8 };
+		bool preview;
+		bool deterministic;
+		renderArea_t previewFrame;
+		volatile bool cancelled;
+		progressOutput_t *monitor;
+		double render_start, samples_done, rays_done;
+		/// counts the samples of area, the done-th of total in pass started at start
+		void areaDone(const char *pass,const renderArea_t &area,int done,int total,double start);
+		/// prints the time, samples and rays of the render
+		void renderStats()const;
 		// used to keep track of the screen sampling position, for 'win' texmap mode
 		//point3d_t screenpos;
 		PFLOAT scymin,scymax,scxmin,scxmax;
 		bool repeatFirst;
+		// partial first pass, cells of REPEAT_CELL pixels marked for it
+		enum { REPEAT_CELL=16 };
+		bool repeatAll;
+		std::vector<bool> repeatCells;
 		std::map<std::string,const void *> published;
 		bool do_tonemap, clamp_rgb;
 		bool alpha_premultiply, alpha_maskbackground;
@@ -0,0 +1,61 @@
+/****************************************************************************
+ *
+ * 			shadecache.cc: per render state memo of shader node results
+ *      This is part of the yafray package
+ *
+ *      This library is free software; you can redistribute it and/or
+ *      modify it under the terms of the GNU Lesser General Public
+ *      License as published by the Free Software Foundation; either
+ *      version 2.1 of the License, or (at your option) any later version.
+ *
+ *      This library is distributed in the hope that it will be useful,
+ *      but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *      MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *      Lesser General Public License for more details.
+ *
+ *      You should have received a copy of the GNU Lesser General Public
+ *      License along with this library; if not, write to the Free Software
+ *      Foundation,Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+ *
+ */
+
+#include "shadecache.h"
+#include "ccthreads.h"
+#include <iostream>
+
+using namespace std;
+
+__BEGIN_YAFRAY
+
+bool shadeCache_t::enabled = true;
+
+// totals gathered from the render states of all threads
+static yafthreads::mutex_t statsMutex;
+static unsigned long totalHits=0, totalMisses=0, totalUncached=0;
+
+shadeCache_t::shadeCache_t(): isvolatile(false), hits(0), misses(0), uncached(0)
+{
+}
+
+shadeCache_t::~shadeCache_t()
+{
+	if (misses==0) return;
+	statsMutex.wait();
+	totalHits += hits;
+	totalMisses += misses;
+	totalUncached += uncached;
+	statsMutex.signal();
+}
+
+void shadeCache_t::printStats()
+{
+	statsMutex.wait();
+	if (totalMisses!=0)
+		cout << "Shading cache: " << totalHits << " hits, " << totalMisses << " misses ("
+			<< (100.0*totalHits)/(double)(totalHits+totalMisses) << "% hit rate), "
+			<< totalUncached << " volatile results not cached" << endl;
+	totalHits = totalMisses = totalUncached = 0;
+	statsMutex.signal();
+}
+
+__END_YAFRAY
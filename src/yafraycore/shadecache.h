@@ -0,0 +1,122 @@
+/****************************************************************************
+ *
+ * 			shadecache.h: per render state memo of shader node results
+ *      This is part of the yafray package
+ *
+ *      This library is free software; you can redistribute it and/or
+ *      modify it under the terms of the GNU Lesser General Public
+ *      License as published by the Free Software Foundation; either
+ *      version 2.1 of the License, or (at your option) any later version.
+ *
+ *      This library is distributed in the hope that it will be useful,
+ *      but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *      MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *      Lesser General Public License for more details.
+ *
+ *      You should have received a copy of the GNU Lesser General Public
+ *      License along with this library; if not, write to the Free Software
+ *      Foundation,Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+ *
+ */
+#ifndef __SHADECACHE_H
+#define __SHADECACHE_H
+
+#ifdef HAVE_CONFIG_H
+#include<config.h>
+#endif
+
+#include "vector3d.h"
+#include "color.h"
+
+__BEGIN_YAFRAY
+
+/** Memo of shader node outputs
+ *
+ * A node is often pulled several times for one shading point: by the
+ * modulators, by fromLight for every light and by fromRadiosity.
+ * Results are kept in a small direct mapped table, keyed by the node and
+ * everything of the surface point and eye a node may read, so an entry is
+ * only reused for the very same point and never needs invalidation.
+ * Nodes with random or state dependent results call setVolatile(), that
+ * keeps them and every node evaluated above them out of the table.
+ *
+ */
+class YAFRAYCORE_EXPORT shadeCache_t
+{
+	public:
+		enum outputType {COLOR, FLOAT};
+		struct key_t
+		{
+			bool operator == (const key_t &k) const
+			{
+				return (node==k.node) && (type==k.type) && (obj==k.obj) && (orco==k.orco)
+					&& (P.x==k.P.x) && (P.y==k.P.y) && (P.z==k.P.z)
+					&& (N.x==k.N.x) && (N.y==k.N.y) && (N.z==k.N.z)
+					&& (Ng.x==k.Ng.x) && (Ng.y==k.Ng.y) && (Ng.z==k.Ng.z)
+					&& (eye.x==k.eye.x) && (eye.y==k.eye.y) && (eye.z==k.eye.z)
+					&& (u==k.u) && (v==k.v) && (fw==k.fw);
+			}
+			const void *node, *obj;
+			outputType type;
+			bool orco;
+			point3d_t P;
+			vector3d_t N, Ng, eye;
+			GFLOAT u, v;
+			PFLOAT fw;
+		};
+
+		shadeCache_t();
+		~shadeCache_t();
+
+		/// Cached result for k, NULL on a miss
+		const colorA_t * find(const key_t &k)
+		{
+			entry_t &e = table[slot(k)];
+			if (e.valid && (e.key==k)) { ++hits;  return &e.result; }
+			++misses;
+			return NULL;
+		}
+		/// Call before evaluating a node, returns the state to give to end()
+		bool begin() { bool v=isvolatile;  isvolatile=false;  return v; }
+		/// Stores the result unless something volatile was evaluated since begin()
+		void end(bool outer, const key_t &k, const colorA_t &r)
+		{
+			if (isvolatile) ++uncached;
+			else
+			{
+				entry_t &e = table[slot(k)];
+				e.key = k;
+				e.result = r;
+				e.valid = true;
+			}
+			isvolatile = isvolatile || outer;
+		}
+		/// The result being evaluated can't be reused
+		void setVolatile() { isvolatile=true; }
+
+		static void setEnabled(bool e) { enabled=e; }
+		static bool isEnabled() { return enabled; }
+		/// Totals of all render states destroyed so far, printed and cleared
+		static void printStats();
+	protected:
+		shadeCache_t(const shadeCache_t &c) {}; //forbiden
+		enum { SIZE=64 };
+		struct entry_t
+		{
+			entry_t(): valid(false) {};
+			key_t key;
+			colorA_t result;
+			bool valid;
+		};
+		int slot(const key_t &k) const
+		{ return (int)(((((size_t)k.node)>>4)*2654435761u) ^ k.type) & (SIZE-1); }
+
+		entry_t table[SIZE];
+		bool isvolatile;
+		unsigned long hits, misses, uncached;
+		static bool enabled;
+};
+
+__END_YAFRAY
+
+#endif
@@ -152,6 +152,57 @@ class YAFRAYCORE_EXPORT shader_t
 		virtual bool discrete()const {return false;};
 		virtual bool isRGB() const { return true; }
 		virtual void getDispersion(PFLOAT &disp_pw, PFLOAT &A, PFLOAT &B, color_t &beer) const { disp_pw=A=B=0;  beer.black(); }
+
+		/** stdoutColor and stdoutFloat through the memo of the render state.
+		 *
+		 * Nodes should pull their inputs with these, so an input shared by
+		 * several nodes, or pulled again for every light, is evaluated once
+		 * per shading point.
+		 * @see shadeCache_t
+		 *
+		 */
+		colorA_t cachedColor(renderState_t &state, const surfacePoint_t &sp,
+				const vector3d_t &eye, const scene_t *scene=NULL) const
+		{
+			if (!shadeCache_t::isEnabled()) return stdoutColor(state, sp, eye, scene);
+			shadeCache_t::key_t k;
+			cacheKey(k, shadeCache_t::COLOR, sp, eye);
+			const colorA_t *r = state.shadecache.find(k);
+			if (r!=NULL) return *r;
+			bool outer = state.shadecache.begin();
+			colorA_t res = stdoutColor(state, sp, eye, scene);
+			state.shadecache.end(outer, k, res);
+			return res;
+		}
+		CFLOAT cachedFloat(renderState_t &state, const surfacePoint_t &sp,
+				const vector3d_t &eye, const scene_t *scene=NULL) const
+		{
+			if (!shadeCache_t::isEnabled()) return stdoutFloat(state, sp, eye, scene);
+			shadeCache_t::key_t k;
+			cacheKey(k, shadeCache_t::FLOAT, sp, eye);
+			const colorA_t *r = state.shadecache.find(k);
+			if (r!=NULL) return r->getR();
+			bool outer = state.shadecache.begin();
+			CFLOAT res = stdoutFloat(state, sp, eye, scene);
+			state.shadecache.end(outer, k, colorA_t(res, 0, 0, 0));
+			return res;
+		}
+	protected:
+		void cacheKey(shadeCache_t::key_t &k, shadeCache_t::outputType t,
+				const surfacePoint_t &sp, const vector3d_t &eye) const
+		{
+			k.node = this;
+			k.type = t;
+			k.obj = sp.getObject();
+			k.orco = sp.hasOrco();
+			k.P = sp.P();
+			k.N = sp.N();
+			k.Ng = sp.Ng();
+			k.eye = eye;
+			k.u = sp.hasUV() ? sp.u() : 0;
+			k.v = sp.hasUV() ? sp.v() : 0;
+			k.fw = sp.filterWidth();
+		}
 };
 
 #define FACE_FORWARD(Ng,N,I) ((((Ng)*(I))<0) ? (-N) : (N))
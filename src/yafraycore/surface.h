@@ -78,11 +78,12 @@ class YAFRAYCORE_EXPORT surfacePoint_t
 			suTV = suNV;
 			suNd = n;	// unmodified normal (not displaced)
 			dudu = dudv = dvdu = dvdv = 0;
+			fwidth = 0;
 			originelement=NULL;
 		}
 
 		///An empty constructor
-		surfacePoint_t() { hasorco=false;hasuv=false;  has_vcol=false;  shader=NULL; originelement=NULL; }
+		surfacePoint_t() { hasorco=false;hasuv=false;  has_vcol=false;  shader=NULL; originelement=NULL; fwidth=0; }
 		/// Destructor
 		~surfacePoint_t() {}
 
@@ -142,6 +143,14 @@ class YAFRAYCORE_EXPORT surfacePoint_t
 		void setGradient(GFLOAT uu, GFLOAT uv, GFLOAT vu, GFLOAT vv)
 		{ dudu=uu;  dudv=uv;  dvdu=vu;  dvdv=vv; }
 
+		/// Width of the ray footprint at this point, in the same units as P(). 0 means a point sample
+		PFLOAT filterWidth() const { return fwidth; }
+		void setFilterWidth(PFLOAT w) { fwidth=w; }
+		/// Ray differentials, change of P() per pixel in x & y. Zero when unknown
+		const vector3d_t & dPdx() const { return sudPdx; }
+		const vector3d_t & dPdy() const { return sudPdy; }
+		void setDifferentials(const vector3d_t &dx, const vector3d_t &dy) { sudPdx=dx;  sudPdy=dy; }
+
 		// tangent vectors, from uv, TV crossp of N and tu
 		void setTangent(const vector3d_t &tu) { suTU=tu;  suTV=suN^tu; }
 		const vector3d_t & TU() const { return suTU; }
@@ -172,6 +181,8 @@ class YAFRAYCORE_EXPORT surfacePoint_t
 		const shader_t *shader;
 		bool hasuv, has_vcol,hasorco;
 		GFLOAT dudu,dudv,dvdu,dvdv;
+		PFLOAT fwidth;
+		vector3d_t sudPdx, sudPdy;
 		// only used with 'win' texture coord. mode
 		point3d_t screenpos;
 		// vertex color
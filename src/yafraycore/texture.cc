@@ -496,12 +496,52 @@ bool modulator_t::doMapping(const surfacePoint_t &sp, const vector3d_t &eye,
 //------------------------------------------------------------------------------------------
 // modulator
 
+void footprintOffset(const surfacePoint_t &sp, bool alongV, surfacePoint_t &dsp)
+{
+	dsp = sp;
+	// ray differential when known, else the footprint width along NU or NV
+	vector3d_t d = alongV ? sp.dPdy() : sp.dPdx();
+	if (d.null()) d = (alongV ? sp.NV() : sp.NU()) * sp.filterWidth();
+	PFLOAT du = d*sp.NU(), dv = d*sp.NV();
+	dsp.P() = sp.P() + d;
+	dsp.u() = sp.u() + sp.dudNU()*du + sp.dudNV()*dv;
+	dsp.v() = sp.v() + sp.dvdNU()*du + sp.dvdNV()*dv;
+	if (sp.hasOrco() && sp.getObject())
+	{
+		const object3d_t *obj = sp.getObject();
+		dsp.orco() = sp.orco() + (obj->toObjectOrco(dsp.P()) - obj->toObjectOrco(sp.P()));
+	}
+}
+
+// image coords repeat, so differences are taken the short way around
+static inline GFLOAT wrapDiff(GFLOAT d) { return d - floor(d+0.5); }
+
+GFLOAT footprintWidth(const point3d_t &t, const point3d_t &tu, const point3d_t &tv)
+{
+	GFLOAT ux=wrapDiff(tu.x-t.x), uy=wrapDiff(tu.y-t.y);
+	GFLOAT vx=wrapDiff(tv.x-t.x), vy=wrapDiff(tv.y-t.y);
+	return sqrt(std::max(ux*ux+uy*uy, vx*vx+vy*vy));
+}
+
+GFLOAT modulator_t::filterWidth(const surfacePoint_t &sp, const vector3d_t &eye, const point3d_t &texpt) const
+{
+	if ((sp.filterWidth()<=0) || !_tex->discrete()) return 0;
+	surfacePoint_t dsp;
+	point3d_t tu, tv;
+	footprintOffset(sp, false, dsp);
+	if (doMapping(dsp, eye, tu)) return 0;
+	footprintOffset(sp, true, dsp);
+	if (doMapping(dsp, eye, tv)) return 0;
+	return footprintWidth(texpt, tu, tv);
+}
+
 void modulator_t::modulate(color_t &C, color_t &S, CFLOAT &H, const surfacePoint_t &sp, const vector3d_t &eye) const
 {
 	point3d_t texpt;
 	if (doMapping(sp, eye, texpt)) return;	// doMapping returns true if texture clipped
-	color_t texcolor = _tex->getColor(texpt);
-	CFLOAT texfloat = _tex->getFloat(texpt);
+	GFLOAT width = filterWidth(sp, eye, texpt);
+	color_t texcolor = _tex->getColorFiltered(texpt, width);
+	CFLOAT texfloat = _tex->getFloatFiltered(texpt, width);
 
 	if (_mode==TMO_MIX)
 	{
@@ -537,7 +577,7 @@ void modulator_t::modulate(color_t &T,color_t &R, const surfacePoint_t &sp, cons
 {
 	point3d_t texpt;
 	if (doMapping(sp, eye, texpt)) return;		//returns true if texture clipped
-	color_t texcolor = _tex->getColor(texpt);
+	color_t texcolor = _tex->getColorFiltered(texpt, filterWidth(sp, eye, texpt));
 
 	if(_mode==TMO_MIX)
 	{
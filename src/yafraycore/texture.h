@@ -48,6 +48,9 @@ class YAFRAYCORE_EXPORT texture_t
 
 		virtual colorA_t getColor(const point3d_t &p) const { return color_t(0.0); }
 		virtual CFLOAT getFloat(const point3d_t &p) const { return 0; }
+		// filtered lookups, width is the footprint size in texture space, only image textures use it
+		virtual colorA_t getColorFiltered(const point3d_t &p, GFLOAT width) const { return getColor(p); }
+		virtual CFLOAT getFloatFiltered(const point3d_t &p, GFLOAT width) const { return getFloat(p); }
 
 		// only used with image backgrounds for SH lighting
 		virtual void preFilter(bool spheremap) {}
@@ -195,6 +198,8 @@ class YAFRAYCORE_EXPORT modulator_t
 					point3d_t &texpt) const;
 
 	protected:
+		GFLOAT filterWidth(const surfacePoint_t &sp, const vector3d_t &eye, const point3d_t &texpt) const;
+
 		CFLOAT _color, _specular, _hard, _transmision, _reflection, _displace;
 		GFLOAT _sizex, _sizey, _sizez;	// texture scale factors
 		TEX_MODULATE _mode;
@@ -218,6 +223,11 @@ YAFRAYCORE_EXPORT void angmap(const point3d_t &p, PFLOAT &u, PFLOAT &v);
 YAFRAYCORE_EXPORT void tubemap(const point3d_t &p, PFLOAT &u, PFLOAT &v);
 YAFRAYCORE_EXPORT void spheremap(const point3d_t &p, PFLOAT &u, PFLOAT &v);
 
+// texture filtering, dsp is sp moved by its x (or y if alongV) ray differential
+YAFRAYCORE_EXPORT void footprintOffset(const surfacePoint_t &sp, bool alongV, surfacePoint_t &dsp);
+// texture space footprint width, from the mapping of sp and of its two offset copies
+YAFRAYCORE_EXPORT GFLOAT footprintWidth(const point3d_t &t, const point3d_t &tu, const point3d_t &tv);
+
 __END_YAFRAY
 
 #endif
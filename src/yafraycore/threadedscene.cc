@@ -80,146 +80,80 @@ void threadedscene_t::renderWorker::body()
 	sigset_t origmask;
 	blockSignals(&origmask);
 #endif
+	myseed=seed;
 	renderArea_t *area=scene->dealer.giveMeWork();
 	while(area!=NULL)
 	{
 		if(fake)
 			((scene_t *)scene)->fakeRender(*area);
+		else if(preview>0)
+			((scene_t *)scene)->previewPass(*area, preview);
+		else if(progress>=0)
+			((scene_t *)scene)->progressivePass(*area, progress);
 		else
 			((scene_t *)scene)->render(*area);
+		if(!fake && !preview) scene->frame.put(*area);
 		cout.flush();
 		scene->dealer.imFinished(area);
 		cout.flush();
 		area=scene->dealer.giveMeWork();
 	}
+	seed=myseed;
 #ifndef WIN32
 	restoreSignals(&origmask);
 #endif
 }
 
-void threadedscene_t::render(colorOutput_t &out)
+/* Hands the areas of spliter to the workers, sending them to the output
+ * as they are finished, or the tiles the frame buffer posted with them
+ * when post is set. Returns false if the output aborted the render or it
+ * was cancelled.
+ */
+bool threadedscene_t::renderPass(colorOutput_t &out, blockSpliter_t &spliter,
+		vector<renderArea_t> &areas, vector<renderWorker *> &workers, bool post,
+		const char *pass)
 {
-	int resx,resy;
-	resx=render_camera->resX();
-	resy=render_camera->resY();
-	blockSpliter_t spliter(resx,resy,64);
-
-	vector<renderArea_t> areas(cpus);
-	vector<renderWorker *> workers;
-
-	for(int i=0;i<cpus;++i) workers.push_back(new renderWorker(*this));
-
-	cout<<"Building bounding tree ... ";cout.flush();
-	BTree=buildObjectTree (obj_list);
-	cout<<"OK"<<endl;
-
-	cout<<"Light setup ..."<<endl;
-	setupLights();
-	cout<<endl<<"Launching "<<cpus<<" threads"<<endl;
-
+	double start=getTime();
 #ifndef WIN32
 	sigset_t origmask;
 	blockSignals(&origmask);
 #endif
-
-	while(repeatFirst)
-	{
-		cout<<"\rFake   pass: [";
-		cout.flush();
-		repeatFirst=false;
-		blockSpliter_t fakespliter(resx,resy,64);
-		
-		int total=fakespliter.size();
-		for(int i=0;i<cpus;++i)
-		{
-			fakespliter.getArea(areas[i]);
-			dealer.addWork(&(areas[i]));
-		}
-		for(int i=0;i<cpus;++i) 
-		{
-			workers[i]->fake=true;
-			workers[i]->run();
-		}
-		int finished=0;
-		while(finished<total)
-		{
-			if((finished>0) && !(finished%10)) {cout<<"#";cout.flush();}
-			renderArea_t *finished_area=dealer.getFinished();
-#ifndef WIN32
-#ifdef linux
-			/* WORKAROUND for linux. Since SIGVTALRM caunts thread
-			 * time instead of process time, linux hardly rises it.
-			 *
-			 * This is a fix for blender to catch ESC key. We have to 
-			 * generate the signal ourselves.
-			 *
-			 */
-			if(underItimer()) kill(getpid(), SIGVTALRM);
-#endif
-			restoreSignals(&origmask);
-#endif
-			if(!finished_area->out(out))
-			{
-				cout<<"Aborted"<<endl;
-				for(int i=0;i<cpus;++i) dealer.addWork(NULL);
-				for(int i=0;i<cpus;++i) workers[i]->wait();
-				for(int i=0;i<cpus;++i) delete workers[i];
-				delete BTree;
-				BTree=NULL;
-				return;
-			}
-#ifndef WIN32
-			blockSignals(&origmask);
-#endif
-			if(!fakespliter.empty())
-			{
-				fakespliter.getArea(*finished_area);
-				dealer.addWork(finished_area);
-			}
-			finished++;
-		}
-		for(int i=0;i<cpus;++i) dealer.addWork(NULL);
-		for(int i=0;i<cpus;++i) workers[i]->wait();
-		cout<<"#]"<<endl;
-		postSetupLights();
-	}
-	cout<<endl;
-
-	cout<<"\rRender pass: [";
-	cout.flush();
-
 	int total=spliter.size();
-	for(int i=0;i<cpus;++i)
+	for(int i=0;(i<cpus) && !spliter.empty();++i)
 	{
 		spliter.getArea(areas[i]);
 		dealer.addWork(&(areas[i]));
 	}
-	for(int i=0;i<cpus;++i) 
-	{
-		workers[i]->fake=false;
-		workers[i]->run();
-	}
+	// the first worker goes on with the random numbers of this thread
+	workers[0]->seed=myseed;
+	for(int i=1;i<cpus;++i) workers[i]->seed=ourRandomI();
+	for(int i=0;i<cpus;++i) workers[i]->run();
 	int finished=0;
+	bool aborted=false;
 	while(finished<total)
 	{
 		if((finished>0) && !(finished%10)) {cout<<"#";cout.flush();}
 		renderArea_t *finished_area=dealer.getFinished();
 #ifndef WIN32
 #ifdef linux
+		/* WORKAROUND for linux. Since SIGVTALRM caunts thread
+		 * time instead of process time, linux hardly rises it.
+		 *
+		 * This is a fix for blender to catch ESC key. We have to 
+		 * generate the signal ourselves.
+		 *
+		 */
 		if(underItimer()) kill(getpid(), SIGVTALRM);
 #endif
 		restoreSignals(&origmask);
 #endif
-		if(!finished_area->out(out))
+		if(cancelled || !(post ? frame.flush(out) : finished_area->out(out)))
 		{
 			cout<<"Aborted"<<endl;
-			for(int i=0;i<cpus;++i) dealer.addWork(NULL);
-			for(int i=0;i<cpus;++i) workers[i]->wait();
-			for(int i=0;i<cpus;++i) delete workers[i];
-			delete BTree;
-			BTree=NULL;
-			return;
+			aborted=true;
+			break;
 		}
+		areaDone(pass,*finished_area,finished+1,total,start);
 #ifndef WIN32
 		blockSignals(&origmask);
 #endif
@@ -232,15 +166,106 @@ void threadedscene_t::render(colorOutput_t &out)
 	}
 	for(int i=0;i<cpus;++i) dealer.addWork(NULL);
 	for(int i=0;i<cpus;++i) workers[i]->wait();
-	for(int i=0;i<cpus;++i) delete workers[i];
-	cout<<"#]"<<endl;
-	delete BTree;
-	BTree=NULL;
-	
+	myseed=workers[0]->seed;
 #ifndef WIN32
-	restoreSignals(&origmask);
+	if(!aborted) restoreSignals(&origmask);
 #endif
+	return !aborted;
+}
+
+void threadedscene_t::render(colorOutput_t &out)
+{
+	int resx,resy;
+	resx=render_camera->resX();
+	resy=render_camera->resY();
+	blockSpliter_t spliter(resx,resy,64);
+
+	vector<renderArea_t> areas(cpus);
+	vector<renderWorker *> workers;
+
+	for(int i=0;i<cpus;++i) workers.push_back(new renderWorker(*this));
+
+	render_start=getTime();
+	samples_done=rays_done=0;
+	tellAOVs(out);
+	prepareObjects();
+	cout<<"Building bounding tree ... ";cout.flush();
+	BTree=buildObjectTree (obj_list);
+	cout<<"OK"<<endl;
+
+	cout<<"Light setup ..."<<endl;
+	setupLights();
+	cout<<endl<<"Launching "<<cpus<<" threads"<<endl;
+
+	bool done=true;
+	while(repeatFirst && done)
+	{
+		bool partial=!repeatAll && !repeatCells.empty();
+		cout<<(partial ? "\rRefine pass: [" : "\rFake   pass: [");
+		cout.flush();
+		blockSpliter_t fakespliter(resx,resy,partial ? REPEAT_CELL : 64,
+				partial ? &repeatCells : NULL);
+		repeatFirst=repeatAll=false;
+		repeatCells.assign(repeatCells.size(),false);
+
+		for(int i=0;i<cpus;++i) workers[i]->fake=true;
+		if((done=renderPass(out,fakespliter,areas,workers,false,
+						partial ? "refine" : "fake")))
+		{
+			cout<<"#]"<<endl;
+			postSetupLights();
+		}
+	}
+	if(done) cout<<endl;
+	for(int i=0;i<cpus;++i) workers[i]->fake=false;
+
+	if(done && preview)
+	{
+		previewFrame.set(0,0,resx,resy);
+		double start=getTime();
+		for(int step=PREVIEW_STEP;(step>1) && done;step/=2)
+		{
+			blockSpliter_t prespliter(resx,resy,64);
+			for(int i=0;i<cpus;++i) workers[i]->preview=step;
+			if((done=renderPass(out,prespliter,areas,workers,false,"preview")))
+				cout<<"Preview 1/"<<step<<" "<<(getTime()-start)<<"s"<<endl;
+		}
+		for(int i=0;i<cpus;++i) workers[i]->preview=0;
+		previewFrame=renderArea_t();
+	}
 
+	if(done && progressive)
+	{
+		progressFrame.set(0,0,resx,resy);
+		progressFrame.startStats();
+		progressFrame.setPlanes(aov_list.size());
+		double start=getTime();
+		for(int pass=0;done;++pass)
+		{
+			cout<<"\rProgressive pass "<<(pass+1)<<": [";
+			cout.flush();
+			blockSpliter_t passpliter(resx,resy,64);
+			for(int i=0;i<cpus;++i) workers[i]->progress=pass;
+			frame.start(resx,resy,64,filter_list,aov_list.size());
+			if((done=renderPass(out,passpliter,areas,workers,true,"progressive")))
+				cout<<"#] "<<(getTime()-start)<<"s"<<endl;
+			if(progressiveDone(pass,start)) break;
+		}
+		progressFrame=renderArea_t();
+	}
+	else if(done)
+	{
+		cout<<"\rRender pass: [";
+		cout.flush();
+		frame.start(resx,resy,64,filter_list,aov_list.size());
+		if((done=renderPass(out,spliter,areas,workers,true,"render")))
+			cout<<"#]"<<endl;
+	}
+
+	for(int i=0;i<cpus;++i) delete workers[i];
+	delete BTree;
+	BTree=NULL;
+	if(done) renderStats();
 }
 
 scene_t *threadedscene_t::factory()
@@ -49,13 +49,23 @@ class YAFRAYCORE_EXPORT threadedscene_t : public scene_t
 		class renderWorker : public yafthreads::thread_t
 		{
 			public:
-				renderWorker(threadedscene_t &s):fake(false),scene(&s) {};
+				renderWorker(threadedscene_t &s):fake(false),progress(-1),preview(0),seed(1),scene(&s) {};
 				virtual void body();
 
 				bool fake;
+				// number of the progressive pass, -1 for the normal render
+				int progress;
+				// cell size of the preview level, 0 when not previewing
+				int preview;
+				// random seed of the thread, taken at the start and given back at the end
+				int seed;
 			protected:
 				threadedscene_t *scene;
 		};
+
+		bool renderPass(colorOutput_t &out, blockSpliter_t &spliter,
+				std::vector<renderArea_t> &areas, std::vector<renderWorker *> &workers, bool post,
+				const char *pass);
 };
 
 __END_YAFRAY
@@ -1,11 +1,23 @@
 
 #include "tools.h"
+#include "ccthreads.h"
+#ifdef WIN32
+#include <ctime>
+#else
+#include <sys/time.h>
+#endif
 
 __BEGIN_YAFRAY
 // This is to workaround the stupid msvc restriction of MT library
 // so blame microsoft ....
 
-context_t::context_t()
+#define ARENA_CHUNK 4096
+
+static yafthreads::mutex_t slotMutex;
+static int slotCount=0;
+static std::vector<int> freeSlots;
+
+context_t::context_t(): arenaUsed(ARENA_CHUNK)
 {
 }
 
@@ -14,6 +26,11 @@ context_t::~context_t()
 	for(std::map<void *,destructible *>::iterator i=destructibles.begin();
 		i!=destructibles.end();++i)
 		delete i->second;
+	// arena objects only need their destructor
+	for(std::vector<destructible *>::iterator i=slots.begin();i!=slots.end();++i)
+		if(*i!=NULL) (*i)->~destructible();
+	for(std::vector<char *>::iterator i=arena.begin();i!=arena.end();++i)
+		delete [] *i;
 }
 
 double & context_t::createRecord(std::map<void *,double> &data,void *k)
@@ -27,4 +44,56 @@ context_t::destructible *& context_t::createRecord(
 	return data[k];
 }
 
+int context_t::reserveSlot()
+{
+	slotMutex.wait();
+	int s;
+	if(freeSlots.empty()) s=slotCount++;
+	else
+	{
+		s=freeSlots.back();
+		freeSlots.pop_back();
+	}
+	slotMutex.signal();
+	return s;
+}
+
+void context_t::releaseSlot(int s)
+{
+	slotMutex.wait();
+	freeSlots.push_back(s);
+	slotMutex.signal();
+}
+
+void * context_t::allocate(size_t size)
+{
+	size = (size+15) & ~(size_t)15;
+	if(size>ARENA_CHUNK)
+	{
+		// oversized blocks get their own chunk, placed before the current one
+		char *b=new char[size];
+		arena.insert(arena.end()-(arena.empty() ? 0 : 1), b);
+		return b;
+	}
+	if(arenaUsed+size>ARENA_CHUNK)
+	{
+		arena.push_back(new char[ARENA_CHUNK]);
+		arenaUsed=0;
+	}
+	void *p=arena.back()+arenaUsed;
+	arenaUsed+=size;
+	return p;
+}
+
+double getTime()
+{
+#ifdef WIN32
+	return (double)clock()/(double)CLOCKS_PER_SEC;
+#else
+	struct timeval t;
+	gettimeofday(&t, NULL);
+	return (double)t.tv_sec + 1e-6*(double)t.tv_usec;
+#endif
+}
+
 __END_YAFRAY
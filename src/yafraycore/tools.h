@@ -6,6 +6,7 @@
 #endif
 
 #include<map>
+#include<vector>
 #include<limits>
 #include"color.h"
 #include"vector3d.h"
@@ -30,6 +31,9 @@ inline bool valid(const vector3d_t &c)
 	return validFloat(c.x) && validFloat(c.y) && validFloat(c.y);
 }
 
+/// wall clock time in seconds, for timings and time budgets
+YAFRAYCORE_EXPORT double getTime();
+
 template<class S, class D>
 class Conversion
 {
@@ -174,10 +178,39 @@ class YAFRAYCORE_EXPORT context_t
 			return back<T, sizeof(T)<=sizeof(double),true>::get(d,data,present,destructibles);
 		};
 
+		/** Slots, the fast way to keep per render state objects.
+		 *
+		 * A plugin reserves its slots once, when created, and gets or stores
+		 * its objects with the index: a plain array access instead of a map
+		 * search. Objects stored in slots are built in memory from allocate(),
+		 * they live in an arena freed in one go with the context.
+		 * The plugin gives its slots back in its destructor, so lights
+		 * redefined between renders reuse them instead of growing every
+		 * context. No render state may be alive then.
+		 *
+		 */
+		static int reserveSlot();
+		static void releaseSlot(int s);
+		destructible * getSlot(int s) const
+		{
+			return (s<(int)slots.size()) ? slots[s] : NULL;
+		}
+		void storeSlot(int s, destructible *d)
+		{
+			if (s>=(int)slots.size()) slots.resize(s+1, NULL);
+			if (slots[s]!=NULL) slots[s]->~destructible();
+			slots[s] = d;
+		}
+		/// Arena memory for an object to store in a slot, use with placement new
+		void * allocate(size_t size);
+
 	protected:
 
 		std::map<void *,double> data;
 		std::map<void *,destructible *> destructibles;
+		std::vector<destructible *> slots;
+		std::vector<char *> arena;
+		size_t arenaUsed;
 };
 
 __END_YAFRAY
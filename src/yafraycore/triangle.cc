@@ -27,48 +27,124 @@ using namespace std;
 
 __BEGIN_YAFRAY
 
-triangle_t::triangle_t(point3d_t *va,point3d_t *vb,point3d_t *vc)
+triangle_t::triangle_t(unsigned int a,unsigned int b,unsigned int c)
+	:va(a),vb(b),vc(c),na(TRI_NONE),nb(TRI_NONE),nc(TRI_NONE),uv(TRI_NONE),vcol(TRI_NONE),
+	mesh(NULL),shader(NULL),normal(0,0,0)
 {
-	a=va;
-	b=vb;
-	c=vc;
-	normal=((*b)-(*a))^((*c)-(*a));
-	normal.normalize();
-	//uv=NULL;
-	hasuv = false;
-	has_vcol = false;
-	na=nb=nc=NULL;
-	ta = tb = tc = NULL;
-	shader=NULL;
 }
 
+// needs the mesh
 void triangle_t::recNormal()
 {
-	normal=((*b)-(*a))^((*c)-(*a));
+	normal=(B()-A())^(C()-A());
 	normal.normalize();
 }
 
-triangle_t::triangle_t():normal(0,0,0)
+triangle_t::triangle_t()
+	:va(0),vb(0),vc(0),na(TRI_NONE),nb(TRI_NONE),nc(TRI_NONE),uv(TRI_NONE),vcol(TRI_NONE),
+	mesh(NULL),shader(NULL),normal(0,0,0)
 {
-	a=NULL;
-	b=NULL;
-	c=NULL;
-	hasuv = false;
-	has_vcol = false;
-	na=nb=nc=NULL;
-	ta = tb = tc = NULL;
-	shader=NULL;
 }
 
-void triangle_t::setVertices(point3d_t *va,point3d_t *vb,point3d_t *vc)
+void triangle_t::setVertices(unsigned int a,unsigned int b,unsigned int c)
 {
-	a=va;
-	b=vb;
-	c=vc;
-	normal=((*b)-(*a))^((*c)-(*a));
-	normal.normalize();
-	na=nb=nc=NULL;
-	ta = tb = tc = NULL;
+	va=a;
+	vb=b;
+	vc=c;
+	na=nb=nc=TRI_NONE;
+	if(mesh!=NULL) recNormal();
+}
+
+/* Octahedral code of a direction: the vector is projected on the octahedron
+ * |x|+|y|+|z|=1, the lower half folded over the upper one, and x and y kept
+ * in 16 bits each.
+ */
+unsigned int meshData_t::octEncode(const vector3d_t &v)
+{
+	PFLOAT l=fabs(v.x)+fabs(v.y)+fabs(v.z);
+	if(l==0) return 0x80008000;
+	PFLOAT x=v.x/l, y=v.y/l;
+	if(v.z<0)
+	{
+		PFLOAT fx=(1.0-fabs(y))*((x<0) ? -1.0 : 1.0);
+		y=(1.0-fabs(x))*((y<0) ? -1.0 : 1.0);
+		x=fx;
+	}
+	unsigned int cx=(unsigned int)((x*0.5+0.5)*65535.0+0.5);
+	unsigned int cy=(unsigned int)((y*0.5+0.5)*65535.0+0.5);
+	return (cx<<16) | cy;
+}
+
+vector3d_t meshData_t::octDecode(unsigned int code)
+{
+	PFLOAT x=(PFLOAT)(code>>16)*(2.0/65535.0)-1.0;
+	PFLOAT y=(PFLOAT)(code&0xffff)*(2.0/65535.0)-1.0;
+	PFLOAT z=1.0-fabs(x)-fabs(y);
+	if(z<0)
+	{
+		PFLOAT fx=(1.0-fabs(y))*((x<0) ? -1.0 : 1.0);
+		y=(1.0-fabs(x))*((y<0) ? -1.0 : 1.0);
+		x=fx;
+	}
+	vector3d_t v(x,y,z);
+	v.normalize();
+	return v;
+}
+
+void meshData_t::pack()
+{
+	if(compact) return;
+	cnormals.resize(normals.size());
+	for(unsigned int i=0;i<normals.size();++i) cnormals[i]=octEncode(normals[i]);
+	ctangents.resize(tangents.size());
+	for(unsigned int i=0;i<tangents.size();++i) ctangents[i]=octEncode(tangents[i]);
+
+	for(int k=0;k<2;++k)
+	{
+		GFLOAT lo=0, hi=0;
+		for(unsigned int i=k;i<facesuv.size();i+=2)
+		{
+			if((i==(unsigned int)k) || (facesuv[i]<lo)) lo=facesuv[i];
+			if((i==(unsigned int)k) || (facesuv[i]>hi)) hi=facesuv[i];
+		}
+		uvmin[k]=lo;
+		uvstep[k]=(hi>lo) ? (hi-lo)/65535.0 : 1.0;
+	}
+	cuv.resize(facesuv.size());
+	for(unsigned int i=0;i<facesuv.size();++i)
+		cuv[i]=(unsigned short)((facesuv[i]-uvmin[i&1])/uvstep[i&1]+0.5);
+
+	cvcol.resize(faces_vcol.size());
+	for(unsigned int i=0;i<faces_vcol.size();++i)
+	{
+		CFLOAT c=faces_vcol[i];
+		c=(c<0) ? 0 : ((c>1) ? 1 : c);
+		cvcol[i]=(unsigned char)(c*255.0+0.5);
+	}
+	// swap with empty ones, clear() keeps the memory
+	std::vector<vector3d_t>().swap(normals);
+	std::vector<vector3d_t>().swap(tangents);
+	std::vector<GFLOAT>().swap(facesuv);
+	std::vector<CFLOAT>().swap(faces_vcol);
+	compact=true;
+}
+
+void meshData_t::unpack()
+{
+	if(!compact) return;
+	compact=false;
+	normals.resize(cnormals.size());
+	for(unsigned int i=0;i<cnormals.size();++i) normals[i]=octDecode(cnormals[i]);
+	tangents.resize(ctangents.size());
+	for(unsigned int i=0;i<ctangents.size();++i) tangents[i]=octDecode(ctangents[i]);
+	facesuv.resize(cuv.size());
+	for(unsigned int i=0;i<cuv.size();++i) facesuv[i]=uvmin[i&1]+uvstep[i&1]*(GFLOAT)cuv[i];
+	faces_vcol.resize(cvcol.size());
+	for(unsigned int i=0;i<cvcol.size();++i) faces_vcol[i]=(CFLOAT)cvcol[i]*(1.0/255.0);
+	std::vector<unsigned int>().swap(cnormals);
+	std::vector<unsigned int>().swap(ctangents);
+	std::vector<unsigned short>().swap(cuv);
+	std::vector<unsigned char>().swap(cvcol);
 }
 
 static bool getInterpolation(const vector3d_t &N, const point3d_t &a,const point3d_t &b,const point3d_t &c
@@ -137,69 +213,75 @@ static bool getInterpolation(const vector3d_t &N, const point3d_t &a,const point
 
 surfacePoint_t triangle_t::getSurface(point3d_t &h,PFLOAT d,bool orco)const
 {
-	if( (!hasuv) && (!has_vcol) && (na==NULL) && !orco)
+	bool hasuv=(uv!=TRI_NONE), has_vcol=(vcol!=TRI_NONE);
+	if( (!hasuv) && (!has_vcol) && (na==TRI_NONE) && !orco)
 		return surfacePoint_t(NULL, h,h, normal, normal, -1, -1, color_t(0.0), d, shader);
 	vector3d_t nn=normal;
 	GFLOAT fa,fb,fc;
-	//if (!getInterpolation(*a, *b, *c, h, fa, fb, fc))
+	//if (!getInterpolation(A(), B(), C(), h, fa, fb, fc))
 	//	return surfacePoint_t(NULL, h, h, normal, normal, -1, -1, color_t(0.0), d, shader);
-	if (!getInterpolation(normal, *a, *b, *c, h, fa, fb, fc))
+	if (!getInterpolation(normal, A(), B(), C(), h, fa, fb, fc))
 		return surfacePoint_t(NULL, h, h, normal, normal, -1, -1, color_t(0.0), d, shader);
+	const meshData_t &m=*mesh;
 	point3d_t orcoP=h;
-	if(orco) orcoP=*(a+1)*fa+*(b+1)*fb+*(c+1)*fc;
-	if(na!=NULL)
+	if(orco) orcoP=m.vertices[va+1]*fa+m.vertices[vb+1]*fb+m.vertices[vc+1]*fc;
+	if(na!=TRI_NONE)
 	{
-		nn = (*na)*fa+(*nb)*fb+(*nc)*fc;
+		nn = m.normal(na)*fa+m.normal(nb)*fb+m.normal(nc)*fc;
 		nn.normalize();
 	}
 	GFLOAT u=0, v=0;
+	GFLOAT tuv[6];
 	if (hasuv)
 	{
-		u=uv[0]*fa+uv[2]*fb+uv[4]*fc;
-		v=uv[1]*fa+uv[3]*fb+uv[5]*fc;
+		for(int i=0;i<6;++i) tuv[i]=m.uv(uv+i);
+		u=tuv[0]*fa+tuv[2]*fb+tuv[4]*fc;
+		v=tuv[1]*fa+tuv[3]*fb+tuv[5]*fc;
 	}
 	color_t vcolor(0.0);
 	if (has_vcol) {
-		vcolor.set(vcol[0]*fa + vcol[3]*fb + vcol[6]*fc,
-							 vcol[1]*fa + vcol[4]*fb + vcol[7]*fc,
-							 vcol[2]*fa + vcol[5]*fb + vcol[8]*fc);
+		CFLOAT c[9];
+		for(int i=0;i<9;++i) c[i]=m.vcol(vcol+i);
+		vcolor.set(c[0]*fa + c[3]*fb + c[6]*fc,
+							 c[1]*fa + c[4]*fb + c[7]*fc,
+							 c[2]*fa + c[5]*fb + c[8]*fc);
 	}
 
 	surfacePoint_t temp(NULL, h,orcoP,nn, normal, u, v, vcolor, d, shader, hasuv, has_vcol,orco);
 	if (hasuv)
 	{
-		vector3d_t vb=(*b)-(*a);
-		vector3d_t vc=(*c)-(*a);
-		GFLOAT lenb=vb.length();
+		vector3d_t eb=B()-A();
+		vector3d_t ec=C()-A();
+		GFLOAT lenb=eb.length();
 
-		GFLOAT dub=(uv[2]-uv[0])/lenb;
-		GFLOAT dvb=(uv[3]-uv[1])/lenb;
-		vb/=lenb;
-		GFLOAT nuc=uv[4],nvc=uv[5],proj=vc*vb;
+		GFLOAT dub=(tuv[2]-tuv[0])/lenb;
+		GFLOAT dvb=(tuv[3]-tuv[1])/lenb;
+		eb/=lenb;
+		GFLOAT nuc=tuv[4],nvc=tuv[5],proj=ec*eb;
 
-		vc=vc-vb*proj;
+		ec=ec-eb*proj;
 		nuc-=proj*dub;
 		nvc-=proj*dvb;
 
-		GFLOAT lenc=vc.length();
-		GFLOAT duc=(nuc-uv[0])/lenc;
-		GFLOAT dvc=(nvc-uv[1])/lenc;
-		vc/=lenc;
+		GFLOAT lenc=ec.length();
+		GFLOAT duc=(nuc-tuv[0])/lenc;
+		GFLOAT dvc=(nvc-tuv[1])/lenc;
+		ec/=lenc;
 
-		GFLOAT projC=temp.NU()*vc,projB=temp.NU()*vb;
+		GFLOAT projC=temp.NU()*ec,projB=temp.NU()*eb;
 		GFLOAT dudu=projC*duc+projB*dub;
 		GFLOAT dvdu=projC*dvc+projB*dvb;
 
-		projC=temp.NV()*vc,projB=temp.NV()*vb;
+		projC=temp.NV()*ec,projB=temp.NV()*eb;
 		GFLOAT dudv=projC*duc+projB*dub;
 		GFLOAT dvdv=projC*dvc+projB*dvb;
 
 		temp.setGradient(dudu,dudv,dvdu,dvdv);
 	}
 	// tangents
-	if (orco | hasuv)
+	if ((orco | hasuv) && m.hasTangents())
 	{
-		vector3d_t tn((*ta)*fa + (*tb)*fb + (*tc)*fc);
+		vector3d_t tn(m.tangent(va)*fa + m.tangent(vb)*fb + m.tangent(vc)*fc);
 		tn.normalize();
 		temp.setTangent(tn);
 	}
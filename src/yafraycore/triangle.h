@@ -34,26 +34,90 @@
 
 __BEGIN_YAFRAY
 
+#define TRI_NONE 0xffffffff
+
+/** Vertex data of a mesh, indexed by its triangles
+ *
+ * Normals and tangents are indexed like the vertices, uvs and vertex colors
+ * by face corner. In compact mode they are kept as 32 bit octahedral codes,
+ * 16 bit steps of the uv range and 8 bit colors, and only decoded when a
+ * hit is shaded. Vertices are always full floats, rays hit them.
+ */
+class YAFRAYCORE_EXPORT meshData_t
+{
+	public:
+		meshData_t(): compact(false) {};
+
+		vector3d_t normal(unsigned int i)const
+		{
+			return compact ? octDecode(cnormals[i]) : normals[i];
+		}
+		vector3d_t tangent(unsigned int i)const
+		{
+			return compact ? octDecode(ctangents[i]) : tangents[i];
+		}
+		GFLOAT uv(unsigned int i)const
+		{
+			return compact ? uvmin[i&1]+uvstep[i&1]*(GFLOAT)cuv[i] : facesuv[i];
+		}
+		CFLOAT vcol(unsigned int i)const
+		{
+			return compact ? (CFLOAT)cvcol[i]*(1.0/255.0) : faces_vcol[i];
+		}
+		bool hasTangents()const {return !tangents.empty() || !ctangents.empty();};
+
+		/// moves normals, tangents, uvs and colors to the compact arrays
+		void pack();
+		/// back to floats, to change them
+		void unpack();
+		bool isCompact()const {return compact;};
+
+		static unsigned int octEncode(const vector3d_t &v);
+		static vector3d_t octDecode(unsigned int code);
+
+		std::vector<point3d_t> vertices;
+		std::vector<vector3d_t> normals, tangents;
+		std::vector<GFLOAT> facesuv;
+		std::vector<CFLOAT> faces_vcol;
+	protected:
+		bool compact;
+		std::vector<unsigned int> cnormals, ctangents;
+		std::vector<unsigned short> cuv;
+		std::vector<unsigned char> cvcol;
+		// range of u (0) and v (1)
+		GFLOAT uvmin[2], uvstep[2];
+};
+
+/** Face of a mesh
+ *
+ * Vertices, normals, uvs and colors are indices in the meshData_t set with
+ * setMesh(), TRI_NONE when the face has none. Tangents go with the
+ * vertices.
+ */
 class YAFRAYCORE_EXPORT triangle_t
 {
 	public:
-		triangle_t(point3d_t *va,point3d_t *vb,point3d_t *vc);
+		triangle_t(unsigned int a,unsigned int b,unsigned int c);
 		triangle_t();
 		~triangle_t() {};
-		void setVertices(point3d_t *va,point3d_t *vb,point3d_t *vc);
+		void setMesh(const meshData_t *m) {mesh=m;};
+		void setVertices(unsigned int a,unsigned int b,unsigned int c);
+		const point3d_t & A()const {return mesh->vertices[va];};
+		const point3d_t & B()const {return mesh->vertices[vb];};
+		const point3d_t & C()const {return mesh->vertices[vc];};
 		bool itsZP() {return (normal.z==0);};
 		bool itsYP() {return (normal.y==0);};
 		bool itsXP() {return (normal.x==0);};
 		bool Z_hit();
 		bool hit(const point3d_t &from,const vector3d_t &ray)
 		{
-			const vector3d_t va=(*a)-from,vb=(*b)-from,vc=(*c)-from;
+			const vector3d_t pa=A()-from,pb=B()-from,pc=C()-from;
 			vector3d_t r;
 			if((ray*normal)<0) r=-ray;
 			else r=ray;
-			if( ((va^vb)*r)<0 ) return false;
-			if( ((vb^vc)*r)<0 ) return false;
-			if( ((vc^va)*r)<0 ) return false;
+			if( ((pa^pb)*r)<0 ) return false;
+			if( ((pb^pc)*r)<0 ) return false;
+			if( ((pc^pa)*r)<0 ) return false;
 			return true;
 		}
 		/*
@@ -62,12 +126,12 @@ class YAFRAYCORE_EXPORT triangle_t
 		{
 			 vector3d_t edge1, tvec, pvec;
 			 PFLOAT det,inv_det,u,v;
-			 edge1=(*b)-(*a);
-			 pvec= ray^((*c)-(*a));
+			 edge1=B()-A();
+			 pvec= ray^(C()-A());
 			 det = edge1*pvec;
 			 if ((det>-MIN_RAYDIST) && (det<MIN_RAYDIST)) return false;
 			 inv_det = 1.0 / det;
-			 tvec=from-(*a);
+			 tvec=from-A();
 			 u = (tvec*pvec) * inv_det;
 			 if (u < 0.0 || u > 1.0) return false;
 			 v = (ray*(tvec^edge1)) * inv_det;
@@ -78,30 +142,32 @@ class YAFRAYCORE_EXPORT triangle_t
 		
 		PFLOAT Z_intersect()
 		{
-			return (normal*(toVector(*a)))/normal.z;
+			return (normal*(toVector(A())))/normal.z;
 		};
 		PFLOAT intersect(const point3d_t &from,const vector3d_t &ray)
 		{
-			return (normal*(*a-from))/(normal*ray);
+			return (normal*(A()-from))/(normal*ray);
 		}
 		void recNormal();
 		const vector3d_t & N() const {return normal;};
 
 		surfacePoint_t  getSurface(point3d_t &h,PFLOAT d,bool orco=false)const;
-		void setNormals(vector3d_t *_na,vector3d_t *_nb,vector3d_t *_nc)
-			{na=_na;nb=_nb;nc=_nc;};
-		void setUV(std::vector<GFLOAT>::iterator _uv) { uv=_uv;  hasuv=true; }
-		void setVCOL(std::vector<CFLOAT>::iterator _vcol) { vcol=_vcol;  has_vcol=true; }
+		void setNormals(unsigned int a,unsigned int b,unsigned int c)
+			{na=a;nb=b;nc=c;};
+		/// first of the 6 uvs of the face
+		void setUV(unsigned int first) {uv=first;};
+		/// first of the 9 color components of the face
+		void setVCOL(unsigned int first) {vcol=first;};
+		bool hasUV()const {return uv!=TRI_NONE;};
+		bool hasVCOL()const {return vcol!=TRI_NONE;};
 		void setShader(const shader_t *sha) {shader=sha;};
 		const shader_t * getShader()const {return shader;};
 
-		point3d_t *a,*b,*c;
-		vector3d_t *na,*nb,*nc;
-		vector3d_t *ta, *tb, *tc;
-		std::vector<GFLOAT>::iterator uv;
-		std::vector<CFLOAT>::iterator vcol;
-		bool hasuv, has_vcol;
+		unsigned int va,vb,vc;
+		unsigned int na,nb,nc;
+		unsigned int uv,vcol;
 	protected:
+		const meshData_t *mesh;
 		const shader_t *shader;
 		vector3d_t normal;
 };
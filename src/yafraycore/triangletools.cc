@@ -206,22 +206,22 @@ int cheapPosition(const triangle_t &tri,const bound_t &bound,PFLOAT Z,int axis)
 	switch(axis)
 	{
 		case AXISX:
-			az=tri.a->x;bz=tri.b->x;cz=tri.c->x;
-			inside  =((tri.a->y>=min.y) && (tri.a->y<=max.y) && (tri.a->z>=min.z) && (tri.a->z<=max.z));
-			inside&=((tri.b->y>=min.y) && (tri.b->y<=max.y) && (tri.b->z>=min.z) && (tri.b->z<=max.z));
-			inside&=((tri.c->y>=min.y) && (tri.c->y<=max.y) && (tri.c->z>=min.z) && (tri.c->z<=max.z));
+			az=tri.A().x;bz=tri.B().x;cz=tri.C().x;
+			inside  =((tri.A().y>=min.y) && (tri.A().y<=max.y) && (tri.A().z>=min.z) && (tri.A().z<=max.z));
+			inside&=((tri.B().y>=min.y) && (tri.B().y<=max.y) && (tri.B().z>=min.z) && (tri.B().z<=max.z));
+			inside&=((tri.C().y>=min.y) && (tri.C().y<=max.y) && (tri.C().z>=min.z) && (tri.C().z<=max.z));
 			break;
 		case AXISY:
-			az=tri.a->y;bz=tri.b->y;cz=tri.c->y;
-			inside  =((tri.a->x>=min.x) && (tri.a->x<=max.x) && (tri.a->z>=min.z) && (tri.a->z<=max.z));
-			inside&=((tri.b->x>=min.x) && (tri.b->x<=max.x) && (tri.b->z>=min.z) && (tri.b->z<=max.z));
-			inside&=((tri.c->x>=min.x) && (tri.c->x<=max.x) && (tri.c->z>=min.z) && (tri.c->z<=max.z));
+			az=tri.A().y;bz=tri.B().y;cz=tri.C().y;
+			inside  =((tri.A().x>=min.x) && (tri.A().x<=max.x) && (tri.A().z>=min.z) && (tri.A().z<=max.z));
+			inside&=((tri.B().x>=min.x) && (tri.B().x<=max.x) && (tri.B().z>=min.z) && (tri.B().z<=max.z));
+			inside&=((tri.C().x>=min.x) && (tri.C().x<=max.x) && (tri.C().z>=min.z) && (tri.C().z<=max.z));
 			break;
 		case AXISZ:
-			az=tri.a->z;bz=tri.b->z;cz=tri.c->z;
-			inside  =((tri.a->x>=min.x) && (tri.a->x<=max.x) && (tri.a->y>=min.y) && (tri.a->y<=max.y));
-			inside&=((tri.b->x>=min.x) && (tri.b->x<=max.x) && (tri.b->y>=min.y) && (tri.b->y<=max.y));
-			inside&=((tri.c->x>=min.x) && (tri.c->x<=max.x) && (tri.c->y>=min.y) && (tri.c->y<=max.y));
+			az=tri.A().z;bz=tri.B().z;cz=tri.C().z;
+			inside  =((tri.A().x>=min.x) && (tri.A().x<=max.x) && (tri.A().y>=min.y) && (tri.A().y<=max.y));
+			inside&=((tri.B().x>=min.x) && (tri.B().x<=max.x) && (tri.B().y>=min.y) && (tri.B().y<=max.y));
+			inside&=((tri.C().x>=min.x) && (tri.C().x<=max.x) && (tri.C().y>=min.y) && (tri.C().y<=max.y));
 			break;
 	}
 	
@@ -245,7 +245,7 @@ int cheapPosition(const triangle_t &tri,const bound_t &bound,PFLOAT Z,int axis)
 
 int expensivePosition(const triangle_t &tri,const bound_t &bound,PFLOAT Z,int axis)
 {
-	const point3d_t &a3=*(tri.a),&b3=*(tri.b),&c3=*(tri.c);
+	const point3d_t &a3=tri.A(),&b3=tri.B(),&c3=tri.C();
 	point3d_t bmin,bmax;
 	const vector3d_t &n=tri.N();
 	bound.get(bmin,bmax);
@@ -296,7 +296,7 @@ int expensivePosition(const triangle_t &tri,const bound_t &bound,PFLOAT Z,int ax
 
 inline PFLOAT cheapMaximize(const triangle_t &tri,int axis)
 {
-	const point3d_t &a=*(tri.a),&b=*(tri.b),&c=*(tri.c);
+	const point3d_t &a=tri.A(),&b=tri.B(),&c=tri.C();
 	PFLOAT Z=0;
 	switch(axis)
 	{
@@ -321,7 +321,7 @@ inline PFLOAT cheapMaximize(const triangle_t &tri,int axis)
 
 inline PFLOAT cheapMinimize(const triangle_t &tri,int axis)
 {
-	const point3d_t &a=*(tri.a),&b=*(tri.b),&c=*(tri.c);
+	const point3d_t &a=tri.A(),&b=tri.B(),&c=tri.C();
 	PFLOAT Z=0;
 	switch(axis)
 	{
@@ -347,7 +347,7 @@ inline PFLOAT cheapMinimize(const triangle_t &tri,int axis)
 template<class F>
 PFLOAT expensiveMaxMin(const triangle_t &tri,const square_t &q,int axis,F &func)
 {
-	const point3d_t &a3=*(tri.a),&b3=*(tri.b),&c3=*(tri.c);
+	const point3d_t &a3=tri.A(),&b3=tri.B(),&c3=tri.C();
 	const vector3d_t &n=tri.N();
 
 	point3d_t a=a3,b=b3,c=c3;
@@ -414,7 +414,7 @@ PFLOAT minimize(const vector<triangle_t *> faces,const bound_t &bound,int axis)
 	PFLOAT Z=numeric_limits<PFLOAT>::infinity();
 	for(vector<triangle_t *>::const_iterator i=faces.begin();i!=faces.end();++i)
 	{
-		const point3d_t &a=*((*i)->a),&b=*((*i)->b),&c=*((*i)->c);
+		const point3d_t &a=(*i)->A(),&b=(*i)->B(),&c=(*i)->C();
 		PFLOAT z;
 		minimize_f func;
 		if(q.isInside(a) && q.isInside(b) && q.isInside(c)) z=cheapMinimize(**i,axis);
@@ -458,7 +458,7 @@ PFLOAT maximize(const vector<triangle_t *> faces,const bound_t &bound,int axis)
 	PFLOAT Z=-numeric_limits<PFLOAT>::infinity();
 	for(vector<triangle_t *>::const_iterator i=faces.begin();i!=faces.end();++i)
 	{
-		const point3d_t &a=*((*i)->a),&b=*((*i)->b),&c=*((*i)->c);
+		const point3d_t &a=(*i)->A(),&b=(*i)->B(),&c=(*i)->C();
 		PFLOAT z;
 		maximize_f func;
 		if(q.isInside(a) && q.isInside(b) && q.isInside(c)) z=cheapMaximize(**i,axis);
@@ -157,7 +157,7 @@ void ShirleyDisk(PFLOAT r1, PFLOAT r2, PFLOAT &u, PFLOAT &v)
 
 
 
-YAFRAYCORE_EXPORT int myseed=123212;
+YAFRAYCORE_EXPORT YAF_THREAD_LOCAL int myseed=123212;
 
 vector3d_t randomVectorCone(const vector3d_t &D,
 				const vector3d_t &U, const vector3d_t &V,
@@ -259,7 +259,25 @@ inline void createCS(const vector3d_t &N, vector3d_t &u, vector3d_t &v)
 
 YAFRAYCORE_EXPORT void ShirleyDisk(PFLOAT r1, PFLOAT r2, PFLOAT &u, PFLOAT &v);
 
-extern YAFRAYCORE_EXPORT int myseed;
+/* Every thread has its own seed where the compiler can do it, so a
+ * deterministic render can restart it at every camera sample. */
+#if HAVE_PTHREAD && defined(__GNUC__) && !defined(WIN32)
+#define YAF_THREAD_LOCAL __thread
+#else
+#define YAF_THREAD_LOCAL
+#endif
+
+extern YAFRAYCORE_EXPORT YAF_THREAD_LOCAL int myseed;
+
+/// a seed for ourRandom() made from two indices, as a pixel and a sample
+inline int indexSeed(unsigned int a,unsigned int b)
+{
+	unsigned int h = a*0x9e3779b1u ^ (b+0x7f4a7c15u);
+	h ^= h>>16;  h *= 0x85ebca6bu;
+	h ^= h>>13;  h *= 0xc2b2ae35u;
+	h ^= h>>16;
+	return (int)(h%2147483646u)+1;
+}
 
 inline int ourRandomI()
 {